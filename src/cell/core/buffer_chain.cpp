@@ -0,0 +1,167 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "buffer_chain.hpp"
+
+#include <utility>
+
+namespace cell {
+
+String& BufferChain::get_append_buffer() noexcept {
+  if (m_end != m_begin && m_end > m_sealed) {
+    Segment& last = m_segments[m_end - 1];
+    if (last.kind == Kind::Copy) {
+      return last.buffer;
+    }
+  }
+  return push(Kind::Copy).buffer;
+}
+
+void BufferChain::append_owned(String& bytes) noexcept {
+  if (bytes.get_length() == 0) {
+    return;
+  }
+
+  Segment& segment = push(Kind::Owned);
+  segment.buffer.swap(bytes);
+}
+
+void BufferChain::append_borrowed(StringSlice bytes) noexcept {
+  if (bytes.get_length() == 0) {
+    return;
+  }
+
+  push(Kind::Borrowed).borrowed = bytes;
+}
+
+void BufferChain::append_file(FileSpan span) noexcept {
+  if (span.length == 0) {
+    return;
+  }
+
+  push(Kind::File).file = std::move(span);
+}
+
+u64 BufferChain::get_length() const noexcept {
+  u64 length = 0;
+  for (u64 i = m_begin; i < m_end; ++i) {
+    length += m_segments[i].get_length();
+  }
+  return length - m_offset;
+}
+
+u32 BufferChain::fill_iovecs(iovec* vectors, u32 count) const noexcept {
+  u32 filled = 0;
+  u64 offset = m_offset;
+
+  for (u64 i = m_begin; i < m_end && filled < count; ++i) {
+    if (m_segments[i].kind == Kind::File) {
+      break;
+    }
+
+    const StringSlice bytes = m_segments[i].bytes();
+    if (bytes.get_length() > offset) {
+      vectors[filled].iov_base = const_cast<u8*>(bytes.get_u8_ptr() + offset);
+      vectors[filled].iov_len = bytes.get_length() - offset;
+      ++filled;
+    }
+    offset = 0;
+  }
+  return filled;
+}
+
+bool BufferChain::get_front_file(int& fd, u64& offset, u64& length) const noexcept {
+  if (m_begin == m_end || m_segments[m_begin].kind != Kind::File) {
+    return false;
+  }
+
+  const FileSpan& span = m_segments[m_begin].file;
+  fd = span.file->get_fd();
+  offset = span.offset + m_offset;
+  length = span.length - m_offset;
+  return true;
+}
+
+void BufferChain::consume(u64 count) noexcept {
+  while (count != 0 && m_begin != m_end) {
+    Segment& segment = m_segments[m_begin];
+    const u64 left = segment.get_length() - m_offset;
+
+    if (count < left) {
+      m_offset += count;
+      return;
+    }
+
+    count -= left;
+    m_offset = 0;
+    recycle(segment);
+    ++m_begin;
+  }
+
+  // An empty copy buffer left at the front is done with too
+  while (m_begin != m_end && m_segments[m_begin].get_length() == 0) {
+    recycle(m_segments[m_begin]);
+    ++m_begin;
+  }
+
+  if (m_begin == m_end) {
+    m_begin = m_end = m_sealed = 0;
+  }
+}
+
+void BufferChain::clear() noexcept {
+  for (u64 i = m_begin; i < m_end; ++i) {
+    recycle(m_segments[i]);
+  }
+  m_begin = m_end = m_sealed = m_offset = 0;
+}
+
+void BufferChain::shrink() noexcept {
+  for (u64 i = 0; i < m_segments.size(); ++i) {
+    String& buffer = m_segments[i].buffer;
+    if ((i < m_begin || i >= m_end) && buffer.get_capacity() > MAX_IDLE_CAPACITY) {
+      String fresh{};
+      buffer.swap(fresh);
+    }
+  }
+}
+
+BufferChain::Segment& BufferChain::push(Kind kind) noexcept {
+  if (m_end == m_segments.size()) {
+    if (m_begin != 0) {
+      // Slide the live segments to the front. Swapping moves String objects,
+      // not their bytes, so sealed segments stay where the kernel reads them.
+      for (u64 i = m_begin; i < m_end; ++i) {
+        Segment& from = m_segments[i];
+        Segment& to = m_segments[i - m_begin];
+        to.kind = from.kind;
+        to.buffer.swap(from.buffer);
+        to.borrowed = from.borrowed;
+        to.file = std::move(from.file);
+      }
+      m_end -= m_begin;
+      m_sealed = m_sealed > m_begin ? m_sealed - m_begin : 0;
+      m_begin = 0;
+    } else {
+      m_segments.emplace_back();
+    }
+  }
+
+  Segment& segment = m_segments[m_end++];
+  segment.kind = kind;
+  segment.buffer.set_length(0);
+  return segment;
+}
+
+void BufferChain::recycle(Segment& segment) noexcept {
+  segment.borrowed = StringSlice{nullptr, 0};
+  segment.file = {};
+  if (segment.buffer.get_capacity() > MAX_RETAINED_CAPACITY) {
+    String fresh{};
+    segment.buffer.swap(fresh);
+  } else {
+    segment.buffer.set_length(0);
+  }
+}
+
+}  // namespace cell
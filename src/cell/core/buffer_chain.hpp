@@ -0,0 +1,113 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_BUFFER_CHAIN_HPP
+#define CELL_BUFFER_CHAIN_HPP
+
+#include <sys/uio.h>
+
+#include <vector>
+
+#include "cell/core/file_handle.hpp"
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+
+namespace cell {
+
+// Outgoing bytes as a list of segments, handed to writev()/sendmsg() as one
+// iovec array instead of being concatenated first. A segment is either
+//
+//   o a copy buffer, that small appends (status lines, headers, short
+//     bodies) go into,
+//   o an owned String, taken over by swapping buffers rather than copying,
+//   o borrowed bytes, which must stay put until they are consumed,
+//   o or a span of an open file, which never enters user space: the iovecs
+//     stop in front of it and it goes out with sendfile() or splice().
+//
+// Segment slots and their buffers are recycled once sent, so a connection
+// stops allocating after its first few responses.
+class BufferChain {
+ public:
+  // Bodies up to this size are cheaper to copy than to give an iovec of their own
+  static constexpr u64 COPY_THRESHOLD = 1024;
+  // iovecs worth filling per send, the rest goes out with the next one
+  static constexpr u32 MAX_IOVECS = 16;
+
+  explicit BufferChain() noexcept = default;
+  BufferChain(const BufferChain&) = delete;
+  BufferChain& operator=(const BufferChain&) = delete;
+
+  // Where to append bytes that are to be copied
+  [[nodiscard]] String& get_append_buffer() noexcept;
+  void append(StringSlice bytes) noexcept { get_append_buffer().append_slice(bytes); }
+
+  // Takes `bytes` over without copying; `bytes` gets an empty buffer back
+  void append_owned(String& bytes) noexcept;
+  void append_borrowed(StringSlice bytes) noexcept;
+  void append_file(FileSpan span) noexcept;
+
+  // Bytes not consumed yet
+  [[nodiscard]] u64 get_length() const noexcept;
+  [[nodiscard]] bool is_empty() const noexcept { return get_length() == 0; }
+
+  // Points up to `count` iovecs at the unconsumed bytes, front first, up to
+  // the first file segment. Returns how many were filled; they cover
+  // get_length() bytes only when every segment fit.
+  [[nodiscard]] u32 fill_iovecs(iovec* vectors, u32 count) const noexcept;
+
+  // When the chain starts with a file segment, where its unconsumed bytes are
+  [[nodiscard]] bool get_front_file(int& fd, u64& offset, u64& length) const noexcept;
+
+  // Drops `count` bytes from the front
+  void consume(u64 count) noexcept;
+
+  // While the kernel reads segments asynchronously (io_uring), appends must
+  // not move their bytes: seal() makes every current segment read-only until
+  // unseal()
+  void seal() noexcept { m_sealed = m_end; }
+  void unseal() noexcept { m_sealed = m_begin; }
+
+  void clear() noexcept;
+
+  // Gives back what recycled slots keep past MAX_IDLE_CAPACITY, for an owner
+  // going idle; live segments are left alone
+  void shrink() noexcept;
+
+ private:
+  // Recycled buffers larger than this are given back to the heap
+  static constexpr u64 MAX_RETAINED_CAPACITY = 64 * 1024;
+  // What a slot may keep through shrink(), a response head's worth
+  static constexpr u64 MAX_IDLE_CAPACITY = 4 * 1024;
+
+  enum class Kind { Copy, Owned, Borrowed, File };
+
+  struct Segment {
+    Kind kind{Kind::Copy};
+    String buffer{};  // Copy and Owned
+    StringSlice borrowed{nullptr, 0};
+    FileSpan file{};
+
+    // Empty for a file segment
+    [[nodiscard]] StringSlice bytes() const noexcept {
+      return kind == Kind::Borrowed ? borrowed : buffer.slice();
+    }
+    [[nodiscard]] u64 get_length() const noexcept {
+      return kind == Kind::File ? file.length : bytes().get_length();
+    }
+  };
+
+  [[nodiscard]] Segment& push(Kind kind) noexcept;
+  void recycle(Segment& segment) noexcept;
+
+  // Live segments are [m_begin, m_end); slots past m_end keep their buffers
+  std::vector<Segment> m_segments{};
+  u64 m_begin{0};
+  u64 m_end{0};
+  u64 m_sealed{0};
+  u64 m_offset{0};  // into the first live segment
+};
+
+}  // namespace cell
+
+#endif  // CELL_BUFFER_CHAIN_HPP
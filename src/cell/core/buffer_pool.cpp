@@ -0,0 +1,108 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "buffer_pool.hpp"
+
+#include <cstring>
+#include <utility>
+
+#include "cell/core/assert.hpp"
+
+namespace cell {
+
+bool BufferPool::reserve(String& buffer, u64 capacity, bool force) noexcept {
+  if (buffer.get_capacity() >= capacity) {
+    return true;
+  }
+
+  constexpr u64 LARGEST = CLASS_SIZES[CLASS_COUNT - 1];
+  const u64 index = get_class(capacity);
+  const u64 size = index < CLASS_COUNT ? CLASS_SIZES[index]
+                                       : (capacity + LARGEST - 1) / LARGEST * LARGEST;
+  const u64 previous = is_lent(buffer) ? buffer.get_capacity() : 0;
+  if (!force && m_limit != 0 && m_lent - previous + size > m_limit) {
+    return false;
+  }
+
+  String grown = [&] {
+    if (index < CLASS_COUNT && !m_free[index].empty()) {
+      String kept{std::move(m_free[index].back())};
+      m_free[index].pop_back();
+      m_kept -= size;
+      return kept;
+    }
+    trim(size);
+    return String{size};
+  }();
+  m_lent += size;
+
+  const u64 length = buffer.get_length();
+  if (length != 0) {
+    ::memcpy(grown.get_buffer_ptr(), buffer.get_buffer_ptr(), length);
+  }
+  grown.set_length(length);
+
+  // `grown` ends up with what `buffer` had, either an empty String to keep
+  // or the smaller buffer, which goes back first
+  buffer.swap(grown);
+  release(grown);
+  m_empty.push_back(std::move(grown));
+  return true;
+}
+
+void BufferPool::release(String& buffer) noexcept {
+  if (!is_lent(buffer)) {
+    return;
+  }
+
+  const u64 capacity = buffer.get_capacity();
+  const u64 index = get_class(capacity);
+  m_lent -= capacity;
+
+  // Either way `buffer` gets an empty String back
+  std::vector<String>& list = index < CLASS_COUNT ? m_free[index] : m_empty;
+  if (m_empty.empty()) {
+    list.emplace_back();
+  } else if (&list != &m_empty) {
+    list.push_back(std::move(m_empty.back()));
+    m_empty.pop_back();
+  }
+
+  if (index < CLASS_COUNT) {
+    // Only buffers lent by reserve() come back, never grown on their own
+    CELL_ASSERT(capacity == CLASS_SIZES[index]);
+    list.back().swap(buffer);
+    list.back().set_length(0);
+    m_kept += capacity;
+    trim(0);
+  } else {
+    // Over the largest class, back to the heap
+    String empty{std::move(list.back())};
+    list.pop_back();
+    buffer.swap(empty);
+  }
+  buffer.set_length(0);
+}
+
+u64 BufferPool::get_class(u64 capacity) noexcept {
+  for (u64 index = 0; index < CLASS_COUNT; ++index) {
+    if (capacity <= CLASS_SIZES[index]) {
+      return index;
+    }
+  }
+  return CLASS_COUNT;
+}
+
+void BufferPool::trim(u64 capacity) noexcept {
+  // Largest first, the fewest frees for the most room
+  u64 index = CLASS_COUNT;
+  while (m_limit != 0 && m_kept != 0 && m_lent + m_kept + capacity > m_limit) {
+    while (m_free[index - 1].empty()) {
+      --index;
+    }
+    m_free[index - 1].pop_back();
+    m_kept -= CLASS_SIZES[index - 1];
+  }
+}
+
+}  // namespace cell
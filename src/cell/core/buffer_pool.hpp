@@ -0,0 +1,79 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_BUFFER_POOL_HPP
+#define CELL_BUFFER_POOL_HPP
+
+#include <array>
+#include <vector>
+
+#include "cell/core/string.hpp"
+#include "cell/core/types.hpp"
+
+namespace cell {
+
+// Size-classed buffers lent out as Strings, for memory that's only needed
+// while bytes are in flight: a connection borrows a read buffer when data
+// arrives and gives it back once it's idle, so idle connections hold none.
+// Requests are rounded up to the next class, and buffers given back are
+// kept on their class's free list for the next borrower. Anything over the
+// largest class comes from the heap and goes straight back to it.
+//
+// Everything lent out or kept for reuse counts against the limit. A reserve
+// that would go over it first frees kept buffers, then fails, and the caller
+// holds off (a server stops reading) until memory is given back.
+// Single-threaded, like the reactor owning it.
+class BufferPool {
+ public:
+  static constexpr std::array<u64, 3> CLASS_SIZES{4 * 1024, 16 * 1024, 64 * 1024};
+
+  // 0: no limit
+  explicit BufferPool(u64 limit = 0) noexcept : m_limit(limit) {}
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  // Makes `buffer` (empty, or from this pool) at least `capacity` bytes,
+  // keeping its bytes. false with `buffer` as it was when that would go
+  // over the limit, unless `force`d: for bytes that already arrived and
+  // can't be left anywhere else.
+  [[nodiscard]] bool reserve(String& buffer, u64 capacity, bool force = false) noexcept;
+
+  // Takes `buffer`'s memory back and leaves it empty. Does nothing to a
+  // buffer that isn't lent, so it's fine to call on every idle connection.
+  void release(String& buffer) noexcept;
+
+  // Whether `capacity` more bytes can be lent without going over the limit
+  [[nodiscard]] bool has_room(u64 capacity) const noexcept {
+    return m_limit == 0 || m_lent + capacity <= m_limit;
+  }
+
+  [[nodiscard]] u64 get_limit() const noexcept { return m_limit; }
+  // Bytes held by borrowers
+  [[nodiscard]] u64 get_lent() const noexcept { return m_lent; }
+  // Bytes held by borrowers or kept for reuse, what the limit applies to
+  [[nodiscard]] u64 get_reserved() const noexcept { return m_lent + m_kept; }
+
+ private:
+  static constexpr u64 CLASS_COUNT = CLASS_SIZES.size();
+
+  // The class `capacity` rounds up to, CLASS_COUNT when it's over the largest
+  [[nodiscard]] static u64 get_class(u64 capacity) noexcept;
+  [[nodiscard]] static bool is_lent(const String& buffer) noexcept {
+    return buffer.get_capacity() >= CLASS_SIZES[0];
+  }
+
+  // Frees kept buffers until `capacity` more fits under the limit, or none are left
+  void trim(u64 capacity) noexcept;
+
+  u64 m_limit;
+  u64 m_lent{0};
+  u64 m_kept{0};
+  std::array<std::vector<String>, CLASS_COUNT> m_free{};
+  // What borrowers held before their first buffer, swapped back in on
+  // release so lending allocates nothing once warm
+  std::vector<String> m_empty{};
+};
+
+}  // namespace cell
+
+#endif  // CELL_BUFFER_POOL_HPP
@@ -4,6 +4,8 @@
 #ifndef CELL_CHARSET_HPP
 #define CELL_CHARSET_HPP
 
+#include <array>
+
 #include "cell/core/types.hpp"
 #include "cell/log/log.hpp"
 
@@ -87,6 +89,17 @@ constexpr const char *ASCII_WHITESPACE = " \n\t\r\f\v";
   return 16 * msb_num + lsb_num;
 }
 
+// Maps every byte to its hex value, or CONVERSION_FAILURE if it isn't a hexdig.
+// Two lookups OR'd together tell whether a pair is valid: only failures have the
+// high nibble set.
+constexpr std::array<u8, 256> HEX_VALUE_TABLE = [] {
+  std::array<u8, 256> table{};
+  for (int i = 0; i < 256; ++i) {
+    table[i] = hex_digits_to_byte(static_cast<u8>(i));
+  }
+  return table;
+}();
+
 [[nodiscard]] constexpr bool is_whitespace(const u8 byte) noexcept {
   return byte == SP || byte == HTAB || byte == CR || byte == LF | byte == '\v' ||
          byte == '\f' || byte == '\b';
@@ -0,0 +1,22 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_CPU_HPP
+#define CELL_CPU_HPP
+
+#include <vector>
+
+#include "cell/core/types.hpp"
+
+namespace cell {
+
+// CPUs this process may run on (its affinity mask, so taskset and cgroup
+// cpusets are respected), in ascending order. Never empty.
+[[nodiscard]] std::vector<int> get_allowed_cpus() noexcept;
+
+// Pins the calling thread to `cpu`
+[[nodiscard]] bool pin_current_thread(int cpu) noexcept;
+
+}  // namespace cell
+
+#endif  // CELL_CPU_HPP
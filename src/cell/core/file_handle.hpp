@@ -0,0 +1,45 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_FILE_HANDLE_HPP
+#define CELL_FILE_HANDLE_HPP
+
+#include <unistd.h>
+
+#include <memory>
+
+#include "cell/core/types.hpp"
+
+namespace cell {
+
+// An open file descriptor, closed with the handle. Shared through
+// std::shared_ptr between a cache and the responses still sending from it,
+// so evicting the file doesn't pull the fd from under a send in flight.
+class FileHandle {
+ public:
+  explicit FileHandle(int fd) noexcept : m_fd(fd) {}
+  FileHandle(const FileHandle&) = delete;
+  FileHandle& operator=(const FileHandle&) = delete;
+
+  ~FileHandle() {
+    if (m_fd != -1) {
+      ::close(m_fd);
+    }
+  }
+
+  [[nodiscard]] int get_fd() const noexcept { return m_fd; }
+
+ private:
+  int m_fd;
+};
+
+// `length` bytes of a file from `offset` on
+struct FileSpan {
+  std::shared_ptr<const FileHandle> file{};
+  u64 offset{0};
+  u64 length{0};
+};
+
+}  // namespace cell
+
+#endif  // CELL_FILE_HANDLE_HPP
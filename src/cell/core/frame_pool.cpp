@@ -0,0 +1,61 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "frame_pool.hpp"
+
+#include <new>
+
+#include "cell/core/assert.hpp"
+
+namespace cell {
+
+namespace {
+
+thread_local FramePool* t_current_pool = nullptr;
+
+}  // namespace
+
+void* FramePool::allocate(u64 size) noexcept {
+  if (size > MAX_POOLED_SIZE) {
+    return ::operator new(size);
+  }
+
+  const u64 index = (size + SIZE_CLASS - 1) / SIZE_CLASS - 1;
+  if (FreeBlock* block = m_free[index]; block != nullptr) {
+    m_free[index] = block->next;
+    return block;
+  }
+
+  const u64 rounded = (index + 1) * SIZE_CLASS;
+  if (CHUNK_SIZE - m_chunk_used < rounded) {
+    // The chunk's tail is too small for this class and stays unused
+    m_chunks.push_back(std::make_unique_for_overwrite<u8[]>(CHUNK_SIZE));
+    m_chunk_used = 0;
+  }
+
+  void* memory = m_chunks.back().get() + m_chunk_used;
+  m_chunk_used += rounded;
+  return memory;
+}
+
+void FramePool::deallocate(void* memory, u64 size) noexcept {
+  if (size > MAX_POOLED_SIZE) {
+    ::operator delete(memory);
+    return;
+  }
+
+  const u64 index = (size + SIZE_CLASS - 1) / SIZE_CLASS - 1;
+  auto* block = static_cast<FreeBlock*>(memory);
+  block->next = m_free[index];
+  m_free[index] = block;
+}
+
+FramePool* FramePool::get_current() noexcept { return t_current_pool; }
+
+FramePool::Scope::Scope(FramePool* pool) noexcept : m_previous(t_current_pool) {
+  t_current_pool = pool;
+}
+
+FramePool::Scope::~Scope() { t_current_pool = m_previous; }
+
+}  // namespace cell
@@ -0,0 +1,66 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_FRAME_POOL_HPP
+#define CELL_FRAME_POOL_HPP
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "cell/core/types.hpp"
+
+namespace cell {
+
+// Free-list allocator for coroutine frames. Sizes are rounded up to a
+// SIZE_CLASS multiple; freed blocks go back on their class's list and are
+// handed out again, so a connection running the same coroutines request
+// after request stops allocating after the first one. Larger frames come
+// from the global heap. Single-threaded, like the connection owning it.
+class FramePool {
+ public:
+  static constexpr u64 SIZE_CLASS = 64;
+  static constexpr u64 MAX_POOLED_SIZE = 4096;
+  static constexpr u64 CHUNK_SIZE = 16 * 1024;
+
+  explicit FramePool() noexcept = default;
+  FramePool(const FramePool&) = delete;
+  FramePool& operator=(const FramePool&) = delete;
+
+  [[nodiscard]] void* allocate(u64 size) noexcept;
+  void deallocate(void* memory, u64 size) noexcept;
+
+  // Bytes reserved from the heap so far, chunks are only given back on destruction
+  [[nodiscard]] u64 get_reserved() const noexcept { return m_chunks.size() * CHUNK_SIZE; }
+
+  // The pool coroutine frames created on this thread come from, nullptr
+  // for the global heap
+  [[nodiscard]] static FramePool* get_current() noexcept;
+
+  // Makes `pool` current until the end of the scope
+  class Scope {
+   public:
+    explicit Scope(FramePool* pool) noexcept;
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    ~Scope();
+
+   private:
+    FramePool* m_previous;
+  };
+
+ private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  static constexpr u64 CLASS_COUNT = MAX_POOLED_SIZE / SIZE_CLASS;
+
+  std::array<FreeBlock*, CLASS_COUNT> m_free{};
+  std::vector<std::unique_ptr<u8[]>> m_chunks{};
+  u64 m_chunk_used{CHUNK_SIZE};
+};
+
+}  // namespace cell
+
+#endif  // CELL_FRAME_POOL_HPP
@@ -0,0 +1,124 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_HASH_HPP
+#define CELL_HASH_HPP
+
+#include <cstring>
+
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+
+namespace cell {
+
+constexpr u64 FNV1A_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+constexpr u64 FNV1A_PRIME = 0x100000001b3ULL;
+
+// FNV-1a, good enough for short keys (paths, header and query names)
+[[nodiscard]] constexpr u64 hash_fnv1a(const u8* data, const u64 length) noexcept {
+  u64 hash = FNV1A_OFFSET_BASIS;
+
+  for (u64 i = 0; i < length; ++i) {
+    hash ^= data[i];
+    hash *= FNV1A_PRIME;
+  }
+
+  return hash;
+}
+
+[[nodiscard]] inline u64 hash_fnv1a(const StringSlice slice) noexcept {
+  return hash_fnv1a(slice.get_u8_ptr(), slice.get_length());
+}
+
+namespace detail {
+
+constexpr u64 XXH64_PRIME_1 = 0x9E3779B185EBCA87ULL;
+constexpr u64 XXH64_PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr u64 XXH64_PRIME_3 = 0x165667B19E3779F9ULL;
+constexpr u64 XXH64_PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr u64 XXH64_PRIME_5 = 0x27D4EB2F165667C5ULL;
+
+[[nodiscard]] inline u64 rotl64(const u64 value, const int bits) noexcept {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+[[nodiscard]] inline u64 read_u64_le(const u8* data) noexcept {
+  u64 value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+[[nodiscard]] inline u64 read_u32_le(const u8* data) noexcept {
+  u32 value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+[[nodiscard]] inline u64 xxh64_round(u64 acc, const u64 input) noexcept {
+  acc += input * XXH64_PRIME_2;
+  return rotl64(acc, 31) * XXH64_PRIME_1;
+}
+
+[[nodiscard]] inline u64 xxh64_merge(const u64 acc, const u64 value) noexcept {
+  return (acc ^ xxh64_round(0, value)) * XXH64_PRIME_1 + XXH64_PRIME_4;
+}
+
+}  // namespace detail
+
+// XXH64, for content: four independent lanes of 8 bytes each, several GB/s.
+// Assumes a little-endian host like the rest of the tree.
+[[nodiscard]] inline u64 hash_xxh64(const u8* data, const u64 length, const u64 seed = 0) noexcept {
+  using namespace detail;
+  const u8* const end = data + length;
+  u64 hash;
+
+  if (length >= 32) {
+    u64 v1 = seed + XXH64_PRIME_1 + XXH64_PRIME_2;
+    u64 v2 = seed + XXH64_PRIME_2;
+    u64 v3 = seed;
+    u64 v4 = seed - XXH64_PRIME_1;
+    for (; data + 32 <= end; data += 32) {
+      v1 = xxh64_round(v1, read_u64_le(data));
+      v2 = xxh64_round(v2, read_u64_le(data + 8));
+      v3 = xxh64_round(v3, read_u64_le(data + 16));
+      v4 = xxh64_round(v4, read_u64_le(data + 24));
+    }
+    hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+    hash = xxh64_merge(hash, v1);
+    hash = xxh64_merge(hash, v2);
+    hash = xxh64_merge(hash, v3);
+    hash = xxh64_merge(hash, v4);
+  } else {
+    hash = seed + XXH64_PRIME_5;
+  }
+
+  hash += length;
+  for (; data + 8 <= end; data += 8) {
+    hash ^= xxh64_round(0, read_u64_le(data));
+    hash = rotl64(hash, 27) * XXH64_PRIME_1 + XXH64_PRIME_4;
+  }
+  if (data + 4 <= end) {
+    hash ^= read_u32_le(data) * XXH64_PRIME_1;
+    hash = rotl64(hash, 23) * XXH64_PRIME_2 + XXH64_PRIME_3;
+    data += 4;
+  }
+  for (; data < end; ++data) {
+    hash ^= *data * XXH64_PRIME_5;
+    hash = rotl64(hash, 11) * XXH64_PRIME_1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= XXH64_PRIME_2;
+  hash ^= hash >> 29;
+  hash *= XXH64_PRIME_3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+[[nodiscard]] inline u64 hash_xxh64(const StringSlice slice, const u64 seed = 0) noexcept {
+  return hash_xxh64(slice.get_u8_ptr(), slice.get_length(), seed);
+}
+
+}  // namespace cell
+
+#endif  // CELL_HASH_HPP
@@ -98,8 +98,24 @@ class String {
   [[nodiscard]] bool save_to_file(const char *path) const noexcept;
 
   void expand(uint64_t new_cap);
+
+  // Exchanges buffers without copying. Unlike std::swap, doesn't go through
+  // the move operations, which leave the source without a buffer.
+  void swap(String &other) noexcept {
+    std::swap(m_cap, other.m_cap);
+    std::swap(m_len, other.m_len);
+    std::swap(m_buf, other.m_buf);
+  }
   void refresh_length() noexcept;
 
+  // For code that writes straight into get_buffer_ptr() after expand():
+  // sets the length and null-terminates. new_length must be below capacity.
+  void set_length(uint64_t new_length) noexcept {
+    CELL_ASSERT(new_length < m_cap);
+    m_len = new_length;
+    m_buf[m_len] = 0;
+  }
+
   // Returns a const pointer to the buffer, which is guaranteed to be a C
   // compatible string (null terminated string)
   [[nodiscard]] const char *get_c_str() const noexcept {
@@ -30,6 +30,10 @@ bool StringSlice::compare(StringSlice to) const noexcept {
     return false;
   }
 
+  if (m_len == 0) [[unlikely]] {
+    return true;
+  }
+
   return mem_compare(m_data, to.m_data, m_len);
 }
 
@@ -0,0 +1,180 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_TASK_HPP
+#define CELL_TASK_HPP
+
+#include <coroutine>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+#include "cell/core/assert.hpp"
+#include "cell/core/frame_pool.hpp"
+#include "cell/core/types.hpp"
+
+namespace cell {
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+class TaskPromiseBase {
+ public:
+  // Frames come from FramePool::get_current() when one is set. The pool is
+  // remembered in front of the frame: frames die wherever the last
+  // Task owning them does, not necessarily inside the same scope.
+  static void* operator new(std::size_t size) {
+    FramePool* pool = FramePool::get_current();
+    void* memory = pool != nullptr ? pool->allocate(size + HEADER_SIZE)
+                                   : ::operator new(size + HEADER_SIZE);
+    *static_cast<FramePool**>(memory) = pool;
+    return static_cast<u8*>(memory) + HEADER_SIZE;
+  }
+
+  static void operator delete(void* frame, std::size_t size) noexcept {
+    void* memory = static_cast<u8*>(frame) - HEADER_SIZE;
+    FramePool* pool = *static_cast<FramePool**>(memory);
+    if (pool != nullptr) {
+      pool->deallocate(memory, size + HEADER_SIZE);
+    } else {
+      ::operator delete(memory);
+    }
+  }
+
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+
+    // Symmetric transfer back to the awaiting coroutine, no stack growth
+    // through long chains of co_await
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+      const std::coroutine_handle<> continuation = handle.promise().m_continuation;
+      return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  // Lazy: nothing runs until the task is awaited or resumed
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+
+  void unhandled_exception() const noexcept { CELL_PANIC("exception escaped a coroutine"); }
+
+  void set_continuation(std::coroutine_handle<> continuation) noexcept {
+    m_continuation = continuation;
+  }
+
+ private:
+  static constexpr std::size_t HEADER_SIZE = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+  std::coroutine_handle<> m_continuation{};
+};
+
+template <typename T>
+class TaskPromise : public TaskPromiseBase {
+ public:
+  Task<T> get_return_object() noexcept;
+
+  template <typename U>
+  void return_value(U&& value) noexcept {
+    m_value.emplace(std::forward<U>(value));
+  }
+
+  [[nodiscard]] T take_value() noexcept {
+    CELL_ASSERT(m_value.has_value());
+    return std::move(*m_value);
+  }
+
+ private:
+  std::optional<T> m_value{};
+};
+
+template <>
+class TaskPromise<void> : public TaskPromiseBase {
+ public:
+  Task<void> get_return_object() noexcept;
+
+  void return_void() const noexcept {}
+  void take_value() const noexcept {}
+};
+
+}  // namespace detail
+
+// Lazily started coroutine returning a T. `co_await task` runs it and
+// resumes the caller with its result; a top-level task is started with
+// get_handle().resume() by whoever drives it (see net::Stream). Owns its
+// frame, destroying a suspended Task destroys the whole chain of frames it
+// is awaiting.
+template <typename T>
+class [[nodiscard]] Task {
+ public:
+  using promise_type = detail::TaskPromise<T>;
+
+  Task() noexcept = default;
+  explicit Task(std::coroutine_handle<promise_type> handle) noexcept : m_handle(handle) {}
+
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      if (m_handle) {
+        m_handle.destroy();
+      }
+      m_handle = std::exchange(other.m_handle, nullptr);
+    }
+    return *this;
+  }
+
+  ~Task() {
+    if (m_handle) {
+      m_handle.destroy();
+    }
+  }
+
+  [[nodiscard]] bool is_valid() const noexcept { return static_cast<bool>(m_handle); }
+  [[nodiscard]] bool is_done() const noexcept { return !m_handle || m_handle.done(); }
+  [[nodiscard]] std::coroutine_handle<> get_handle() const noexcept { return m_handle; }
+
+  auto operator co_await() && noexcept {
+    struct Awaiter {
+      std::coroutine_handle<promise_type> handle;
+
+      bool await_ready() const noexcept { return !handle || handle.done(); }
+
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+        handle.promise().set_continuation(caller);
+        return handle;
+      }
+
+      decltype(auto) await_resume() noexcept { return handle.promise().take_value(); }
+    };
+    return Awaiter{m_handle};
+  }
+
+  auto operator co_await() & noexcept { return std::move(*this).operator co_await(); }
+
+ private:
+  std::coroutine_handle<promise_type> m_handle{};
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() noexcept {
+  return Task<T>{std::coroutine_handle<TaskPromise<T>>::from_promise(*this)};
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+  return Task<void>{std::coroutine_handle<TaskPromise<void>>::from_promise(*this)};
+}
+
+}  // namespace detail
+
+}  // namespace cell
+
+#endif  // CELL_TASK_HPP
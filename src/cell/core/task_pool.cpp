@@ -0,0 +1,134 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "task_pool.hpp"
+
+#include <cstdio>
+
+#include "cell/core/assert.hpp"
+#include "cell/core/cpu.hpp"
+#include "cell/log/log.hpp"
+
+namespace cell {
+
+thread_local TaskPool::Worker* TaskPool::t_worker = nullptr;
+
+TaskPool::TaskPool(TaskPoolConfig config) noexcept {
+  const std::vector<int> cpus = get_allowed_cpus();
+  const u64 count = config.worker_count != 0 ? config.worker_count : cpus.size();
+
+  for (u64 i = 0; i < count; ++i) {
+    auto worker = std::make_unique<Worker>();
+    worker->pool = this;
+    worker->index = static_cast<u32>(i);
+    worker->cpu = config.pin_threads ? cpus[i % cpus.size()] : -1;
+    m_workers.push_back(std::move(worker));
+  }
+
+  // Started only once m_workers is complete, thieves walk it
+  for (auto& worker : m_workers) {
+    worker->thread = std::thread([this, &worker = *worker] { run_worker(worker); });
+  }
+}
+
+TaskPool::~TaskPool() {
+  {
+    std::lock_guard lock(m_mutex);
+    m_stopping.store(true);
+  }
+  m_wake.notify_all();
+
+  for (auto& worker : m_workers) {
+    worker->thread.join();
+  }
+}
+
+void TaskPool::submit(Job task) noexcept {
+  auto* item = new Item{std::move(task)};
+  m_submitted.fetch_add(1, std::memory_order_relaxed);
+
+  // Counted before it's visible, so a worker taking it never sees a negative count
+  m_pending.fetch_add(1);
+
+  if (t_worker != nullptr && t_worker->pool == this) {
+    t_worker->deque.push(item);
+  } else {
+    std::lock_guard lock(m_mutex);
+    m_injected.push_back(item);
+  }
+
+  // Pairs with the increment in run_worker(): either the sleeper sees the
+  // pending task, or we see the sleeper and wake it up
+  if (m_sleeping.load() != 0) {
+    { std::lock_guard lock(m_mutex); }
+    m_wake.notify_one();
+  }
+}
+
+TaskPool::Item* TaskPool::take(Worker& worker) noexcept {
+  Item* item = worker.deque.pop();
+
+  if (item == nullptr) {
+    std::lock_guard lock(m_mutex);
+    if (!m_injected.empty()) {
+      item = m_injected.front();
+      m_injected.pop_front();
+    }
+  }
+
+  // Victims are tried starting after ourselves, so thieves spread out
+  for (u64 i = 1; item == nullptr && i < m_workers.size(); ++i) {
+    Worker& victim = *m_workers[(worker.index + i) % m_workers.size()];
+    item = victim.deque.steal();
+    if (item != nullptr) {
+      worker.steals.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  if (item != nullptr) {
+    m_pending.fetch_sub(1);
+  }
+  return item;
+}
+
+void TaskPool::run_worker(Worker& worker) noexcept {
+  t_worker = &worker;
+
+  if (worker.cpu >= 0 && !pin_current_thread(worker.cpu)) {
+    CELL_LOG_DEBUG("task pool: can't pin worker %u to CPU %d", worker.index, worker.cpu);
+  }
+
+  while (true) {
+    if (Item* item = take(worker); item != nullptr) {
+      item->task();
+      delete item;
+      worker.executed.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+
+    std::unique_lock lock(m_mutex);
+    m_sleeping.fetch_add(1);
+    m_wake.wait(lock, [this] { return m_pending.load() > 0 || m_stopping.load(); });
+    m_sleeping.fetch_sub(1);
+
+    if (m_stopping.load() && m_pending.load() == 0) {
+      return;
+    }
+  }
+}
+
+TaskPoolStats TaskPool::get_stats() const noexcept {
+  TaskPoolStats stats{};
+  stats.submitted = m_submitted.load(std::memory_order_relaxed);
+
+  for (const auto& worker : m_workers) {
+    stats.executed += worker->executed.load(std::memory_order_relaxed);
+    stats.steals += worker->steals.load(std::memory_order_relaxed);
+  }
+
+  const i64 pending = m_pending.load(std::memory_order_relaxed);
+  stats.queue_depth = pending > 0 ? static_cast<u64>(pending) : 0;
+  return stats;
+}
+
+}  // namespace cell
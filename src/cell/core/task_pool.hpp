@@ -0,0 +1,91 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_TASK_POOL_HPP
+#define CELL_TASK_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cell/core/types.hpp"
+#include "cell/core/work_stealing_deque.hpp"
+
+namespace cell {
+
+struct TaskPoolConfig {
+  u32 worker_count{0};  // 0: one per CPU the process may run on
+  bool pin_threads{false};
+};
+
+struct TaskPoolStats {
+  u64 submitted{0};
+  u64 executed{0};
+  u64 steals{0};        // tasks a worker took from another worker's deque
+  u64 queue_depth{0};   // submitted, not started yet
+};
+
+using Job = std::function<void()>;
+
+// Work-stealing pool for CPU-heavy work that shouldn't run on a reactor.
+// Every worker owns a Chase-Lev deque: tasks submitted from a worker go to
+// its own deque, tasks submitted from elsewhere (reactors) go through a
+// shared injection queue, and idle workers steal from each other before
+// going to sleep. See net::Server::suspend() to finish a response from a
+// task.
+class TaskPool {
+ public:
+  explicit TaskPool(TaskPoolConfig config = {}) noexcept;
+  TaskPool(const TaskPool&) = delete;
+  TaskPool& operator=(const TaskPool&) = delete;
+
+  // Runs every task still queued, then joins the workers
+  ~TaskPool();
+
+  // Safe to call from any thread, including from a task
+  void submit(Job task) noexcept;
+
+  [[nodiscard]] u32 get_worker_count() const noexcept {
+    return static_cast<u32>(m_workers.size());
+  }
+  [[nodiscard]] TaskPoolStats get_stats() const noexcept;
+
+ private:
+  struct Item {
+    Job task;
+  };
+
+  struct alignas(64) Worker {
+    const TaskPool* pool{nullptr};
+    u32 index{0};
+    int cpu{-1};  // -1: not pinned
+    WorkStealingDeque<Item> deque{};
+    std::atomic<u64> executed{0};
+    std::atomic<u64> steals{0};
+    std::thread thread{};
+  };
+
+  // The worker the calling thread is, if any
+  static thread_local Worker* t_worker;
+
+  void run_worker(Worker& worker) noexcept;
+  [[nodiscard]] Item* take(Worker& worker) noexcept;
+
+  std::vector<std::unique_ptr<Worker>> m_workers{};
+  std::mutex m_mutex{};
+  std::condition_variable m_wake{};
+  std::deque<Item*> m_injected{};  // guarded by m_mutex
+  std::atomic<i64> m_pending{0};
+  std::atomic<u32> m_sleeping{0};
+  std::atomic<u64> m_submitted{0};
+  std::atomic<bool> m_stopping{false};
+};
+
+}  // namespace cell
+
+#endif  // CELL_TASK_POOL_HPP
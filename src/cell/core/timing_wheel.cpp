@@ -0,0 +1,104 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "timing_wheel.hpp"
+
+#include "cell/core/assert.hpp"
+
+namespace cell {
+
+TimingWheel::TimingWheel(u64 now) noexcept : m_next(now) {
+  for (u32 slot = 0; slot < LEVELS * SLOTS; ++slot) {
+    m_slots[slot].m_prev = m_slots[slot].m_next = &m_slots[slot];
+    m_slots[slot].m_slot = slot;
+  }
+}
+
+void TimingWheel::arm(TimerNode& node, u64 expiry) noexcept {
+  if (node.is_armed()) {
+    unlink(node);
+  }
+
+  if (expiry < m_next) {
+    expiry = m_next;
+  } else if (expiry - m_next > MAX_SPAN) {
+    expiry = m_next + MAX_SPAN;
+  }
+  node.m_expiry = expiry;
+  link(node);
+}
+
+void TimingWheel::disarm(TimerNode& node) noexcept {
+  if (node.is_armed()) {
+    unlink(node);
+  }
+}
+
+u64 TimingWheel::get_next_expiry() const noexcept {
+  if (m_count == 0) {
+    return UINT64_MAX;
+  }
+
+  // On a wrap, the cascade that's yet to run may bring anything down
+  const auto index = static_cast<u32>(m_next & SLOT_MASK);
+  if (index == 0) {
+    return m_next;
+  }
+
+  // Level 0 holds only what's due within SLOTS ticks, so its occupied slots
+  // from the current one on are exact; anything else waits for the wrap
+  const u64 ahead = m_occupied[0] >> index;
+  if (ahead != 0) {
+    return m_next + static_cast<u64>(std::countr_zero(ahead));
+  }
+  return (m_next | SLOT_MASK) + 1;
+}
+
+void TimingWheel::link(TimerNode& node) noexcept {
+  const u64 delta = node.m_expiry - m_next;
+
+  u32 level = 0;
+  while (level + 1 < LEVELS && delta >= (1ULL << (SLOT_BITS * (level + 1)))) {
+    ++level;
+  }
+  const auto slot = static_cast<u32>((node.m_expiry >> (SLOT_BITS * level)) & SLOT_MASK);
+
+  TimerNode& head = get_slot(level * SLOTS + slot);
+  node.m_slot = level * SLOTS + slot;
+  node.m_prev = head.m_prev;
+  node.m_next = &head;
+  head.m_prev->m_next = &node;
+  head.m_prev = &node;
+
+  m_occupied[level] |= 1ULL << slot;
+  ++m_count;
+}
+
+void TimingWheel::unlink(TimerNode& node) noexcept {
+  CELL_ASSERT(node.is_armed());
+
+  node.m_prev->m_next = node.m_next;
+  node.m_next->m_prev = node.m_prev;
+  node.m_prev = node.m_next = nullptr;
+
+  const TimerNode& head = m_slots[node.m_slot];
+  if (head.m_next == &head) {
+    m_occupied[node.m_slot / SLOTS] &= ~(1ULL << (node.m_slot % SLOTS));
+  }
+  --m_count;
+}
+
+void TimingWheel::cascade(u32 level) noexcept {
+  const auto slot = static_cast<u32>((m_next >> (SLOT_BITS * level)) & SLOT_MASK);
+  TimerNode& head = get_slot(level * SLOTS + slot);
+
+  // Every timer here is due within this slot's span, which now starts at
+  // m_next: each goes to a lower level
+  while (head.m_next != &head) {
+    TimerNode& node = *head.m_next;
+    unlink(node);
+    link(node);
+  }
+}
+
+}  // namespace cell
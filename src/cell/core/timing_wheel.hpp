@@ -0,0 +1,132 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_TIMING_WHEEL_HPP
+#define CELL_TIMING_WHEEL_HPP
+
+#include <bit>
+#include <cstdint>
+
+#include "cell/core/types.hpp"
+
+namespace cell {
+
+// A timer that lives in whatever it times out; the wheel only links it in,
+// arming and disarming allocate nothing. Not copyable while armed.
+class TimerNode {
+ public:
+  explicit TimerNode() noexcept = default;
+  TimerNode(const TimerNode&) = delete;
+  TimerNode& operator=(const TimerNode&) = delete;
+
+  [[nodiscard]] bool is_armed() const noexcept { return m_next != nullptr; }
+  [[nodiscard]] u64 get_expiry() const noexcept { return m_expiry; }
+
+  // For the owner, to find its way back from an expired node
+  u64 data{0};
+
+ private:
+  friend class TimingWheel;
+
+  TimerNode* m_prev{nullptr};
+  TimerNode* m_next{nullptr};
+  u64 m_expiry{0};
+  u32 m_slot{0};  // level * SLOTS + slot, for its occupancy bit
+};
+
+// Hierarchical timing wheel (Varghese & Lauck), in ticks of whatever length
+// the owner picks. LEVELS wheels of SLOTS slots each: level 0 has one slot
+// per tick, every level above one per SLOTS slots of the level below, and a
+// timer goes to the lowest level whose span covers it. When level 0 wraps,
+// the next slot of level 1 is cascaded into it, and so on up.
+//
+// Arming and disarming are O(1), and so is expiring per timer: a timer is
+// cascaded at most LEVELS - 1 times. An occupancy bitmap per level lets
+// advance() jump over empty slots instead of walking every tick.
+// Not thread safe, keep one per reactor.
+class TimingWheel {
+ public:
+  static constexpr u32 SLOT_BITS = 6;
+  static constexpr u32 SLOTS = 1U << SLOT_BITS;
+  static constexpr u32 LEVELS = 4;
+  // Expiries further out are clamped to this and fire early
+  static constexpr u64 MAX_SPAN = (1ULL << (SLOT_BITS * LEVELS)) - 1;
+
+  explicit TimingWheel(u64 now = 0) noexcept;
+  TimingWheel(const TimingWheel&) = delete;
+  TimingWheel& operator=(const TimingWheel&) = delete;
+
+  // (Re)arms `node` to expire at tick `expiry`; at the next advance() when
+  // that's already past
+  void arm(TimerNode& node, u64 expiry) noexcept;
+  void disarm(TimerNode& node) noexcept;
+
+  // Moves the wheel to tick `now` and calls `on_expired(TimerNode&)` for
+  // every timer due by then, disarmed already. It may arm and disarm
+  // timers, the one it was called for included.
+  template <typename OnExpired>
+  void advance(u64 now, OnExpired&& on_expired) noexcept;
+
+  // A tick no later than the earliest expiry, UINT64_MAX without timers.
+  // Exact within the current turn of level 0, the next wrap otherwise.
+  [[nodiscard]] u64 get_next_expiry() const noexcept;
+
+  [[nodiscard]] u64 get_count() const noexcept { return m_count; }
+
+ private:
+  static constexpr u64 SLOT_MASK = SLOTS - 1;
+
+  [[nodiscard]] TimerNode& get_slot(u32 slot) noexcept { return m_slots[slot]; }
+  void link(TimerNode& node) noexcept;
+  void unlink(TimerNode& node) noexcept;
+  // Re-arms the timers of a level > 0 slot that now fit a lower level
+  void cascade(u32 level) noexcept;
+
+  TimerNode m_slots[LEVELS * SLOTS];  // list heads, circular
+  u64 m_occupied[LEVELS]{};           // bit per non-empty slot
+  u64 m_next{0};                      // the next tick to expire
+  u64 m_count{0};
+};
+
+template <typename OnExpired>
+void TimingWheel::advance(u64 now, OnExpired&& on_expired) noexcept {
+  while (m_next <= now) {
+    if (m_count == 0) {
+      m_next = now + 1;
+      return;
+    }
+
+    const u64 tick = m_next;
+    const auto index = static_cast<u32>(tick & SLOT_MASK);
+    if (index == 0) {
+      for (u32 level = 1; level < LEVELS; ++level) {
+        const u64 slot = (tick >> (SLOT_BITS * level)) & SLOT_MASK;
+        cascade(level);
+        if (slot != 0) {
+          break;
+        }
+      }
+    }
+
+    // Past this tick before any callback runs: whatever it re-arms for
+    // this tick or earlier lands in the next one, not a turn later
+    ++m_next;
+
+    TimerNode& head = get_slot(index);
+    while (head.m_next != &head) {
+      TimerNode& node = *head.m_next;
+      unlink(node);
+      on_expired(node);
+    }
+
+    // Straight to the next occupied slot, stopping where level 0 wraps
+    const u64 next = get_next_expiry();
+    if (next > m_next) {
+      m_next = next < now + 1 ? next : now + 1;
+    }
+  }
+}
+
+}  // namespace cell
+
+#endif  // CELL_TIMING_WHEEL_HPP
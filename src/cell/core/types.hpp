@@ -7,6 +7,8 @@
 #include <cstdint>
 
 using u8 = uint8_t;
+using u32 = uint32_t;
 using u64 = uint64_t;
+using i64 = int64_t;
 
 #endif  // CELL_TYPES_HPP
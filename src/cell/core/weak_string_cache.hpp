@@ -21,6 +21,7 @@ class WeakStringCache {
 
   [[nodiscard]] u64 GetSize() const { return table_.size(); }
   [[nodiscard]] bool IsEmpty() const { return table_.empty(); }
+  void Clear() noexcept { table_.clear(); }
 
   uint64_t AddKeyValuePair(const String& k, const String& v) noexcept;
   uint64_t AppendToValue(StringSlice k, StringSlice v) noexcept;
@@ -0,0 +1,138 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_WORK_STEALING_DEQUE_HPP
+#define CELL_WORK_STEALING_DEQUE_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "cell/core/assert.hpp"
+#include "cell/core/types.hpp"
+
+namespace cell {
+
+// Chase-Lev work-stealing deque of T*, with the memory orderings of Lê et al.,
+// "Correct and Efficient Work-Stealing for Weak Memory Models" (PPoPP '13).
+//
+// The owner thread push()es and pop()s at the bottom (LIFO, cache friendly);
+// any other thread steal()s from the top (FIFO, oldest work first). Grows
+// without bound; arrays outgrown by the owner are kept until destruction
+// because a thief may still be reading from them.
+template <typename T>
+class WorkStealingDeque {
+ public:
+  static constexpr i64 DEFAULT_CAPACITY = 256;
+
+  explicit WorkStealingDeque(i64 capacity = DEFAULT_CAPACITY) noexcept {
+    CELL_ASSERT(capacity > 0 && (capacity & (capacity - 1)) == 0);
+    m_arrays.push_back(std::make_unique<Array>(capacity));
+    m_array.store(m_arrays.back().get(), std::memory_order_relaxed);
+  }
+
+  WorkStealingDeque(const WorkStealingDeque&) = delete;
+  WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+  // Owner only
+  void push(T* item) noexcept {
+    const i64 bottom = m_bottom.load(std::memory_order_relaxed);
+    const i64 top = m_top.load(std::memory_order_acquire);
+    Array* array = m_array.load(std::memory_order_relaxed);
+
+    if (bottom - top > array->capacity - 1) {
+      array = grow(array, bottom, top);
+    }
+
+    array->put(bottom, item);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+  }
+
+  // Owner only. nullptr when empty.
+  [[nodiscard]] T* pop() noexcept {
+    const i64 bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    Array* array = m_array.load(std::memory_order_relaxed);
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    i64 top = m_top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+      m_bottom.store(bottom + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    T* item = array->get(bottom);
+    if (top == bottom) {
+      // Last item, race the thieves for it
+      if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                         std::memory_order_relaxed)) {
+        item = nullptr;
+      }
+      m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return item;
+  }
+
+  // Any thread. nullptr when empty or when another thread won the race.
+  [[nodiscard]] T* steal() noexcept {
+    i64 top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const i64 bottom = m_bottom.load(std::memory_order_acquire);
+
+    if (top >= bottom) {
+      return nullptr;
+    }
+
+    Array* array = m_array.load(std::memory_order_acquire);
+    T* item = array->get(top);
+    if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                       std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return item;
+  }
+
+  // Approximate when other threads are at work
+  [[nodiscard]] i64 size() const noexcept {
+    const i64 bottom = m_bottom.load(std::memory_order_relaxed);
+    const i64 top = m_top.load(std::memory_order_relaxed);
+    return bottom > top ? bottom - top : 0;
+  }
+
+ private:
+  struct Array {
+    explicit Array(i64 capacity) noexcept
+        : capacity(capacity), items(std::make_unique<std::atomic<T*>[]>(capacity)) {}
+
+    [[nodiscard]] T* get(i64 index) const noexcept {
+      return items[index & (capacity - 1)].load(std::memory_order_relaxed);
+    }
+    void put(i64 index, T* item) noexcept {
+      items[index & (capacity - 1)].store(item, std::memory_order_relaxed);
+    }
+
+    i64 capacity;
+    std::unique_ptr<std::atomic<T*>[]> items;
+  };
+
+  Array* grow(Array* array, i64 bottom, i64 top) noexcept {
+    m_arrays.push_back(std::make_unique<Array>(array->capacity * 2));
+    Array* grown = m_arrays.back().get();
+    for (i64 i = top; i < bottom; ++i) {
+      grown->put(i, array->get(i));
+    }
+    m_array.store(grown, std::memory_order_release);
+    return grown;
+  }
+
+  // Owner and thieves hammer different ends, keep them off one cache line
+  alignas(64) std::atomic<i64> m_top{0};
+  alignas(64) std::atomic<i64> m_bottom{0};
+  alignas(64) std::atomic<Array*> m_array{nullptr};
+  std::vector<std::unique_ptr<Array>> m_arrays{};  // owner only
+};
+
+}  // namespace cell
+
+#endif  // CELL_WORK_STEALING_DEQUE_HPP
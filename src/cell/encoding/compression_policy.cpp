@@ -0,0 +1,118 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "compression_policy.hpp"
+
+#include <time.h>
+
+#include <algorithm>
+
+#include "cell/http/mime_type.hpp"
+
+namespace cell::encoding {
+
+namespace http_encoding = http::encoding;
+
+namespace {
+
+u64 clock_ns(clockid_t clock) noexcept {
+  timespec ts{};
+  ::clock_gettime(clock, &ts);
+  return static_cast<u64>(ts.tv_sec) * 1'000'000'000ULL + static_cast<u64>(ts.tv_nsec);
+}
+
+// Cheap enough to read per response; the first sample and every later one
+// must come from it, the precise clock can run ahead of it
+u64 wall_ns() noexcept { return clock_ns(CLOCK_MONOTONIC_COARSE); }
+
+}  // namespace
+
+CompressionPolicy::CompressionPolicy(CompressionPolicyConfig config) noexcept
+    : m_config(config),
+      m_last_sample_wall_ns(wall_ns()),
+      m_last_sample_cpu_ns(thread_cpu_time_ns()) {}
+
+u64 CompressionPolicy::thread_cpu_time_ns() noexcept { return clock_ns(CLOCK_THREAD_CPUTIME_ID); }
+
+void CompressionPolicy::maybe_sample_cpu() noexcept {
+  if (m_config.sample_interval_ns == 0) {
+    return;
+  }
+
+  const u64 now = wall_ns();
+  const u64 elapsed = now - std::min(now, m_last_sample_wall_ns);
+  if (elapsed < m_config.sample_interval_ns) {
+    return;
+  }
+
+  const u64 cpu = thread_cpu_time_ns();
+  const double busy = static_cast<double>(cpu - m_last_sample_cpu_ns) / static_cast<double>(elapsed);
+
+  m_cpu_pressure += PRESSURE_SMOOTHING * (std::clamp(busy, 0.0, 1.0) - m_cpu_pressure);
+  m_last_sample_wall_ns = now;
+  m_last_sample_cpu_ns = cpu;
+}
+
+CompressionDecision CompressionPolicy::skip(CompressionSkipReason reason) noexcept {
+  switch (reason) {
+    case CompressionSkipReason::NotAccepted:
+      ++m_stats.skipped_not_accepted;
+      break;
+    case CompressionSkipReason::BodyTooSmall:
+      ++m_stats.skipped_too_small;
+      break;
+    case CompressionSkipReason::NotCompressible:
+      ++m_stats.skipped_not_compressible;
+      break;
+    case CompressionSkipReason::Overloaded:
+      ++m_stats.skipped_overloaded;
+      break;
+    case CompressionSkipReason::None:
+      break;
+  }
+
+  return {http_encoding::IDENTITY, 0, reason};
+}
+
+CompressionDecision CompressionPolicy::decide(http_encoding::EncodingSet coding, u64 body_size,
+                                              StringSlice content_type) noexcept {
+  if (coding == http_encoding::kNone || coding == http_encoding::IDENTITY) {
+    return skip(CompressionSkipReason::NotAccepted);
+  }
+
+  if (body_size < m_config.min_body_size) {
+    return skip(CompressionSkipReason::BodyTooSmall);
+  }
+
+  if (!http::is_compressible_mime_type(content_type)) {
+    return skip(CompressionSkipReason::NotCompressible);
+  }
+
+  maybe_sample_cpu();
+
+  int level;
+  if (m_cpu_pressure >= m_config.pressure_skip) {
+    return skip(CompressionSkipReason::Overloaded);
+  } else if (m_cpu_pressure >= m_config.pressure_saturated) {
+    level = m_config.level_saturated;
+  } else if (m_cpu_pressure >= m_config.pressure_busy) {
+    level = m_config.level_busy;
+  } else {
+    level = m_config.level_idle;
+  }
+
+  if (body_size >= m_config.large_body_size) {
+    level = std::min(level, m_config.level_busy);
+  }
+
+  return {coding, level, CompressionSkipReason::None};
+}
+
+void CompressionPolicy::record(u64 bytes_in, u64 bytes_out, u64 cpu_ns) noexcept {
+  ++m_stats.compressed;
+  m_stats.bytes_in += bytes_in;
+  m_stats.bytes_out += bytes_out;
+  m_stats.cpu_ns += cpu_ns;
+}
+
+}  // namespace cell::encoding
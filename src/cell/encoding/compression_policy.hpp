@@ -0,0 +1,97 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_COMPRESSION_POLICY_HPP
+#define CELL_COMPRESSION_POLICY_HPP
+
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+#include "cell/http/encoding.hpp"
+
+namespace cell::encoding {
+
+enum class CompressionSkipReason {
+  None,
+  NotAccepted,       // client doesn't accept any coding we have
+  BodyTooSmall,
+  NotCompressible,   // images, archives, ...
+  Overloaded,        // worker CPU is saturated
+};
+
+struct CompressionDecision {
+  http::encoding::EncodingSet coding{http::encoding::kNone};
+  int level{0};
+  CompressionSkipReason skip_reason{CompressionSkipReason::None};
+
+  [[nodiscard]] bool should_compress() const noexcept {
+    return skip_reason == CompressionSkipReason::None;
+  }
+};
+
+struct CompressionPolicyConfig {
+  u64 min_body_size{1024};           // below this gzip framing eats the gain
+  u64 large_body_size{1024 * 1024};  // bodies above this get at most level_busy
+  int level_idle{6};
+  int level_busy{4};
+  int level_saturated{1};
+  double pressure_busy{0.5};
+  double pressure_saturated{0.8};
+  double pressure_skip{0.95};        // above this, don't compress dynamic bodies at all
+  u64 sample_interval_ns{100'000'000};  // 0 disables sampling, see set_cpu_pressure()
+};
+
+struct CompressionPolicyStats {
+  u64 compressed{0};
+  u64 skipped_not_accepted{0};
+  u64 skipped_too_small{0};
+  u64 skipped_not_compressible{0};
+  u64 skipped_overloaded{0};
+  u64 bytes_in{0};
+  u64 bytes_out{0};
+  u64 cpu_ns{0};
+
+  [[nodiscard]] u64 get_bytes_saved() const noexcept {
+    return bytes_in > bytes_out ? bytes_in - bytes_out : 0;
+  }
+};
+
+// Decides, per response, whether to compress and at which level, from the
+// body size, its Content-Type and how busy the worker's CPU is. CPU pressure
+// is the share of wall time the calling thread spent on the CPU, sampled
+// every sample_interval_ns and smoothed. One instance per worker thread.
+class CompressionPolicy {
+ public:
+  explicit CompressionPolicy(CompressionPolicyConfig config = {}) noexcept;
+
+  // `coding` is the result of AcceptEncoding::negotiate()
+  [[nodiscard]] CompressionDecision decide(http::encoding::EncodingSet coding, u64 body_size,
+                                           StringSlice content_type) noexcept;
+
+  // Feed back what compressing a body actually cost
+  void record(u64 bytes_in, u64 bytes_out, u64 cpu_ns) noexcept;
+
+  [[nodiscard]] double get_cpu_pressure() const noexcept { return m_cpu_pressure; }
+  // Overrides the sampled value, e.g. with a load figure computed elsewhere
+  void set_cpu_pressure(double pressure) noexcept { m_cpu_pressure = pressure; }
+
+  [[nodiscard]] const CompressionPolicyStats& get_stats() const noexcept { return m_stats; }
+  [[nodiscard]] const CompressionPolicyConfig& get_config() const noexcept { return m_config; }
+
+  [[nodiscard]] static u64 thread_cpu_time_ns() noexcept;
+
+ private:
+  static constexpr double PRESSURE_SMOOTHING = 0.3;
+
+  void maybe_sample_cpu() noexcept;
+  [[nodiscard]] CompressionDecision skip(CompressionSkipReason reason) noexcept;
+
+  CompressionPolicyConfig m_config;
+  CompressionPolicyStats m_stats{};
+  double m_cpu_pressure{0.0};
+  u64 m_last_sample_wall_ns{0};
+  u64 m_last_sample_cpu_ns{0};
+};
+
+}  // namespace cell::encoding
+
+#endif  // CELL_COMPRESSION_POLICY_HPP
@@ -0,0 +1,35 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_COMPRESSOR_HPP
+#define CELL_COMPRESSOR_HPP
+
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+#include "sink.hpp"
+
+namespace cell::encoding {
+
+// Common interface of the streaming encoders, so pools and the response
+// path don't care which content coding they're driving
+class Compressor {
+ public:
+  Compressor() = default;
+  Compressor(const Compressor&) = delete;
+  Compressor& operator=(const Compressor&) = delete;
+  virtual ~Compressor() = default;
+
+  [[nodiscard]] virtual bool is_ok() const noexcept = 0;
+  // Rough amount of memory held by the encoder's internal state
+  [[nodiscard]] virtual u64 get_memory_footprint() const noexcept = 0;
+
+  virtual void set_sink(Sink* sink) noexcept = 0;
+  [[nodiscard]] virtual bool write(StringSlice data) noexcept = 0;
+  [[nodiscard]] virtual bool flush() noexcept = 0;
+  [[nodiscard]] virtual bool finish() noexcept = 0;
+  virtual void reset() noexcept = 0;
+};
+
+}  // namespace cell::encoding
+
+#endif  // CELL_COMPRESSOR_HPP
@@ -0,0 +1,166 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "compressor_pool.hpp"
+
+#include "cell/core/assert.hpp"
+#include "cell/log/log.hpp"
+#include "gzip.hpp"
+#ifdef CELL_HAVE_ZSTD
+#include "zstd.hpp"
+#endif
+
+namespace cell::encoding {
+
+namespace http_encoding = http::encoding;
+
+// -----------------------------------------------------------------------------
+// CompressorLease
+// -----------------------------------------------------------------------------
+
+CompressorLease::CompressorLease(CompressorPool* pool, u64 key,
+                                 std::unique_ptr<Compressor> compressor) noexcept
+    : m_pool(pool), m_key(key), m_compressor(std::move(compressor)) {}
+
+CompressorLease::CompressorLease(CompressorLease&& other) noexcept
+    : m_pool(other.m_pool), m_key(other.m_key), m_compressor(std::move(other.m_compressor)) {
+  other.m_pool = nullptr;
+}
+
+CompressorLease& CompressorLease::operator=(CompressorLease&& other) noexcept {
+  if (this != &other) {
+    release();
+    m_pool = other.m_pool;
+    m_key = other.m_key;
+    m_compressor = std::move(other.m_compressor);
+    other.m_pool = nullptr;
+  }
+
+  return *this;
+}
+
+CompressorLease::~CompressorLease() { release(); }
+
+void CompressorLease::release() noexcept {
+  if (m_pool != nullptr && m_compressor != nullptr) {
+    m_pool->give_back(m_key, std::move(m_compressor));
+  }
+
+  m_pool = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+// CompressorPool
+// -----------------------------------------------------------------------------
+
+CompressorPool::CompressorPool(u64 max_idle_per_key) noexcept
+    : m_max_idle_per_key(max_idle_per_key) {}
+
+CompressorPool& CompressorPool::get_thread_local() noexcept {
+  thread_local CompressorPool pool;
+  return pool;
+}
+
+u64 CompressorPool::make_key(http_encoding::EncodingSet coding, int level) noexcept {
+  return coding << 32 | static_cast<u32>(level);
+}
+
+std::unique_ptr<Compressor> CompressorPool::create(u64 key) noexcept {
+  const http_encoding::EncodingSet coding = key >> 32;
+  const auto level = static_cast<int>(static_cast<u32>(key));
+
+  std::unique_ptr<Compressor> compressor;
+  switch (coding) {
+    case http_encoding::GZIP:
+      compressor = std::make_unique<GzipStream>(nullptr, level);
+      break;
+#ifdef CELL_HAVE_ZSTD
+    case http_encoding::ZSTD:
+      compressor = std::make_unique<ZstdStream>(nullptr, level);
+      break;
+#endif
+    default:
+      return nullptr;
+  }
+
+  if (!compressor->is_ok()) {
+    CELL_LOG_DEBUG("compressor pool: failed to initialize coding %lu level %d", coding, level);
+    return nullptr;
+  }
+
+  return compressor;
+}
+
+CompressorLease CompressorPool::acquire(http_encoding::EncodingSet coding, int level,
+                                        Sink* sink) noexcept {
+  const u64 key = make_key(coding, level);
+  std::unique_ptr<Compressor> compressor;
+
+  auto it = m_idle.find(key);
+  if (it != m_idle.end() && !it->second.empty()) {
+    compressor = std::move(it->second.back());
+    it->second.pop_back();
+
+    ++m_stats.hits;
+    --m_stats.idle_contexts;
+    m_stats.idle_bytes -= compressor->get_memory_footprint();
+  } else {
+    compressor = create(key);
+    if (compressor == nullptr) {
+      return {};
+    }
+
+    ++m_stats.misses;
+  }
+
+  ++m_stats.leased_contexts;
+  m_stats.leased_bytes += compressor->get_memory_footprint();
+
+  compressor->set_sink(sink);
+  return {this, key, std::move(compressor)};
+}
+
+void CompressorPool::give_back(u64 key, std::unique_ptr<Compressor> compressor) noexcept {
+  CELL_ASSERT(m_stats.leased_contexts != 0);
+
+  const u64 footprint = compressor->get_memory_footprint();
+  --m_stats.leased_contexts;
+  m_stats.leased_bytes -= footprint;
+
+  auto& idle = m_idle[key];
+  if (idle.size() >= m_max_idle_per_key) {
+    ++m_stats.discarded;
+    return;
+  }
+
+  compressor->reset();
+  compressor->set_sink(nullptr);
+  idle.push_back(std::move(compressor));
+
+  ++m_stats.idle_contexts;
+  m_stats.idle_bytes += footprint;
+}
+
+void CompressorPool::prewarm(http_encoding::EncodingSet coding, int level, u64 count) noexcept {
+  const u64 key = make_key(coding, level);
+  auto& idle = m_idle[key];
+
+  while (idle.size() < count && idle.size() < m_max_idle_per_key) {
+    auto compressor = create(key);
+    if (compressor == nullptr) {
+      return;
+    }
+
+    ++m_stats.idle_contexts;
+    m_stats.idle_bytes += compressor->get_memory_footprint();
+    idle.push_back(std::move(compressor));
+  }
+}
+
+void CompressorPool::trim() noexcept {
+  m_idle.clear();
+  m_stats.idle_contexts = 0;
+  m_stats.idle_bytes = 0;
+}
+
+}  // namespace cell::encoding
@@ -0,0 +1,94 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_COMPRESSOR_POOL_HPP
+#define CELL_COMPRESSOR_POOL_HPP
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "cell/core/types.hpp"
+#include "cell/http/encoding.hpp"
+#include "compressor.hpp"
+#include "sink.hpp"
+
+namespace cell::encoding {
+
+class CompressorPool;
+
+struct CompressorPoolStats {
+  u64 hits{0};            // acquire() served from an idle context
+  u64 misses{0};          // acquire() had to initialize a new context
+  u64 discarded{0};       // released contexts freed because the pool was full
+  u64 idle_contexts{0};
+  u64 leased_contexts{0};
+  u64 idle_bytes{0};      // memory held by idle contexts
+  u64 leased_bytes{0};    // memory held by contexts currently checked out
+};
+
+// A checked out compressor. Goes back to its pool, reset, when destroyed.
+class CompressorLease {
+ public:
+  CompressorLease() noexcept = default;
+  CompressorLease(CompressorPool* pool, u64 key, std::unique_ptr<Compressor> compressor) noexcept;
+  CompressorLease(CompressorLease&& other) noexcept;
+  CompressorLease& operator=(CompressorLease&& other) noexcept;
+  CompressorLease(const CompressorLease&) = delete;
+  CompressorLease& operator=(const CompressorLease&) = delete;
+  ~CompressorLease();
+
+  [[nodiscard]] bool is_valid() const noexcept { return m_compressor != nullptr; }
+  [[nodiscard]] Compressor* get() const noexcept { return m_compressor.get(); }
+  [[nodiscard]] Compressor* operator->() const noexcept { return m_compressor.get(); }
+
+  // Returns the compressor early
+  void release() noexcept;
+
+ private:
+  CompressorPool* m_pool{nullptr};
+  u64 m_key{0};
+  std::unique_ptr<Compressor> m_compressor{};
+};
+
+// Pool of initialized compressor contexts keyed by (coding, level). Setting
+// up a deflate stream allocates a few hundred KB, so contexts are reset and
+// reused instead of freed. Not thread safe: use get_thread_local().
+class CompressorPool {
+ public:
+  static constexpr u64 DEFAULT_MAX_IDLE_PER_KEY = 16;
+
+  explicit CompressorPool(u64 max_idle_per_key = DEFAULT_MAX_IDLE_PER_KEY) noexcept;
+  CompressorPool(const CompressorPool&) = delete;
+  CompressorPool& operator=(const CompressorPool&) = delete;
+
+  [[nodiscard]] static CompressorPool& get_thread_local() noexcept;
+
+  // The lease is invalid if `coding` isn't supported by this build or the
+  // encoder failed to initialize
+  [[nodiscard]] CompressorLease acquire(http::encoding::EncodingSet coding, int level,
+                                        Sink* sink) noexcept;
+
+  // Initializes `count` contexts ahead of time, e.g. at worker start-up
+  void prewarm(http::encoding::EncodingSet coding, int level, u64 count) noexcept;
+
+  // Frees every idle context
+  void trim() noexcept;
+
+  [[nodiscard]] const CompressorPoolStats& get_stats() const noexcept { return m_stats; }
+
+ private:
+  friend class CompressorLease;
+
+  [[nodiscard]] static u64 make_key(http::encoding::EncodingSet coding, int level) noexcept;
+  [[nodiscard]] static std::unique_ptr<Compressor> create(u64 key) noexcept;
+  void give_back(u64 key, std::unique_ptr<Compressor> compressor) noexcept;
+
+  u64 m_max_idle_per_key;
+  std::unordered_map<u64, std::vector<std::unique_ptr<Compressor>>> m_idle{};
+  CompressorPoolStats m_stats{};
+};
+
+}  // namespace cell::encoding
+
+#endif  // CELL_COMPRESSOR_POOL_HPP
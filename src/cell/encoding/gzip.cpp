@@ -5,6 +5,10 @@
 
 #include <zlib.h>
 
+#include <algorithm>
+#include <climits>
+
+#include "cell/core/base.hpp"
 #include "cell/core/memory.hpp"
 #include "cell/core/string_slice.hpp"
 #include "cell/core/types.hpp"
@@ -12,10 +16,10 @@
 
 namespace cell::encoding {
 
-Gzip::Gzip() {
+Gzip::Gzip(int level) {
   mem_zero(&m_stream, sizeof(z_stream));
-  m_status = deflateInit2(&m_stream, DEFAULT_COMPRESSION_LEVEL, DEFAULT_METHOD,
-                          DEFAULT_GZIP_WINDOW_BITS, DEFAULT_MEM_LEVEL, DEFAULT_STRATEGY);
+  m_status = deflateInit2(&m_stream, level, DEFAULT_METHOD, DEFAULT_GZIP_WINDOW_BITS,
+                          DEFAULT_MEM_LEVEL, DEFAULT_STRATEGY);
 }
 
 Gzip::~Gzip() { deflateEnd(&m_stream); }
@@ -23,28 +27,53 @@ Gzip::~Gzip() { deflateEnd(&m_stream); }
 void Gzip::reset() { deflateReset(&m_stream); }
 
 
-void Gzip::compress_string(const String& in, String& out, int block_size) {
-  out.expand(block_size); // reserve block size if it isn't already that big
-  m_stream.next_in = in.get_buffer_ptr();
-  m_stream.avail_in = in.get_length();
-  m_stream.next_out = out.get_buffer_ptr();
-  m_stream.avail_out = out.get_capacity();
-
-  CELL_ASSERT(m_stream.avail_out != 0);
+bool Gzip::compress_string(StringSlice in, String& out) {
   CELL_ASSERT(is_ok());
 
-  constexpr auto flush = Z_FINISH; // we already have all the input we need
-  int deflate_status;
+  // deflateBound is an upper bound for a single Z_FINISH call, so one
+  // expand() is enough and deflate never runs out of room
+  const u64 bound = deflateBound(&m_stream, static_cast<uLong>(in.get_length()));
+  const u64 out_length = out.get_length();
+  if (out_length + bound >= out.get_capacity()) {
+    out.expand(round_up_8(out_length + bound + 1));
+  }
+
+  // zlib counts in uInt, so 4 GiB and more go in slices each way, with
+  // Z_FINISH once the last of the input is in
+  const u8* next_in = in.get_u8_ptr();
+  u64 remaining = in.get_length();
+  u8* const dst = out.get_buffer_ptr() + out_length;
+  const u64 room = out.get_capacity() - out_length - 1;
+  u64 written = 0;
+
+  int deflate_status = Z_OK;
+  while (deflate_status == Z_OK) {
+    const u64 avail_in = std::min<u64>(remaining, UINT_MAX);
+    const u64 avail_out = std::min<u64>(room - written, UINT_MAX);
+    m_stream.next_in = const_cast<Bytef*>(next_in);
+    m_stream.avail_in = static_cast<uInt>(avail_in);
+    m_stream.next_out = dst + written;
+    m_stream.avail_out = static_cast<uInt>(avail_out);
 
-  do {
-    CELL_LOG_DEBUG_SIMPLE("DEFLATING");
-    deflate_status = deflate(&m_stream, flush);
+    deflate_status = deflate(&m_stream, avail_in == remaining ? Z_FINISH : Z_NO_FLUSH);
     CELL_ASSERT(deflate_status != Z_STREAM_ERROR);
-  } while (m_stream.avail_out == 0);
 
-  // finished
-  deflateEnd(&m_stream);
-  log::hexdump(reinterpret_cast<const u8*>(out.get_buffer_ptr()), 32);
+    const u64 consumed = avail_in - m_stream.avail_in;
+    next_in += consumed;
+    remaining -= consumed;
+    written += avail_out - m_stream.avail_out;
+  }
+
+  const bool finished = deflate_status == Z_STREAM_END;
+  if (finished) {
+    out.set_length(out_length + written);
+  } else {
+    CELL_LOG_DEBUG("gzip: deflate did not finish (status %d)", deflate_status);
+    out.set_length(out_length);
+  }
+
+  deflateReset(&m_stream);
+  return finished;
 }
 StringSlice Gzip::get_status_as_string() const noexcept {
   switch (m_status) {
@@ -61,4 +90,89 @@ StringSlice Gzip::get_status_as_string() const noexcept {
   }
 }
 
+// -----------------------------------------------------------------------------
+// GzipStream
+// -----------------------------------------------------------------------------
+
+GzipStream::GzipStream(Sink* sink, int level, u64 chunk_size)
+    : m_sink(sink), m_level(level), m_status(Z_OK), m_chunk(chunk_size), m_chunk_size(chunk_size) {
+  CELL_ASSERT(chunk_size != 0);
+  mem_zero(&m_stream, sizeof(z_stream));
+  m_status = deflateInit2(&m_stream, level, Gzip::DEFAULT_METHOD, Gzip::DEFAULT_GZIP_WINDOW_BITS,
+                          Gzip::DEFAULT_MEM_LEVEL, Gzip::DEFAULT_STRATEGY);
+}
+
+GzipStream::~GzipStream() { deflateEnd(&m_stream); }
+
+bool GzipStream::write(StringSlice data) noexcept {
+  if (data.get_length() == 0) {
+    return true;
+  }
+
+  // In uInt-sized slices, pump() takes each one whole
+  const u8* next_in = data.get_u8_ptr();
+  u64 remaining = data.get_length();
+  while (remaining != 0) {
+    const u64 avail_in = std::min<u64>(remaining, UINT_MAX);
+    m_stream.next_in = const_cast<Bytef*>(next_in);
+    m_stream.avail_in = static_cast<uInt>(avail_in);
+    if (!pump(Z_NO_FLUSH)) {
+      return false;
+    }
+    next_in += avail_in;
+    remaining -= avail_in;
+  }
+  return true;
+}
+
+bool GzipStream::flush() noexcept { return pump(Z_SYNC_FLUSH); }
+
+bool GzipStream::finish() noexcept {
+  const bool ok = pump(Z_FINISH);
+  deflateReset(&m_stream);
+  return ok;
+}
+
+void GzipStream::reset() noexcept { deflateReset(&m_stream); }
+
+u64 GzipStream::get_memory_footprint() const noexcept {
+  // zlib's own estimate for deflate (zconf.h): (1 << (windowBits+2)) + (1 << (memLevel+9))
+  constexpr u64 window_bits = Gzip::DEFAULT_GZIP_WINDOW_BITS - 16;
+  constexpr u64 deflate_state = (1ULL << (window_bits + 2)) + (1ULL << (Gzip::DEFAULT_MEM_LEVEL + 9));
+  return deflate_state + m_chunk.get_capacity();
+}
+
+bool GzipStream::pump(int flush) noexcept {
+  CELL_ASSERT(is_ok());
+  CELL_ASSERT(m_sink != nullptr);
+
+  u8* const chunk = m_chunk.get_buffer_ptr();
+  const u64 chunk_size = std::min<u64>(m_chunk_size, UINT_MAX);
+
+  while (true) {
+    m_stream.next_out = chunk;
+    m_stream.avail_out = static_cast<uInt>(chunk_size);
+
+    const int deflate_status = deflate(&m_stream, flush);
+    if (deflate_status == Z_STREAM_ERROR) {
+      return false;
+    }
+
+    const u64 produced = chunk_size - m_stream.avail_out;
+    if (produced != 0 && !m_sink->consume(StringSlice{chunk, produced})) {
+      return false;
+    }
+
+    if (deflate_status == Z_STREAM_END) {
+      return true;
+    }
+
+    // A full chunk means deflate may have more to give. Otherwise all input
+    // was consumed, and for Z_NO_FLUSH/Z_SYNC_FLUSH that's all we wanted.
+    if (m_stream.avail_out != 0 && flush != Z_FINISH) {
+      return m_stream.avail_in == 0;
+    }
+  }
+}
+
 }  // namespace cell::encoding
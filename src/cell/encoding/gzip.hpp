@@ -8,6 +8,9 @@
 
 #include "cell/core/string.hpp"
 #include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+#include "compressor.hpp"
+#include "sink.hpp"
 
 namespace cell::encoding {
 class Gzip {
@@ -18,7 +21,9 @@ class Gzip {
   static constexpr int DEFAULT_MEM_LEVEL = 9;
   static constexpr int DEFAULT_STRATEGY = Z_DEFAULT_STRATEGY;
 
-  Gzip();
+  explicit Gzip(int level = DEFAULT_COMPRESSION_LEVEL);
+  Gzip(const Gzip&) = delete;
+  Gzip& operator=(const Gzip&) = delete;
   ~Gzip();
 
 
@@ -29,14 +34,55 @@ class Gzip {
 
   void reset();
 
-  void compress_string(const String& in, String& out, int block_size = 512);
+  // Appends a complete gzip member holding `in` to `out`, growing `out` as
+  // needed. The stream is reset afterwards, so the object can be reused.
+  [[nodiscard]] bool compress_string(StringSlice in, String& out);
 
  private:
   int m_status;
   z_stream m_stream{};
 };
 
+// Incremental gzip compressor. Output goes to the sink in chunks of at most
+// chunk_size bytes, so memory stays bounded however large the input is.
+// finish() ends the gzip member and resets the stream for the next one.
+class GzipStream final : public Compressor {
+ public:
+  static constexpr u64 DEFAULT_CHUNK_SIZE = 16 * 1024;
+
+  explicit GzipStream(Sink* sink, int level = Gzip::DEFAULT_COMPRESSION_LEVEL,
+                      u64 chunk_size = DEFAULT_CHUNK_SIZE);
+  GzipStream(const GzipStream&) = delete;
+  GzipStream& operator=(const GzipStream&) = delete;
+  ~GzipStream() override;
+
+  [[nodiscard]] bool is_ok() const noexcept override { return m_status == Z_OK; }
+  [[nodiscard]] u64 get_memory_footprint() const noexcept override;
+  [[nodiscard]] int get_level() const noexcept { return m_level; }
+  [[nodiscard]] u64 get_total_in() const noexcept { return m_stream.total_in; }
+  [[nodiscard]] u64 get_total_out() const noexcept { return m_stream.total_out; }
+
+  void set_sink(Sink* sink) noexcept override { m_sink = sink; }
+
+  [[nodiscard]] bool write(StringSlice data) noexcept override;
+  // Emits everything written so far on a byte boundary (Z_SYNC_FLUSH), e.g.
+  // before handing a partial response to the socket
+  [[nodiscard]] bool flush() noexcept override;
+  [[nodiscard]] bool finish() noexcept override;
+
+  // Drops any pending state and starts a new member
+  void reset() noexcept override;
 
+ private:
+  [[nodiscard]] bool pump(int flush) noexcept;
+
+  Sink* m_sink;
+  int m_level;
+  int m_status;
+  String m_chunk;
+  u64 m_chunk_size;
+  z_stream m_stream{};
+};
 
 }
 
@@ -0,0 +1,173 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "inflate.hpp"
+
+#include <algorithm>
+#include <climits>
+
+#include "cell/core/assert.hpp"
+#include "cell/core/memory.hpp"
+#include "cell/core/string.hpp"
+#include "cell/log/log.hpp"
+
+namespace cell::encoding {
+
+namespace {
+
+constexpr int GZIP_WINDOW_BITS = 15 + 16;
+constexpr int ZLIB_WINDOW_BITS = 15;
+constexpr int RAW_DEFLATE_WINDOW_BITS = -15;
+
+}  // namespace
+
+InflateStream::InflateStream(InflateLimits limits) noexcept : m_limits(limits), m_status(Z_OK) {
+  CELL_ASSERT(limits.max_ratio != 0);
+  mem_zero(&m_stream, sizeof(z_stream));
+  m_status = inflateInit2(&m_stream, GZIP_WINDOW_BITS);
+}
+
+InflateStream::~InflateStream() { inflateEnd(&m_stream); }
+
+bool InflateStream::begin(http::encoding::EncodingSet coding) noexcept {
+  CELL_ASSERT(is_ok());
+
+  m_finished = false;
+  m_total_in = 0;
+  m_total_out = 0;
+
+  switch (coding) {
+    case http::encoding::GZIP:
+      m_format = Format::Gzip;
+      return inflateReset2(&m_stream, GZIP_WINDOW_BITS) == Z_OK;
+    case http::encoding::DEFLATE:
+      // Decided by the first byte, see select_format()
+      m_format = Format::DeflateUndecided;
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool InflateStream::select_format(u8 first_byte) noexcept {
+  // A zlib header starts with CM = 8 and CINFO <= 7. A raw deflate block
+  // only starts like that when it's a stored block with junk padding bits,
+  // which encoders don't produce.
+  const bool is_zlib = (first_byte & 0x0f) == Z_DEFLATED && (first_byte >> 4) <= 7;
+  m_format = is_zlib ? Format::Zlib : Format::RawDeflate;
+  return inflateReset2(&m_stream, is_zlib ? ZLIB_WINDOW_BITS : RAW_DEFLATE_WINDOW_BITS) == Z_OK;
+}
+
+u64 InflateStream::get_output_budget(u64 pending_input) const noexcept {
+  // Both limits hold on entry (inflate() fails otherwise); the extra byte
+  // lets the next call overshoot by one so the violation gets noticed
+  const u64 ratio_allowance = std::max(m_limits.ratio_grace_size,
+                                       (m_total_in + pending_input) * m_limits.max_ratio);
+  return std::min(m_limits.max_output_size, ratio_allowance) - m_total_out + 1;
+}
+
+InflateResult InflateStream::inflate(StringSlice& in, u8* out, u64 out_capacity,
+                                     u64& out_length) noexcept {
+  CELL_ASSERT(is_ok());
+  out_length = 0;
+
+  while (true) {
+    if (m_finished) {
+      if (in.get_length() == 0) {
+        return InflateResult::Done;
+      }
+
+      // Another gzip member may follow, anything else is trailing junk
+      if (m_format != Format::Gzip || inflateReset(&m_stream) != Z_OK) {
+        return InflateResult::ErrorCorrupt;
+      }
+      m_finished = false;
+    }
+
+    if (out_length == out_capacity) {
+      return InflateResult::OutputFull;
+    }
+
+    if (m_format == Format::DeflateUndecided) {
+      if (in.get_length() == 0) {
+        return InflateResult::NeedInput;
+      }
+      if (!select_format(in.byte_at(0))) {
+        return InflateResult::ErrorCorrupt;
+      }
+    }
+
+    const u64 avail_in = std::min<u64>(in.get_length(), UINT_MAX);
+    const u64 avail_out =
+        std::min<u64>({out_capacity - out_length, get_output_budget(avail_in), UINT_MAX});
+
+    m_stream.next_in = const_cast<Bytef*>(in.get_u8_ptr());
+    m_stream.avail_in = static_cast<uInt>(avail_in);
+    m_stream.next_out = out + out_length;
+    m_stream.avail_out = static_cast<uInt>(avail_out);
+
+    const int status = ::inflate(&m_stream, Z_NO_FLUSH);
+
+    const u64 consumed = avail_in - m_stream.avail_in;
+    const u64 produced = avail_out - m_stream.avail_out;
+    in = StringSlice{in.get_u8_ptr() + consumed, in.get_length() - consumed};
+    m_total_in += consumed;
+    m_total_out += produced;
+    out_length += produced;
+
+    if (m_total_out > m_limits.max_output_size) {
+      CELL_LOG_DEBUG("inflate: refusing body larger than %lu bytes", m_limits.max_output_size);
+      return InflateResult::ErrorTooLarge;
+    }
+
+    if (m_total_out > m_limits.ratio_grace_size &&
+        m_total_out > m_total_in * m_limits.max_ratio) {
+      CELL_LOG_DEBUG("inflate: refusing body, %lu bytes out of %lu", m_total_out, m_total_in);
+      return InflateResult::ErrorRatioExceeded;
+    }
+
+    switch (status) {
+      case Z_STREAM_END:
+        m_finished = true;
+        break;
+      case Z_OK:
+        if (in.get_length() == 0 && m_stream.avail_out != 0) {
+          return InflateResult::NeedInput;
+        }
+        break;
+      case Z_BUF_ERROR:
+        // No progress possible: out of input, nothing left buffered
+        return InflateResult::NeedInput;
+      default:
+        CELL_LOG_DEBUG("inflate: zlib status %d", status);
+        return InflateResult::ErrorCorrupt;
+    }
+  }
+}
+
+InflateResult InflateStream::inflate_to_sink(StringSlice in, Sink* sink, u64 chunk_size) noexcept {
+  CELL_ASSERT(sink != nullptr && chunk_size != 0);
+  String chunk(chunk_size + 1);
+
+  while (true) {
+    u64 length = 0;
+    const InflateResult result = inflate(in, chunk.get_buffer_ptr(), chunk_size, length);
+
+    if (length != 0 && !sink->consume(StringSlice{chunk.get_buffer_ptr(), length})) {
+      // Sinks refuse input when they're out of room
+      return InflateResult::ErrorTooLarge;
+    }
+
+    switch (result) {
+      case InflateResult::OutputFull:
+        continue;
+      case InflateResult::NeedInput:
+        // The whole body was given, so it was cut short
+        return InflateResult::ErrorCorrupt;
+      default:
+        return result;
+    }
+  }
+}
+
+}  // namespace cell::encoding
@@ -0,0 +1,83 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_INFLATE_HPP
+#define CELL_INFLATE_HPP
+
+#include <zlib.h>
+
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+#include "cell/http/encoding.hpp"
+#include "sink.hpp"
+
+namespace cell::encoding {
+
+// Bounds on what a compressed request body may expand to. The ratio is only
+// enforced past ratio_grace_size, small bodies compress very well.
+struct InflateLimits {
+  u64 max_output_size{16 * 1024 * 1024};
+  u64 max_ratio{100};  // output bytes per input byte
+  u64 ratio_grace_size{64 * 1024};
+};
+
+enum class InflateResult {
+  NeedInput,   // all input consumed, the stream isn't over yet
+  OutputFull,  // call again with a fresh output buffer
+  Done,
+  ErrorCorrupt,
+  ErrorTooLarge,
+  ErrorRatioExceeded,
+};
+
+// Incremental gzip / deflate decompressor for request bodies. Output goes
+// into caller-provided buffers, and limits are checked on every call, so a
+// decompression bomb is refused after at most one buffer's worth of output.
+class InflateStream {
+ public:
+  static constexpr u64 DEFAULT_CHUNK_SIZE = 16 * 1024;
+
+  explicit InflateStream(InflateLimits limits = {}) noexcept;
+  InflateStream(const InflateStream&) = delete;
+  InflateStream& operator=(const InflateStream&) = delete;
+  ~InflateStream();
+
+  [[nodiscard]] bool is_ok() const noexcept { return m_status == Z_OK; }
+  [[nodiscard]] const InflateLimits& get_limits() const noexcept { return m_limits; }
+  void set_limits(InflateLimits limits) noexcept { m_limits = limits; }
+
+  // Starts a new body in the given coding, GZIP or DEFLATE. "deflate" is
+  // zlib-wrapped per RFC 9110, raw deflate is accepted as some clients send it.
+  [[nodiscard]] bool begin(http::encoding::EncodingSet coding) noexcept;
+
+  // Inflates from `in` into `out`, advancing `in` past the consumed bytes
+  // and setting `out_length` to the bytes written. Concatenated gzip members
+  // are decoded as one body.
+  [[nodiscard]] InflateResult inflate(StringSlice& in, u8* out, u64 out_capacity,
+                                      u64& out_length) noexcept;
+
+  // Inflates a whole body to the sink, chunk_size bytes at a time
+  [[nodiscard]] InflateResult inflate_to_sink(StringSlice in, Sink* sink,
+                                              u64 chunk_size = DEFAULT_CHUNK_SIZE) noexcept;
+
+  [[nodiscard]] u64 get_total_in() const noexcept { return m_total_in; }
+  [[nodiscard]] u64 get_total_out() const noexcept { return m_total_out; }
+
+ private:
+  enum class Format { Gzip, DeflateUndecided, Zlib, RawDeflate };
+
+  [[nodiscard]] bool select_format(u8 first_byte) noexcept;
+  [[nodiscard]] u64 get_output_budget(u64 pending_input) const noexcept;
+
+  InflateLimits m_limits;
+  z_stream m_stream{};
+  int m_status;
+  Format m_format{Format::Gzip};
+  bool m_finished{false};
+  u64 m_total_in{0};
+  u64 m_total_out{0};
+};
+
+}  // namespace cell::encoding
+
+#endif  // CELL_INFLATE_HPP
@@ -0,0 +1,192 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "parallel_gzip.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "cell/core/assert.hpp"
+#include "cell/core/base.hpp"
+#include "cell/log/log.hpp"
+
+namespace cell::encoding {
+
+namespace {
+
+constexpr int RAW_DEFLATE_WINDOW_BITS = -15;
+
+// ID1 ID2 CM FLG MTIME(4) XFL OS, no name and no mtime, like gzip -n
+constexpr u8 GZIP_HEADER[] = {0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0, 0, 3};
+
+// Z_SYNC_FLUSH appends an empty stored block on top of deflateBound's estimate
+constexpr u64 SYNC_FLUSH_OVERHEAD = 16;
+
+struct Block {
+  String compressed{8};
+  uLong crc{0};
+  bool ok{false};
+};
+
+// Shared with the jobs, which may only get to run once the call is over:
+// by then there's no block left to claim, and they don't touch the input
+struct Blocks {
+  StringSlice in;
+  int level;
+  u64 block_size;
+  std::vector<Block> blocks;
+  std::atomic<u64> next{0};
+  std::atomic<u64> done{0};
+};
+
+void append_u32_le(String& out, u32 value) {
+  const u8 bytes[] = {static_cast<u8>(value), static_cast<u8>(value >> 8),
+                      static_cast<u8>(value >> 16), static_cast<u8>(value >> 24)};
+  out.append_slice(StringSlice{bytes, sizeof(bytes)});
+}
+
+// Raw deflate of one block; all but the last end byte-aligned and non-final
+bool compress_block(z_stream& stream, StringSlice dictionary, StringSlice in, bool last,
+                    String& out) {
+  if (deflateReset(&stream) != Z_OK) {
+    return false;
+  }
+
+  if (dictionary.get_length() != 0 &&
+      deflateSetDictionary(&stream, dictionary.get_u8_ptr(),
+                           static_cast<uInt>(dictionary.get_length())) != Z_OK) {
+    return false;
+  }
+
+  const u64 bound = deflateBound(&stream, static_cast<uLong>(in.get_length())) + SYNC_FLUSH_OVERHEAD;
+  out.set_length(0);
+  if (bound >= out.get_capacity()) {
+    out.expand(round_up_8(bound + 1));
+  }
+
+  stream.next_in = const_cast<Bytef*>(in.get_u8_ptr());
+  stream.avail_in = static_cast<uInt>(in.get_length());
+  stream.next_out = out.get_buffer_ptr();
+  stream.avail_out = static_cast<uInt>(bound);
+
+  const int status = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+  const bool done = last ? status == Z_STREAM_END : status == Z_OK && stream.avail_in == 0;
+  if (!done) {
+    CELL_LOG_DEBUG("parallel gzip: deflate status %d", status);
+    return false;
+  }
+
+  out.set_length(bound - stream.avail_out);
+  return true;
+}
+
+bool init_stream(z_stream& stream, int level) {
+  return deflateInit2(&stream, level, Z_DEFLATED, RAW_DEFLATE_WINDOW_BITS, Gzip::DEFAULT_MEM_LEVEL,
+                      Gzip::DEFAULT_STRATEGY) == Z_OK;
+}
+
+// Claims the next block, if any is left, and compresses it. `stream` is
+// initialized on first use. false once every block is claimed.
+bool compress_next(Blocks& state, z_stream& stream, bool& stream_ready) {
+  const u64 i = state.next.fetch_add(1);
+  const u64 count = state.blocks.size();
+  if (i >= count) {
+    return false;
+  }
+
+  const StringSlice in = state.in;
+  const u64 offset = i * state.block_size;
+  const u64 length = std::min(state.block_size, in.get_length() - std::min(offset, in.get_length()));
+  const StringSlice block{in.get_u8_ptr() + offset, length};
+  const u64 dictionary_length = std::min(offset, ParallelGzip::DICTIONARY_SIZE);
+  const StringSlice dictionary{in.get_u8_ptr() + offset - dictionary_length, dictionary_length};
+
+  if (!stream_ready) {
+    stream = z_stream{};
+    stream_ready = init_stream(stream, state.level);
+  }
+
+  Block& result = state.blocks[i];
+  result.crc = crc32(0, block.get_u8_ptr(), static_cast<uInt>(block.get_length()));
+  result.ok =
+      stream_ready && compress_block(stream, dictionary, block, i + 1 == count, result.compressed);
+
+  if (state.done.fetch_add(1) + 1 == count) {
+    state.done.notify_all();
+  }
+  return true;
+}
+
+}  // namespace
+
+ParallelGzip::ParallelGzip(ParallelGzipConfig config) noexcept : m_config(config) {
+  CELL_ASSERT(m_config.block_size >= DICTIONARY_SIZE);
+}
+
+bool ParallelGzip::compress_string(StringSlice in, String& out) {
+  const u64 block_size = m_config.block_size;
+  const u64 block_count = std::max<u64>(1, (in.get_length() + block_size - 1) / block_size);
+  auto state = std::make_shared<Blocks>(in, m_config.level, block_size,
+                                        std::vector<Block>(block_count));
+
+  // One job per block, the caller taking the first and whatever the pool
+  // hasn't got to
+  if (m_config.pool != nullptr) {
+    for (u64 i = 1; i < block_count; ++i) {
+      m_config.pool->submit([state] {
+        z_stream stream{};
+        bool stream_ready = false;
+        if (compress_next(*state, stream, stream_ready) && stream_ready) {
+          deflateEnd(&stream);
+        }
+      });
+    }
+  }
+
+  z_stream stream{};
+  bool stream_ready = false;
+  while (compress_next(*state, stream, stream_ready)) {
+  }
+  if (stream_ready) {
+    deflateEnd(&stream);
+  }
+
+  // Blocks the jobs claimed are still being compressed
+  for (u64 done = state->done.load(); done != block_count; done = state->done.load()) {
+    state->done.wait(done);
+  }
+
+  const std::vector<Block>& blocks = state->blocks;
+  u64 compressed_length = sizeof(GZIP_HEADER) + 8;
+  for (const Block& block : blocks) {
+    if (!block.ok) {
+      return false;
+    }
+    compressed_length += block.compressed.get_length();
+  }
+
+  const u64 out_length = out.get_length();
+  if (out_length + compressed_length >= out.get_capacity()) {
+    out.expand(round_up_8(out_length + compressed_length + 1));
+  }
+
+  out.append_slice(StringSlice{GZIP_HEADER, sizeof(GZIP_HEADER)});
+  uLong crc = crc32(0, nullptr, 0);
+  for (u64 i = 0; i < block_count; ++i) {
+    out.append_slice(blocks[i].compressed.slice());
+    const u64 offset = i * block_size;
+    const u64 length = std::min(block_size, in.get_length() - std::min(offset, in.get_length()));
+    crc = crc32_combine(crc, blocks[i].crc, static_cast<z_off_t>(length));
+  }
+
+  // CRC32 and ISIZE (length mod 2^32), little endian
+  append_u32_le(out, static_cast<u32>(crc));
+  append_u32_le(out, static_cast<u32>(in.get_length()));
+  return true;
+}
+
+}  // namespace cell::encoding
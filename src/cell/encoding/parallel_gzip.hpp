@@ -0,0 +1,50 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_PARALLEL_GZIP_HPP
+#define CELL_PARALLEL_GZIP_HPP
+
+#include "cell/core/string.hpp"
+#include "cell/core/task_pool.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+#include "gzip.hpp"
+
+namespace cell::encoding {
+
+struct ParallelGzipConfig {
+  int level{Gzip::DEFAULT_COMPRESSION_LEVEL};
+  u64 block_size{128 * 1024};
+  TaskPool* pool{nullptr};  // nullptr: every block on the calling thread
+};
+
+// pigz-style gzip for large bodies. The input is cut into blocks which are
+// deflated concurrently, each primed with the last 32 KiB of the previous
+// block so the ratio stays close to a single-threaded run. Blocks end on a
+// byte boundary (Z_SYNC_FLUSH), so they concatenate into a single gzip
+// member that any gunzip reads.
+//
+// Every block but the first is a job on the TaskPool. The calling thread
+// takes blocks too while it waits, whichever are left, so a call from a
+// pool worker or with a busy pool still makes progress.
+class ParallelGzip {
+ public:
+  // zlib's window, the most a block can refer back to
+  static constexpr u64 DICTIONARY_SIZE = 32 * 1024;
+
+  explicit ParallelGzip(ParallelGzipConfig config = {}) noexcept;
+
+  [[nodiscard]] TaskPool* get_pool() const noexcept { return m_config.pool; }
+  [[nodiscard]] u64 get_block_size() const noexcept { return m_config.block_size; }
+
+  // Appends one gzip member holding `in` to `out`, blocking until it's
+  // done. Inputs of a single block are compressed on the calling thread.
+  [[nodiscard]] bool compress_string(StringSlice in, String& out);
+
+ private:
+  ParallelGzipConfig m_config;
+};
+
+}  // namespace cell::encoding
+
+#endif  // CELL_PARALLEL_GZIP_HPP
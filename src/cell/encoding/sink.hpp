@@ -0,0 +1,69 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_SINK_HPP
+#define CELL_SINK_HPP
+
+#include <vector>
+
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+
+namespace cell::encoding {
+
+// Receives the output of streaming encoders chunk by chunk. A chunk is only
+// valid for the duration of the call; consume() returns false to abort the
+// stream.
+class Sink {
+ public:
+  Sink() = default;
+  Sink(const Sink&) = delete;
+  Sink& operator=(const Sink&) = delete;
+  virtual ~Sink() = default;
+
+  [[nodiscard]] virtual bool consume(StringSlice chunk) noexcept = 0;
+};
+
+// Appends everything to a single String
+class StringSink final : public Sink {
+ public:
+  explicit StringSink(String* out) noexcept : m_out(out) {}
+  StringSink(const StringSink&) = delete;
+  StringSink& operator=(const StringSink&) = delete;
+
+  [[nodiscard]] bool consume(StringSlice chunk) noexcept override {
+    m_out->append_slice(chunk);
+    return true;
+  }
+
+ private:
+  String* m_out;
+};
+
+// Keeps every chunk as its own buffer, so nothing is ever moved to make room
+class ChainSink final : public Sink {
+ public:
+  explicit ChainSink() noexcept = default;
+
+  [[nodiscard]] bool consume(StringSlice chunk) noexcept override {
+    m_chain.emplace_back(chunk);
+    m_total_length += chunk.get_length();
+    return true;
+  }
+
+  [[nodiscard]] const std::vector<String>& get_chain() const noexcept { return m_chain; }
+  [[nodiscard]] u64 get_total_length() const noexcept { return m_total_length; }
+  void clear() noexcept {
+    m_chain.clear();
+    m_total_length = 0;
+  }
+
+ private:
+  std::vector<String> m_chain{};
+  u64 m_total_length{0};
+};
+
+}  // namespace cell::encoding
+
+#endif  // CELL_SINK_HPP
@@ -0,0 +1,168 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "zstd.hpp"
+
+// For ZSTD_estimateCStreamSize(), exported by the shared library too
+#define ZSTD_STATIC_LINKING_ONLY
+#include <zstd.h>
+
+#include "cell/core/base.hpp"
+#include "cell/core/memory.hpp"
+#include "cell/log/log.hpp"
+
+namespace cell::encoding {
+
+namespace {
+
+bool set_level_and_dictionary(ZSTD_CCtx* cctx, int level, const ZstdDictionary* dictionary) {
+  if (ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level))) {
+    return false;
+  }
+
+  // Content checksums cost a few % of throughput; TCP and TLS cover us
+  if (ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 0))) {
+    return false;
+  }
+
+  ZSTD_CDict* cdict = dictionary != nullptr ? dictionary->get_cdict() : nullptr;
+  return !ZSTD_isError(ZSTD_CCtx_refCDict(cctx, cdict));
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------------
+// ZstdDictionary
+// -----------------------------------------------------------------------------
+
+ZstdDictionary::~ZstdDictionary() { ZSTD_freeCDict(m_cdict); }
+
+bool ZstdDictionary::load_from_file(const char* path) noexcept {
+  String contents;
+  if (!contents.append_file_contents(path)) {
+    return false;
+  }
+
+  return load_from_memory(contents.slice());
+}
+
+bool ZstdDictionary::load_from_memory(StringSlice dictionary) noexcept {
+  if (dictionary.get_length() == 0) {
+    return false;
+  }
+
+  // ZSTD_createCDict copies the buffer, the caller's may go away
+  ZSTD_CDict* cdict = ZSTD_createCDict(dictionary.get_u8_ptr(), dictionary.get_length(), m_level);
+  if (cdict == nullptr) {
+    CELL_LOG_DEBUG_SIMPLE("zstd: failed to digest dictionary");
+    return false;
+  }
+
+  ZSTD_freeCDict(m_cdict);
+  m_cdict = cdict;
+  m_id = ZSTD_getDictID_fromDict(dictionary.get_u8_ptr(), dictionary.get_length());
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// Zstd
+// -----------------------------------------------------------------------------
+
+Zstd::Zstd(int level, const ZstdDictionary* dictionary) : m_cctx(ZSTD_createCCtx()) {
+  m_ok = m_cctx != nullptr && set_level_and_dictionary(m_cctx, level, dictionary);
+}
+
+Zstd::~Zstd() { ZSTD_freeCCtx(m_cctx); }
+
+bool Zstd::compress_string(StringSlice in, String& out) {
+  CELL_ASSERT(is_ok());
+
+  const u64 bound = ZSTD_compressBound(in.get_length());
+  const u64 out_length = out.get_length();
+  if (out_length + bound >= out.get_capacity()) {
+    out.expand(round_up_8(out_length + bound + 1));
+  }
+
+  const size_t written =
+      ZSTD_compress2(m_cctx, out.get_buffer_ptr() + out_length, out.get_capacity() - out_length - 1,
+                     in.get_u8_ptr(), in.get_length());
+
+  if (ZSTD_isError(written)) {
+    CELL_LOG_DEBUG("zstd: %s", ZSTD_getErrorName(written));
+    out.set_length(out_length);
+    return false;
+  }
+
+  out.set_length(out_length + written);
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// ZstdStream
+// -----------------------------------------------------------------------------
+
+ZstdStream::ZstdStream(Sink* sink, int level, const ZstdDictionary* dictionary, u64 chunk_size)
+    : m_sink(sink),
+      m_cctx(ZSTD_createCCtx()),
+      m_chunk(chunk_size),
+      m_chunk_size(chunk_size),
+      m_footprint(ZSTD_estimateCStreamSize(level) + m_chunk.get_capacity()) {
+  CELL_ASSERT(chunk_size != 0);
+  m_ok = m_cctx != nullptr && set_level_and_dictionary(m_cctx, level, dictionary);
+}
+
+ZstdStream::~ZstdStream() { ZSTD_freeCCtx(m_cctx); }
+
+bool ZstdStream::set_dictionary(const ZstdDictionary* dictionary) noexcept {
+  ZSTD_CDict* cdict = dictionary != nullptr ? dictionary->get_cdict() : nullptr;
+  return !ZSTD_isError(ZSTD_CCtx_refCDict(m_cctx, cdict));
+}
+
+bool ZstdStream::write(StringSlice data) noexcept {
+  if (data.get_length() == 0) {
+    return true;
+  }
+
+  return pump(data, ZSTD_e_continue);
+}
+
+bool ZstdStream::flush() noexcept { return pump(StringSlice{nullptr, 0}, ZSTD_e_flush); }
+
+bool ZstdStream::finish() noexcept {
+  const bool ok = pump(StringSlice{nullptr, 0}, ZSTD_e_end);
+  reset();
+  return ok;
+}
+
+void ZstdStream::reset() noexcept { ZSTD_CCtx_reset(m_cctx, ZSTD_reset_session_only); }
+
+bool ZstdStream::pump(StringSlice data, int directive) noexcept {
+  CELL_ASSERT(is_ok());
+  CELL_ASSERT(m_sink != nullptr);
+
+  const auto end_op = static_cast<ZSTD_EndDirective>(directive);
+  ZSTD_inBuffer input{data.get_u8_ptr(), data.get_length(), 0};
+
+  while (true) {
+    ZSTD_outBuffer output{m_chunk.get_buffer_ptr(), m_chunk_size, 0};
+    const size_t remaining = ZSTD_compressStream2(m_cctx, &output, &input, end_op);
+
+    if (ZSTD_isError(remaining)) {
+      CELL_LOG_DEBUG("zstd: %s", ZSTD_getErrorName(remaining));
+      return false;
+    }
+
+    if (output.pos != 0 && !m_sink->consume(StringSlice{m_chunk.get_buffer_ptr(), output.pos})) {
+      return false;
+    }
+
+    // ZSTD_e_continue is done once the input is consumed; flush and end are
+    // done once zstd reports nothing left to write out
+    const bool done = end_op == ZSTD_e_continue ? input.pos == input.size : remaining == 0;
+    if (done) {
+      return true;
+    }
+  }
+}
+
+}  // namespace cell::encoding
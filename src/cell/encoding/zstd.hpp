@@ -0,0 +1,107 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_ZSTD_HPP
+#define CELL_ZSTD_HPP
+
+// Only built when libzstd is found, see CELL_HAVE_ZSTD
+
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+#include "compressor.hpp"
+#include "sink.hpp"
+
+// Keep <zstd.h> out of our headers
+struct ZSTD_CCtx_s;
+struct ZSTD_CDict_s;
+
+namespace cell::encoding {
+
+// A dictionary trained offline (see tools/cellzstd) and digested once for a
+// compression level. Immutable after loading, so one instance can be shared
+// by every stream on every thread. Clients need the same dictionary to
+// decode, so this is meant for our own API clients.
+class ZstdDictionary {
+ public:
+  explicit ZstdDictionary(int level) noexcept : m_level(level) {}
+  ZstdDictionary(const ZstdDictionary&) = delete;
+  ZstdDictionary& operator=(const ZstdDictionary&) = delete;
+  ~ZstdDictionary();
+
+  [[nodiscard]] bool load_from_file(const char* path) noexcept;
+  [[nodiscard]] bool load_from_memory(StringSlice dictionary) noexcept;
+
+  [[nodiscard]] bool is_loaded() const noexcept { return m_cdict != nullptr; }
+  [[nodiscard]] u32 get_id() const noexcept { return m_id; }
+  [[nodiscard]] int get_level() const noexcept { return m_level; }
+  [[nodiscard]] ZSTD_CDict_s* get_cdict() const noexcept { return m_cdict; }
+
+ private:
+  int m_level;
+  u32 m_id{0};
+  ZSTD_CDict_s* m_cdict{nullptr};
+};
+
+// One-shot zstd, mirrors Gzip
+class Zstd {
+ public:
+  static constexpr int DEFAULT_COMPRESSION_LEVEL = 19;
+
+  explicit Zstd(int level = DEFAULT_COMPRESSION_LEVEL, const ZstdDictionary* dictionary = nullptr);
+  Zstd(const Zstd&) = delete;
+  Zstd& operator=(const Zstd&) = delete;
+  ~Zstd();
+
+  [[nodiscard]] bool is_ok() const noexcept { return m_ok; }
+
+  // Appends one zstd frame holding `in` to `out`
+  [[nodiscard]] bool compress_string(StringSlice in, String& out);
+
+ private:
+  ZSTD_CCtx_s* m_cctx;
+  bool m_ok{false};
+};
+
+// Incremental zstd compressor, the counterpart of GzipStream. finish() ends
+// the frame and resets the session, keeping level and dictionary.
+class ZstdStream final : public Compressor {
+ public:
+  static constexpr u64 DEFAULT_CHUNK_SIZE = 16 * 1024;
+
+  explicit ZstdStream(Sink* sink, int level = Zstd::DEFAULT_COMPRESSION_LEVEL,
+                      const ZstdDictionary* dictionary = nullptr,
+                      u64 chunk_size = DEFAULT_CHUNK_SIZE);
+  ZstdStream(const ZstdStream&) = delete;
+  ZstdStream& operator=(const ZstdStream&) = delete;
+  ~ZstdStream() override;
+
+  [[nodiscard]] bool is_ok() const noexcept override { return m_ok; }
+  // What the context grows to once it has compressed something, not what
+  // it holds now: a pool counts the same bytes when lending and taking back
+  [[nodiscard]] u64 get_memory_footprint() const noexcept override { return m_footprint; }
+
+  void set_sink(Sink* sink) noexcept override { m_sink = sink; }
+  // Takes effect from the next frame; nullptr goes back to no dictionary
+  [[nodiscard]] bool set_dictionary(const ZstdDictionary* dictionary) noexcept;
+
+  [[nodiscard]] bool write(StringSlice data) noexcept override;
+  [[nodiscard]] bool flush() noexcept override;
+  [[nodiscard]] bool finish() noexcept override;
+  void reset() noexcept override;
+
+ private:
+  // Takes a ZSTD_EndDirective
+  [[nodiscard]] bool pump(StringSlice data, int directive) noexcept;
+
+  Sink* m_sink;
+  ZSTD_CCtx_s* m_cctx;
+  String m_chunk;
+  u64 m_chunk_size;
+  u64 m_footprint;
+  bool m_ok{false};
+};
+
+}  // namespace cell::encoding
+
+#endif  // CELL_ZSTD_HPP
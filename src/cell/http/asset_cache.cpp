@@ -0,0 +1,258 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "asset_cache.hpp"
+
+#include <sys/stat.h>
+#include <time.h>
+
+#include "cell/core/hash.hpp"
+#include "cell/log/log.hpp"
+#include "mime_type.hpp"
+
+namespace cell::http {
+
+namespace {
+
+u64 monotonic_coarse_ns() noexcept {
+  timespec ts{};
+  ::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  return static_cast<u64>(ts.tv_sec) * 1'000'000'000ULL + static_cast<u64>(ts.tv_nsec);
+}
+
+i64 mtime_ns_of(const struct stat& statbuf) noexcept {
+  return static_cast<i64>(statbuf.st_mtim.tv_sec) * 1'000'000'000LL + statbuf.st_mtim.tv_nsec;
+}
+
+void set_etag(const EntityTag& etag, Asset& asset) noexcept {
+  asset.etag = etag.get_value();
+  asset.etag_header = etag.get_header_line();
+}
+
+}  // namespace
+
+u64 AssetCache::Entry::get_bytes() const noexcept {
+  u64 bytes = identity.get_length();
+  if (available & encoding::GZIP) {
+    bytes += gzip.get_length();
+  }
+#ifdef CELL_HAVE_ZSTD
+  if (available & encoding::ZSTD) {
+    bytes += zstd.get_length();
+  }
+#endif
+  return bytes;
+}
+
+AssetCache::AssetCache(AssetCacheConfig config) noexcept
+    : m_config(config), m_gzip(config.gzip_level) {}
+
+AssetCache::EntryList::iterator AssetCache::find(StringSlice file_path, u64 hash) noexcept {
+  const auto it = m_index.find(hash);
+  if (it == m_index.end() || !it->second->path.compare(file_path)) {
+    return m_lru.end();
+  }
+  return it->second;
+}
+
+AssetCacheResult AssetCache::get(StringSlice file_path, const encoding::AcceptEncoding& accepted,
+                                 Asset& asset) noexcept {
+  const u64 hash = hash_fnv1a(file_path);
+  auto it = find(file_path, hash);
+
+  if (it != m_lru.end()) {
+    Entry& entry = *it;
+    const u64 now = monotonic_coarse_ns();
+
+    if (now - entry.last_validated_ns >= m_config.revalidate_interval_ns) {
+      struct stat statbuf;  // NOLINT
+      if (::stat(entry.path.get_c_str(), &statbuf) != 0 || !S_ISREG(statbuf.st_mode)) {
+        erase(it);
+        return AssetCacheResult::NotFound;
+      }
+
+      entry.last_validated_ns = now;
+
+      if (mtime_ns_of(statbuf) != entry.mtime_ns ||
+          static_cast<u64>(statbuf.st_size) != entry.file_size) {
+        CELL_LOG_DEBUG("asset cache: '%s' changed on disk, reloading", entry.path.get_c_str());
+        ++m_stats.reloads;
+        m_stats.bytes_used -= entry.get_bytes();
+
+        const auto result = load(entry);
+        if (result != AssetCacheResult::Ok) {
+          m_stats.bytes_used += entry.get_bytes();
+          erase(it);
+          return result;
+        }
+
+        m_stats.bytes_used += entry.get_bytes();
+      }
+    }
+
+    ++m_stats.hits;
+    m_lru.splice(m_lru.begin(), m_lru, it);
+    fill(entry, accepted, asset);
+
+    // A reload may have pushed us over the budget; never evict what we return
+    evict_over_budget();
+    return AssetCacheResult::Ok;
+  }
+
+  ++m_stats.misses;
+
+  if (m_index.contains(hash)) {
+    // 64-bit hash collision with a different path: the new one wins
+    erase(m_index[hash]);
+  }
+
+  m_lru.emplace_front();
+  Entry& entry = m_lru.front();
+  entry.path.append_slice(file_path);
+  entry.hash = hash;
+
+  const auto result = load(entry);
+  if (result != AssetCacheResult::Ok || entry.get_bytes() > m_config.byte_budget) {
+    m_lru.pop_front();
+    return result == AssetCacheResult::Ok ? AssetCacheResult::TooLarge : result;
+  }
+
+  m_index[hash] = m_lru.begin();
+  ++m_stats.entries;
+  m_stats.bytes_used += entry.get_bytes();
+  evict_over_budget();
+
+  fill(entry, accepted, asset);
+  return AssetCacheResult::Ok;
+}
+
+AssetCacheResult AssetCache::load(Entry& entry) noexcept {
+  struct stat statbuf;  // NOLINT
+  if (::stat(entry.path.get_c_str(), &statbuf) != 0 || !S_ISREG(statbuf.st_mode)) {
+    return AssetCacheResult::NotFound;
+  }
+
+  const auto file_size = static_cast<u64>(statbuf.st_size);
+  if (file_size > m_config.max_asset_size) {
+    return AssetCacheResult::TooLarge;
+  }
+
+  entry.identity.clear();
+  if (!entry.identity.append_file_contents(entry.path.get_c_str())) {
+    return AssetCacheResult::NotFound;
+  }
+
+  entry.file_size = file_size;
+  entry.mtime_ns = mtime_ns_of(statbuf);
+  entry.last_validated_ns = monotonic_coarse_ns();
+  entry.content_type = mime_type_from_path(entry.path.slice());
+
+  // Same bytes as before (a touch, a deploy of identical files): the
+  // variants and their tags still hold
+  const u64 content_hash = hash_xxh64(entry.identity.slice());
+  if (entry.identity_etag.is_set() && content_hash == entry.content_hash) {
+    return AssetCacheResult::Ok;
+  }
+
+  entry.content_hash = content_hash;
+  entry.identity_etag = EntityTag{content_hash};
+  entry.gzip_etag = EntityTag{content_hash, StringSlice::from_cstr("-gzip")};
+#ifdef CELL_HAVE_ZSTD
+  entry.zstd_etag = EntityTag{content_hash, StringSlice::from_cstr("-zstd")};
+#endif
+  entry.available = encoding::IDENTITY;
+
+  // Only keep the compressed variant when it's actually smaller
+  if (entry.identity.get_length() != 0 && is_compressible_mime_type(entry.content_type)) {
+    entry.gzip.clear();
+    if (m_gzip.compress_string(entry.identity.slice(), entry.gzip) &&
+        entry.gzip.get_length() < entry.identity.get_length()) {
+      entry.available |= encoding::GZIP;
+    }
+
+#ifdef CELL_HAVE_ZSTD
+    entry.zstd.clear();
+    if (m_zstd.is_ok() && m_zstd.compress_string(entry.identity.slice(), entry.zstd) &&
+        entry.zstd.get_length() < entry.identity.get_length()) {
+      entry.available |= encoding::ZSTD;
+    }
+#endif
+  }
+
+  return AssetCacheResult::Ok;
+}
+
+void AssetCache::fill(const Entry& entry, const encoding::AcceptEncoding& accepted,
+                      Asset& asset) const noexcept {
+  asset.content_type = entry.content_type;
+  asset.identity_length = entry.identity.get_length();
+  asset.mtime_ns = entry.mtime_ns;
+
+  const encoding::EncodingSet coding = accepted.negotiate(entry.available);
+  if (coding == encoding::GZIP) {
+    asset.coding = encoding::GZIP;
+    asset.body = entry.gzip.slice();
+    set_etag(entry.gzip_etag, asset);
+    return;
+  }
+
+#ifdef CELL_HAVE_ZSTD
+  if (coding == encoding::ZSTD) {
+    asset.coding = encoding::ZSTD;
+    asset.body = entry.zstd.slice();
+    set_etag(entry.zstd_etag, asset);
+    return;
+  }
+#endif
+
+  // Identity even when the client refused it: that's for the caller to
+  // turn into a 406, the cache has nothing better to offer
+  asset.coding = encoding::IDENTITY;
+  asset.body = entry.identity.slice();
+  set_etag(entry.identity_etag, asset);
+}
+
+u64 AssetCache::warmup(const std::vector<StringSlice>& file_paths) noexcept {
+  const encoding::AcceptEncoding any;
+  Asset asset;
+  u64 loaded = 0;
+
+  for (const auto& path : file_paths) {
+    if (get(path, any, asset) == AssetCacheResult::Ok) {
+      ++loaded;
+    }
+  }
+
+  return loaded;
+}
+
+void AssetCache::erase(EntryList::iterator it) noexcept {
+  m_stats.bytes_used -= it->get_bytes();
+  --m_stats.entries;
+  m_index.erase(it->hash);
+  m_lru.erase(it);
+}
+
+void AssetCache::evict_over_budget() noexcept {
+  // The front entry is the one being served, it is never evicted
+  while (m_stats.bytes_used > m_config.byte_budget && m_lru.size() > 1) {
+    ++m_stats.evictions;
+    erase(std::prev(m_lru.end()));
+  }
+}
+
+void AssetCache::invalidate(StringSlice file_path) noexcept {
+  const auto it = find(file_path, hash_fnv1a(file_path));
+  if (it != m_lru.end()) {
+    erase(it);
+  }
+}
+
+void AssetCache::clear() noexcept {
+  m_lru.clear();
+  m_index.clear();
+  m_stats.bytes_used = 0;
+  m_stats.entries = 0;
+}
+
+}  // namespace cell::http
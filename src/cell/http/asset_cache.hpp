@@ -0,0 +1,132 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_ASSET_CACHE_HPP
+#define CELL_ASSET_CACHE_HPP
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+#include "cell/encoding/gzip.hpp"
+#ifdef CELL_HAVE_ZSTD
+#include "cell/encoding/zstd.hpp"
+#endif
+#include "encoding.hpp"
+#include "entity_tag.hpp"
+
+namespace cell::http {
+
+enum class AssetCacheResult {
+  Ok,
+  NotFound,
+  TooLarge,  // bigger than max_asset_size, serve it from disk instead
+};
+
+// What a request gets back: the best variant for its Accept-Encoding. The
+// slices point into the cache and stay valid until the next call that may
+// load or evict an entry.
+struct Asset {
+  StringSlice body{nullptr, 0};
+  encoding::EncodingSet coding{encoding::IDENTITY};
+  StringSlice content_type{nullptr, 0};
+  u64 identity_length{0};
+  i64 mtime_ns{0};
+  // The variant's strong ETag: its value, and the whole header line
+  StringSlice etag{nullptr, 0};
+  StringSlice etag_header{nullptr, 0};
+};
+
+struct AssetCacheConfig {
+  u64 byte_budget{64 * 1024 * 1024};
+  u64 max_asset_size{8 * 1024 * 1024};
+  u64 revalidate_interval_ns{1'000'000'000};  // stat() an entry at most this often
+  int gzip_level{cell::encoding::Gzip::DEFAULT_COMPRESSION_LEVEL};
+#ifdef CELL_HAVE_ZSTD
+  int zstd_level{cell::encoding::Zstd::DEFAULT_COMPRESSION_LEVEL};
+#endif
+};
+
+struct AssetCacheStats {
+  u64 hits{0};
+  u64 misses{0};
+  u64 reloads{0};     // entries whose file changed on disk
+  u64 evictions{0};
+  u64 bytes_used{0};  // all variants of all entries
+  u64 entries{0};
+};
+
+// In-memory cache of static files, each stored as identity and (when it
+// pays off) pre-compressed variants, computed once at the best level, each
+// with a strong ETag from a hash of the content. A file touched without
+// changing keeps its variants and tags, nothing is compressed again. Bounded
+// by byte_budget with LRU eviction; entries are revalidated against the
+// file's mtime and size. Not thread safe, keep one per worker thread.
+class AssetCache {
+ public:
+  explicit AssetCache(AssetCacheConfig config = {}) noexcept;
+  AssetCache(const AssetCache&) = delete;
+  AssetCache& operator=(const AssetCache&) = delete;
+
+  [[nodiscard]] AssetCacheResult get(StringSlice file_path, const encoding::AcceptEncoding& accepted,
+                                     Asset& asset) noexcept;
+
+  // Loads files ahead of the first request, returns how many made it in
+  u64 warmup(const std::vector<StringSlice>& file_paths) noexcept;
+
+  void invalidate(StringSlice file_path) noexcept;
+  void clear() noexcept;
+
+  [[nodiscard]] const AssetCacheStats& get_stats() const noexcept { return m_stats; }
+
+ private:
+  static constexpr u64 DEFAULT_PATH_BUFFER_CAPACITY = 256;
+
+  struct Entry {
+    String path{DEFAULT_PATH_BUFFER_CAPACITY};
+    u64 hash{0};
+    i64 mtime_ns{0};
+    u64 file_size{0};
+    u64 last_validated_ns{0};
+    StringSlice content_type{nullptr, 0};
+    String identity{8};
+    String gzip{8};
+#ifdef CELL_HAVE_ZSTD
+    String zstd{8};
+#endif
+    encoding::EncodingSet available{encoding::IDENTITY};
+    // XXH64 of the identity bytes; every variant's tag derives from it
+    u64 content_hash{0};
+    EntityTag identity_etag{};
+    EntityTag gzip_etag{};
+#ifdef CELL_HAVE_ZSTD
+    EntityTag zstd_etag{};
+#endif
+
+    [[nodiscard]] u64 get_bytes() const noexcept;
+  };
+
+  using EntryList = std::list<Entry>;
+
+  [[nodiscard]] AssetCacheResult load(Entry& entry) noexcept;
+  void erase(EntryList::iterator it) noexcept;
+  void evict_over_budget() noexcept;
+  void fill(const Entry& entry, const encoding::AcceptEncoding& accepted, Asset& asset) const noexcept;
+  [[nodiscard]] EntryList::iterator find(StringSlice file_path, u64 hash) noexcept;
+
+  AssetCacheConfig m_config;
+  AssetCacheStats m_stats{};
+  EntryList m_lru{};  // most recently used first
+  std::unordered_map<u64, EntryList::iterator> m_index{};
+  cell::encoding::Gzip m_gzip;
+#ifdef CELL_HAVE_ZSTD
+  cell::encoding::Zstd m_zstd{m_config.zstd_level};
+#endif
+};
+
+}  // namespace cell::http
+
+#endif  // CELL_ASSET_CACHE_HPP
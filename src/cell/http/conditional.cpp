@@ -0,0 +1,93 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "conditional.hpp"
+
+#include "cell/core/charset.hpp"
+#include "date.hpp"
+
+namespace cell::http {
+
+namespace {
+
+// entity-tag = [ "W/" ] DQUOTE *etagc DQUOTE, from `cursor` on. `tag` gets
+// the quoted part, which is what weak comparison looks at.
+bool parse_entity_tag(const u8*& cursor, const u8* end, StringSlice& tag, bool& weak) noexcept {
+  weak = end - cursor >= 2 && cursor[0] == 'W' && cursor[1] == '/';
+  if (weak) {
+    cursor += 2;
+  }
+  if (cursor == end || *cursor != '"') {
+    return false;
+  }
+
+  const u8* const first = cursor++;
+  while (cursor < end && *cursor != '"') {
+    ++cursor;
+  }
+  if (cursor == end) {
+    return false;
+  }
+  ++cursor;
+
+  tag = {first, static_cast<u64>(cursor - first)};
+  return true;
+}
+
+}  // namespace
+
+bool if_none_match_matches(StringSlice list, StringSlice etag) noexcept {
+  const u8* cursor = list.get_u8_ptr();
+  const u8* const end = cursor + list.get_length();
+
+  // If-None-Match = "*" / #entity-tag
+  while (cursor < end) {
+    if (*cursor == ',' || rfc9110::is_whitespace(*cursor)) {
+      ++cursor;
+      continue;
+    }
+    if (*cursor == '*') {
+      return etag.get_length() != 0;
+    }
+
+    StringSlice tag{nullptr, 0};
+    bool weak = false;
+    if (!parse_entity_tag(cursor, end, tag, weak)) {
+      return false;
+    }
+    if (etag.get_length() != 0 && tag.compare(etag)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool etag_matches_strongly(StringSlice validator, StringSlice etag) noexcept {
+  const u8* cursor = validator.get_u8_ptr();
+  const u8* const end = cursor + validator.get_length();
+
+  StringSlice tag{nullptr, 0};
+  bool weak = false;
+  return etag.get_length() != 0 && parse_entity_tag(cursor, end, tag, weak) && !weak &&
+         cursor == end && tag.compare(etag);
+}
+
+bool is_not_modified(const Request& request, StringSlice etag, i64 last_modified) noexcept {
+  if (request.get_method() != Method::Get && request.get_method() != Method::Head) {
+    return false;
+  }
+
+  // With If-None-Match, If-Modified-Since is ignored even when it fails
+  const StringSlice if_none_match = request.get_if_none_match();
+  if (if_none_match.get_length() != 0) {
+    return if_none_match_matches(if_none_match, etag);
+  }
+
+  i64 since = 0;
+  const StringSlice if_modified_since = request.get_if_modified_since();
+  return if_modified_since.get_length() != 0 && parse_imf_fixdate(if_modified_since, since) &&
+         last_modified <= since;
+}
+
+}  // namespace cell::http
@@ -0,0 +1,31 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_CONDITIONAL_HPP
+#define CELL_CONDITIONAL_HPP
+
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+#include "entity_tag.hpp"
+#include "request.hpp"
+
+namespace cell::http {
+
+// If-None-Match (RFC 9110 13.1.2): whether `list` is "*" or names `etag`,
+// by weak comparison. A malformed list matches nothing.
+[[nodiscard]] bool if_none_match_matches(StringSlice list, StringSlice etag) noexcept;
+
+// Strong comparison, for If-Range: a weak validator never matches
+[[nodiscard]] bool etag_matches_strongly(StringSlice validator, StringSlice etag) noexcept;
+
+// Whether a GET or HEAD for a representation with `etag` (empty if it has
+// none) last modified at `last_modified` seconds can be answered with 304
+// (RFC 9110 13.2.2): If-None-Match decides when sent, If-Modified-Since
+// otherwise. Parses no more than the validators; meant to run before any
+// work on the body.
+[[nodiscard]] bool is_not_modified(const Request& request, StringSlice etag,
+                                   i64 last_modified) noexcept;
+
+}  // namespace cell::http
+
+#endif  // CELL_CONDITIONAL_HPP
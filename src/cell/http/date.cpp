@@ -0,0 +1,145 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "date.hpp"
+
+#include <time.h>
+
+#include <cstring>
+
+namespace cell::http {
+
+namespace {
+
+// 1970-01-01 was a Thursday
+constexpr char DAY_NAMES[7][4] = {"Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed"};
+constexpr char MONTH_NAMES[12][4] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                     "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+constexpr char DATE_PREFIX[] = "Date: ";
+constexpr u64 DATE_PREFIX_LENGTH = sizeof(DATE_PREFIX) - 1;
+constexpr u64 DATE_LINE_LENGTH = DATE_PREFIX_LENGTH + IMF_FIXDATE_LENGTH + 2;
+
+void put_2_digits(char* out, i64 value) noexcept {
+  out[0] = static_cast<char>('0' + value / 10);
+  out[1] = static_cast<char>('0' + value % 10);
+}
+
+// -1 when the two bytes aren't digits
+i64 get_2_digits(const u8* in) noexcept {
+  if (in[0] < '0' || in[0] > '9' || in[1] < '0' || in[1] > '9') {
+    return -1;
+  }
+  return (in[0] - '0') * 10 + (in[1] - '0');
+}
+
+// H. Hinnant's days_from_civil
+i64 days_from_civil(i64 year, i64 month, i64 day) noexcept {
+  year -= month <= 2 ? 1 : 0;
+  const i64 era = (year >= 0 ? year : year - 399) / 400;
+  const i64 year_of_era = year - era * 400;
+  const i64 day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  const i64 day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + day_of_era - 719468;
+}
+
+struct DateLine {
+  i64 second{-1};
+  char text[DATE_LINE_LENGTH];
+};
+
+thread_local DateLine t_date_line{};
+
+}  // namespace
+
+void format_imf_fixdate(i64 seconds, char* out) noexcept {
+  i64 days = seconds / 86400;
+  i64 time_of_day = seconds % 86400;
+  if (time_of_day < 0) {
+    time_of_day += 86400;
+    --days;
+  }
+
+  // Days to civil date, H. Hinnant's days_from_civil inverted
+  const i64 z = days + 719468;
+  const i64 era = (z >= 0 ? z : z - 146096) / 146097;
+  const i64 day_of_era = z - era * 146097;
+  const i64 year_of_era =
+      (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+  const i64 day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  const i64 mp = (5 * day_of_year + 2) / 153;
+  const i64 day = day_of_year - (153 * mp + 2) / 5 + 1;
+  const i64 month = mp < 10 ? mp + 3 : mp - 9;
+  const i64 year = year_of_era + era * 400 + (month <= 2 ? 1 : 0);
+
+  const i64 weekday = ((days % 7) + 7) % 7;
+
+  // "Sun, 06 Nov 1994 08:49:37 GMT"
+  std::memcpy(out, DAY_NAMES[weekday], 3);
+  out[3] = ',';
+  out[4] = ' ';
+  put_2_digits(out + 5, day);
+  out[7] = ' ';
+  std::memcpy(out + 8, MONTH_NAMES[month - 1], 3);
+  out[11] = ' ';
+  put_2_digits(out + 12, (year / 100) % 100);
+  put_2_digits(out + 14, year % 100);
+  out[16] = ' ';
+  put_2_digits(out + 17, time_of_day / 3600);
+  out[19] = ':';
+  put_2_digits(out + 20, time_of_day / 60 % 60);
+  out[22] = ':';
+  put_2_digits(out + 23, time_of_day % 60);
+  std::memcpy(out + 25, " GMT", 4);
+}
+
+bool parse_imf_fixdate(StringSlice text, i64& seconds) noexcept {
+  // "Sun, 06 Nov 1994 08:49:37 GMT"
+  if (text.get_length() != IMF_FIXDATE_LENGTH) {
+    return false;
+  }
+  const u8* in = text.get_u8_ptr();
+  if (in[3] != ',' || in[4] != ' ' || in[7] != ' ' || in[11] != ' ' || in[16] != ' ' ||
+      in[19] != ':' || in[22] != ':' || std::memcmp(in + 25, " GMT", 4) != 0) {
+    return false;
+  }
+
+  i64 month = 0;
+  while (month < 12 && std::memcmp(in + 8, MONTH_NAMES[month], 3) != 0) {
+    ++month;
+  }
+
+  const i64 day = get_2_digits(in + 5);
+  const i64 century = get_2_digits(in + 12);
+  const i64 year_of_century = get_2_digits(in + 14);
+  const i64 hour = get_2_digits(in + 17);
+  const i64 minute = get_2_digits(in + 20);
+  const i64 second = get_2_digits(in + 23);
+  if (month == 12 || day < 1 || day > 31 || century < 0 || year_of_century < 0 || hour < 0 ||
+      hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 60) {
+    return false;
+  }
+
+  const i64 days = days_from_civil(century * 100 + year_of_century, month + 1, day);
+  seconds = days * 86400 + hour * 3600 + minute * 60 + second;
+  return true;
+}
+
+StringSlice get_date_line() noexcept {
+  // The coarse clock is a plain vDSO read, cheap enough to call per response
+  timespec now{};
+  ::clock_gettime(CLOCK_REALTIME_COARSE, &now);
+
+  DateLine& line = t_date_line;
+  if (now.tv_sec != line.second) {
+    line.second = now.tv_sec;
+    std::memcpy(line.text, DATE_PREFIX, DATE_PREFIX_LENGTH);
+    format_imf_fixdate(now.tv_sec, line.text + DATE_PREFIX_LENGTH);
+    line.text[DATE_LINE_LENGTH - 2] = '\r';
+    line.text[DATE_LINE_LENGTH - 1] = '\n';
+  }
+
+  return StringSlice{reinterpret_cast<const u8*>(line.text), DATE_LINE_LENGTH};
+}
+
+}  // namespace cell::http
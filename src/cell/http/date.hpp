@@ -0,0 +1,29 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_DATE_HPP
+#define CELL_DATE_HPP
+
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+
+namespace cell::http {
+
+// IMF-fixdate (RFC 9110, 5.6.7), e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+constexpr u64 IMF_FIXDATE_LENGTH = 29;
+
+// Renders `seconds` since the Unix epoch into IMF_FIXDATE_LENGTH bytes of `out`
+void format_imf_fixdate(i64 seconds, char* out) noexcept;
+
+// Reads an IMF-fixdate back into seconds since the Unix epoch. The obsolete
+// RFC 850 and asctime() forms are refused: false means "no usable date",
+// which conditional requests treat as a failed condition, the safe way.
+[[nodiscard]] bool parse_imf_fixdate(StringSlice text, i64& seconds) noexcept;
+
+// "Date: <now>\r\n". Re-rendered at most once per second per thread,
+// otherwise a cached line; valid until the thread's next call.
+[[nodiscard]] StringSlice get_date_line() noexcept;
+
+}  // namespace cell::http
+
+#endif  // CELL_DATE_HPP
@@ -2,81 +2,289 @@
 // SPDX-License-Identifier: Apache-2.0
 #include "encoding.hpp"
 
+#include <bit>
+
+#include "cell/core/assert.hpp"
 #include "cell/core/charset.hpp"
-#include "cell/core/string.hpp"
 #include "cell/log/log.hpp"
 
 namespace cell::http::encoding {
 
 namespace {
-enum class EncodingParserState {
-  GetEncoding,
-  EatSpaces,
-};
+
+// Order in which ties are broken in negotiate()
+constexpr EncodingSet SERVER_PREFERENCE[] = {ZSTD, BROTLI, GZIP, DEFLATE, IDENTITY};
+
+[[nodiscard]] constexpr u64 coding_index(EncodingSet coding) noexcept {
+  CELL_ASSERT(std::has_single_bit(coding) && coding <= IDENTITY);
+  return static_cast<u64>(std::countr_zero(coding));
 }
 
-EncodingSet parse_from_request_header(const StringSlice slice) noexcept {
-  String buf(ENCODING_BUFFER_SIZE);
-  uint64_t cursor = 0;
-  uint8_t ch;
+[[nodiscard]] bool is_ows(const u8 ch) noexcept { return rfc9110::is_whitespace(ch); }
 
-  bool end = false;
-  EncodingParserState state = EncodingParserState::GetEncoding;
-  EncodingSet set = kNone;
+StringSlice trim_ows(const u8* begin, const u8* end) noexcept {
+  while (begin < end && is_ows(*begin)) {
+    ++begin;
+  }
+  while (end > begin && is_ows(end[-1])) {
+    --end;
+  }
+  return {begin, static_cast<u64>(end - begin)};
+}
+
+// Maps a coding token to its bit. '*' is reported through `is_any`.
+EncodingSet coding_from_token(StringSlice token, bool& is_any) noexcept {
+  is_any = false;
+
+  switch (token.get_length()) {
+    case 1:
+      is_any = token.byte_at(0) == '*';
+      return kNone;
+    case 2:
+      return token.compare_ignore_case(StringSlice::from_cstr("br")) ? BROTLI : kNone;
+    case 4:
+      return token.compare_ignore_case(StringSlice::from_cstr("gzip"))   ? GZIP
+             : token.compare_ignore_case(StringSlice::from_cstr("zstd")) ? ZSTD
+                                                                         : kNone;
+    case 6:
+      return token.compare_ignore_case(StringSlice::from_cstr("x-gzip")) ? GZIP : kNone;
+    case 7:
+      return token.compare_ignore_case(StringSlice::from_cstr("deflate")) ? DEFLATE : kNone;
+    case 8:
+      return token.compare_ignore_case(StringSlice::from_cstr("identity")) ? IDENTITY : kNone;
+    default:
+      return kNone;
+  }
+}
 
-  while (!end) {
-    if (cursor != slice.get_length()) {
-      ch = slice.byte_at(cursor);
-    } else {
-      end = true;
+// qvalue = ( "0" [ "." 0*3DIGIT ] ) / ( "1" [ "." 0*3("0") ] )
+bool parse_qvalue(StringSlice value, QValue& q) noexcept {
+  const u64 length = value.get_length();
+  if (length == 0 || length > 5) {
+    return false;
+  }
+
+  const u8 unit = value.byte_at(0);
+  if (unit != '0' && unit != '1') {
+    return false;
+  }
+
+  QValue result = unit == '1' ? Q_MAX : 0;
+
+  if (length > 1) {
+    if (value.byte_at(1) != '.') {
+      return false;
     }
 
-//    CELL_LOG_DEBUG("parse Encoding: at byte '%c' buf: '%s'", ch, buf.get_c_str());
-
-    switch (state) {
-      case EncodingParserState::GetEncoding: {
-        if (ch == ',' || end) {
-          if (buf.compare(StringSlice::from_cstr("Gzip"))) {
-            CELL_LOG_DEBUG_SIMPLE("encoding: +Gzip");
-            set |= GZIP;
-          } else if (buf.compare(StringSlice::from_cstr("deflate"))) {
-            CELL_LOG_DEBUG_SIMPLE("encoding: +deflate");
-            set |= DEFLATE;
-          } else if (buf.compare(StringSlice::from_cstr("br"))) {
-            CELL_LOG_DEBUG_SIMPLE("encoding: +brotli");
-            set |= BROTLI;
-          } else if (buf.compare(StringSlice::from_cstr("zstd"))) {
-            CELL_LOG_DEBUG_SIMPLE("encoding: +zstd");
-            set |= ZSTD;
-          } else {
-            CELL_LOG_DEBUG("No encoding named: '%s'", buf.get_c_str());
-            return ERROR_PARSING;
-          }
-
-          buf.clear();
-          state = EncodingParserState::EatSpaces;
-          break ;
-        } else if (ch == SP) {
-          return ERROR_PARSING;
-        }
-
-        buf.append_byte(ch);
-        break;
-      }
-      case EncodingParserState::EatSpaces: {
-        if (ch != SP) {
-          state = EncodingParserState::GetEncoding;
-          cursor--;
-          break ;
-        }
-        break;
+    QValue scale = 100;
+    for (u64 i = 2; i < length; ++i, scale /= 10) {
+      const u8 digit = value.byte_at(i);
+      if (!is_digit(digit) || (unit == '1' && digit != '0')) {
+        return false;
       }
+      result += static_cast<QValue>((digit - '0') * scale);
     }
+  }
+
+  q = result;
+  return true;
+}
 
+// Reads the parameters after a coding; only 'q' means anything to us.
+bool parse_weight(const u8* cursor, const u8* end, QValue& q) noexcept {
+  q = Q_MAX;
+
+  while (cursor < end) {
+    CELL_ASSERT(*cursor == ';');
     ++cursor;
+
+    const u8* param_end = cursor;
+    while (param_end < end && *param_end != ';') {
+      ++param_end;
+    }
+
+    const StringSlice param = trim_ows(cursor, param_end);
+    if (param.get_length() >= 2 && to_lower(param.byte_at(0)) == 'q') {
+      const u8* p = param.get_u8_ptr() + 1;
+      const u8* const p_end = param.get_u8_ptr() + param.get_length();
+      while (p < p_end && is_ows(*p)) {
+        ++p;
+      }
+      if (p == p_end || *p != '=') {
+        return false;
+      }
+      if (!parse_qvalue(trim_ows(p + 1, p_end), q)) {
+        return false;
+      }
+    }
+
+    cursor = param_end;
+  }
+
+  return true;
+}
+
+}  // namespace
+
+QValue AcceptEncoding::get_listed_q(EncodingSet coding) const noexcept {
+  return m_q[coding_index(coding)];
+}
+
+QValue AcceptEncoding::get_effective_q(EncodingSet coding) const noexcept {
+  if (!m_present) {
+    // No header: only identity, even though anything would be allowed
+    return coding == IDENTITY ? Q_MAX : 0;
+  }
+
+  const QValue listed = m_q[coding_index(coding)];
+  if (listed != Q_UNSET) {
+    return listed;
+  }
+
+  if (m_any_q != Q_UNSET) {
+    return m_any_q;
+  }
+
+  // identity is acceptable unless excluded explicitly or through '*;q=0'
+  return coding == IDENTITY ? Q_MAX : 0;
+}
+
+EncodingSet AcceptEncoding::get_acceptable() const noexcept {
+  EncodingSet set = kNone;
+
+  for (const EncodingSet coding : SERVER_PREFERENCE) {
+    if (get_effective_q(coding) != 0) {
+      set |= coding;
+    }
   }
 
   return set;
 }
 
+EncodingSet AcceptEncoding::negotiate(EncodingSet available) const noexcept {
+  EncodingSet best = kNone;
+  QValue best_q = 0;
+
+  for (const EncodingSet coding : SERVER_PREFERENCE) {
+    if ((available & coding) == 0) {
+      continue;
+    }
+
+    const QValue q = get_effective_q(coding);
+    if (q > best_q) {
+      best = coding;
+      best_q = q;
+    }
+  }
+
+  return best;
+}
+
+void AcceptEncoding::set_q(EncodingSet coding, QValue q) noexcept {
+  m_q[coding_index(coding)] = q;
+}
+
+void AcceptEncoding::reset() noexcept { *this = AcceptEncoding(); }
+
+AcceptEncoding parse_accept_encoding(const StringSlice slice) noexcept {
+  AcceptEncoding accepted;
+  accepted.set_present();
+
+  const u8* cursor = slice.get_u8_ptr();
+  const u8* const end = cursor + slice.get_length();
+
+  while (cursor < end) {
+    const u8* element_end = cursor;
+    while (element_end < end && *element_end != ',') {
+      ++element_end;
+    }
+
+    const u8* token_end = cursor;
+    while (token_end < element_end && *token_end != ';') {
+      ++token_end;
+    }
+
+    const StringSlice token = trim_ows(cursor, token_end);
+    QValue q = Q_MAX;
+
+    if (token.get_length() != 0 && parse_weight(token_end, element_end, q)) {
+      bool is_any = false;
+      const EncodingSet coding = coding_from_token(token, is_any);
+
+      if (is_any) {
+        accepted.set_any_q(q);
+      } else if (coding != kNone) {
+        accepted.set_q(coding, q);
+      } else {
+        CELL_LOG_DEBUG("encoding: ignoring unknown coding '%.*s'",
+                       static_cast<int>(token.get_length()), token.get_const_char_ptr());
+      }
+    }
+
+    cursor = element_end + 1;
+  }
+
+  return accepted;
 }
+
+EncodingSet parse_from_request_header(const StringSlice slice) noexcept {
+  return parse_accept_encoding(slice).get_acceptable() & ~IDENTITY;
+}
+
+EncodingSet parse_content_encoding(const StringSlice slice) noexcept {
+  EncodingSet applied = IDENTITY;
+
+  const u8* cursor = slice.get_u8_ptr();
+  const u8* const end = cursor + slice.get_length();
+
+  while (cursor < end) {
+    const u8* element_end = cursor;
+    while (element_end < end && *element_end != ',') {
+      ++element_end;
+    }
+
+    const StringSlice token = trim_ows(cursor, element_end);
+    cursor = element_end + 1;
+
+    if (token.get_length() == 0) {
+      continue;
+    }
+
+    bool is_any = false;
+    const EncodingSet coding = coding_from_token(token, is_any);
+    if (coding == kNone) {
+      return ERROR_PARSING;
+    }
+
+    if (coding == IDENTITY) {
+      continue;
+    }
+
+    // Stacked codings ("gzip, br") would need a decoder chain
+    if (applied != IDENTITY) {
+      return ERROR_PARSING;
+    }
+    applied = coding;
+  }
+
+  return applied;
+}
+
+StringSlice encoding_to_string(EncodingSet coding) noexcept {
+  switch (coding) {
+    case DEFLATE:
+      return StringSlice::from_cstr("deflate");
+    case GZIP:
+      return StringSlice::from_cstr("gzip");
+    case BROTLI:
+      return StringSlice::from_cstr("br");
+    case ZSTD:
+      return StringSlice::from_cstr("zstd");
+    case IDENTITY:
+      return StringSlice::from_cstr("identity");
+    default:
+      CELL_PANIC("unknown content coding");
+  }
+}
+
+}  // namespace cell::http::encoding
@@ -7,20 +7,74 @@
 #include <cstdint>
 
 #include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
 
 namespace cell::http::encoding {
 using EncodingSet = uint64_t;
-constexpr uint64_t ENCODING_BUFFER_SIZE = 16;
 
 constexpr EncodingSet ERROR_PARSING = static_cast<EncodingSet>(-1);
 constexpr EncodingSet kNone = 0;
 constexpr EncodingSet DEFLATE = 0b1;
 constexpr EncodingSet GZIP = 0b10;
 constexpr EncodingSet BROTLI = 0b100;
-constexpr EncodingSet ZSTD = 0b100;
+constexpr EncodingSet ZSTD = 0b1000;
+constexpr EncodingSet IDENTITY = 0b10000;
 
-[[nodiscard]] EncodingSet parse_from_request_header(const StringSlice slice) noexcept;
+constexpr u64 ENCODING_COUNT = 5;
 
-}
+// Quality values are kept in thousandths, as RFC 9110 12.4.2 allows at most
+// three decimals. q=0 means "not acceptable".
+using QValue = uint16_t;
+constexpr QValue Q_MAX = 1000;
+constexpr QValue Q_UNSET = static_cast<QValue>(-1);
+
+// Parsed Accept-Encoding header (RFC 9110 12.5.3)
+class AcceptEncoding {
+ public:
+  explicit AcceptEncoding() noexcept = default;
+
+  [[nodiscard]] bool is_present() const noexcept { return m_present; }
+
+  // Explicit weight of a single coding, or Q_UNSET if the header didn't list it
+  [[nodiscard]] QValue get_listed_q(EncodingSet coding) const noexcept;
+
+  // Weight after applying '*' and the implicit acceptability of identity
+  [[nodiscard]] QValue get_effective_q(EncodingSet coding) const noexcept;
+
+  // Every coding with an effective weight above zero
+  [[nodiscard]] EncodingSet get_acceptable() const noexcept;
+
+  // Picks the best of the `available` codings: highest weight first, then
+  // the server's preference (zstd, br, gzip, deflate, identity). Returns
+  // kNone if nothing available is acceptable, not even identity.
+  [[nodiscard]] EncodingSet negotiate(EncodingSet available) const noexcept;
+
+  void set_q(EncodingSet coding, QValue q) noexcept;
+  void set_any_q(QValue q) noexcept { m_any_q = q; }
+  void set_present() noexcept { m_present = true; }
+  void reset() noexcept;
+
+ private:
+  QValue m_q[ENCODING_COUNT]{Q_UNSET, Q_UNSET, Q_UNSET, Q_UNSET, Q_UNSET};
+  QValue m_any_q{Q_UNSET};
+  bool m_present{false};
+};
+
+// Parses an Accept-Encoding value without allocating. Unknown codings are
+// skipped, and so are elements with a malformed q parameter.
+[[nodiscard]] AcceptEncoding parse_accept_encoding(StringSlice slice) noexcept;
+
+// Set of codings the header makes acceptable. Kept for callers that don't
+// care about weights; never returns ERROR_PARSING.
+[[nodiscard]] EncodingSet parse_from_request_header(StringSlice slice) noexcept;
+
+// Parses a Content-Encoding value into the single coding it applies,
+// IDENTITY when none. Returns ERROR_PARSING for unknown or stacked codings.
+[[nodiscard]] EncodingSet parse_content_encoding(StringSlice slice) noexcept;
+
+// Content-Encoding token of a single coding
+[[nodiscard]] StringSlice encoding_to_string(EncodingSet coding) noexcept;
+
+}  // namespace cell::http::encoding
 
 #endif  // CELL_ENCODING_HPP
@@ -0,0 +1,32 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "entity_tag.hpp"
+
+#include <cstring>
+
+#include "cell/core/assert.hpp"
+
+namespace cell::http {
+
+EntityTag::EntityTag(u64 hash, StringSlice suffix) noexcept {
+  CELL_ASSERT(suffix.get_length() <= MAX_SUFFIX_LENGTH);
+
+  constexpr char HEX[] = "0123456789abcdef";
+  u8* out = m_line;
+  std::memcpy(out, "ETag: \"", NAME_LENGTH + 1);
+  out += NAME_LENGTH + 1;
+  for (int shift = 60; shift >= 0; shift -= 4) {
+    *out++ = HEX[(hash >> shift) & 0xF];
+  }
+  if (suffix.get_length() != 0) {
+    std::memcpy(out, suffix.get_u8_ptr(), suffix.get_length());
+    out += suffix.get_length();
+  }
+  std::memcpy(out, "\"\r\n", 3);
+  out += 3;
+
+  m_length = static_cast<u8>(out - m_line);
+}
+
+}  // namespace cell::http
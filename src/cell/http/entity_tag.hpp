@@ -0,0 +1,51 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_ENTITY_TAG_HPP
+#define CELL_ENTITY_TAG_HPP
+
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+
+namespace cell::http {
+
+// A strong entity tag, rendered once along with its header line:
+//
+//   ETag: "<16 hex digits of a hash><suffix>"\r\n
+//
+// The suffix tells apart representations of the same content, such as its
+// gzip and zstd variants, which must not share a strong tag.
+class EntityTag {
+ public:
+  static constexpr u64 MAX_SUFFIX_LENGTH = 8;
+
+  explicit EntityTag() noexcept = default;
+  explicit EntityTag(u64 hash, StringSlice suffix = {nullptr, 0}) noexcept;
+
+  [[nodiscard]] bool is_set() const noexcept { return m_length != 0; }
+  // The quoted tag, as compared against validators; empty when unset
+  [[nodiscard]] StringSlice get_value() const noexcept {
+    if (!is_set()) {
+      return {nullptr, 0};
+    }
+    return {m_line + NAME_LENGTH, m_length - NAME_LENGTH - 2};
+  }
+  // "ETag: ...\r\n", for Response::add_header_line(); empty when unset
+  [[nodiscard]] StringSlice get_header_line() const noexcept {
+    if (!is_set()) {
+      return {nullptr, 0};
+    }
+    return {m_line, m_length};
+  }
+
+ private:
+  static constexpr u64 NAME_LENGTH = 6;  // "ETag: "
+  static constexpr u64 MAX_LINE_LENGTH = NAME_LENGTH + 2 + 16 + MAX_SUFFIX_LENGTH + 2;
+
+  u8 m_line[MAX_LINE_LENGTH]{};
+  u8 m_length{0};
+};
+
+}  // namespace cell::http
+
+#endif  // CELL_ENTITY_TAG_HPP
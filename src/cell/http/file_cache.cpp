@@ -0,0 +1,249 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "file_cache.hpp"
+
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "cell/core/hash.hpp"
+#include "cell/log/log.hpp"
+#include "mime_type.hpp"
+
+namespace cell::http {
+
+namespace {
+
+// Whatever changes a file's bytes or takes its name away. IN_ATTRIB covers
+// unlink() and rename() over it too, through the link count.
+constexpr u32 WATCH_MASK = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF;
+
+u64 monotonic_coarse_ns() noexcept {
+  timespec ts{};
+  ::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  return static_cast<u64>(ts.tv_sec) * 1'000'000'000ULL + static_cast<u64>(ts.tv_nsec);
+}
+
+i64 mtime_ns_of(const struct stat& statbuf) noexcept {
+  return static_cast<i64>(statbuf.st_mtim.tv_sec) * 1'000'000'000LL + statbuf.st_mtim.tv_nsec;
+}
+
+}  // namespace
+
+FileCache::FileCache(FileCacheConfig config) noexcept
+    : m_config(config), m_notify_fd(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
+  if (m_notify_fd == -1) {
+    CELL_LOG_DEBUG("file cache: no inotify (errno %d), revalidating by stat() only", errno);
+  }
+}
+
+FileCache::~FileCache() {
+  clear();
+  if (m_notify_fd != -1) {
+    ::close(m_notify_fd);
+  }
+}
+
+FileCache::EntryList::iterator FileCache::find(StringSlice file_path, u64 hash) noexcept {
+  const auto it = m_index.find(hash);
+  if (it == m_index.end() || !it->second->path.compare(file_path)) {
+    return m_lru.end();
+  }
+  return it->second;
+}
+
+FileCacheResult FileCache::get(StringSlice file_path, OpenFile& file) noexcept {
+  const u64 now = monotonic_coarse_ns();
+  if (now - m_last_notify_ns >= m_config.notify_interval_ns) {
+    m_last_notify_ns = now;
+    read_notifications();
+  }
+
+  const u64 hash = hash_fnv1a(file_path);
+  auto it = find(file_path, hash);
+
+  if (it != m_lru.end()) {
+    Entry& entry = *it;
+
+    if (now - entry.last_validated_ns >= m_config.revalidate_interval_ns) {
+      // stat() the path rather than the fd: a file renamed over it is a new inode
+      struct stat statbuf;  // NOLINT
+      if (::stat(entry.path.get_c_str(), &statbuf) != 0 || !S_ISREG(statbuf.st_mode)) {
+        erase(it);
+        return FileCacheResult::NotFound;
+      }
+
+      entry.last_validated_ns = now;
+
+      if (statbuf.st_ino != entry.inode || mtime_ns_of(statbuf) != entry.file.mtime_ns ||
+          static_cast<u64>(statbuf.st_size) != entry.file.size) {
+        CELL_LOG_DEBUG("file cache: '%s' changed on disk, reopening", entry.path.get_c_str());
+        ++m_stats.reloads;
+        unwatch(entry);
+        watch(it);
+        if (open(entry) != FileCacheResult::Ok) {
+          erase(it);
+          return FileCacheResult::NotFound;
+        }
+      }
+    }
+
+    ++m_stats.hits;
+    m_lru.splice(m_lru.begin(), m_lru, it);
+    file = entry.file;
+    return FileCacheResult::Ok;
+  }
+
+  ++m_stats.misses;
+
+  if (m_index.contains(hash)) {
+    // 64-bit hash collision with a different path: the new one wins
+    erase(m_index[hash]);
+  }
+
+  m_lru.emplace_front();
+  Entry& entry = m_lru.front();
+  entry.path.append_slice(file_path);
+  entry.hash = hash;
+
+  watch(m_lru.begin());
+  if (open(entry) != FileCacheResult::Ok) {
+    unwatch(entry);
+    m_lru.pop_front();
+    return FileCacheResult::NotFound;
+  }
+
+  m_index[hash] = m_lru.begin();
+  ++m_stats.open_files;
+
+  // The front entry is the one being served, it is never evicted
+  while (m_stats.open_files > m_config.max_open_files && m_lru.size() > 1) {
+    ++m_stats.evictions;
+    erase(std::prev(m_lru.end()));
+  }
+
+  file = entry.file;
+  return FileCacheResult::Ok;
+}
+
+FileCacheResult FileCache::open(Entry& entry) noexcept {
+  const int fd = ::open(entry.path.get_c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return FileCacheResult::NotFound;
+  }
+
+  struct stat statbuf;  // NOLINT
+  if (::fstat(fd, &statbuf) != 0 || !S_ISREG(statbuf.st_mode)) {
+    ::close(fd);
+    return FileCacheResult::NotFound;
+  }
+
+  // Responses still sending the previous version keep its handle
+  entry.file.handle = std::make_shared<const FileHandle>(fd);
+  entry.file.size = static_cast<u64>(statbuf.st_size);
+  entry.file.mtime_ns = mtime_ns_of(statbuf);
+  entry.file.content_type = mime_type_from_path(entry.path.slice());
+  entry.inode = statbuf.st_ino;
+  const u64 version[] = {entry.inode, entry.file.size, static_cast<u64>(entry.file.mtime_ns)};
+  entry.file.etag =
+      EntityTag{hash_xxh64(reinterpret_cast<const u8*>(version), sizeof(version))};
+  entry.last_validated_ns = monotonic_coarse_ns();
+  return FileCacheResult::Ok;
+}
+
+void FileCache::erase(EntryList::iterator it) noexcept {
+  unwatch(*it);
+  --m_stats.open_files;
+  m_index.erase(it->hash);
+  m_lru.erase(it);
+}
+
+void FileCache::watch(EntryList::iterator it) noexcept {
+  if (m_notify_fd == -1) {
+    return;
+  }
+
+  // Fails past fs.inotify.max_user_watches; stat() still catches changes
+  it->watch = ::inotify_add_watch(m_notify_fd, it->path.get_c_str(), WATCH_MASK);
+  if (it->watch != -1) {
+    m_watches.emplace(it->watch, it);
+  }
+}
+
+void FileCache::unwatch(Entry& entry) noexcept {
+  if (entry.watch == -1) {
+    return;
+  }
+
+  const int watch = entry.watch;
+  entry.watch = -1;
+
+  auto [first, last] = m_watches.equal_range(watch);
+  for (auto it = first; it != last; ++it) {
+    if (&*it->second == &entry) {
+      m_watches.erase(it);
+      break;
+    }
+  }
+
+  if (!m_watches.contains(watch)) {
+    ::inotify_rm_watch(m_notify_fd, watch);
+  }
+}
+
+void FileCache::read_notifications() noexcept {
+  if (m_notify_fd == -1 || m_watches.empty()) {
+    return;
+  }
+
+  alignas(inotify_event) u8 buffer[4096];
+  while (true) {
+    const ssize_t count = ::read(m_notify_fd, buffer, sizeof(buffer));
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return;
+    }
+
+    for (ssize_t offset = 0; offset < count;) {
+      inotify_event event;  // NOLINT
+      ::memcpy(&event, buffer + offset, sizeof(event));
+      offset += static_cast<ssize_t>(sizeof(event) + event.len);
+
+      // IN_IGNORED: the kernel dropped the watch itself, there is none to remove
+      const bool watch_gone = event.mask & IN_IGNORED;
+      for (auto it = m_watches.find(event.wd); it != m_watches.end();
+           it = m_watches.find(event.wd)) {
+        const EntryList::iterator entry = it->second;
+        if (watch_gone) {
+          m_watches.erase(it);
+          entry->watch = -1;
+        }
+        ++m_stats.notifications;
+        erase(entry);
+      }
+    }
+  }
+}
+
+void FileCache::invalidate(StringSlice file_path) noexcept {
+  const auto it = find(file_path, hash_fnv1a(file_path));
+  if (it != m_lru.end()) {
+    erase(it);
+  }
+}
+
+void FileCache::clear() noexcept {
+  while (!m_lru.empty()) {
+    erase(m_lru.begin());
+  }
+}
+
+}  // namespace cell::http
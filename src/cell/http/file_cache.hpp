@@ -0,0 +1,110 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_FILE_CACHE_HPP
+#define CELL_FILE_CACHE_HPP
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+#include "cell/core/file_handle.hpp"
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+#include "entity_tag.hpp"
+
+namespace cell::http {
+
+enum class FileCacheResult {
+  Ok,
+  NotFound,
+};
+
+// An open file as of its last check. The handle is shared with the cache:
+// the fd stays open for as long as a response sends from it, even when the
+// cache has let go of the file meanwhile.
+struct OpenFile {
+  std::shared_ptr<const FileHandle> handle{};
+  u64 size{0};
+  i64 mtime_ns{0};
+  StringSlice content_type{nullptr, 0};
+  // From the inode, size and mtime, not the content: these files are too
+  // large to read through on every change
+  EntityTag etag{};
+
+  [[nodiscard]] FileSpan get_span() const noexcept { return {handle, 0, size}; }
+};
+
+struct FileCacheConfig {
+  u64 max_open_files{1024};
+  u64 revalidate_interval_ns{1'000'000'000};  // stat() an entry at most this often
+  u64 notify_interval_ns{1'000'000};          // read inotify events at most this often
+};
+
+struct FileCacheStats {
+  u64 hits{0};
+  u64 misses{0};
+  u64 reloads{0};        // entries found changed by stat()
+  u64 notifications{0};  // entries dropped on an inotify event
+  u64 evictions{0};
+  u64 open_files{0};
+};
+
+// Bounded LRU cache of open file descriptors and their stat() results, for
+// files too large to keep in memory (see AssetCache): their bytes go from
+// the page cache to the socket with sendfile() or splice() and never enter
+// user space. An entry is dropped as soon as inotify reports its file
+// written, truncated, renamed or unlinked, and revalidated against mtime and
+// size every revalidate_interval_ns regardless, for filesystems inotify
+// doesn't see changes on. Not thread safe, keep one per worker thread.
+class FileCache {
+ public:
+  explicit FileCache(FileCacheConfig config = {}) noexcept;
+  FileCache(const FileCache&) = delete;
+  FileCache& operator=(const FileCache&) = delete;
+  ~FileCache();
+
+  [[nodiscard]] FileCacheResult get(StringSlice file_path, OpenFile& file) noexcept;
+
+  void invalidate(StringSlice file_path) noexcept;
+  void clear() noexcept;
+
+  [[nodiscard]] const FileCacheStats& get_stats() const noexcept { return m_stats; }
+
+ private:
+  static constexpr u64 DEFAULT_PATH_BUFFER_CAPACITY = 256;
+
+  struct Entry {
+    String path{DEFAULT_PATH_BUFFER_CAPACITY};
+    u64 hash{0};
+    OpenFile file{};
+    u64 inode{0};
+    int watch{-1};  // inotify watch descriptor, -1 without one
+    u64 last_validated_ns{0};
+  };
+
+  using EntryList = std::list<Entry>;
+
+  [[nodiscard]] FileCacheResult open(Entry& entry) noexcept;
+  void erase(EntryList::iterator it) noexcept;
+  // Watched before it's opened, so a change in between isn't missed
+  void watch(EntryList::iterator it) noexcept;
+  void unwatch(Entry& entry) noexcept;
+  // Drops the entries inotify has events for
+  void read_notifications() noexcept;
+  [[nodiscard]] EntryList::iterator find(StringSlice file_path, u64 hash) noexcept;
+
+  FileCacheConfig m_config;
+  FileCacheStats m_stats{};
+  EntryList m_lru{};  // most recently used first
+  std::unordered_map<u64, EntryList::iterator> m_index{};
+  // Paths resolving to the same inode share a watch descriptor
+  std::unordered_multimap<int, EntryList::iterator> m_watches{};
+  int m_notify_fd{-1};
+  u64 m_last_notify_ns{0};
+};
+
+}  // namespace cell::http
+
+#endif  // CELL_FILE_CACHE_HPP
@@ -0,0 +1,175 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "file_response.hpp"
+
+#include <time.h>
+
+#include <cstring>
+
+#include "conditional.hpp"
+#include "date.hpp"
+#include "range.hpp"
+
+namespace cell::http {
+
+namespace {
+
+constexpr char MULTIPART_TYPE[] = "multipart/byteranges; boundary=";
+constexpr char BOUNDARY_PREFIX[] = "cell-";
+constexpr u64 BOUNDARY_LENGTH = sizeof(BOUNDARY_PREFIX) - 1 + 16;
+// "bytes " plus three u64s and their separators
+constexpr u64 MAX_CONTENT_RANGE_LENGTH = 6 + 3 * 20 + 2;
+
+thread_local u64 t_boundary_state = 0;
+
+[[nodiscard]] i64 get_last_modified(const OpenFile& file) noexcept {
+  return file.mtime_ns / 1'000'000'000;
+}
+
+// Digits of `value` at `out`, returns the end
+char* put_decimal(char* out, u64 value) noexcept {
+  char digits[20];
+  char* first = digits + sizeof(digits);
+  do {
+    *--first = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+
+  const auto length = static_cast<u64>(digits + sizeof(digits) - first);
+  std::memcpy(out, first, length);
+  return out + length;
+}
+
+// "bytes first-last/length"
+StringSlice format_content_range(const ByteRange& range, u64 length, char* out) noexcept {
+  char* end = out;
+  std::memcpy(end, "bytes ", 6);
+  end = put_decimal(end + 6, range.first);
+  *end++ = '-';
+  end = put_decimal(end, range.last);
+  *end++ = '/';
+  end = put_decimal(end, length);
+  return {reinterpret_cast<const u8*>(out), static_cast<u64>(end - out)};
+}
+
+// Unpredictable enough that no file plausibly contains it; a splitmix64
+// stream per thread, seeded from the clock
+StringSlice make_boundary(char* out) noexcept {
+  if (t_boundary_state == 0) {
+    timespec now{};
+    ::clock_gettime(CLOCK_MONOTONIC, &now);
+    t_boundary_state = static_cast<u64>(now.tv_sec) * 1'000'000'000ULL +
+                       static_cast<u64>(now.tv_nsec) + reinterpret_cast<u64>(&t_boundary_state);
+  }
+
+  u64 z = (t_boundary_state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z ^= z >> 31;
+
+  constexpr char HEX[] = "0123456789abcdef";
+  std::memcpy(out, BOUNDARY_PREFIX, sizeof(BOUNDARY_PREFIX) - 1);
+  for (u64 i = 0; i < 16; ++i) {
+    out[sizeof(BOUNDARY_PREFIX) - 1 + i] = HEX[(z >> (i * 4)) & 0xF];
+  }
+  return {reinterpret_cast<const u8*>(out), BOUNDARY_LENGTH};
+}
+
+void respond_with_ranges(const OpenFile& file, const ByteRange* ranges, u32 count,
+                         Response& response) noexcept {
+  char content_range[MAX_CONTENT_RANGE_LENGTH];
+  response.set_status(Status::PartialContent);
+
+  if (count == 1) {
+    response.set_content_type(file.content_type);
+    response.add_header(StringSlice::from_cstr("Content-Range"),
+                        format_content_range(ranges[0], file.size, content_range));
+    response.set_body_file({file.handle, ranges[0].first, ranges[0].get_length()});
+    return;
+  }
+
+  char boundary_text[BOUNDARY_LENGTH];
+  const StringSlice boundary = make_boundary(boundary_text);
+
+  char content_type[sizeof(MULTIPART_TYPE) - 1 + BOUNDARY_LENGTH];
+  std::memcpy(content_type, MULTIPART_TYPE, sizeof(MULTIPART_TYPE) - 1);
+  std::memcpy(content_type + sizeof(MULTIPART_TYPE) - 1, boundary_text, BOUNDARY_LENGTH);
+  response.set_content_type(
+      StringSlice{reinterpret_cast<const u8*>(content_type), sizeof(content_type)});
+  response.set_body(StringSlice::from_cstr(""));
+
+  // Every part: delimiter, its own headers, then its bytes straight from the file
+  for (u32 i = 0; i < count; ++i) {
+    response.append_body(StringSlice::from_cstr(i == 0 ? "--" : "\r\n--"));
+    response.append_body(boundary);
+    response.append_body(StringSlice::from_cstr("\r\nContent-Type: "));
+    response.append_body(file.content_type);
+    response.append_body(StringSlice::from_cstr("\r\nContent-Range: "));
+    response.append_body(format_content_range(ranges[i], file.size, content_range));
+    response.append_body(StringSlice::from_cstr("\r\n\r\n"));
+    response.append_body_file({file.handle, ranges[i].first, ranges[i].get_length()});
+  }
+  response.append_body(StringSlice::from_cstr("\r\n--"));
+  response.append_body(boundary);
+  response.append_body(StringSlice::from_cstr("--\r\n"));
+}
+
+}  // namespace
+
+bool if_range_matches(StringSlice if_range, const OpenFile& file) noexcept {
+  if (if_range.get_length() == 0) {
+    return true;
+  }
+
+  // An entity tag, strong ("...") or weak (W/"..."), the latter never matches
+  if (if_range.byte_at(0) == '"' || if_range.byte_at(0) == 'W') {
+    return etag_matches_strongly(if_range, file.etag.get_value());
+  }
+
+  i64 seconds = 0;
+  return parse_imf_fixdate(if_range, seconds) && seconds == get_last_modified(file);
+}
+
+void respond_with_file(const Request& request, const OpenFile& file, Response& response) noexcept {
+  char last_modified[IMF_FIXDATE_LENGTH];
+  format_imf_fixdate(get_last_modified(file), last_modified);
+  response.add_header_line(file.etag.get_header_line());
+  response.add_header(StringSlice::from_cstr("Last-Modified"),
+                      StringSlice{reinterpret_cast<const u8*>(last_modified), IMF_FIXDATE_LENGTH});
+
+  // Revalidation: the validators and nothing else
+  if (is_not_modified(request, file.etag.get_value(), get_last_modified(file))) {
+    response.set_status(Status::NotModified);
+    return;
+  }
+
+  response.add_header(StringSlice::from_cstr("Accept-Ranges"), StringSlice::from_cstr("bytes"));
+
+  // Range only means something for GET (RFC 9110 14.2)
+  const ByteRanges& requested = request.get_range();
+  if (request.get_method() != Method::Get || !requested.is_present() ||
+      !if_range_matches(request.get_if_range(), file)) {
+    response.set_content_type(file.content_type);
+    response.set_body_file(file.get_span());
+    return;
+  }
+
+  ByteRange ranges[ByteRanges::MAX_RANGES];
+  const u32 count = requested.resolve(file.size, ranges);
+  if (count == 0) {
+    char content_range[MAX_CONTENT_RANGE_LENGTH];
+    std::memcpy(content_range, "bytes */", 8);
+    const char* end = put_decimal(content_range + 8, file.size);
+    response.set_status(Status::RangeNotSatisfiable);
+    response.add_header(StringSlice::from_cstr("Content-Range"),
+                        StringSlice{reinterpret_cast<const u8*>(content_range),
+                                    static_cast<u64>(end - content_range)});
+    response.set_body(StringSlice::from_cstr(""));
+    return;
+  }
+
+  respond_with_ranges(file, ranges, count, response);
+}
+
+}  // namespace cell::http
@@ -0,0 +1,34 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_FILE_RESPONSE_HPP
+#define CELL_FILE_RESPONSE_HPP
+
+#include "cell/core/string_slice.hpp"
+#include "file_cache.hpp"
+#include "request.hpp"
+#include "response.hpp"
+
+namespace cell::http {
+
+// Whether a Range may be honoured given the request's If-Range: always
+// without one, with one only while it still names this version of the
+// file (RFC 9110 13.1.5), by strong ETag or by exact Last-Modified date.
+[[nodiscard]] bool if_range_matches(StringSlice if_range, const OpenFile& file) noexcept;
+
+// Answers a GET or HEAD for `file`, body as file spans for sendfile():
+//
+//   o nothing (304) when If-None-Match or If-Modified-Since says the
+//     client has it already,
+//   o the whole file (200), without a Range, when If-Range doesn't match,
+//     and for HEAD,
+//   o one window of it (206 with Content-Range),
+//   o several as multipart/byteranges (206),
+//   o or nothing (416) when no range is satisfiable.
+//
+// ETag and Last-Modified go on every answer, Accept-Ranges on all but 304.
+void respond_with_file(const Request& request, const OpenFile& file, Response& response) noexcept;
+
+}  // namespace cell::http
+
+#endif  // CELL_FILE_RESPONSE_HPP
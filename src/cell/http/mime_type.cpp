@@ -3,6 +3,109 @@
 
 #include "mime_type.hpp"
 
+#include "cell/core/charset.hpp"
+#include "cell/core/types.hpp"
+
 namespace cell {
-namespace http {}  // namespace http
-}  // namespace cell
\ No newline at end of file
+namespace http {
+
+namespace {
+
+bool starts_with_ignore_case(StringSlice slice, const char* prefix_cstr) noexcept {
+  const auto prefix = StringSlice::from_cstr(prefix_cstr);
+  return slice.get_length() >= prefix.get_length() &&
+         StringSlice{slice.get_u8_ptr(), prefix.get_length()}.compare_ignore_case(prefix);
+}
+
+bool ends_with_ignore_case(StringSlice slice, const char* suffix_cstr) noexcept {
+  const auto suffix = StringSlice::from_cstr(suffix_cstr);
+  const u64 length = slice.get_length();
+  return length >= suffix.get_length() &&
+         StringSlice{slice.get_u8_ptr() + length - suffix.get_length(), suffix.get_length()}
+             .compare_ignore_case(suffix);
+}
+
+}  // namespace
+
+bool is_compressible_mime_type(StringSlice content_type) noexcept {
+  // Strip parameters and trailing whitespace: "text/html; charset=utf-8"
+  u64 length = 0;
+  while (length < content_type.get_length() && content_type.byte_at(length) != ';') {
+    ++length;
+  }
+  while (length > 0 && rfc9110::is_whitespace(content_type.byte_at(length - 1))) {
+    --length;
+  }
+
+  const StringSlice type{content_type.get_u8_ptr(), length};
+
+  if (starts_with_ignore_case(type, "text/")) {
+    return true;
+  }
+
+  if (ends_with_ignore_case(type, "+json") || ends_with_ignore_case(type, "+xml")) {
+    return true;  // application/ld+json, image/svg+xml, application/atom+xml, ...
+  }
+
+  static const char* const compressible_types[] = {
+      "application/json",       "application/javascript", "application/x-javascript",
+      "application/ecmascript", "application/xml",        "application/wasm",
+      "application/x-ndjson",   "application/graphql",    "font/ttf",
+      "font/otf",               "image/x-icon",           "image/bmp",
+  };
+
+  for (const char* candidate : compressible_types) {
+    if (type.compare_ignore_case(StringSlice::from_cstr(candidate))) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+StringSlice mime_type_from_path(StringSlice path) noexcept {
+  struct Extension {
+    const char* extension;
+    const char* mime_type;
+  };
+
+  static const Extension extensions[] = {
+      {".html", "text/html; charset=utf-8"},
+      {".htm", "text/html; charset=utf-8"},
+      {".css", "text/css; charset=utf-8"},
+      {".js", "text/javascript; charset=utf-8"},
+      {".mjs", "text/javascript; charset=utf-8"},
+      {".json", "application/json"},
+      {".txt", "text/plain; charset=utf-8"},
+      {".xml", "application/xml"},
+      {".svg", "image/svg+xml"},
+      {".png", "image/png"},
+      {".jpg", "image/jpeg"},
+      {".jpeg", "image/jpeg"},
+      {".gif", "image/gif"},
+      {".webp", "image/webp"},
+      {".avif", "image/avif"},
+      {".ico", "image/x-icon"},
+      {".wasm", "application/wasm"},
+      {".woff", "font/woff"},
+      {".woff2", "font/woff2"},
+      {".ttf", "font/ttf"},
+      {".pdf", "application/pdf"},
+      {".zip", "application/zip"},
+      {".gz", "application/gzip"},
+      {".mp4", "video/mp4"},
+      {".webm", "video/webm"},
+      {".mp3", "audio/mpeg"},
+  };
+
+  for (const auto& [extension, mime_type] : extensions) {
+    if (ends_with_ignore_case(path, extension)) {
+      return StringSlice::from_cstr(mime_type);
+    }
+  }
+
+  return StringSlice::from_cstr("application/octet-stream");
+}
+
+}  // namespace http
+}  // namespace cell
@@ -4,6 +4,8 @@
 #ifndef CELL_MIME_TYPE_HPP
 #define CELL_MIME_TYPE_HPP
 
+#include "cell/core/string_slice.hpp"
+
 namespace cell::http {
 //
 // enum HttpMimeType {
@@ -15,6 +17,16 @@ namespace cell::http {
 //    [HttpMimeType::Text_Plain] = "text/plain"
 //};
 
+// Whether a body of this Content-Type is worth compressing. Text, JSON,
+// JavaScript, XML and SVG are; images, audio, video, fonts in compressed
+// formats and archives already are compressed. Parameters (";charset=...")
+// are ignored, unknown types are treated as not compressible.
+[[nodiscard]] bool is_compressible_mime_type(StringSlice content_type) noexcept;
+
+// Content-Type for a file, from its extension (case-insensitive). Falls
+// back to application/octet-stream.
+[[nodiscard]] StringSlice mime_type_from_path(StringSlice path) noexcept;
+
 }  // namespace cell::http
 
 #endif  // CELL_MIME_TYPE_HPP
@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "path_cache.hpp"
+
+#include <bit>
+
+#include "cell/core/hash.hpp"
+#include "uri.hpp"
+
+namespace cell::http {
+
+PathCache::PathCache(u64 slot_count) noexcept
+    : m_slots(std::bit_ceil(slot_count == 0 ? 1 : slot_count)), m_mask(m_slots.size() - 1) {}
+
+bool PathCache::canonicalize(StringSlice raw_path, StringSlice& canonical) noexcept {
+  if (raw_path.get_length() == 0 || raw_path.byte_at(0) != '/') [[unlikely]] {
+    return false;
+  }
+
+  const u64 hash = hash_fnv1a(raw_path);
+  Slot& slot = m_slots[hash & m_mask];
+
+  if (slot.used && slot.hash == hash && slot.raw.compare(raw_path)) {
+    ++m_hits;
+    canonical = slot.canonical.slice();
+    return true;
+  }
+
+  ++m_misses;
+
+  // Overly long paths are normalized but not cached, so one client can't
+  // blow up the memory held by the slots
+  const bool cacheable = raw_path.get_length() <= MAX_CACHED_PATH_LENGTH;
+  String& out = cacheable ? slot.canonical : m_scratch;
+
+  out.clear();
+  out.append_slice(raw_path);
+
+  u64 length = out.get_length();
+  if (!Uri::normalize_path_in_place(out.get_buffer_ptr(), length)) {
+    if (cacheable) {
+      slot.used = false;
+    }
+    return false;
+  }
+
+  out.set_length(length);
+
+  if (cacheable) {
+    slot.hash = hash;
+    slot.used = true;
+    slot.raw.clear();
+    slot.raw.append_slice(raw_path);
+  }
+
+  canonical = out.slice();
+  return true;
+}
+
+void PathCache::clear() noexcept {
+  for (auto& slot : m_slots) {
+    slot.used = false;
+  }
+
+  m_hits = 0;
+  m_misses = 0;
+}
+
+}  // namespace cell::http
@@ -0,0 +1,59 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_PATH_CACHE_HPP
+#define CELL_PATH_CACHE_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+
+namespace cell::http {
+
+// Bounded, direct-mapped cache from raw request paths to their normalized
+// form (see Uri::get_path_normalized). A hit costs one hash and one compare;
+// a miss normalizes into the slot, evicting whatever was there.
+//
+// Not thread safe, keep one per worker thread.
+class PathCache {
+ public:
+  static constexpr u64 DEFAULT_SLOT_COUNT = 1024;
+  static constexpr u64 MAX_CACHED_PATH_LENGTH = 512;
+
+  // slot_count is rounded up to a power of 2
+  explicit PathCache(u64 slot_count = DEFAULT_SLOT_COUNT) noexcept;
+
+  // Sets `canonical` to the normalized form of `raw_path`, which must start
+  // with '/'. The slice is valid until the next call. Returns false if the
+  // path has a malformed escape.
+  [[nodiscard]] bool canonicalize(StringSlice raw_path, StringSlice& canonical) noexcept;
+
+  void clear() noexcept;
+
+  [[nodiscard]] u64 get_hits() const noexcept { return m_hits; }
+  [[nodiscard]] u64 get_misses() const noexcept { return m_misses; }
+  [[nodiscard]] u64 get_slot_count() const noexcept { return m_slots.size(); }
+
+ private:
+  static constexpr u64 DEFAULT_SLOT_BUFFER_CAPACITY = 64;
+
+  struct Slot {
+    u64 hash{0};
+    bool used{false};
+    String raw{DEFAULT_SLOT_BUFFER_CAPACITY};
+    String canonical{DEFAULT_SLOT_BUFFER_CAPACITY};
+  };
+
+  std::vector<Slot> m_slots;
+  u64 m_mask{0};
+  u64 m_hits{0};
+  u64 m_misses{0};
+  String m_scratch{DEFAULT_SLOT_BUFFER_CAPACITY};
+};
+
+}  // namespace cell::http
+
+#endif  // CELL_PATH_CACHE_HPP
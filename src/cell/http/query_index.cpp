@@ -0,0 +1,306 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "query_index.hpp"
+
+#include <bit>
+#include <cstring>
+#include <limits>
+
+#include "cell/core/charset.hpp"
+#include "cell/core/hash.hpp"
+#include "cell/core/memory.hpp"
+#include "uri.hpp"
+
+namespace cell::http {
+
+namespace {
+
+// Numbers and booleans are short, values longer than this can't be valid
+constexpr u64 TYPED_VALUE_MAX_LENGTH = 32;
+
+// Copies `raw` into `buf` and decodes it if needed, returning the slice to
+// parse. Keeps typed accessors off the heap.
+bool decode_small_value(StringSlice raw, u8 (&buf)[TYPED_VALUE_MAX_LENGTH], StringSlice& out) {
+  if (!Uri::needs_decoding(raw, true)) {
+    out = raw;
+    return true;
+  }
+
+  u64 length = raw.get_length();
+  if (length > TYPED_VALUE_MAX_LENGTH) {
+    return false;
+  }
+
+  ::memcpy(buf, raw.get_u8_ptr(), length);
+  if (!Uri::decode_in_place(buf, length, true)) {
+    return false;
+  }
+
+  out = StringSlice{buf, length};
+  return true;
+}
+
+}  // namespace
+
+void QueryIndex::clear() noexcept {
+  m_entries.clear();
+  m_buckets.clear();
+  m_decoded_keys.set_length(0);
+}
+
+void QueryIndex::build(StringSlice query) noexcept {
+  clear();
+
+  const u8* cursor = query.get_u8_ptr();
+  const u8* const end = cursor + query.get_length();
+
+  while (cursor < end) {
+    const auto* amp = static_cast<const u8*>(::memchr(cursor, '&', static_cast<u64>(end - cursor)));
+    const u8* pair_end = amp ? amp : end;
+
+    if (pair_end != cursor) {
+      const auto* eq =
+          static_cast<const u8*>(::memchr(cursor, '=', static_cast<u64>(pair_end - cursor)));
+      const u8* key_end = eq ? eq : pair_end;
+      const u8* value_begin = eq ? eq + 1 : pair_end;
+
+      const StringSlice raw_key{cursor, static_cast<u64>(key_end - cursor)};
+      u64 decoded_key_offset = NOT_FOUND;
+
+      if (Uri::needs_decoding(raw_key, true)) {
+        const u64 offset = m_decoded_keys.get_length();
+        if (!Uri::decode(raw_key, m_decoded_keys, true)) {
+          // Malformed key, nothing could ever look it up
+          cursor = pair_end + 1;
+          continue;
+        }
+        decoded_key_offset = offset;
+      }
+
+      m_entries.push_back(Entry{
+          raw_key, StringSlice{value_begin, static_cast<u64>(pair_end - value_begin)}, 0, NO_NEXT,
+          decoded_key_offset});
+    }
+
+    cursor = pair_end + 1;
+  }
+
+  if (m_entries.empty()) {
+    return;
+  }
+
+  // Decoded keys live in m_decoded_keys, which may have moved while growing,
+  // so their slices are only resolved once it's done
+  u64 decoded_end = m_decoded_keys.get_length();
+  for (u64 i = m_entries.size(); i-- > 0;) {
+    Entry& entry = m_entries[i];
+    if (entry.decoded_key_offset != NOT_FOUND) {
+      entry.key = m_decoded_keys.slice(entry.decoded_key_offset,
+                                       decoded_end - entry.decoded_key_offset);
+      decoded_end = entry.decoded_key_offset;
+    }
+    entry.hash = hash_fnv1a(entry.key);
+  }
+
+  m_buckets.assign(std::bit_ceil(m_entries.size() * 2), EMPTY_BUCKET);
+  for (u64 i = 0; i < m_entries.size(); ++i) {
+    insert_into_table(static_cast<u32>(i));
+  }
+}
+
+void QueryIndex::insert_into_table(u32 index) noexcept {
+  const u64 mask = m_buckets.size() - 1;
+  Entry& entry = m_entries[index];
+
+  for (u64 bucket = entry.hash & mask;; bucket = (bucket + 1) & mask) {
+    if (m_buckets[bucket] == EMPTY_BUCKET) {
+      m_buckets[bucket] = index + 1;
+      return;
+    }
+
+    Entry& head = m_entries[m_buckets[bucket] - 1];
+    if (head.hash == entry.hash && head.key.compare(entry.key)) {
+      // Repeated key: append to the end of its chain to keep the order
+      Entry* tail = &head;
+      while (tail->next_same_key != NO_NEXT) {
+        tail = &m_entries[tail->next_same_key];
+      }
+      tail->next_same_key = index;
+      return;
+    }
+  }
+}
+
+StringSlice QueryIndex::get_key_at(u64 index) const noexcept {
+  CELL_ASSERT(index < m_entries.size());
+  return m_entries[index].key;
+}
+
+StringSlice QueryIndex::get_raw_value_at(u64 index) const noexcept {
+  CELL_ASSERT(index < m_entries.size());
+  return m_entries[index].value;
+}
+
+u64 QueryIndex::find_first(StringSlice key) const noexcept {
+  if (m_buckets.empty()) {
+    return NOT_FOUND;
+  }
+
+  const u64 hash = hash_fnv1a(key);
+  const u64 mask = m_buckets.size() - 1;
+
+  for (u64 bucket = hash & mask;; bucket = (bucket + 1) & mask) {
+    const u32 slot = m_buckets[bucket];
+    if (slot == EMPTY_BUCKET) {
+      return NOT_FOUND;
+    }
+
+    const Entry& entry = m_entries[slot - 1];
+    if (entry.hash == hash && entry.key.compare(key)) {
+      return slot - 1;
+    }
+  }
+}
+
+u64 QueryIndex::find_next(u64 index) const noexcept {
+  CELL_ASSERT(index < m_entries.size());
+  const u32 next = m_entries[index].next_same_key;
+  return next == NO_NEXT ? NOT_FOUND : next;
+}
+
+u64 QueryIndex::count(StringSlice key) const noexcept {
+  u64 n = 0;
+  for (u64 i = find_first(key); i != NOT_FOUND; i = find_next(i)) {
+    ++n;
+  }
+  return n;
+}
+
+bool QueryIndex::get_raw(StringSlice key, StringSlice& value) const noexcept {
+  const u64 index = find_first(key);
+  if (index == NOT_FOUND) {
+    return false;
+  }
+
+  value = m_entries[index].value;
+  return true;
+}
+
+bool QueryIndex::get_decoded(StringSlice key, String& out) const noexcept {
+  StringSlice raw{nullptr, 0};
+  return get_raw(key, raw) && Uri::decode(raw, out, true);
+}
+
+bool QueryIndex::get_i64(StringSlice key, i64& value) const noexcept {
+  StringSlice raw{nullptr, 0};
+  u8 buf[TYPED_VALUE_MAX_LENGTH];
+  StringSlice decoded{nullptr, 0};
+  return get_raw(key, raw) && decode_small_value(raw, buf, decoded) && parse_i64(decoded, value);
+}
+
+bool QueryIndex::get_u64(StringSlice key, u64& value) const noexcept {
+  StringSlice raw{nullptr, 0};
+  u8 buf[TYPED_VALUE_MAX_LENGTH];
+  StringSlice decoded{nullptr, 0};
+  return get_raw(key, raw) && decode_small_value(raw, buf, decoded) && parse_u64(decoded, value);
+}
+
+bool QueryIndex::get_bool(StringSlice key, bool& value) const noexcept {
+  const u64 index = find_first(key);
+  if (index == NOT_FOUND) {
+    return false;
+  }
+
+  const StringSlice raw = m_entries[index].value;
+  if (raw.get_length() == 0) {
+    value = true;
+    return true;
+  }
+
+  u8 buf[TYPED_VALUE_MAX_LENGTH];
+  StringSlice decoded{nullptr, 0};
+  return decode_small_value(raw, buf, decoded) && parse_bool(decoded, value);
+}
+
+bool QueryIndex::parse_u64(StringSlice raw, u64& value) noexcept {
+  const u64 length = raw.get_length();
+  if (length == 0) {
+    return false;
+  }
+
+  u64 result = 0;
+  for (u64 i = 0; i < length; ++i) {
+    const u8 ch = raw.byte_at(i);
+    if (!is_digit(ch)) {
+      return false;
+    }
+
+    const u64 digit = ch - '0';
+    if (result > (std::numeric_limits<u64>::max() - digit) / 10) {
+      return false;  // overflow
+    }
+    result = result * 10 + digit;
+  }
+
+  value = result;
+  return true;
+}
+
+bool QueryIndex::parse_i64(StringSlice raw, i64& value) noexcept {
+  const u64 length = raw.get_length();
+  if (length == 0) {
+    return false;
+  }
+
+  const u8 sign = raw.byte_at(0);
+  const bool negative = sign == '-';
+  const u64 skip = (negative || sign == '+') ? 1 : 0;
+
+  u64 magnitude = 0;
+  if (!parse_u64(StringSlice{raw.get_u8_ptr() + skip, length - skip}, magnitude)) {
+    return false;
+  }
+
+  constexpr u64 max_positive = static_cast<u64>(std::numeric_limits<i64>::max());
+  if (negative) {
+    if (magnitude > max_positive + 1) {
+      return false;
+    }
+    value = magnitude == max_positive + 1 ? std::numeric_limits<i64>::min()
+                                          : -static_cast<i64>(magnitude);
+    return true;
+  }
+
+  if (magnitude > max_positive) {
+    return false;
+  }
+
+  value = static_cast<i64>(magnitude);
+  return true;
+}
+
+bool QueryIndex::parse_bool(StringSlice raw, bool& value) noexcept {
+  static const StringSlice truthy[] = {StringSlice::from_cstr("1"), StringSlice::from_cstr("true"),
+                                       StringSlice::from_cstr("yes"), StringSlice::from_cstr("on")};
+  static const StringSlice falsy[] = {StringSlice::from_cstr("0"), StringSlice::from_cstr("false"),
+                                      StringSlice::from_cstr("no"), StringSlice::from_cstr("off")};
+
+  for (const auto& candidate : truthy) {
+    if (raw.compare_ignore_case(candidate)) {
+      value = true;
+      return true;
+    }
+  }
+
+  for (const auto& candidate : falsy) {
+    if (raw.compare_ignore_case(candidate)) {
+      value = false;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+}  // namespace cell::http
@@ -0,0 +1,81 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_QUERY_INDEX_HPP
+#define CELL_QUERY_INDEX_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+
+namespace cell::http {
+
+// Index over a raw query string ("a=1&b=2&a=3"). Keeps every parameter in
+// the order it appeared, repeated keys included, and hashes the keys into an
+// open-addressing table so lookups don't scan.
+//
+// Values are stored raw (still percent-encoded) as slices of the query
+// string, which must outlive the index. Keys are matched decoded.
+class QueryIndex {
+ public:
+  static constexpr u64 NOT_FOUND = static_cast<u64>(-1);
+
+  explicit QueryIndex() noexcept = default;
+
+  // Rebuilds the index for `query`, reusing previously allocated memory
+  void build(StringSlice query) noexcept;
+  void clear() noexcept;
+
+  [[nodiscard]] u64 get_size() const noexcept { return m_entries.size(); }
+  [[nodiscard]] bool is_empty() const noexcept { return m_entries.empty(); }
+
+  // Ordered iteration: parameters are numbered in the order they appeared
+  [[nodiscard]] StringSlice get_key_at(u64 index) const noexcept;
+  [[nodiscard]] StringSlice get_raw_value_at(u64 index) const noexcept;
+
+  // Walk all values of a key with find_first() / find_next()
+  [[nodiscard]] u64 find_first(StringSlice key) const noexcept;
+  [[nodiscard]] u64 find_next(u64 index) const noexcept;
+  [[nodiscard]] u64 count(StringSlice key) const noexcept;
+  [[nodiscard]] bool contains(StringSlice key) const noexcept { return find_first(key) != NOT_FOUND; }
+
+  // Accessors for the first value of `key`. All return false if the key is
+  // missing or its value doesn't parse.
+  [[nodiscard]] bool get_raw(StringSlice key, StringSlice& value) const noexcept;
+  [[nodiscard]] bool get_decoded(StringSlice key, String& out) const noexcept;
+  [[nodiscard]] bool get_i64(StringSlice key, i64& value) const noexcept;
+  [[nodiscard]] bool get_u64(StringSlice key, u64& value) const noexcept;
+  // Accepts 1/0, true/false, yes/no and on/off in any case. A key with no
+  // value at all ("?verbose") reads as true.
+  [[nodiscard]] bool get_bool(StringSlice key, bool& value) const noexcept;
+
+  [[nodiscard]] static bool parse_i64(StringSlice raw, i64& value) noexcept;
+  [[nodiscard]] static bool parse_u64(StringSlice raw, u64& value) noexcept;
+  [[nodiscard]] static bool parse_bool(StringSlice raw, bool& value) noexcept;
+
+ private:
+  static constexpr u64 DEFAULT_KEY_STORAGE_CAPACITY = 64;
+  static constexpr u32 EMPTY_BUCKET = 0;
+  static constexpr u32 NO_NEXT = static_cast<u32>(-1);
+
+  struct Entry {
+    StringSlice key;
+    StringSlice value;
+    u64 hash;
+    u32 next_same_key;
+    u64 decoded_key_offset;  // NOT_FOUND if `key` points into the query
+  };
+
+  void insert_into_table(u32 index) noexcept;
+
+  std::vector<Entry> m_entries{};
+  std::vector<u32> m_buckets{};  // entry index + 1, EMPTY_BUCKET if unused
+  String m_decoded_keys{DEFAULT_KEY_STORAGE_CAPACITY};
+};
+
+}  // namespace cell::http
+
+#endif  // CELL_QUERY_INDEX_HPP
@@ -0,0 +1,154 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "range.hpp"
+
+#include <algorithm>
+
+#include "cell/core/charset.hpp"
+
+namespace cell::http {
+
+namespace {
+
+// Numbers too large for a u64 saturate: they clamp like any other past the end
+constexpr u64 MAX_POSITION = ByteRanges::UNSET - 1;
+
+[[nodiscard]] bool is_ows(const u8 ch) noexcept { return rfc9110::is_whitespace(ch); }
+
+// 1*DIGIT from `cursor` on; false without a digit
+bool parse_position(const u8*& cursor, const u8* end, u64& position) noexcept {
+  if (cursor == end || !is_digit(*cursor)) {
+    return false;
+  }
+
+  position = 0;
+  for (; cursor < end && is_digit(*cursor); ++cursor) {
+    const u64 digit = *cursor - '0';
+    position = position > (MAX_POSITION - digit) / 10 ? MAX_POSITION : position * 10 + digit;
+  }
+  return true;
+}
+
+// range-spec = int-range / suffix-range, OWS already trimmed
+bool parse_spec(const u8* cursor, const u8* end, ByteRanges& ranges) noexcept {
+  u64 first = ByteRanges::UNSET;
+  if (*cursor != '-' && !parse_position(cursor, end, first)) {
+    return false;
+  }
+
+  if (cursor == end || *cursor != '-') {
+    return false;
+  }
+  ++cursor;
+
+  u64 last = ByteRanges::UNSET;
+  if (cursor != end && !parse_position(cursor, end, last)) {
+    return false;
+  }
+
+  // "-" alone, trailing garbage, or last-pos before first-pos
+  if (cursor != end || (first == ByteRanges::UNSET && last == ByteRanges::UNSET) ||
+      (first != ByteRanges::UNSET && last != ByteRanges::UNSET && last < first)) {
+    return false;
+  }
+
+  return ranges.add(first, last);
+}
+
+}  // namespace
+
+bool ByteRanges::add(u64 first, u64 last) noexcept {
+  if (m_count == MAX_RANGES) {
+    return false;
+  }
+  m_specs[m_count++] = {first, last};
+  return true;
+}
+
+u32 ByteRanges::resolve(u64 length, ByteRange* out) const noexcept {
+  u32 count = 0;
+
+  for (u32 i = 0; i < m_count; ++i) {
+    const ByteRange& spec = m_specs[i];
+    ByteRange range;
+
+    if (spec.first == UNSET) {
+      // The last `spec.last` bytes; a zero-length suffix selects nothing
+      if (spec.last == 0 || length == 0) {
+        continue;
+      }
+      range = {length - std::min(spec.last, length), length - 1};
+    } else {
+      if (spec.first >= length) {
+        continue;
+      }
+      range = {spec.first, std::min(spec.last, length - 1)};
+    }
+
+    // Insertion sort by first byte, there are MAX_RANGES at most
+    u32 at = count++;
+    for (; at > 0 && out[at - 1].first > range.first; --at) {
+      out[at] = out[at - 1];
+    }
+    out[at] = range;
+  }
+
+  if (count == 0) {
+    return 0;
+  }
+
+  // Overlapping or adjacent ranges become one, no byte is sent twice
+  u32 merged = 0;
+  for (u32 i = 1; i < count; ++i) {
+    if (out[i].first <= out[merged].last + 1) {
+      out[merged].last = std::max(out[merged].last, out[i].last);
+    } else {
+      out[++merged] = out[i];
+    }
+  }
+  return merged + 1;
+}
+
+ByteRanges parse_range(StringSlice value) noexcept {
+  ByteRanges ranges;
+
+  // ranges-specifier = range-unit "=" range-set
+  constexpr u64 UNIT_LENGTH = 6;
+  if (value.get_length() <= UNIT_LENGTH ||
+      !StringSlice{value.get_u8_ptr(), UNIT_LENGTH}.compare_ignore_case(
+          StringSlice::from_cstr("bytes="))) {
+    return ranges;
+  }
+
+  const u8* cursor = value.get_u8_ptr() + UNIT_LENGTH;
+  const u8* const end = value.get_u8_ptr() + value.get_length();
+
+  // range-set = 1#range-spec; empty list elements are allowed and skipped
+  while (cursor < end) {
+    const u8* element_end = cursor;
+    while (element_end < end && *element_end != ',') {
+      ++element_end;
+    }
+
+    const u8* first = cursor;
+    const u8* last = element_end;
+    while (first < last && is_ows(*first)) {
+      ++first;
+    }
+    while (last > first && is_ows(last[-1])) {
+      --last;
+    }
+
+    if (first != last && !parse_spec(first, last, ranges)) {
+      ranges.reset();
+      return ranges;
+    }
+
+    cursor = element_end + 1;
+  }
+
+  return ranges;
+}
+
+}  // namespace cell::http
@@ -0,0 +1,57 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_RANGE_HPP
+#define CELL_RANGE_HPP
+
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+
+namespace cell::http {
+
+// Bytes first..last of a representation, both included, as in Content-Range
+struct ByteRange {
+  u64 first{0};
+  u64 last{0};
+
+  [[nodiscard]] u64 get_length() const noexcept { return last - first + 1; }
+};
+
+// Parsed Range header (RFC 9110 14.1.2), "bytes" ranges only. Kept as sent
+// until resolve() is given the representation's length.
+class ByteRanges {
+ public:
+  // More ranges than this and the whole representation is sent instead
+  static constexpr u32 MAX_RANGES = 16;
+
+  explicit ByteRanges() noexcept = default;
+
+  // False when the header was missing, or is ignored: malformed, another
+  // unit, or too many ranges. RFC 9110 lets a server ignore Range.
+  [[nodiscard]] bool is_present() const noexcept { return m_count != 0; }
+  [[nodiscard]] u32 get_count() const noexcept { return m_count; }
+
+  // The satisfiable ranges for a representation of `length` bytes, clamped
+  // to it, in ascending order, overlapping and adjacent ones merged. Returns
+  // how many were written to `out`, which has room for MAX_RANGES; 0 means
+  // none is satisfiable (416).
+  [[nodiscard]] u32 resolve(u64 length, ByteRange* out) const noexcept;
+
+  // A range as sent: "first-last", "first-" with last UNSET, or "-suffix"
+  // with first UNSET and the suffix length as last. False once full.
+  static constexpr u64 UNSET = static_cast<u64>(-1);
+  [[nodiscard]] bool add(u64 first, u64 last) noexcept;
+  void reset() noexcept { m_count = 0; }
+
+ private:
+  ByteRange m_specs[MAX_RANGES]{};
+  u32 m_count{0};
+};
+
+// Parses a Range value without allocating. Anything malformed gives an
+// absent ByteRanges, never an error: the request is served whole.
+[[nodiscard]] ByteRanges parse_range(StringSlice value) noexcept;
+
+}  // namespace cell::http
+
+#endif  // CELL_RANGE_HPP
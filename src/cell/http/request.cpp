@@ -3,10 +3,14 @@
 
 #include "request.hpp"
 
+#include <cstring>
+
 #include "cell/core/charset.hpp"
 #include "cell/core/scanner.hpp"
 #include "cell/core/string.hpp"
 #include "cell/core/string_slice.hpp"
+#include "cell/encoding/inflate.hpp"
+#include "cell/encoding/sink.hpp"
 #include "cell/log/log.hpp"
 #include "encoding.hpp"
 #include "method.hpp"
@@ -15,12 +19,116 @@
 
 namespace cell::http {
 
+namespace {
+
+constexpr char HEADERS_END[] = "\r\n\r\n";
+constexpr u64 HEADERS_END_LENGTH = sizeof(HEADERS_END) - 1;
+
+// Value of the first `name:` header in the block, `name` in lower case
+bool find_header_value(StringSlice headers, StringSlice name, StringSlice &value) noexcept {
+  const u8 *cursor = headers.get_u8_ptr();
+  const u8 *const end = cursor + headers.get_length();
+
+  while (cursor < end) {
+    const auto *line_end = static_cast<const u8 *>(::memchr(cursor, '\n', end - cursor));
+    if (line_end == nullptr) {
+      line_end = end;
+    }
+
+    const StringSlice line{cursor, static_cast<u64>(line_end - cursor)};
+    if (line.get_length() > name.get_length() && line.byte_at(name.get_length()) == ':' &&
+        StringSlice{cursor, name.get_length()}.compare_ignore_case(name)) {
+      const u8 *value_begin = cursor + name.get_length() + 1;
+      const u8 *value_end = line_end;
+      while (value_begin < value_end && is_whitespace(*value_begin)) {
+        ++value_begin;
+      }
+      while (value_end > value_begin && is_whitespace(value_end[-1])) {
+        --value_end;
+      }
+      value = StringSlice{value_begin, static_cast<u64>(value_end - value_begin)};
+      return true;
+    }
+
+    cursor = line_end + 1;
+  }
+
+  return false;
+}
+
+}  // namespace
+
+RequestFramingResult frame_request(StringSlice data, u64 max_request_size,
+                                   u64 &request_length) noexcept {
+  const auto *headers_end = static_cast<const u8 *>(
+      ::memmem(data.get_u8_ptr(), data.get_length(), HEADERS_END, HEADERS_END_LENGTH));
+
+  if (headers_end == nullptr) {
+    return data.get_length() >= max_request_size ? RequestFramingResult::ErrorHeadersTooLarge
+                                                 : RequestFramingResult::Incomplete;
+  }
+
+  const u64 headers_length =
+      static_cast<u64>(headers_end - data.get_u8_ptr()) + HEADERS_END_LENGTH;
+  const StringSlice headers{data.get_u8_ptr(), headers_length};
+
+  StringSlice value{nullptr, 0};
+  if (find_header_value(headers, StringSlice::from_cstr("transfer-encoding"), value)) {
+    return RequestFramingResult::ErrorChunkedUnsupported;
+  }
+
+  u64 content_length = 0;
+  if (find_header_value(headers, StringSlice::from_cstr("content-length"), value)) {
+    if (value.get_length() == 0 || value.get_length() > 19) {
+      return RequestFramingResult::ErrorInvalidContentLength;
+    }
+    for (u64 i = 0; i < value.get_length(); ++i) {
+      const u8 digit = value.byte_at(i);
+      if (digit < '0' || digit > '9') {
+        return RequestFramingResult::ErrorInvalidContentLength;
+      }
+      content_length = content_length * 10 + (digit - '0');
+    }
+  }
+
+  if (headers_length + content_length > max_request_size) {
+    return RequestFramingResult::ErrorBodyTooLarge;
+  }
+
+  request_length = headers_length + content_length;
+  return data.get_length() >= request_length ? RequestFramingResult::Complete
+                                             : RequestFramingResult::Incomplete;
+}
+
 Request::Request(String *databuffer) noexcept : m_data(databuffer) {}
 
-RequestParserResult Request::parse() noexcept {
+void Request::reset() noexcept {
+  m_parser_state = RequestParserState::NeedMethod;
+  m_version = Version::UnsupportedVersion;
+  m_method = Method::UnsupportedMethod;
+  m_accept_encoding.reset();
+  m_content_encoding = encoding::IDENTITY;
+  m_range.reset();
+  m_if_range.set_length(0);
+  m_if_none_match.set_length(0);
+  m_if_modified_since.set_length(0);
+  m_connection = Connection::Close;
+  m_connection_header_seen = false;
+  m_upgrade_insecure_requests = false;
+  m_host.set_length(0);
+  m_referrer.set_length(0);
+  m_user_agent.set_length(0);
+  m_headers.Clear();
+}
+
+RequestParserResult Request::parse() noexcept { return parse(m_data->get_length()); }
+
+RequestParserResult Request::parse(const u64 length) noexcept {
+  CELL_ASSERT(length <= m_data->get_length());
   uint64_t cursor = 0;
   uint8_t ch;
-  m_data->refresh_length();
+  // No refresh_length() here: bodies may be binary (gzip) and contain NULs,
+  // whoever fills m_data keeps its length right
   m_buf1.clear();
   m_buf2.clear();
   m_uri.clear_data_buffer();
@@ -28,7 +136,7 @@ RequestParserResult Request::parse() noexcept {
 
   //  CELL_LOG_DEBUG("Parsing request [%s]", m_data->slice(0, 1));
 
-  while (cursor != m_data->get_length()) {
+  while (cursor != length) {
     ch = m_data->byte_at(cursor);
 
     switch (m_parser_state) {
@@ -137,6 +245,7 @@ RequestParserResult Request::parse() noexcept {
           // Assign common headers
           // TODO: Extract to separate method
           if (m_buf1.compare(StringSlice::from_cstr("connection"))) {
+            m_connection_header_seen = true;
             if (m_buf2.compare(StringSlice::from_cstr("keep-alive"))) {
               CELL_LOG_DEBUG_SIMPLE("[~] Connection: keep-alive");
               m_connection = Connection::KeepAlive;
@@ -161,12 +270,24 @@ RequestParserResult Request::parse() noexcept {
             }
           } else if (m_buf1.compare(StringSlice::from_cstr("accept-encoding"))) {
             CELL_LOG_DEBUG("[~] Passing accept-encoding string of '%s' to designated parser",
-                           m_buf1.get_c_str());
-            m_accept_encoding = encoding::parse_from_request_header(m_buf2.slice());
-
-            if (m_accept_encoding == encoding::ERROR_PARSING) {
-              CELL_LOG_DEBUG_SIMPLE("[!!!] Failed parsing accept-encoding, defaults to None");
-              m_accept_encoding = 0;
+                           m_buf2.get_c_str());
+            m_accept_encoding = encoding::parse_accept_encoding(m_buf2.slice());
+          } else if (m_buf1.compare(StringSlice::from_cstr("range"))) {
+            m_range = parse_range(m_buf2.slice());
+          } else if (m_buf1.compare(StringSlice::from_cstr("if-range"))) {
+            m_if_range = m_buf2;
+          } else if (m_buf1.compare(StringSlice::from_cstr("if-none-match"))) {
+            m_if_none_match = m_buf2;
+          } else if (m_buf1.compare(StringSlice::from_cstr("if-modified-since"))) {
+            m_if_modified_since = m_buf2;
+          } else if (m_buf1.compare(StringSlice::from_cstr("content-encoding"))) {
+            m_content_encoding = encoding::parse_content_encoding(m_buf2.slice());
+
+            // Refuse early, before buffering a body we can't decode
+            if (m_content_encoding != encoding::IDENTITY && m_content_encoding != encoding::GZIP &&
+                m_content_encoding != encoding::DEFLATE) {
+              CELL_LOG_DEBUG("[~] Unsupported content-encoding '%s'", m_buf2.get_c_str());
+              return RequestParserResult::ErrorContentEncodingUnsupported;
             }
           } else {
             CELL_LOG_DEBUG("[~] Found uncommon header '%s' -> '%s', adding to table",
@@ -199,6 +320,11 @@ RequestParserResult Request::parse() noexcept {
       case RequestParserState::NeedCrlfBetweenHeadersAndBody: {
         // end of headers?
         if (m_data->byte_at(cursor) == LF) {
+          // HTTP/1.1 connections persist unless the client says otherwise
+          if (!m_connection_header_seen && m_version == Version::Http1_1) {
+            m_connection = Connection::KeepAlive;
+          }
+
           m_parser_state = RequestParserState::AppendingBody;
           break ;
         }
@@ -211,8 +337,9 @@ RequestParserResult Request::parse() noexcept {
           return RequestParserResult::ErrorHeadRequestBodyExists;
         }
 
-//        CELL_LOG_DEBUG("Appending to body [%c] (%X)", ch, ch);
-        m_body.append_byte(ch);
+        // The rest is body, copy it in one go
+        m_body.append_slice(m_data->slice(cursor, length - cursor));
+        cursor = length - 1;
         break;
       }
     }
@@ -220,7 +347,34 @@ RequestParserResult Request::parse() noexcept {
     ++cursor;
   }
 
+  if (m_content_encoding != encoding::IDENTITY && !m_body.is_empty()) {
+    return decode_body();
+  }
+
   return RequestParserResult::Ok;
 }
 
+RequestParserResult Request::decode_body() noexcept {
+  if (!m_inflate.is_ok() || !m_inflate.begin(m_content_encoding)) {
+    return RequestParserResult::ErrorContentEncodingUnsupported;
+  }
+
+  m_decoded_body.clear();
+  cell::encoding::StringSink sink(&m_decoded_body);
+  const auto result = m_inflate.inflate_to_sink(m_body.slice(), &sink);
+
+  switch (result) {
+    case cell::encoding::InflateResult::Done:
+      CELL_LOG_DEBUG("[~] Decoded body, %lu -> %lu bytes", m_inflate.get_total_in(),
+                     m_inflate.get_total_out());
+      m_body.swap(m_decoded_body);
+      return RequestParserResult::Ok;
+    case cell::encoding::InflateResult::ErrorTooLarge:
+    case cell::encoding::InflateResult::ErrorRatioExceeded:
+      return RequestParserResult::ErrorBodyTooLarge;
+    default:
+      return RequestParserResult::ErrorBodyDecodingFailed;
+  }
+}
+
 }  // namespace cell::http
\ No newline at end of file
@@ -8,9 +8,11 @@
 #include "cell/core/string.hpp"
 #include "cell/core/string_slice.hpp"
 #include "cell/core/weak_string_cache.hpp"
+#include "cell/encoding/inflate.hpp"
 #include "connection.hpp"
 #include "encoding.hpp"
 #include "method.hpp"
+#include "range.hpp"
 #include "uri.hpp"
 #include "version.hpp"
 
@@ -28,8 +30,26 @@ enum class RequestParserResult {
   ErrorUriInvalid,
   ErrorFieldLineStartsWithWhitespace,
   ErrorHeadRequestBodyExists,
+  ErrorContentEncodingUnsupported,
+  ErrorBodyTooLarge,
+  ErrorBodyDecodingFailed,
 };
 
+enum class RequestFramingResult {
+  Complete,
+  Incomplete,
+  ErrorHeadersTooLarge,
+  ErrorBodyTooLarge,
+  ErrorInvalidContentLength,
+  ErrorChunkedUnsupported,
+};
+
+// Finds where the first request in `data` ends: after the blank line plus
+// Content-Length bytes of body. Lets a connection split pipelined requests
+// before handing each one to Request::parse().
+[[nodiscard]] RequestFramingResult frame_request(StringSlice data, u64 max_request_size,
+                                                 u64& request_length) noexcept;
+
 enum class RequestParserState {
   NeedMethod,
   NeedTarget,
@@ -50,15 +70,46 @@ class Request {
 
   [[nodiscard]] RequestParserResult parse() noexcept;
 
+  // Parses only the first `length` bytes of the buffer, see frame_request()
+  [[nodiscard]] RequestParserResult parse(u64 length) noexcept;
+
+  // Forgets the previous request, for connections that are kept alive
+  void reset() noexcept;
+
+  // Bounds for bodies sent with a Content-Encoding, see InflateLimits
+  void set_body_limits(cell::encoding::InflateLimits limits) noexcept {
+    m_inflate.set_limits(limits);
+  }
+
   [[nodiscard]] Version get_version() const noexcept { return m_version; }
   [[nodiscard]] Method get_method() const noexcept { return m_method; }
   [[nodiscard]] StringSlice get_target() const noexcept { return m_uri.get_data_buffer_as_slice(); }
+  [[nodiscard]] Uri& get_uri() noexcept { return m_uri; }
+  [[nodiscard]] const Uri& get_uri() const noexcept { return m_uri; }
   [[nodiscard]] StringSlice get_user_agent() const noexcept { return m_user_agent.slice(); }
   [[nodiscard]] StringSlice get_host() const noexcept { return m_host.slice(); }
   [[nodiscard]] StringSlice get_referrer() const noexcept { return m_referrer.slice(); }
+  // Already decoded when the request came with a Content-Encoding
   [[nodiscard]] StringSlice get_body() const noexcept { return m_body.slice(); }
-  [[nodiscard]] encoding::EncodingSet get_accept_encoding() const noexcept { return m_accept_encoding; }
+  [[nodiscard]] encoding::EncodingSet get_content_encoding() const noexcept {
+    return m_content_encoding;
+  }
+  [[nodiscard]] encoding::EncodingSet get_accept_encoding() const noexcept {
+    return m_accept_encoding.get_acceptable() & ~encoding::IDENTITY;
+  }
+  [[nodiscard]] const encoding::AcceptEncoding& get_accept_encoding_weights() const noexcept {
+    return m_accept_encoding;
+  }
   [[nodiscard]] Connection get_connection_type() const noexcept { return m_connection; }
+  // Absent unless the request came with a usable Range header
+  [[nodiscard]] const ByteRanges& get_range() const noexcept { return m_range; }
+  // The If-Range validator as sent, an entity tag or an HTTP-date
+  [[nodiscard]] StringSlice get_if_range() const noexcept { return m_if_range.slice(); }
+  // Conditional GET validators as sent, evaluated by is_not_modified()
+  [[nodiscard]] StringSlice get_if_none_match() const noexcept { return m_if_none_match.slice(); }
+  [[nodiscard]] StringSlice get_if_modified_since() const noexcept {
+    return m_if_modified_since.slice();
+  }
   [[nodiscard]] bool get_can_upgrade_insecure_connections() const noexcept {
     return m_upgrade_insecure_requests;
   }
@@ -66,18 +117,29 @@ class Request {
  private:
   static constexpr uint64_t DEFAULT_BUFFER_CAPACITY = 4096;
   static constexpr uint64_t DEFAULT_HEADER_BUFFER_CAPACITY = 4096;
+  static constexpr uint64_t DEFAULT_VALIDATOR_BUFFER_CAPACITY = 64;
+
+  [[nodiscard]] RequestParserResult decode_body() noexcept;
 
   String* m_data;
   String m_buf1{DEFAULT_BUFFER_CAPACITY};
   String m_buf2{DEFAULT_BUFFER_CAPACITY};
   String m_body{DEFAULT_BUFFER_CAPACITY};
+  String m_decoded_body{DEFAULT_BUFFER_CAPACITY};
 
   RequestParserState m_parser_state{RequestParserState::NeedMethod};
   Version m_version{Version::UnsupportedVersion};
   Method m_method{Method::UnsupportedMethod};
   Uri m_uri{};
-  encoding::EncodingSet m_accept_encoding{encoding::kNone};
+  encoding::AcceptEncoding m_accept_encoding{};
+  encoding::EncodingSet m_content_encoding{encoding::IDENTITY};
+  ByteRanges m_range{};
+  String m_if_range{DEFAULT_VALIDATOR_BUFFER_CAPACITY};
+  String m_if_none_match{DEFAULT_VALIDATOR_BUFFER_CAPACITY};
+  String m_if_modified_since{DEFAULT_VALIDATOR_BUFFER_CAPACITY};
+  cell::encoding::InflateStream m_inflate{};
   Connection m_connection{Connection::Close};
+  bool m_connection_header_seen{false};
   bool m_upgrade_insecure_requests{false};
   String m_host{DEFAULT_HEADER_BUFFER_CAPACITY};
   String m_referrer{DEFAULT_HEADER_BUFFER_CAPACITY};
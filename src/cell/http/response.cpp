@@ -0,0 +1,185 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "response.hpp"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <utility>
+
+#include "cell/core/assert.hpp"
+#include "date.hpp"
+
+namespace cell::http {
+
+namespace {
+
+// Reads `span` in behind `out`. A short read leaves the body short, as a
+// failed sendfile() would.
+void append_file_contents(String& out, const FileSpan& span) noexcept {
+  const u64 length = out.get_length();
+  out.expand(length + span.length + 1);
+
+  u64 done = 0;
+  while (done < span.length) {
+    const ssize_t count = ::pread(span.file->get_fd(), out.get_buffer_ptr() + length + done,
+                                  span.length - done, static_cast<off_t>(span.offset + done));
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      break;
+    }
+    done += static_cast<u64>(count);
+  }
+  out.set_length(length + done);
+}
+
+}  // namespace
+
+void Response::reset() noexcept {
+  m_status = Status::Ok;
+  m_headers.set_length(0);
+  m_body.set_length(0);
+  m_has_body_view = false;
+  m_body_files.clear();
+}
+
+void Response::add_header(StringSlice name, StringSlice value) noexcept {
+  m_headers.append_slice(name);
+  m_headers.append_slice(StringSlice::from_cstr(": "));
+  m_headers.append_slice(value);
+  m_headers.append_slice(StringSlice::from_cstr("\r\n"));
+}
+
+u64 Response::get_body_length() const noexcept {
+  u64 length = get_body().get_length();
+  for (const BodyFile& body_file : m_body_files) {
+    length += body_file.span.length;
+  }
+  return length;
+}
+
+void Response::set_body(StringSlice body) noexcept {
+  m_has_body_view = false;
+  m_body_files.clear();
+  m_body.set_length(0);
+  m_body.append_slice(body);
+}
+
+void Response::set_body(String& body) noexcept {
+  m_has_body_view = false;
+  m_body_files.clear();
+  m_body.swap(body);
+  body.set_length(0);
+}
+
+void Response::set_body_view(StringSlice body) noexcept {
+  m_has_body_view = true;
+  m_body_view = body;
+  m_body_files.clear();
+}
+
+void Response::set_body_file(FileSpan span) noexcept {
+  m_has_body_view = false;
+  m_body.set_length(0);
+  m_body_files.clear();
+  append_body_file(std::move(span));
+}
+
+void Response::append_body(StringSlice bytes) noexcept {
+  CELL_ASSERT(!m_has_body_view);
+  m_body.append_slice(bytes);
+}
+
+void Response::append_body_file(FileSpan span) noexcept {
+  CELL_ASSERT(!m_has_body_view);
+  if (span.length != 0) {
+    m_body_files.push_back({m_body.get_length(), std::move(span)});
+  }
+}
+
+void Response::serialize(String& out, Version version, bool keep_alive,
+                         bool include_body) const noexcept {
+  serialize_head(out, version, keep_alive);
+
+  if (!include_body || !has_body()) {
+    return;
+  }
+
+  const StringSlice body = get_body();
+  u64 at = 0;
+  for (const BodyFile& body_file : m_body_files) {
+    out.append_slice(StringSlice{body.get_u8_ptr() + at, body_file.at - at});
+    append_file_contents(out, body_file.span);
+    at = body_file.at;
+  }
+  out.append_slice(StringSlice{body.get_u8_ptr() + at, body.get_length() - at});
+}
+
+void Response::serialize(BufferChain& out, Version version, bool keep_alive,
+                         bool include_body) noexcept {
+  serialize_head(out.get_append_buffer(), version, keep_alive);
+
+  if (!include_body || !has_body()) {
+    return;
+  }
+
+  if (!m_body_files.empty()) {
+    // The bytes around file spans are part boundaries and the like, copied
+    u64 at = 0;
+    for (BodyFile& body_file : m_body_files) {
+      if (body_file.at != at) {
+        out.append(StringSlice{m_body.get_buffer_ptr() + at, body_file.at - at});
+      }
+      out.append_file(std::move(body_file.span));
+      at = body_file.at;
+    }
+    if (m_body.get_length() != at) {
+      out.append(StringSlice{m_body.get_buffer_ptr() + at, m_body.get_length() - at});
+    }
+    m_body_files.clear();
+    return;
+  }
+
+  const StringSlice body = m_has_body_view ? m_body_view : m_body.slice();
+  if (body.get_length() <= BufferChain::COPY_THRESHOLD) {
+    out.append(body);
+  } else if (m_has_body_view) {
+    out.append_borrowed(body);
+  } else {
+    out.append_owned(m_body);
+  }
+}
+
+void Response::serialize_head(String& out, Version version, bool keep_alive) const noexcept {
+  // HTTP/1.0 clients get an HTTP/1.0 answer, everyone else HTTP/1.1. Both
+  // lines are pre-rendered, so the head is all memcpy but Content-Length.
+  out.append_slice(status_line(m_status, version));
+  out.append_slice(get_date_line());
+  out.append_slice(m_headers.slice());
+
+  // 204 and 304 have no body and no Content-Length to go with it
+  if (has_body()) {
+    // Digits right to left, append_u64() would go through sprintf()
+    u8 digits[24];
+    u8* first = digits + sizeof(digits) - 2;
+    digits[sizeof(digits) - 2] = '\r';
+    digits[sizeof(digits) - 1] = '\n';
+    u64 length = get_body_length();
+    do {
+      *--first = static_cast<u8>('0' + length % 10);
+      length /= 10;
+    } while (length != 0);
+
+    out.append_slice(StringSlice::from_cstr("Content-Length: "));
+    out.append_slice(StringSlice{first, static_cast<u64>(digits + sizeof(digits) - first)});
+  }
+
+  out.append_slice(keep_alive ? StringSlice::from_cstr("Connection: keep-alive\r\n")
+                              : StringSlice::from_cstr("Connection: close\r\n"));
+  out.append_slice(StringSlice::from_cstr("\r\n"));
+}
+
+}  // namespace cell::http
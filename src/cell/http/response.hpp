@@ -0,0 +1,107 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_RESPONSE_HPP
+#define CELL_RESPONSE_HPP
+
+#include <vector>
+
+#include "cell/core/buffer_chain.hpp"
+#include "cell/core/file_handle.hpp"
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+#include "status.hpp"
+#include "version.hpp"
+
+namespace cell::http {
+
+// What a handler fills in. Date, Content-Length and Connection are added
+// by serialize(), handlers only set their own headers.
+class Response {
+ public:
+  explicit Response() noexcept = default;
+
+  void reset() noexcept;
+
+  [[nodiscard]] Status get_status() const noexcept { return m_status; }
+  void set_status(Status status) noexcept { m_status = status; }
+
+  // Header lines are kept serialized, names as given
+  void add_header(StringSlice name, StringSlice value) noexcept;
+  // A pre-rendered "Name: value\r\n", copied as is
+  void add_header_line(StringSlice line) noexcept { m_headers.append_slice(line); }
+  void set_content_type(StringSlice content_type) noexcept {
+    add_header(StringSlice::from_cstr("Content-Type"), content_type);
+  }
+  [[nodiscard]] StringSlice get_headers() const noexcept { return m_headers.slice(); }
+
+  // The owned body; a body view or file set before is dropped
+  [[nodiscard]] String& get_body() noexcept {
+    m_has_body_view = false;
+    m_body_files.clear();
+    return m_body;
+  }
+  // The in-memory bytes, without the file spans between them
+  [[nodiscard]] StringSlice get_body() const noexcept {
+    return m_has_body_view ? m_body_view : m_body.slice();
+  }
+  [[nodiscard]] u64 get_body_length() const noexcept;
+  void set_body(StringSlice body) noexcept;
+
+  // Takes `body` over without copying it; `body` gets the previous buffer
+  // back, emptied
+  void set_body(String& body) noexcept;
+  void set_body(String&& body) noexcept { set_body(body); }
+
+  // Sends `body` in place, without copying it anywhere. It must stay valid
+  // until the response is on the wire: string literals and the like.
+  void set_body_view(StringSlice body) noexcept;
+
+  // Sends `span` of an open file straight from the page cache, see
+  // FileCache. The handle is shared, the file stays open until it's sent.
+  void set_body_file(FileSpan span) noexcept;
+  [[nodiscard]] bool has_body_file() const noexcept { return !m_body_files.empty(); }
+
+  // Builds a body of bytes and file spans in order, multipart/byteranges
+  // for one. Neither drops what's there, unlike the setters.
+  void append_body(StringSlice bytes) noexcept;
+  void append_body_file(FileSpan span) noexcept;
+
+  // Appends the whole response to `out`. With `include_body` unset (HEAD)
+  // Content-Length still describes the body that would have been sent. A
+  // file body is read in, this is the copying path.
+  void serialize(String& out, Version version, bool keep_alive, bool include_body) const noexcept;
+
+  // Same, as segments of `out`: the status line and headers are copied in,
+  // a large body is moved in (or referenced, for a view or a file) rather
+  // than copied.
+  // Leaves the response without its body.
+  void serialize(BufferChain& out, Version version, bool keep_alive, bool include_body) noexcept;
+
+ private:
+  static constexpr u64 DEFAULT_HEADERS_CAPACITY = 512;
+  static constexpr u64 DEFAULT_BODY_CAPACITY = 4096;
+
+  void serialize_head(String& out, Version version, bool keep_alive) const noexcept;
+  [[nodiscard]] bool has_body() const noexcept {
+    return m_status != Status::NoContent && m_status != Status::NotModified;
+  }
+
+  Status m_status{Status::Ok};
+  String m_headers{DEFAULT_HEADERS_CAPACITY};
+  String m_body{DEFAULT_BODY_CAPACITY};
+  StringSlice m_body_view{nullptr, 0};
+  bool m_has_body_view{false};
+
+  // File spans go in the body at byte `at` of m_body
+  struct BodyFile {
+    u64 at;
+    FileSpan span;
+  };
+  std::vector<BodyFile> m_body_files{};
+};
+
+}  // namespace cell::http
+
+#endif  // CELL_RESPONSE_HPP
@@ -0,0 +1,97 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "status.hpp"
+
+#include <array>
+#include <iterator>
+
+#include "cell/core/assert.hpp"
+#include "cell/core/types.hpp"
+
+namespace cell::http {
+
+namespace {
+
+// Every Status with its code and reason phrase, the tables below are built from this
+#define CELL_HTTP_STATUSES(X)                                             \
+  X(Ok, 200, "OK")                                                        \
+  X(NoContent, 204, "No Content")                                         \
+  X(PartialContent, 206, "Partial Content")                               \
+  X(NotModified, 304, "Not Modified")                                     \
+  X(BadRequest, 400, "Bad Request")                                       \
+  X(NotFound, 404, "Not Found")                                           \
+  X(MethodNotAllowed, 405, "Method Not Allowed")                          \
+  X(NotAcceptable, 406, "Not Acceptable")                                 \
+  X(PayloadTooLarge, 413, "Content Too Large")                            \
+  X(UnsupportedMediaType, 415, "Unsupported Media Type")                  \
+  X(RangeNotSatisfiable, 416, "Range Not Satisfiable")                    \
+  X(RequestHeaderFieldsTooLarge, 431, "Request Header Fields Too Large") \
+  X(InternalServerError, 500, "Internal Server Error")                    \
+  X(NotImplemented, 501, "Not Implemented")                               \
+  X(ServiceUnavailable, 503, "Service Unavailable")
+
+#define CELL_CHECK_CODE(name, code, reason) \
+  static_assert(status_to_code(Status::name) == (code), "status code mismatch");
+CELL_HTTP_STATUSES(CELL_CHECK_CODE)
+#undef CELL_CHECK_CODE
+
+struct Rendered {
+  const char* text;
+  u64 length;
+};
+
+template <u64 N>
+constexpr Rendered render(const char (&text)[N]) noexcept {
+  return {text, N - 1};
+}
+
+struct StatusText {
+  Rendered reason;
+  Rendered lines[2];  // HTTP/1.0, HTTP/1.1
+};
+
+#define CELL_STATUS_TEXT(name, code, reason)                 \
+  {render(reason),                                           \
+   {render("HTTP/1.0 " #code " " reason "\r\n"),             \
+    render("HTTP/1.1 " #code " " reason "\r\n")}},
+
+constexpr StatusText STATUS_TEXTS[] = {CELL_HTTP_STATUSES(CELL_STATUS_TEXT)};
+#undef CELL_STATUS_TEXT
+
+#define CELL_STATUS_VALUE(name, code, reason) Status::name,
+constexpr Status STATUSES[] = {CELL_HTTP_STATUSES(CELL_STATUS_VALUE)};
+#undef CELL_STATUS_VALUE
+
+// Code to STATUS_TEXTS index + 1, 0 for codes without a Status
+constexpr u64 MAX_CODE = 600;
+constexpr auto TEXT_INDEX = [] {
+  std::array<u8, MAX_CODE> index{};
+  for (u64 i = 0; i < std::size(STATUSES); ++i) {
+    index[status_to_code(STATUSES[i])] = static_cast<u8>(i + 1);
+  }
+  return index;
+}();
+
+const StatusText& get_text(Status status) noexcept {
+  const u64 code = status_to_code(status);
+  const u8 index = code < MAX_CODE ? TEXT_INDEX[code] : 0;
+  if (index == 0) [[unlikely]] {
+    CELL_PANIC("unknown status");
+  }
+  return STATUS_TEXTS[index - 1];
+}
+
+StringSlice to_slice(Rendered rendered) noexcept {
+  return StringSlice{reinterpret_cast<const u8*>(rendered.text), rendered.length};
+}
+
+}  // namespace
+
+StringSlice status_to_string(Status status) noexcept { return to_slice(get_text(status).reason); }
+
+StringSlice status_line(Status status, Version version) noexcept {
+  return to_slice(get_text(status).lines[version == Version::Http1 ? 0 : 1]);
+}
+
+}  // namespace cell::http
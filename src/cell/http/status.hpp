@@ -0,0 +1,45 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_STATUS_HPP
+#define CELL_STATUS_HPP
+
+#include <cstdint>
+
+#include "cell/core/string_slice.hpp"
+#include "version.hpp"
+
+namespace cell::http {
+
+enum class Status : uint16_t {
+  Ok = 200,
+  NoContent = 204,
+  PartialContent = 206,
+  NotModified = 304,
+  BadRequest = 400,
+  NotFound = 404,
+  MethodNotAllowed = 405,
+  NotAcceptable = 406,
+  PayloadTooLarge = 413,
+  UnsupportedMediaType = 415,
+  RangeNotSatisfiable = 416,
+  RequestHeaderFieldsTooLarge = 431,
+  InternalServerError = 500,
+  NotImplemented = 501,
+  ServiceUnavailable = 503,
+};
+
+[[nodiscard]] constexpr uint16_t status_to_code(Status status) noexcept {
+  return static_cast<uint16_t>(status);
+}
+
+// Reason phrase, e.g. "Not Found"
+[[nodiscard]] StringSlice status_to_string(Status status) noexcept;
+
+// The whole status line, e.g. "HTTP/1.1 404 Not Found\r\n", rendered at
+// compile time. HTTP/1.0 for Version::Http1, HTTP/1.1 for everything else.
+[[nodiscard]] StringSlice status_line(Status status, Version version) noexcept;
+
+}  // namespace cell::http
+
+#endif  // CELL_STATUS_HPP
@@ -3,122 +3,469 @@
 
 #include "uri.hpp"
 
+#include <array>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "cell/core/base.hpp"
 #include "cell/core/charset.hpp"
+#include "cell/core/memory.hpp"
 #include "cell/core/types.hpp"
 #include "cell/log/log.hpp"
 
 namespace cell::http {
-UriParserResult Uri::parse() noexcept {
-  uint64_t cursor = 0;
-  uint8_t ch;
-  bool end_flag = false;
 
-  CELL_LOG_DEBUG("parse URI: [%s]", m_data.get_c_str());
+namespace {
 
-  while (!end_flag) {
-    if (cursor != m_data.get_length()) {
-      ch = m_data.byte_at(cursor);
-    } else {
-      end_flag = true;
+constexpr u64 DECODING_FAILED = static_cast<u64>(-1);
+
+constexpr std::array<bool, 256> URI_UNRESERVED_TABLE = [] {
+  std::array<bool, 256> table{};
+  for (int i = 0; i < 256; ++i) {
+    table[i] = rfc3986::is_unreserved(static_cast<u8>(i));
+  }
+  return table;
+}();
+
+// Returns a pointer to the first '%' (or '+', when plus_as_space is set) in
+// [ptr, end), or end. Scans 16 bytes at a time where SSE2 is available.
+const u8* find_escape(const u8* ptr, const u8* const end, bool plus_as_space) noexcept {
+#ifdef __SSE2__
+  const __m128i percent = _mm_set1_epi8('%');
+  const __m128i plus = _mm_set1_epi8(plus_as_space ? '+' : '%');
+
+  while (end - ptr >= 16) {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+    const __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, percent), _mm_cmpeq_epi8(chunk, plus));
+    const int mask = _mm_movemask_epi8(hits);
+
+    if (mask != 0) {
+      return ptr + __builtin_ctz(static_cast<unsigned>(mask));
     }
 
-    switch (state_) {
-      case UriParserState::GetType: {
-        if (ch == '/') {
-          m_uri_type = UriType::Relative;
-          state_ = UriParserState::GetPath;
-          CELL_LOG_DEBUG_SIMPLE("Uri type: Relative");
-          break;
-        }
+    ptr += 16;
+  }
+#endif
+
+  while (ptr < end && *ptr != '%' && !(plus_as_space && *ptr == '+')) {
+    ++ptr;
+  }
+
+  return ptr;
+}
 
-        CELL_LOG_DEBUG_SIMPLE("Uri type is Absolute, but we don't support it yet (TODO)");
-        return UriParserResult::UnsupportedUriType;
+// Decodes [src, src + length) into dst and returns the amount of bytes
+// written, or DECODING_FAILED. dst may equal src: the write cursor never
+// overtakes the read cursor, so runs are moved with memmove.
+u64 decode_run(const u8* src, const u64 length, u8* dst, bool plus_as_space) noexcept {
+  const u8* const end = src + length;
+  u8* const dst_begin = dst;
+
+  while (true) {
+    const u8* escape = find_escape(src, end, plus_as_space);
+    const auto run = static_cast<u64>(escape - src);
+
+    if (run != 0) {
+      if (dst != src) {
+        ::memmove(dst, src, run);
       }
-      case UriParserState::GetPath: {
-        if (ch == '?') {
-          state_ = UriParserState::GetQueryKey;
+      dst += run;
+      src = escape;
+    }
+
+    if (src == end) {
+      break;
+    }
 
-          CELL_LOG_DEBUG("URI Path: [%s]", m_path.get_c_str());
+    if (*src == '+') {
+      *dst++ = SP;
+      ++src;
+      continue;
+    }
+
+    if (end - src < 3) {
+      return DECODING_FAILED;  // '%' without 2 hexdigs after it
+    }
+
+    const u8 msb = HEX_VALUE_TABLE[src[1]];
+    const u8 lsb = HEX_VALUE_TABLE[src[2]];
+    if (((msb | lsb) & 0xF0) != 0) {
+      return DECODING_FAILED;  // fail, '%' with 2 non-hexdigs
+    }
+
+    *dst++ = static_cast<u8>(msb << 4 | lsb);
+    src += 3;
+  }
+
+  return static_cast<u64>(dst - dst_begin);
+}
+
+// RFC 3986 6.2.2.1 and 6.2.2.2: decode escaped unreserved characters and
+// upper-case the hexdigs of the rest. Never grows the buffer.
+u64 normalize_escapes(u8* data, const u64 length) noexcept {
+  u64 in = 0;
+  u64 out = 0;
 
-          if (!Uri::decode(m_path.slice(), m_path_decoded)) {
-            CELL_LOG_DEBUG_SIMPLE("Could not decode URI path");
-            return UriParserResult::DecodingPathFailed;
-          }
+  while (in < length) {
+    const u8 ch = data[in];
 
-          CELL_LOG_DEBUG("URI Path Decoded: [%s]", m_path_decoded.get_c_str());
-          break;
-        }
+    if (ch != '%') {
+      data[out++] = ch;
+      ++in;
+      continue;
+    }
+
+    if (length - in < 3) {
+      return DECODING_FAILED;
+    }
+
+    const u8 msb = HEX_VALUE_TABLE[data[in + 1]];
+    const u8 lsb = HEX_VALUE_TABLE[data[in + 2]];
+    if (((msb | lsb) & 0xF0) != 0) {
+      return DECODING_FAILED;
+    }
+
+    const auto decoded = static_cast<u8>(msb << 4 | lsb);
+    if (URI_UNRESERVED_TABLE[decoded]) {
+      data[out++] = decoded;
+    } else {
+      data[out++] = '%';
+      data[out++] = HEX_DIGITS_UPPER[msb];
+      data[out++] = HEX_DIGITS_UPPER[lsb];
+    }
+
+    in += 3;
+  }
 
-        m_path.append_byte(ch);
-        break;
+  return out;
+}
+
+// RFC 3986 5.2.4 remove_dot_segments, also collapsing runs of '/'. Works
+// segment by segment; the output never overtakes the input since every
+// segment written was preceded by at least one consumed '/'.
+u64 remove_dot_segments(u8* data, const u64 length) noexcept {
+  u64 in = 0;
+  u64 out = 0;
+
+  while (in < length) {
+    while (in < length && data[in] == '/') {
+      ++in;
+    }
+
+    const u64 segment_begin = in;
+    while (in < length && data[in] != '/') {
+      ++in;
+    }
+
+    const u64 segment_length = in - segment_begin;
+    const bool is_last = in == length;
+
+    if (segment_length == 0) {
+      // trailing slash
+      data[out++] = '/';
+      break;
+    }
+
+    if (segment_length == 1 && data[segment_begin] == '.') {
+      if (is_last) {
+        data[out++] = '/';
       }
-      case UriParserState::GetQueryKey: {
-        if (ch == '=') {
-          state_ = UriParserState::GetQueryValue;
-          break;
-        }
-
-        m_query_key.append_byte(ch);
-        break;
+      continue;
+    }
+
+    if (segment_length == 2 && data[segment_begin] == '.' && data[segment_begin + 1] == '.') {
+      while (out > 0 && data[out - 1] != '/') {
+        --out;
+      }
+      if (out > 0) {
+        --out;
       }
-      case UriParserState::GetQueryValue: {
-        if (ch == '&' || end_flag) {
-          state_ = UriParserState::GetQueryKey;
-          CELL_LOG_DEBUG("URI Query Key: [%s] -> [%s]", m_query_key.get_c_str(),
-                         m_query_value.get_c_str());
-
-          if (!Uri::decode(m_query_value.slice(), m_query_value_decoded)) {
-            CELL_LOG_DEBUG_SIMPLE("URI Query Value decoding failed");
-            return UriParserResult::DecodingQueryValueFailed;
-          }
-
-          CELL_LOG_DEBUG("URI Query Key Decoded: [%s] -> [%s]", m_query_key.get_c_str(),
-                         m_query_value_decoded.get_c_str());
-
-          m_queries.AddKeyValuePair(m_query_key, m_query_value_decoded);
-          m_query_key.clear();
-          m_query_value.clear();
-          break;
-        }
-
-        m_query_value.append_byte(ch);
-        break;
+      if (is_last) {
+        data[out++] = '/';
       }
+      continue;
+    }
+
+    data[out++] = '/';
+    if (out != segment_begin) {
+      ::memmove(data + out, data + segment_begin, segment_length);
     }
+    out += segment_length;
+  }
 
-    ++cursor;
+  if (out == 0) {
+    data[out++] = '/';
+  }
+
+  return out;
+}
+
+}  // namespace
+
+UriParserResult Uri::parse() noexcept {
+  const u64 length = m_data.get_length();
+  const u8* begin = m_data.get_buffer_ptr();
+
+  m_path_length = length;
+  m_query_offset = NO_QUERY;
+  m_path_decoded_ready = false;
+  m_path_normalized_ready = false;
+  m_query_index_ready = false;
+
+  CELL_LOG_DEBUG("parse URI: [%s]", m_data.get_c_str());
+
+  if (length == 0 || begin[0] != '/') {
+    CELL_LOG_DEBUG_SIMPLE("Uri type is Absolute, but we don't support it yet (TODO)");
+    return UriParserResult::UnsupportedUriType;
+  }
+
+  m_uri_type = UriType::Relative;
+
+  const auto* question_mark = static_cast<const u8*>(::memchr(begin, '?', length));
+  if (question_mark != nullptr) {
+    m_path_length = static_cast<u64>(question_mark - begin);
+    m_query_offset = m_path_length + 1;
+  }
+
+  // Only validate the path here, decoding is left to whoever needs it
+  if (!is_valid_encoding(get_path_raw())) {
+    CELL_LOG_DEBUG_SIMPLE("Could not decode URI path");
+    return UriParserResult::DecodingPathFailed;
   }
 
   return UriParserResult::Ok;
 }
 
-bool Uri::decode(StringSlice slice, String& out) {
-  u64 cursor = 0;
-  u8 ch;
-  bool fail_flag = false;
+StringSlice Uri::get_query_raw() const noexcept {
+  if (m_query_offset == NO_QUERY) {
+    return m_data.slice(m_data.get_length(), 0);
+  }
 
-  while (cursor < slice.get_length()) {
-    ch = slice.byte_at(cursor);
+  return m_data.slice(m_query_offset);
+}
 
-    if (ch == '%') {
-      if (cursor + 2 >= slice.get_length()) {
-        return false;
+StringSlice Uri::get_path_decoded() noexcept {
+  if (m_path_decoded_ready) {
+    return m_path_decoded_slice;
+  }
+
+  const auto raw = get_path_raw();
+  m_path_decoded_slice = raw;
+
+  if (needs_decoding(raw)) {
+    m_path_decoded.clear();
+
+    // parse() already rejected malformed escapes, so this cannot fail
+    [[maybe_unused]] const bool ok = decode(raw, m_path_decoded);
+    CELL_ASSERT(ok);
+    m_path_decoded_slice = m_path_decoded.slice();
+    CELL_LOG_DEBUG("URI Path Decoded: [%s]", m_path_decoded.get_c_str());
+  }
+
+  m_path_decoded_ready = true;
+  return m_path_decoded_slice;
+}
+
+StringSlice Uri::get_path_normalized() noexcept {
+  if (m_path_normalized_ready) {
+    return m_path_normalized.slice();
+  }
+
+  m_path_normalized.clear();
+  m_path_normalized.append_slice(get_path_raw());
+
+  u64 length = m_path_normalized.get_length();
+  if (length != 0) {
+    // parse() already rejected malformed escapes, so this cannot fail
+    [[maybe_unused]] const bool ok =
+        normalize_path_in_place(m_path_normalized.get_buffer_ptr(), length);
+    CELL_ASSERT(ok);
+    m_path_normalized.set_length(length);
+  }
+
+  m_path_normalized_ready = true;
+  return m_path_normalized.slice();
+}
+
+bool Uri::get_query_value(StringSlice key, StringSlice& value) noexcept {
+  const auto query = get_query_raw();
+  const u8* cursor = query.get_u8_ptr();
+  const u8* const end = cursor + query.get_length();
+
+  while (cursor < end) {
+    const auto* amp = static_cast<const u8*>(::memchr(cursor, '&', static_cast<u64>(end - cursor)));
+    const u8* pair_end = amp ? amp : end;
+    const auto* eq = static_cast<const u8*>(::memchr(cursor, '=', static_cast<u64>(pair_end - cursor)));
+    const u8* key_end = eq ? eq : pair_end;
+
+    if (key.compare(StringSlice{cursor, static_cast<u64>(key_end - cursor)})) {
+      const u8* value_begin = eq ? eq + 1 : pair_end;
+      const StringSlice raw{value_begin, static_cast<u64>(pair_end - value_begin)};
+
+      if (!needs_decoding(raw, true)) {
+        value = raw;
+        return true;
       }
-      const auto decoded_byte =
-          hex_pair_to_byte(slice.byte_at(cursor + 1), slice.byte_at(cursor + 2), fail_flag);
-      if (fail_flag) {
-        return false; // fail, '%' with 2 non-hexdigs
+
+      m_query_value_decoded.clear();
+      if (!decode(raw, m_query_value_decoded, true)) {
+        CELL_LOG_DEBUG_SIMPLE("URI Query Value decoding failed");
+        return false;
       }
 
-      out.append_byte(decoded_byte);
-      cursor += 2;
-    } else {
-      out.append_byte(ch);
+      value = m_query_value_decoded.slice();
+      return true;
+    }
+
+    cursor = pair_end + 1;
+  }
+
+  return false;
+}
+
+const QueryIndex& Uri::get_query_index() noexcept {
+  if (!m_query_index_ready) {
+    m_query_index.build(get_query_raw());
+    m_query_index_ready = true;
+  }
+
+  return m_query_index;
+}
+
+bool Uri::needs_decoding(StringSlice slice, bool plus_as_space) noexcept {
+  const auto length = slice.get_length();
+  if (length == 0) {
+    return false;
+  }
+
+  if (::memchr(slice.get_u8_ptr(), '%', length) != nullptr) {
+    return true;
+  }
+
+  return plus_as_space && ::memchr(slice.get_u8_ptr(), '+', length) != nullptr;
+}
+
+bool Uri::is_valid_encoding(StringSlice slice) noexcept {
+  const u8* cursor = slice.get_u8_ptr();
+  const u8* const end = cursor + slice.get_length();
+
+  while (cursor < end) {
+    const auto* percent = static_cast<const u8*>(::memchr(cursor, '%', static_cast<u64>(end - cursor)));
+    if (percent == nullptr) {
+      return true;
+    }
+
+    if (end - percent < 3 || !is_hex(percent[1]) || !is_hex(percent[2])) {
+      return false;
     }
 
-    ++cursor;
+    cursor = percent + 3;
   }
 
   return true;
 }
-}  // namespace cell::http
\ No newline at end of file
+
+bool Uri::decode(StringSlice slice, String& out, bool plus_as_space) {
+  const u64 length = slice.get_length();
+  if (length == 0) {
+    return true;
+  }
+
+  const u64 out_length = out.get_length();
+  if (out_length + length >= out.get_capacity()) {
+    out.expand(round_up_8(out_length + length + 1));
+  }
+
+  u8* dst = out.get_buffer_ptr() + out_length;
+  const u64 written = decode_run(slice.get_u8_ptr(), length, dst, plus_as_space);
+
+  if (written == DECODING_FAILED) {
+    out.set_length(out_length);
+    return false;
+  }
+
+  out.set_length(out_length + written);
+  return true;
+}
+
+bool Uri::decode_in_place(u8* data, u64& length, bool plus_as_space) noexcept {
+  const u64 written = decode_run(data, length, data, plus_as_space);
+
+  if (written == DECODING_FAILED) {
+    return false;
+  }
+
+  length = written;
+  return true;
+}
+
+bool Uri::decode_in_place(String& str, bool plus_as_space) noexcept {
+  u64 length = str.get_length();
+
+  if (!decode_in_place(str.get_buffer_ptr(), length, plus_as_space)) {
+    return false;
+  }
+
+  str.set_length(length);
+  return true;
+}
+
+bool Uri::normalize_path_in_place(u8* data, u64& length) noexcept {
+  CELL_ASSERT(length != 0 && data[0] == '/');
+
+  const u64 unescaped_length = normalize_escapes(data, length);
+  if (unescaped_length == DECODING_FAILED) {
+    return false;
+  }
+
+  length = remove_dot_segments(data, unescaped_length);
+  return true;
+}
+
+void Uri::encode(StringSlice slice, String& out, bool keep_slashes) noexcept {
+  const u64 length = slice.get_length();
+  if (length == 0) {
+    return;
+  }
+
+  // worst case: every byte becomes %XX
+  const u64 out_length = out.get_length();
+  if (out_length + length * 3 >= out.get_capacity()) {
+    out.expand(round_up_8(out_length + length * 3 + 1));
+  }
+
+  const u8* src = slice.get_u8_ptr();
+  const u8* const end = src + length;
+  u8* dst = out.get_buffer_ptr() + out_length;
+
+  while (src < end) {
+    const u8* run_end = src;
+    while (run_end < end && (URI_UNRESERVED_TABLE[*run_end] || (keep_slashes && *run_end == '/'))) {
+      ++run_end;
+    }
+
+    const auto run = static_cast<u64>(run_end - src);
+    if (run != 0) {
+      mem_copy(dst, src, run);
+      dst += run;
+      src = run_end;
+    }
+
+    if (src == end) {
+      break;
+    }
+
+    dst[0] = '%';
+    dst[1] = HEX_DIGITS_UPPER[*src >> 4];
+    dst[2] = HEX_DIGITS_UPPER[*src & 0x0F];
+    dst += 3;
+    ++src;
+  }
+
+  out.set_length(static_cast<u64>(dst - out.get_buffer_ptr()));
+}
+
+}  // namespace cell::http
@@ -5,12 +5,10 @@
 #define CELL_URI_HPP
 
 #include <cstdint>
-#include <functional>
-#include <unordered_map>
 
 #include "cell/core/string.hpp"
 #include "cell/core/string_slice.hpp"
-#include "cell/core/weak_string_cache.hpp"
+#include "query_index.hpp"
 
 namespace cell::http {
 
@@ -21,47 +19,94 @@ enum class UriParserResult {
   DecodingPathFailed,
 };
 
-enum class UriParserState { GetType, GetPath, GetQueryKey, GetQueryValue };
-
 enum class UriType {
   Absolute,
   Relative,
 };
 
+// The Uri owns a copy of the request target and nothing else: the path and
+// the query string are offsets into it, and are only percent-decoded when
+// somebody asks for them.
 class Uri {
  public:
   explicit Uri() noexcept = default;
 
-  [[nodiscard]] StringSlice get_path_raw() const noexcept { return m_path.slice(); }
-  [[nodiscard]] StringSlice get_path_decoded() const noexcept { return m_path_decoded.slice(); }
-  [[nodiscard]] const WeakStringCache & get_queries() const noexcept {
-    return m_queries;
+  [[nodiscard]] StringSlice get_path_raw() const noexcept {
+    return m_data.slice(0, m_path_length);
   }
+  [[nodiscard]] StringSlice get_query_raw() const noexcept;
+  [[nodiscard]] bool has_query() const noexcept { return m_query_offset != NO_QUERY; }
+  [[nodiscard]] UriType get_type() const noexcept { return m_uri_type; }
+
+  // Decoded on first use and kept until the next parse(). A path without
+  // escapes is returned as a slice of the target itself.
+  [[nodiscard]] StringSlice get_path_decoded() noexcept;
+
+  // RFC 3986 normal form of the path: escapes of unreserved characters are
+  // decoded, other escapes get upper-case hexdigs, runs of '/' are collapsed
+  // and dot segments are removed. Computed on first use into a buffer owned
+  // by the Uri, so it's safe to use as a routing key.
+  [[nodiscard]] StringSlice get_path_normalized() noexcept;
+
+  // Finds the first value of `key` in the query string. Values without '%'
+  // or '+' are returned as a slice of the target, anything else is decoded
+  // into a scratch buffer that is overwritten by the next lookup.
+  // Returns false if the key is missing or its value is malformed.
+  [[nodiscard]] bool get_query_value(StringSlice key, StringSlice& value) noexcept;
+
+  // Index over every query parameter, built on first use and kept until the
+  // next parse(). Prefer it over get_query_value() for repeated keys or
+  // more than a couple of lookups.
+  [[nodiscard]] const QueryIndex& get_query_index() noexcept;
 
   [[nodiscard]] UriParserResult parse() noexcept;
   [[nodiscard]] StringSlice get_data_buffer_as_slice() const noexcept { return m_data.slice(); }
-  [[nodiscard]] static bool decode(StringSlice slice, String& out);
+
+  // Appends the percent-decoded `slice` to `out`. With `plus_as_space` set,
+  // '+' is decoded as a space (application/x-www-form-urlencoded).
+  [[nodiscard]] static bool decode(StringSlice slice, String& out, bool plus_as_space = false);
+
+  // Decodes `length` bytes at `data` over themselves and updates `length`.
+  // The output is never longer than the input. On failure the buffer is left
+  // partially rewritten.
+  [[nodiscard]] static bool decode_in_place(uint8_t* data, uint64_t& length,
+                                            bool plus_as_space = false) noexcept;
+  [[nodiscard]] static bool decode_in_place(String& str, bool plus_as_space = false) noexcept;
+
+  // Appends `slice` to `out`, percent-encoding everything but unreserved
+  // characters (RFC 3986 2.3). With `keep_slashes` set, '/' is left as is so
+  // whole paths can be encoded in one go.
+  static void encode(StringSlice slice, String& out, bool keep_slashes = false) noexcept;
+
+  // Normalizes the path at `data` (which must start with '/') over itself,
+  // see get_path_normalized(). Returns false on a malformed escape.
+  [[nodiscard]] static bool normalize_path_in_place(uint8_t* data, uint64_t& length) noexcept;
+  [[nodiscard]] static bool needs_decoding(StringSlice slice, bool plus_as_space = false) noexcept;
+  [[nodiscard]] static bool is_valid_encoding(StringSlice slice) noexcept;
 
   void append_byte_to_data_buffer(uint8_t ch) noexcept { m_data.append_byte(ch); }
   void clear_data_buffer() noexcept { m_data.clear(); }
-  void set_data_buffer(StringSlice slice) noexcept { m_data = String(slice);
-  }
+  void set_data_buffer(StringSlice slice) noexcept { m_data = String(slice); }
 
  private:
   static constexpr uint64_t DEFAULT_URI_BUFFER_CAPACITY = 1024;
   static constexpr uint64_t DEFAULT_URI_PATH_BUFFER_CAPACITY = 256;
-  static constexpr uint64_t DEFAULT_QUERY_KEY_BUFFER_CAPACITY = 64;
   static constexpr uint64_t DEFAULT_QUERY_VALUE_BUFFER_CAPACITY = 256;
+  static constexpr uint64_t NO_QUERY = static_cast<uint64_t>(-1);
 
-  UriParserState state_{UriParserState::GetType};
   String m_data{DEFAULT_URI_BUFFER_CAPACITY};
-  String m_path{DEFAULT_URI_PATH_BUFFER_CAPACITY};
+  uint64_t m_path_length{0};
+  uint64_t m_query_offset{NO_QUERY};
+  UriType m_uri_type{UriType::Absolute};
+
+  bool m_path_decoded_ready{false};
+  StringSlice m_path_decoded_slice{nullptr, 0};
   String m_path_decoded{DEFAULT_URI_PATH_BUFFER_CAPACITY};
-  String m_query_key{DEFAULT_QUERY_KEY_BUFFER_CAPACITY};
-  String m_query_value{DEFAULT_QUERY_VALUE_BUFFER_CAPACITY};
+  bool m_path_normalized_ready{false};
+  String m_path_normalized{DEFAULT_URI_PATH_BUFFER_CAPACITY};
   String m_query_value_decoded{DEFAULT_QUERY_VALUE_BUFFER_CAPACITY};
-  WeakStringCache m_queries{};
-  UriType m_uri_type{UriType::Absolute};
+  bool m_query_index_ready{false};
+  QueryIndex m_query_index{};
 };
 
 }  // namespace cell::http
@@ -8,7 +8,8 @@
 namespace cell::http {
 
 Version version_from_string(StringSlice slice) noexcept {
-  if (slice.compare(StringSlice::from_cstr("HTTP/1"))) {
+  if (slice.compare(StringSlice::from_cstr("HTTP/1")) ||
+      slice.compare(StringSlice::from_cstr("HTTP/1.0"))) {
     return Version::Http1;
   } else if (slice.compare(StringSlice::from_cstr("HTTP/1.1"))) {
     return Version::Http1_1;
@@ -18,6 +18,7 @@ void hexdump(const u8* ptr, int length, int line_width) {
     }
     printf("%02x ", ptr[i]);
   }
-}
 #endif
-}
\ No newline at end of file
+}
+
+}  // namespace cell::log
\ No newline at end of file
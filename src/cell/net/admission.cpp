@@ -0,0 +1,80 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "admission.hpp"
+
+#include <cmath>
+
+namespace cell::net {
+
+namespace {
+
+constexpr u64 NS_PER_MS = 1'000'000;
+
+}  // namespace
+
+AdmissionControl::AdmissionControl(AdmissionConfig config) noexcept
+    : m_config(config),
+      m_max_queue_time(config.max_queue_time_ms * NS_PER_MS),
+      m_target(config.codel_target_ms * NS_PER_MS),
+      m_interval(config.codel_interval_ms * NS_PER_MS) {}
+
+Admission AdmissionControl::admit(u64 now, u64 queued_at, u64 in_flight) noexcept {
+  const u64 queue_time = now > queued_at ? now - queued_at : 0;
+
+  // CoDel sees every request, its state follows the queue whatever else
+  // refuses them
+  const bool shed = m_target != 0 && should_shed(now, queue_time);
+
+  if (m_config.max_in_flight != 0 && in_flight >= m_config.max_in_flight) {
+    return Admission::InFlightLimit;
+  }
+  if (m_max_queue_time != 0 && queue_time > m_max_queue_time) {
+    return Admission::QueueTimeout;
+  }
+  return shed ? Admission::CoDel : Admission::Admitted;
+}
+
+bool AdmissionControl::should_shed(u64 now, u64 queue_time) noexcept {
+  // Above target for a whole interval: a standing queue, not a burst
+  bool ok_to_drop = false;
+  if (queue_time < m_target) {
+    m_first_above_time = 0;
+  } else if (m_first_above_time == 0) {
+    m_first_above_time = now + m_interval;
+  } else if (now >= m_first_above_time) {
+    ok_to_drop = true;
+  }
+
+  if (m_dropping) {
+    if (!ok_to_drop) {
+      m_dropping = false;
+      return false;
+    }
+    if (now < m_drop_next) {
+      return false;
+    }
+    ++m_count;
+    m_drop_next = get_next_drop(m_drop_next);
+    return true;
+  }
+
+  if (!ok_to_drop) {
+    return false;
+  }
+
+  // Back to dropping soon after leaving it: pick up near the rate it had
+  m_dropping = true;
+  const u64 delta = m_count - m_last_count;
+  m_count = delta > 1 && now < m_drop_next + 16 * m_interval ? delta : 1;
+  m_last_count = m_count;
+  m_drop_next = get_next_drop(now);
+  return true;
+}
+
+u64 AdmissionControl::get_next_drop(u64 from) const noexcept {
+  return from + static_cast<u64>(static_cast<double>(m_interval) /
+                                 std::sqrt(static_cast<double>(m_count)));
+}
+
+}  // namespace cell::net
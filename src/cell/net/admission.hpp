@@ -0,0 +1,73 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_ADMISSION_HPP
+#define CELL_ADMISSION_HPP
+
+#include "cell/core/types.hpp"
+
+namespace cell::net {
+
+// What the server lets in under load, 0 turns each limit off. A refused
+// request isn't parsed, it gets a pre-rendered 503 with Retry-After and the
+// connection stays open.
+struct AdmissionConfig {
+  u32 max_in_flight{0};      // suspended responses at once, see Server::suspend()
+  u32 max_queue_time_ms{0};  // from a request's bytes arriving to its handler
+  // CoDel: once queue time has stayed above the target for an interval,
+  // requests are shed at a rate that grows until it drops below again
+  u32 codel_target_ms{0};
+  u32 codel_interval_ms{100};
+  u32 retry_after_s{1};
+};
+
+enum class Admission : u8 { Admitted, InFlightLimit, QueueTimeout, CoDel };
+
+// Admission control over the queue a reactor keeps implicitly: requests
+// read but not handled yet, behind earlier events of the same batch or a
+// suspended response on their connection. Their queue time is what CoDel
+// (RFC 8289) looks at, with the same state machine as for packets: a
+// standing queue, one that doesn't drain within an interval, makes it shed
+// one request, then the next after interval / sqrt(count), until queue time
+// is back under the target. Bursts that drain in time are let through.
+// Single-threaded, one per reactor.
+class AdmissionControl {
+ public:
+  explicit AdmissionControl(AdmissionConfig config) noexcept;
+
+  // Whether admit() can refuse anything at all
+  [[nodiscard]] bool is_enabled() const noexcept {
+    return m_config.max_in_flight != 0 || needs_clock();
+  }
+  // Whether admit() looks at queue time, and needs the current time for it
+  [[nodiscard]] bool needs_clock() const noexcept {
+    return m_target != 0 || m_max_queue_time != 0;
+  }
+
+  // For a request about to be handled, queued since `queued_at`, with
+  // `in_flight` responses suspended. Times in nanoseconds of one clock.
+  [[nodiscard]] Admission admit(u64 now, u64 queued_at, u64 in_flight) noexcept;
+
+  // CoDel is in its shedding state
+  [[nodiscard]] bool is_dropping() const noexcept { return m_dropping; }
+
+ private:
+  // One CoDel dequeue decision, true to shed
+  [[nodiscard]] bool should_shed(u64 now, u64 queue_time) noexcept;
+  [[nodiscard]] u64 get_next_drop(u64 from) const noexcept;
+
+  AdmissionConfig m_config;
+  u64 m_max_queue_time{0};
+  u64 m_target{0};
+  u64 m_interval{0};
+
+  u64 m_first_above_time{0};  // when queue time will have been above target for an interval
+  u64 m_drop_next{0};
+  u64 m_count{0};  // shed since entering the dropping state
+  u64 m_last_count{0};
+  bool m_dropping{false};
+};
+
+}  // namespace cell::net
+
+#endif  // CELL_ADMISSION_HPP
@@ -0,0 +1,139 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "reactor_group.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "cell/core/assert.hpp"
+#include "cell/core/cpu.hpp"
+#include "cell/log/log.hpp"
+
+namespace cell::net {
+
+ReactorGroup::ReactorGroup(ReactorGroupConfig config, HandlerFactory factory) noexcept
+    : m_config(config), m_factory(std::move(factory)) {
+  CELL_ASSERT(m_factory != nullptr);
+  m_config.server.reuse_port = true;
+}
+
+ReactorGroup::~ReactorGroup() {
+  stop();
+  wait();
+}
+
+bool ReactorGroup::start() noexcept {
+  CELL_ASSERT(m_reactors.empty());
+
+  const std::vector<int> cpus = get_allowed_cpus();
+  const u64 count = m_config.reactor_count != 0 ? m_config.reactor_count : cpus.size();
+
+  for (u64 i = 0; i < count; ++i) {
+    auto reactor = std::make_unique<Reactor>();
+    reactor->index = static_cast<u32>(i);
+    reactor->cpu = m_config.pin_threads ? cpus[i % cpus.size()] : -1;
+    m_reactors.push_back(std::move(reactor));
+  }
+
+  // The first reactor resolves port 0, the others bind to whatever it got
+  launch(*m_reactors[0], m_config.server.port);
+  bool ok = wait_until_listening(*m_reactors[0]);
+
+  if (ok) {
+    m_port = m_reactors[0]->server->get_port();
+    for (u64 i = 1; i < count; ++i) {
+      launch(*m_reactors[i], m_port);
+    }
+    for (u64 i = 1; i < count; ++i) {
+      ok &= wait_until_listening(*m_reactors[i]);
+    }
+  }
+
+  if (!ok) {
+    stop();
+    wait();
+  }
+  return ok;
+}
+
+void ReactorGroup::launch(Reactor& reactor, uint16_t port) noexcept {
+  reactor.thread = std::thread([this, &reactor, port] { run_reactor(reactor, port); });
+}
+
+bool ReactorGroup::wait_until_listening(const Reactor& reactor) noexcept {
+  std::unique_lock lock(m_mutex);
+  m_state_changed.wait(lock, [&reactor] { return reactor.state != ReactorState::Starting; });
+  return reactor.state == ReactorState::Listening;
+}
+
+void ReactorGroup::run_reactor(Reactor& reactor, uint16_t port) noexcept {
+  if (reactor.cpu >= 0 && !pin_current_thread(reactor.cpu)) {
+    CELL_LOG_DEBUG("reactor %u: can't pin to CPU %d", reactor.index, reactor.cpu);
+  }
+
+  ServerConfig config = m_config.server;
+  config.port = port;
+  // Reactors share nothing, buffer memory included
+  config.buffer_memory_limit /= m_reactors.size();
+  // and so is the in-flight limit, each reactor keeps at least one
+  if (config.admission.max_in_flight != 0) {
+    config.admission.max_in_flight =
+        std::max<u32>(1, config.admission.max_in_flight / m_reactors.size());
+  }
+
+  // Built here rather than in start() so the allocations are first touched
+  // by the thread, and on the CPU, that will use them
+  auto server = std::make_unique<Server>(config, m_factory(reactor.index));
+  const bool listening = server->listen();
+
+  {
+    std::lock_guard lock(m_mutex);
+    reactor.server = std::move(server);
+    reactor.state.store(listening ? ReactorState::Listening : ReactorState::Failed,
+                        std::memory_order_release);
+  }
+  m_state_changed.notify_all();
+
+  if (listening) {
+    reactor.server->run();
+  }
+}
+
+void ReactorGroup::wait() noexcept {
+  for (auto& reactor : m_reactors) {
+    if (reactor->thread.joinable()) {
+      reactor->thread.join();
+    }
+  }
+}
+
+void ReactorGroup::stop() noexcept {
+  for (auto& reactor : m_reactors) {
+    if (reactor->state.load(std::memory_order_acquire) == ReactorState::Listening) {
+      reactor->server->stop();
+    }
+  }
+}
+
+ServerStats ReactorGroup::get_stats() const noexcept {
+  ServerStats total{};
+
+  for (const auto& reactor : m_reactors) {
+    if (reactor->server != nullptr) {
+      const ServerStats& stats = reactor->server->get_stats();
+      total.accepted += stats.accepted;
+      total.requests += stats.requests;
+      total.active_connections += stats.active_connections;
+      total.timeouts += stats.timeouts;
+      total.read_pauses += stats.read_pauses;
+      total.rejected_in_flight += stats.rejected_in_flight;
+      total.rejected_queue_time += stats.rejected_queue_time;
+      total.rejected_codel += stats.rejected_codel;
+    }
+  }
+
+  return total;
+}
+
+}  // namespace cell::net
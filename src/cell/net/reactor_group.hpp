@@ -0,0 +1,94 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_REACTOR_GROUP_HPP
+#define CELL_REACTOR_GROUP_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cell/core/types.hpp"
+#include "server.hpp"
+
+namespace cell::net {
+
+struct ReactorGroupConfig {
+  ServerConfig server{};  // shared by every reactor, reuse_port is forced on
+  u32 reactor_count{0};   // 0: one per CPU the process may run on
+  bool pin_threads{true};
+};
+
+// Called once per reactor, on the reactor's own thread, so whatever the
+// handler allocates is local to it
+using HandlerFactory = std::function<Handler(u32 reactor)>;
+
+// Thread-per-core mode: every reactor is a Server on its own thread, pinned
+// to its own CPU, with its own SO_REUSEPORT listener so the kernel spreads
+// connections over them. Reactors share nothing on the request path, each
+// has its own connections, buffers and handler; whatever the handler keeps,
+// an AssetCache and its compressors for one, is the reactor's alone.
+class ReactorGroup {
+ public:
+  explicit ReactorGroup(ReactorGroupConfig config, HandlerFactory factory) noexcept;
+  ReactorGroup(const ReactorGroup&) = delete;
+  ReactorGroup& operator=(const ReactorGroup&) = delete;
+  ~ReactorGroup();
+
+  // Starts the reactors and returns once every one is listening, or false
+  // (with everything torn down) if any of them couldn't
+  [[nodiscard]] bool start() noexcept;
+
+  // Blocks until every reactor has stopped
+  void wait() noexcept;
+
+  // Safe to call from any thread and from signal handlers, once start() returned
+  void stop() noexcept;
+
+  [[nodiscard]] uint16_t get_port() const noexcept { return m_port; }
+  [[nodiscard]] u32 get_reactor_count() const noexcept {
+    return static_cast<u32>(m_reactors.size());
+  }
+
+  // Backend of the reactors, they all fall back to epoll the same way
+  [[nodiscard]] Backend get_backend() const noexcept {
+    const bool started = !m_reactors.empty() && m_reactors[0]->server != nullptr;
+    return started ? m_reactors[0]->server->get_backend() : m_config.server.backend;
+  }
+
+  // Sum over the reactors, only consistent once wait() has returned
+  [[nodiscard]] ServerStats get_stats() const noexcept;
+
+ private:
+  enum class ReactorState { Starting, Listening, Failed };
+
+  struct Reactor {
+    u32 index{0};
+    int cpu{-1};  // -1: not pinned
+    // Atomic for stop(), which may run in a signal handler: once it reads
+    // Listening, `server` is set and stays until the group is destroyed
+    std::atomic<ReactorState> state{ReactorState::Starting};
+    std::unique_ptr<Server> server{};
+    std::thread thread{};
+  };
+  static_assert(std::atomic<ReactorState>::is_always_lock_free, "stop() runs in signal handlers");
+
+  void launch(Reactor& reactor, uint16_t port) noexcept;
+  [[nodiscard]] bool wait_until_listening(const Reactor& reactor) noexcept;
+  void run_reactor(Reactor& reactor, uint16_t port) noexcept;
+
+  ReactorGroupConfig m_config;
+  HandlerFactory m_factory;
+  uint16_t m_port{0};
+  std::vector<std::unique_ptr<Reactor>> m_reactors{};
+  std::mutex m_mutex{};
+  std::condition_variable m_state_changed{};
+};
+
+}  // namespace cell::net
+
+#endif  // CELL_REACTOR_GROUP_HPP
@@ -0,0 +1,986 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "server.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstring>
+#include <mutex>
+
+#include "cell/core/assert.hpp"
+#include "cell/log/log.hpp"
+#include "socket.hpp"
+#include "stream.hpp"
+
+namespace cell::net {
+
+namespace {
+
+http::Status status_from_framing(http::RequestFramingResult result) noexcept {
+  switch (result) {
+    case http::RequestFramingResult::ErrorHeadersTooLarge:
+      return http::Status::RequestHeaderFieldsTooLarge;
+    case http::RequestFramingResult::ErrorBodyTooLarge:
+      return http::Status::PayloadTooLarge;
+    case http::RequestFramingResult::ErrorChunkedUnsupported:
+      return http::Status::NotImplemented;
+    default:
+      return http::Status::BadRequest;
+  }
+}
+
+http::Status status_from_parser(http::RequestParserResult result) noexcept {
+  switch (result) {
+    case http::RequestParserResult::ErrorMethodInvalid:
+      return http::Status::NotImplemented;
+    case http::RequestParserResult::ErrorContentEncodingUnsupported:
+      return http::Status::UnsupportedMediaType;
+    case http::RequestParserResult::ErrorBodyTooLarge:
+      return http::Status::PayloadTooLarge;
+    default:
+      return http::Status::BadRequest;
+  }
+}
+
+thread_local Server* t_current_server = nullptr;
+
+u64 get_steady_ns() noexcept {
+  const auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return static_cast<u64>(std::chrono::nanoseconds{now}.count());
+}
+
+// No Date, which 5xx may leave out (RFC 9110 6.6.1), so it never changes
+String render_rejection(u32 retry_after_s) noexcept {
+  String rejection{128};
+  rejection.append_c_str("HTTP/1.1 503 Service Unavailable\r\nRetry-After: ");
+  rejection.append_u64(retry_after_s);
+  rejection.append_c_str("\r\nContent-Length: 0\r\n\r\n");
+  return rejection;
+}
+
+}  // namespace
+
+// Completions travel from any thread to the reactor through here. Shared with
+// every DeferredResponse so a late resume() finds it closed rather than dangling.
+struct ServerMailbox {
+  struct Completion {
+    int fd;
+    u32 generation;
+    std::function<void(http::Response&)> fill;
+  };
+
+  std::mutex mutex{};
+  std::vector<Completion> completions{};  // guarded by mutex
+  int wake_fd{-1};                        // guarded by mutex, -1 once closed
+};
+
+void DeferredResponse::resume(std::function<void(http::Response& response)> fill) noexcept {
+  CELL_ASSERT(is_valid());
+
+  std::lock_guard lock(m_mailbox->mutex);
+  if (m_mailbox->wake_fd < 0) {
+    return;
+  }
+
+  m_mailbox->completions.push_back({m_fd, m_generation, std::move(fill)});
+  const u64 one = 1;
+  [[maybe_unused]] const auto written = ::write(m_mailbox->wake_fd, &one, sizeof(one));
+}
+
+// Out of line, Stream is incomplete in the header
+Server::Connection::Connection(int fd) noexcept : fd(fd) {}
+Server::Connection::~Connection() = default;
+
+Server::Server(ServerConfig config, Handler handler) noexcept
+    : m_config(config),
+      m_handler(std::move(handler)),
+      m_mailbox(std::make_shared<ServerMailbox>()),
+      m_buffers(config.buffer_memory_limit),
+      m_admission(config.admission),
+      m_rejection(render_rejection(config.admission.retry_after_s)) {
+  CELL_ASSERT(m_handler != nullptr);
+  CELL_ASSERT(m_config.max_events != 0);
+}
+
+Server::Server(ServerConfig config, StreamHandler handler) noexcept
+    : m_config(config),
+      m_stream_handler(std::move(handler)),
+      m_mailbox(std::make_shared<ServerMailbox>()),
+      m_buffers(config.buffer_memory_limit),
+      m_admission(config.admission),
+      m_rejection(render_rejection(config.admission.retry_after_s)) {
+  CELL_ASSERT(m_stream_handler != nullptr);
+  CELL_ASSERT(m_config.max_events != 0);
+}
+
+Server::~Server() {
+  {
+    std::lock_guard lock(m_mailbox->mutex);
+    m_mailbox->wake_fd = -1;
+    m_mailbox->completions.clear();
+  }
+
+  for (auto& connection : m_connections) {
+    // A closing io_uring connection may already have lost its fd number
+    if (connection != nullptr && !connection->closing) {
+      ::close(connection->fd);
+    }
+  }
+
+  for (const int fd : {m_listen_fd, m_epoll_fd, m_wake_fd}) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+}
+
+bool Server::listen() noexcept {
+  CELL_ASSERT(m_listen_fd < 0);
+
+  m_listen_fd = create_listen_socket(m_config.host, m_config.port, m_config.backlog,
+                                     m_config.reuse_port);
+  m_wake_fd = ::eventfd(0, EFD_CLOEXEC);
+  if (m_listen_fd < 0 || m_wake_fd < 0) {
+    return false;
+  }
+
+  {
+    std::lock_guard lock(m_mailbox->mutex);
+    m_mailbox->wake_fd = m_wake_fd;
+  }
+
+  m_backend = Backend::Epoll;
+#ifdef CELL_HAVE_IO_URING
+  if (m_config.backend == Backend::IoUring && listen_uring()) {
+    m_backend = Backend::IoUring;
+  }
+#endif
+
+  if (m_backend == Backend::Epoll && !listen_epoll()) {
+    return false;
+  }
+
+  // sendfile() and splice() have no MSG_NOSIGNAL: a peer gone mid-file would
+  // kill the process. A handler someone installed stays.
+  struct sigaction action {};
+  if (::sigaction(SIGPIPE, nullptr, &action) == 0 && action.sa_handler == SIG_DFL) {
+    action.sa_handler = SIG_IGN;
+    ::sigaction(SIGPIPE, &action, nullptr);
+  }
+
+  m_port = get_local_port(m_listen_fd);
+  m_running.store(true);
+  return true;
+}
+
+bool Server::listen_epoll() noexcept {
+  m_epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+  if (m_epoll_fd < 0) {
+    return false;
+  }
+
+  epoll_event event{};
+  event.events = EPOLLIN | EPOLLET;
+  event.data.fd = m_listen_fd;
+  if (::epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_listen_fd, &event) != 0) {
+    return false;
+  }
+
+  event.events = EPOLLIN;
+  event.data.fd = m_wake_fd;
+  return ::epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wake_fd, &event) == 0;
+}
+
+void Server::stop() noexcept {
+  m_running.store(false);
+
+  // write() is async-signal-safe, the loop wakes up and sees the flag
+  const u64 one = 1;
+  [[maybe_unused]] const auto written = ::write(m_wake_fd, &one, sizeof(one));
+}
+
+void Server::run() noexcept {
+  t_current_server = this;
+
+  // The wheel starts at the current tick, deadlines are relative to it
+  update_clock();
+  run_timers();
+
+#ifdef CELL_HAVE_IO_URING
+  if (m_backend == Backend::IoUring) {
+    run_uring();
+  } else {
+    run_epoll();
+  }
+#else
+  run_epoll();
+#endif
+
+  t_current_server = nullptr;
+}
+
+Server* Server::get_current() noexcept { return t_current_server; }
+
+DeferredResponse Server::suspend() noexcept {
+  CELL_ASSERT(m_current != nullptr);
+  CELL_ASSERT(!m_current->suspended);
+
+  m_current->suspended = true;
+  ++m_in_flight;
+  return DeferredResponse{m_mailbox, m_current->fd, m_current->generation};
+}
+
+void Server::drain_mailbox() noexcept {
+  std::vector<ServerMailbox::Completion> completions;
+  {
+    std::lock_guard lock(m_mailbox->mutex);
+    completions.swap(m_mailbox->completions);
+  }
+
+  for (auto& completion : completions) {
+    const auto fd = static_cast<u64>(completion.fd);
+    Connection* connection = fd < m_connections.size() ? m_connections[fd].get() : nullptr;
+    if (connection == nullptr || connection->generation != completion.generation ||
+        !connection->suspended) {
+      continue;
+    }
+
+    completion.fill(connection->response);
+    connection->suspended = false;
+    --m_in_flight;
+    finish_response(*connection);
+    resume(*connection);
+  }
+}
+
+void Server::resume(Connection& connection) noexcept {
+  // Pipelined requests that waited behind the suspended one go next
+  process(connection);
+
+#ifdef CELL_HAVE_IO_URING
+  if (m_backend == Backend::IoUring) {
+    uring_flush(connection);
+    release_buffers(connection);
+    update_deadline(connection);
+    return;
+  }
+#endif
+
+  // Edge-triggered: input left unread while suspended raises no new event
+  on_event(connection, EPOLLIN);
+}
+
+void Server::run_epoll() noexcept {
+  CELL_ASSERT(m_epoll_fd >= 0);
+  std::vector<epoll_event> events(m_config.max_events);
+
+  while (m_running.load(std::memory_order_relaxed)) {
+    const int count = ::epoll_wait(m_epoll_fd, events.data(), static_cast<int>(events.size()),
+                                   get_timer_timeout());
+    update_clock();
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      CELL_LOG_DEBUG("server: epoll_wait failed (errno %d)", errno);
+      return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      const int fd = events[i].data.fd;
+
+      if (fd == m_listen_fd) {
+        accept_all();
+      } else if (fd == m_wake_fd) {
+        u64 value;
+        [[maybe_unused]] const auto read = ::read(m_wake_fd, &value, sizeof(value));
+        drain_mailbox();
+      } else if (static_cast<u64>(fd) < m_connections.size() && m_connections[fd] != nullptr) {
+        on_event(*m_connections[fd], events[i].events);
+      }
+    }
+
+    run_timers();
+    resume_reads();
+  }
+}
+
+void Server::accept_all() noexcept {
+  while (true) {
+    const int fd = ::accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        // EMFILE and friends: leave the rest in the backlog for now
+        CELL_LOG_DEBUG("server: accept failed (errno %d)", errno);
+      }
+      return;
+    }
+
+    Connection* connection = open(fd);
+    if (connection == nullptr) {
+      ::close(fd);
+    } else if (m_stream_handler != nullptr) {
+      stream_open(*connection);
+    }
+  }
+}
+
+Server::Connection* Server::open(int fd) noexcept {
+  [[maybe_unused]] const bool nodelay = set_tcp_nodelay(fd);
+
+  epoll_event event{};
+  event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  event.data.fd = fd;
+  if (::epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+    return nullptr;
+  }
+
+  return acquire(fd);
+}
+
+Server::Connection* Server::acquire(int fd) noexcept {
+  if (static_cast<u64>(fd) >= m_connections.size()) {
+    m_connections.resize(static_cast<u64>(fd) + 1);
+  }
+  CELL_ASSERT(m_connections[fd] == nullptr);
+
+  // Connections are recycled, their buffers are the expensive part
+  std::unique_ptr<Connection> connection;
+  if (!m_free_connections.empty()) {
+    connection = std::move(m_free_connections.back());
+    m_free_connections.pop_back();
+    connection->fd = fd;
+  } else {
+    connection = std::make_unique<Connection>(fd);
+  }
+
+  connection->generation = m_next_generation++;
+  connection->timeout.data = static_cast<u64>(fd);
+  m_connections[fd] = std::move(connection);
+  ++m_stats.accepted;
+  ++m_stats.active_connections;
+
+  // The first request's header timeout starts now, a peer that connects
+  // and sends nothing is the cheapest slowloris
+  Connection* accepted = m_connections[fd].get();
+  update_deadline(*accepted);
+  return accepted;
+}
+
+void Server::close(Connection& connection) noexcept {
+  // Closing the fd also takes it out of the epoll set
+  ::close(connection.fd);
+  release(connection);
+}
+
+void Server::release(Connection& connection) noexcept {
+  const int fd = connection.fd;
+  --m_stats.active_connections;
+
+  m_buffers.release(connection.in);
+  connection.in.set_length(0);
+  connection.output.clear();
+  connection.output.shrink();
+  connection.close_after_write = false;
+  connection.send_in_flight = false;
+  connection.closing = false;
+  if (connection.suspended) {
+    connection.suspended = false;
+    --m_in_flight;
+  }
+  m_timeouts.disarm(connection.timeout);
+  connection.deadline = Deadline::None;
+  connection.awaiting_body = false;
+  connection.has_served = false;
+  connection.read_paused = false;
+  connection.recv_armed = false;
+
+  // Whatever a broken splice left in the pipe isn't the next connection's
+  if (connection.pipe_read != -1) {
+    ::close(connection.pipe_read);
+    ::close(connection.pipe_write);
+    connection.pipe_read = connection.pipe_write = -1;
+    connection.pipe_capacity = connection.pipe_pending = 0;
+  }
+
+  // Wherever the coroutine is suspended, its frames go back to the pool
+  connection.task = {};
+
+  if (m_free_connections.size() < MAX_FREE_CONNECTIONS) {
+    m_free_connections.push_back(std::move(m_connections[fd]));
+  } else {
+    m_connections[fd].reset();
+  }
+}
+
+void Server::on_event(Connection& connection, u32 events) noexcept {
+  if (m_stream_handler != nullptr) {
+    stream_on_event(connection, events);
+    return;
+  }
+
+  if (events & EPOLLERR) {
+    close(connection);
+    return;
+  }
+
+  if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+    ReadResult result;
+    do {
+      result = read_some(connection);
+      process(connection);
+    } while (result == ReadResult::BufferFull && !connection.close_after_write &&
+             !connection.suspended);
+
+    if (result == ReadResult::Paused) {
+      pause_reads(connection);
+    }
+
+    if (result == ReadResult::Closed) {
+      // Answer what the peer sent before it went away, then hang up; a
+      // suspended response is waited for, resume() gets here again
+      [[maybe_unused]] const bool flushed = flush(connection);
+      if (connection.suspended) {
+        connection.close_after_write = true;
+      } else {
+        close(connection);
+      }
+      return;
+    }
+  }
+
+  if (!flush(connection)) {
+    close(connection);
+    return;
+  }
+
+  release_buffers(connection);
+  update_deadline(connection);
+}
+
+Server::ReadResult Server::read_some(Connection& connection) noexcept {
+  String& in = connection.in;
+
+  while (true) {
+    if (in.get_capacity() - in.get_length() < MIN_READ_SIZE) {
+      // A request can't be larger than this, let process() refuse it
+      if (in.get_length() >= m_config.max_request_size) {
+        return ReadResult::BufferFull;
+      }
+      // Refused a larger buffer, read into what's left of this one
+      if (!m_buffers.reserve(in, std::max(in.get_capacity() * 2, in.get_length() + MIN_READ_SIZE)) &&
+          (in.get_capacity() < MIN_READ_SIZE || in.get_capacity() - in.get_length() <= 1)) {
+        return ReadResult::Paused;
+      }
+    }
+
+    const u64 room = in.get_capacity() - in.get_length() - 1;
+    const ssize_t count = ::recv(connection.fd, in.get_buffer_ptr() + in.get_length(), room, 0);
+
+    if (count > 0) {
+      connection.received_at = m_now;
+      in.set_length(in.get_length() + static_cast<u64>(count));
+      continue;
+    }
+
+    if (count == 0) {
+      return ReadResult::Closed;
+    }
+
+    if (errno == EINTR) {
+      continue;
+    }
+
+    return errno == EAGAIN || errno == EWOULDBLOCK ? ReadResult::WouldBlock : ReadResult::Closed;
+  }
+}
+
+void Server::process(Connection& connection) noexcept {
+  while (!connection.close_after_write && !connection.suspended) {
+    // Left as is until the blank line is in, see frame_request()
+    u64 request_length = 0;
+    const NextRequest next = next_request(connection, request_length);
+    if (next == NextRequest::Rejected) {
+      consume(connection, request_length);
+      continue;
+    }
+    if (next != NextRequest::Ready) {
+      connection.awaiting_body = request_length != 0;
+      return;
+    }
+
+    http::Request& request = connection.request;
+    connection.version = request.get_version();
+    connection.keep_alive = request.get_connection_type() == http::Connection::KeepAlive;
+    connection.include_body = request.get_method() != http::Method::Head;
+
+    connection.response.reset();
+    m_current = &connection;
+    m_handler(request, connection.response);
+    m_current = nullptr;
+
+    if (!connection.suspended) {
+      finish_response(connection);
+    }
+
+    consume(connection, request_length);
+  }
+}
+
+Server::NextRequest Server::next_request(Connection& connection, u64& request_length) noexcept {
+  const auto framing =
+      http::frame_request(connection.in.slice(), m_config.max_request_size, request_length);
+  if (framing == http::RequestFramingResult::Incomplete) {
+    return NextRequest::Incomplete;
+  }
+  if (framing != http::RequestFramingResult::Complete) {
+    respond_with_error(connection, status_from_framing(framing));
+    return NextRequest::Error;
+  }
+
+  ++m_stats.requests;
+  if (m_admission.is_enabled() && !admit(connection)) {
+    return NextRequest::Rejected;
+  }
+
+  http::Request& request = connection.request;
+  request.reset();
+  const auto result = request.parse(request_length);
+
+  if (result != http::RequestParserResult::Ok) {
+    respond_with_error(connection, status_from_parser(result));
+    return NextRequest::Error;
+  }
+  return NextRequest::Ready;
+}
+
+bool Server::admit(Connection& connection) noexcept {
+  // The loop's clock is as old as the batch, queue time is up to now
+  const u64 now = m_admission.needs_clock() ? get_steady_ns() : 0;
+
+  switch (m_admission.admit(now, connection.received_at, m_in_flight)) {
+    case Admission::Admitted:
+      return true;
+    case Admission::InFlightLimit:
+      ++m_stats.rejected_in_flight;
+      break;
+    case Admission::QueueTimeout:
+      ++m_stats.rejected_queue_time;
+      break;
+    case Admission::CoDel:
+      ++m_stats.rejected_codel;
+      break;
+  }
+
+  connection.output.append_borrowed(m_rejection.slice());
+  return false;
+}
+
+void Server::consume(Connection& connection, u64 request_length) noexcept {
+  // Pipelined requests move to the front of the buffer
+  String& in = connection.in;
+  const u64 remaining = in.get_length() - request_length;
+  if (remaining != 0) {
+    ::memmove(in.get_buffer_ptr(), in.get_buffer_ptr() + request_length, remaining);
+  }
+  in.set_length(remaining);
+
+  // The next request's deadlines start over
+  connection.deadline = Deadline::None;
+  connection.awaiting_body = false;
+  connection.has_served = true;
+}
+
+void Server::finish_response(Connection& connection) noexcept {
+  connection.response.serialize(connection.output, connection.version, connection.keep_alive,
+                                connection.include_body);
+  if (!connection.keep_alive) {
+    connection.close_after_write = true;
+  }
+}
+
+void Server::respond_with_error(Connection& connection, http::Status status) noexcept {
+  http::Response& response = connection.response;
+  response.reset();
+  response.set_status(status);
+  response.set_content_type(StringSlice::from_cstr("text/plain"));
+  response.set_body(http::status_to_string(status));
+  response.serialize(connection.output, http::Version::Http1_1, false, true);
+
+  connection.close_after_write = true;
+  connection.in.set_length(0);
+}
+
+bool Server::flush(Connection& connection) noexcept {
+  BufferChain& output = connection.output;
+
+  while (true) {
+    const u64 length = output.get_length();
+    if (length == 0) {
+      break;
+    }
+
+    ssize_t count;
+    int file_fd;
+    u64 file_offset;
+    u64 file_length;
+    if (output.get_front_file(file_fd, file_offset, file_length)) {
+      // Page cache to socket, the bytes never come up here
+      auto offset = static_cast<off_t>(file_offset);
+      count = ::sendfile(connection.fd, file_fd, &offset, std::min(file_length, MAX_SENDFILE_SIZE));
+      if (count == 0) {
+        // The file shrank under us, the response can't be finished
+        return false;
+      }
+    } else {
+      iovec vectors[BufferChain::MAX_IOVECS];
+      msghdr message{};
+      message.msg_iov = vectors;
+      message.msg_iovlen = output.fill_iovecs(vectors, BufferChain::MAX_IOVECS);
+
+      // With a file (or more iovecs) behind, let the head share a packet with it
+      u64 sending = 0;
+      for (u64 i = 0; i < message.msg_iovlen; ++i) {
+        sending += vectors[i].iov_len;
+      }
+      count = ::sendmsg(connection.fd, &message,
+                        MSG_NOSIGNAL | (sending < length ? MSG_MORE : 0));
+    }
+
+    if (count > 0) {
+      output.consume(static_cast<u64>(count));
+      continue;
+    }
+
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+
+    // EAGAIN: EPOLLOUT fires once the socket drains
+    return count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+  }
+
+  return !connection.close_after_write;
+}
+
+u64 Server::get_pending_output(const Connection& connection) const noexcept {
+  return connection.output.get_length() + connection.pipe_pending;
+}
+
+void Server::stream_open(Connection& connection) noexcept {
+  if (connection.stream == nullptr) {
+    connection.stream.reset(new Stream{*this, connection});
+  }
+  connection.stream->reset();
+
+  {
+    FramePool::Scope scope{&connection.frames};
+    connection.task = m_stream_handler(*connection.stream);
+  }
+
+  // The task starts suspended, run it up to its first wait
+  connection.stream->wait(Stream::Wait::None, connection.task.get_handle());
+  stream_resume(connection);
+}
+
+void Server::stream_on_event(Connection& connection, u32 events) noexcept {
+  if (events & EPOLLERR) {
+    close(connection);
+    return;
+  }
+
+  if (!flush(connection)) {
+    if (connection.task.is_done()) {
+      close(connection);
+      return;
+    }
+    connection.stream->m_broken = true;
+  }
+
+  // A finished task only waits for its output to drain
+  if (!connection.task.is_done()) {
+    stream_poll(connection);
+  }
+}
+
+void Server::stream_poll(Connection& connection) noexcept {
+  Stream& stream = *connection.stream;
+
+  bool ready = false;
+  switch (stream.m_wait) {
+    case Stream::Wait::Read:
+      ready = stream.try_read_request();
+      break;
+    case Stream::Wait::Write:
+      ready = stream.m_broken || get_pending_output(connection) <= Stream::WRITE_HIGH_WATERMARK;
+      break;
+    default:
+      break;
+  }
+
+  if (ready) {
+    stream_resume(connection);
+  }
+}
+
+void Server::stream_resume(Connection& connection) noexcept {
+  Stream& stream = *connection.stream;
+  const std::coroutine_handle<> waiter = std::exchange(stream.m_waiter, nullptr);
+  stream.m_wait = Stream::Wait::None;
+  CELL_ASSERT(waiter);
+
+  {
+    // Frames of coroutines the handler calls from here on come from the connection
+    FramePool::Scope scope{&connection.frames};
+    waiter.resume();
+  }
+
+  if (!connection.task.is_done()) {
+    return;
+  }
+
+  connection.close_after_write = true;
+#ifdef CELL_HAVE_IO_URING
+  if (m_backend == Backend::IoUring) {
+    uring_flush(connection);
+    return;
+  }
+#endif
+  if (!flush(connection)) {
+    close(connection);
+  }
+}
+
+bool Server::stream_receive(Connection& connection) noexcept {
+#ifdef CELL_HAVE_IO_URING
+  if (m_backend == Backend::IoUring) {
+    return true;
+  }
+#endif
+  return read_some(connection) != ReadResult::Closed;
+}
+
+void Server::stream_send(Connection& connection) noexcept {
+#ifdef CELL_HAVE_IO_URING
+  if (m_backend == Backend::IoUring) {
+    uring_flush(connection);
+    if (connection.closing) {
+      connection.stream->m_broken = true;
+    }
+    return;
+  }
+#endif
+  // Errors only, the connection isn't closed under the running coroutine
+  if (!flush(connection)) {
+    connection.stream->m_broken = true;
+  }
+}
+
+void Server::add_timer(Connection& connection,
+                       std::chrono::steady_clock::time_point deadline) noexcept {
+  m_timers.push({deadline, connection.fd, connection.generation});
+
+#ifdef CELL_HAVE_IO_URING
+  if (m_backend == Backend::IoUring) {
+    uring_arm_timer();
+  }
+#endif
+}
+
+std::chrono::steady_clock::time_point Server::get_next_deadline() const noexcept {
+  auto deadline = std::chrono::steady_clock::time_point::max();
+  if (!m_timers.empty()) {
+    deadline = m_timers.top().deadline;
+  }
+
+  const u64 tick = m_timeouts.get_next_expiry();
+  if (tick != UINT64_MAX) {
+    const std::chrono::steady_clock::time_point timeout{
+        std::chrono::nanoseconds{tick * TIMEOUT_TICK_NS}};
+    deadline = std::min(deadline, timeout);
+  }
+  return deadline;
+}
+
+int Server::get_timer_timeout() const noexcept {
+  const auto deadline = get_next_deadline();
+  if (deadline == std::chrono::steady_clock::time_point::max()) {
+    return -1;
+  }
+
+  const auto remaining = deadline - std::chrono::steady_clock::now();
+  if (remaining <= std::chrono::steady_clock::duration::zero()) {
+    return 0;
+  }
+  const auto milliseconds = std::chrono::ceil<std::chrono::milliseconds>(remaining).count();
+  return static_cast<int>(std::min<i64>(milliseconds, INT_MAX));
+}
+
+void Server::run_timers() noexcept {
+  const auto now = std::chrono::steady_clock::now();
+
+  while (!m_timers.empty() && m_timers.top().deadline <= now) {
+    const Timer timer = m_timers.top();
+    m_timers.pop();
+
+    const auto fd = static_cast<u64>(timer.fd);
+    Connection* connection = fd < m_connections.size() ? m_connections[fd].get() : nullptr;
+    if (connection != nullptr && connection->generation == timer.generation &&
+        connection->stream != nullptr && connection->stream->m_wait == Stream::Wait::Sleep) {
+      stream_resume(*connection);
+    }
+  }
+
+  // Closed connections were disarmed, whatever expires is still open
+  m_timeouts.advance(m_now_tick, [this](TimerNode& node) {
+    CELL_ASSERT(node.data < m_connections.size() && m_connections[node.data] != nullptr);
+    on_timeout(*m_connections[node.data]);
+  });
+}
+
+void Server::update_clock() noexcept {
+  m_now = get_steady_ns();
+  m_now_tick = m_now / TIMEOUT_TICK_NS;
+}
+
+void Server::update_deadline(Connection& connection) noexcept {
+  if (m_stream_handler != nullptr || connection.closing) {
+    return;
+  }
+
+  // While suspended the wait is ours, not the peer's
+  Deadline deadline = Deadline::None;
+  if (connection.suspended) {
+    deadline = Deadline::None;
+  } else if (connection.in.get_length() != 0) {
+    deadline = connection.awaiting_body ? Deadline::Body : Deadline::Headers;
+  } else if (get_pending_output(connection) != 0) {
+    deadline = Deadline::Send;
+  } else {
+    deadline = connection.has_served ? Deadline::Idle : Deadline::Headers;
+  }
+
+  // Trickling bytes in doesn't push a deadline back, taking them out does
+  if (deadline == connection.deadline && deadline != Deadline::Send) {
+    return;
+  }
+  connection.deadline = deadline;
+
+  u32 timeout_ms = 0;
+  switch (deadline) {
+    case Deadline::Idle:
+    case Deadline::Send:
+      timeout_ms = m_config.idle_timeout_ms;
+      break;
+    case Deadline::Headers:
+      timeout_ms = m_config.header_timeout_ms;
+      break;
+    case Deadline::Body:
+      timeout_ms = m_config.body_timeout_ms;
+      break;
+    case Deadline::None:
+      break;
+  }
+
+  if (timeout_ms == 0) {
+    m_timeouts.disarm(connection.timeout);
+    return;
+  }
+
+  // A tick more, so it never fires early
+  const u64 ticks = (timeout_ms * 1'000'000ULL + TIMEOUT_TICK_NS - 1) / TIMEOUT_TICK_NS;
+  m_timeouts.arm(connection.timeout, m_now_tick + ticks + 1);
+
+#ifdef CELL_HAVE_IO_URING
+  if (m_backend == Backend::IoUring) {
+    uring_arm_timer();
+  }
+#endif
+}
+
+void Server::pause_reads(Connection& connection) noexcept {
+  if (connection.read_paused) {
+    return;
+  }
+  connection.read_paused = true;
+  ++m_stats.read_pauses;
+  m_paused_reads.push_back({connection.fd, connection.generation});
+
+#ifdef CELL_HAVE_IO_URING
+  if (m_backend == Backend::IoUring) {
+    uring_cancel_recv(connection);
+  }
+#endif
+}
+
+void Server::resume_reads() noexcept {
+  // Those that pause again go to the back and wait for the next round
+  for (u64 count = m_paused_reads.size();
+       count != 0 && m_buffers.has_room(BufferPool::CLASS_SIZES[0]); --count) {
+    const PausedRead paused = m_paused_reads.front();
+    m_paused_reads.pop_front();
+
+    const auto fd = static_cast<u64>(paused.fd);
+    Connection* connection = fd < m_connections.size() ? m_connections[fd].get() : nullptr;
+    if (connection == nullptr || connection->generation != paused.generation ||
+        !connection->read_paused) {
+      continue;
+    }
+    connection->read_paused = false;
+
+#ifdef CELL_HAVE_IO_URING
+    if (m_backend == Backend::IoUring) {
+      // Otherwise the cancellation is still on its way, and re-arms
+      if (!connection->recv_armed && !connection->closing) {
+        uring_arm_recv(*connection);
+      }
+      continue;
+    }
+#endif
+    // Edge-triggered: what the socket held when reads paused raises no new event
+    on_event(*connection, EPOLLIN);
+  }
+}
+
+void Server::release_buffers(Connection& connection) noexcept {
+  // A stream keeps slices of `in` across its waits
+  if (m_stream_handler != nullptr) {
+    return;
+  }
+
+  if (connection.in.get_length() == 0) {
+    m_buffers.release(connection.in);
+  }
+  if (get_pending_output(connection) == 0 && !connection.send_in_flight) {
+    connection.output.shrink();
+  }
+}
+
+void Server::on_timeout(Connection& connection) noexcept {
+  CELL_LOG_DEBUG("server: connection %d timed out (deadline %d)", connection.fd,
+                 static_cast<int>(connection.deadline));
+  ++m_stats.timeouts;
+  connection.deadline = Deadline::None;
+
+#ifdef CELL_HAVE_IO_URING
+  if (m_backend == Backend::IoUring) {
+    uring_close(connection);
+    return;
+  }
+#endif
+  close(connection);
+}
+
+}  // namespace cell::net
@@ -0,0 +1,362 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_SERVER_HPP
+#define CELL_SERVER_HPP
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "admission.hpp"
+#include "cell/core/buffer_chain.hpp"
+#include "cell/core/buffer_pool.hpp"
+#include "cell/core/frame_pool.hpp"
+#include "cell/core/string.hpp"
+#include "cell/core/task.hpp"
+#include "cell/core/timing_wheel.hpp"
+#include "cell/core/types.hpp"
+#include "cell/http/request.hpp"
+#include "cell/http/response.hpp"
+
+namespace cell::net {
+
+enum class Backend {
+  Epoll,
+  IoUring,  // falls back to Epoll when io_uring is missing or refused
+};
+
+struct ServerConfig {
+  const char* host{"0.0.0.0"};
+  uint16_t port{8080};  // 0 picks a free port, see get_port()
+  int backlog{1024};
+  u64 max_request_size{1024 * 1024};  // headers and body
+  u32 max_events{256};                // per epoll_wait()
+  Backend backend{Backend::Epoll};
+  bool reuse_port{false};  // SO_REUSEPORT, see ReactorGroup
+
+  // Connections that take longer are closed; 0 turns one off. Not for
+  // StreamHandler connections, the coroutine keeps its own time.
+  u32 idle_timeout_ms{60'000};    // between requests, or stuck sending a response
+  u32 header_timeout_ms{10'000};  // from a request's first byte to its blank line
+  u32 body_timeout_ms{30'000};    // from the blank line to the body's last byte
+
+  // Read buffers of every connection together, 0 for no limit. Past it
+  // connections stop reading until others give buffers back (or time out),
+  // so keep it well above max_request_size. ReactorGroup splits it between
+  // its reactors.
+  u64 buffer_memory_limit{0};
+
+  AdmissionConfig admission{};
+};
+
+struct ServerStats {
+  u64 accepted{0};
+  u64 requests{0};
+  u64 active_connections{0};
+  u64 timeouts{0};     // connections closed by one of the timeouts above
+  u64 read_pauses{0};  // reads held off for buffer_memory_limit
+
+  // Requests refused by admission control, by reason
+  u64 rejected_in_flight{0};
+  u64 rejected_queue_time{0};
+  u64 rejected_codel{0};
+};
+
+using Handler = std::function<void(http::Request& request, http::Response& response)>;
+
+class Stream;
+
+// Runs once per connection and owns it until the returned task finishes,
+// see Stream
+using StreamHandler = std::function<Task<void>(Stream& stream)>;
+
+struct ServerMailbox;
+
+// A response a handler left unfinished with Server::suspend(). Copyable, but
+// resume it once.
+class DeferredResponse {
+ public:
+  DeferredResponse() noexcept = default;
+
+  [[nodiscard]] bool is_valid() const noexcept { return m_mailbox != nullptr; }
+
+  // Safe to call from any thread. `fill` runs on the connection's reactor
+  // thread, with the response as the handler left it, and the response is
+  // sent right after. Dropped when the connection or the server is gone.
+  void resume(std::function<void(http::Response& response)> fill) noexcept;
+
+ private:
+  friend class Server;
+
+  DeferredResponse(std::shared_ptr<ServerMailbox> mailbox, int fd, u32 generation) noexcept
+      : m_mailbox(std::move(mailbox)), m_fd(fd), m_generation(generation) {}
+
+  std::shared_ptr<ServerMailbox> m_mailbox{};
+  int m_fd{-1};
+  u32 m_generation{0};
+};
+
+// Single-threaded HTTP/1.1 server on an edge-triggered epoll loop, or on an
+// io_uring completion loop when Backend::IoUring is asked for and available.
+// Connections borrow read buffers from a pool while bytes are in and keep
+// little more than a response head's worth of write buffers while idle.
+// Requests are framed from the read buffer (pipelining included) and
+// answered in order, and connections are kept alive unless the request or an
+// error says otherwise.
+// Both backends share the framing and handler path, so handlers can't tell
+// them apart. A StreamHandler takes the whole connection instead, as a
+// coroutine driven by the same loop.
+class Server {
+ public:
+  explicit Server(ServerConfig config, Handler handler) noexcept;
+  explicit Server(ServerConfig config, StreamHandler handler) noexcept;
+  Server(const Server&) = delete;
+  Server& operator=(const Server&) = delete;
+  ~Server();
+
+  // Binds the listening socket and sets up the backend. Call once before run().
+  [[nodiscard]] bool listen() noexcept;
+  [[nodiscard]] uint16_t get_port() const noexcept { return m_port; }
+
+  // The backend in use after listen(), which may differ from the configured one
+  [[nodiscard]] Backend get_backend() const noexcept { return m_backend; }
+
+  // Serves until stop() is called
+  void run() noexcept;
+
+  // Safe to call from any thread and from signal handlers
+  void stop() noexcept;
+
+  [[nodiscard]] const ServerStats& get_stats() const noexcept { return m_stats; }
+
+  // The server whose run() is on the calling thread, nullptr elsewhere
+  [[nodiscard]] static Server* get_current() noexcept;
+
+  // Only from inside the handler: the response isn't sent when the handler
+  // returns but once the returned DeferredResponse is resumed, typically by
+  // a TaskPool task doing the expensive part. Later pipelined requests on
+  // the connection wait for it. The request is gone by then, copy what the
+  // task needs out of it first.
+  [[nodiscard]] DeferredResponse suspend() noexcept;
+
+ private:
+  friend class Stream;
+
+  static constexpr u64 MIN_READ_SIZE = 4096;
+  static constexpr u64 MAX_FREE_CONNECTIONS = 1024;
+  // Per sendfile() or splice(), so one large file doesn't hog the loop
+  static constexpr u64 MAX_SENDFILE_SIZE = 1024 * 1024;
+  // Resolution of the connection timeouts
+  static constexpr u64 TIMEOUT_TICK_NS = 10'000'000;
+
+  // Paused: out of buffer memory, see pause_reads()
+  enum class ReadResult { WouldBlock, BufferFull, Paused, Closed };
+  // Which of the timeouts a connection is under
+  enum class Deadline : u8 { None, Idle, Headers, Body, Send };
+  // Rejected: refused by admission control, answered and left unparsed
+  enum class NextRequest { Incomplete, Ready, Rejected, Error };
+
+  struct Connection {
+    explicit Connection(int fd) noexcept;
+    ~Connection();
+
+    int fd;
+    String in{};  // from m_buffers while it has bytes, see release_buffers()
+    // When bytes last came into `in`, where admission control's queue time
+    // starts: a slow sender doesn't count against the server
+    u64 received_at{0};
+    // Responses in order, bodies moved in rather than copied; goes out
+    // with one sendmsg() per MAX_IOVECS segments
+    BufferChain output{};
+    http::Request request{&in};
+    http::Response response{};
+    bool close_after_write{false};
+
+    // How the current response goes out, kept for suspended responses
+    http::Version version{http::Version::Http1_1};
+    bool keep_alive{true};
+    bool include_body{true};
+    bool suspended{false};
+
+    // io_uring only: what the SENDMSG in flight reads, `output` is sealed meanwhile
+    std::array<iovec, BufferChain::MAX_IOVECS> send_vectors{};
+    msghdr send_message{};
+    u32 generation{0};
+    bool send_in_flight{false};
+    bool closing{false};
+
+    // io_uring only, which has no sendfile: file segments go file -> pipe ->
+    // socket with two linked SPLICEs. Bytes spliced in but not out yet are
+    // left in the pipe and go first.
+    int pipe_read{-1};
+    int pipe_write{-1};
+    u64 pipe_capacity{0};
+    u64 pipe_pending{0};
+
+    // In the reactor's timing wheel while a deadline applies. Headers, Body
+    // and Idle run from when they began, Send from the last progress.
+    TimerNode timeout{};
+    Deadline deadline{Deadline::None};
+    bool awaiting_body{false};  // the blank line is in, the body isn't
+    bool has_served{false};     // idle only counts between requests
+
+    // Waiting in m_paused_reads for buffer memory
+    bool read_paused{false};
+    // io_uring only: a recv is armed, or its cancellation hasn't completed
+    bool recv_armed{false};
+
+    // StreamHandler only. The pool outlives the task whose frames it holds.
+    FramePool frames{};
+    std::unique_ptr<Stream> stream{};
+    Task<void> task{};
+  };
+
+  struct Timer {
+    std::chrono::steady_clock::time_point deadline;
+    int fd;
+    u32 generation;
+
+    bool operator>(const Timer& other) const noexcept { return deadline > other.deadline; }
+  };
+
+  struct PausedRead {
+    int fd;
+    u32 generation;
+  };
+
+  [[nodiscard]] bool listen_epoll() noexcept;
+  void run_epoll() noexcept;
+  void accept_all() noexcept;
+  [[nodiscard]] Connection* open(int fd) noexcept;
+  [[nodiscard]] Connection* acquire(int fd) noexcept;
+  void release(Connection& connection) noexcept;
+  void on_event(Connection& connection, u32 events) noexcept;
+  [[nodiscard]] ReadResult read_some(Connection& connection) noexcept;
+  void process(Connection& connection) noexcept;
+  // Frames and parses the next request in `in`; a bad one is answered right
+  // away and ends the connection
+  [[nodiscard]] NextRequest next_request(Connection& connection, u64& request_length) noexcept;
+  // Admission control for the request framed at the front of `in`; false
+  // once it's been refused and answered
+  [[nodiscard]] bool admit(Connection& connection) noexcept;
+  // Drops a handled request from the front of `in`
+  void consume(Connection& connection, u64 request_length) noexcept;
+  void finish_response(Connection& connection) noexcept;
+  // Runs completions posted by DeferredResponse::resume()
+  void drain_mailbox() noexcept;
+  void resume(Connection& connection) noexcept;
+  void respond_with_error(Connection& connection, http::Status status) noexcept;
+  // false once the connection should be closed: on error, or when the last
+  // response went out and the connection isn't kept alive
+  [[nodiscard]] bool flush(Connection& connection) noexcept;
+  void close(Connection& connection) noexcept;
+  // Output not taken by the socket yet, on either backend
+  [[nodiscard]] u64 get_pending_output(const Connection& connection) const noexcept;
+
+  void stream_open(Connection& connection) noexcept;
+  void stream_on_event(Connection& connection, u32 events) noexcept;
+  // Resumes the stream's coroutine if what it waits for is there
+  void stream_poll(Connection& connection) noexcept;
+  // Resumes the stream's coroutine, and hangs up once its task is done
+  void stream_resume(Connection& connection) noexcept;
+  // Epoll reads what the socket has, false once the peer is gone; io_uring
+  // always has a recv armed and has nothing to do
+  [[nodiscard]] bool stream_receive(Connection& connection) noexcept;
+  void stream_send(Connection& connection) noexcept;
+
+  void add_timer(Connection& connection, std::chrono::steady_clock::time_point deadline) noexcept;
+  // The earliest Stream timer or connection timeout, time_point::max() without one
+  [[nodiscard]] std::chrono::steady_clock::time_point get_next_deadline() const noexcept;
+  // Milliseconds until the next deadline, -1 without one
+  [[nodiscard]] int get_timer_timeout() const noexcept;
+  // Stream timers and connection timeouts that are due
+  void run_timers() noexcept;
+
+  // Reads the clock for the timeouts, once per loop iteration
+  void update_clock() noexcept;
+  // Moves the connection's timeout to the deadline its state calls for
+  void update_deadline(Connection& connection) noexcept;
+  void on_timeout(Connection& connection) noexcept;
+
+  // Stops reading from the connection until resume_reads() finds buffer
+  // memory for it; io_uring cancels the recv
+  void pause_reads(Connection& connection) noexcept;
+  // Reads again on paused connections, in the order they paused, while
+  // there's room
+  void resume_reads() noexcept;
+  // Gives the read buffer back once it's empty, and the write buffers once
+  // everything is out
+  void release_buffers(Connection& connection) noexcept;
+
+#ifdef CELL_HAVE_IO_URING
+  struct UringState;
+  struct UringStateDeleter {
+    void operator()(UringState* state) const noexcept;
+  };
+
+  [[nodiscard]] bool listen_uring() noexcept;
+  void run_uring() noexcept;
+  void uring_on_completion(u64 user_data, int result, u32 flags) noexcept;
+  void uring_on_recv(Connection& connection, int result, u32 flags) noexcept;
+  void uring_on_send(Connection& connection, int result) noexcept;
+  void uring_on_splice_in(Connection& connection, int result) noexcept;
+  void uring_on_splice_out(Connection& connection, int result) noexcept;
+  // Splices what's in the pipe out, or the front file segment in and out;
+  // false without a pipe
+  [[nodiscard]] bool uring_splice(Connection& connection) noexcept;
+  void uring_arm_accept() noexcept;
+  void uring_arm_wake() noexcept;
+  void uring_arm_recv(Connection& connection) noexcept;
+  void uring_cancel_recv(Connection& connection) noexcept;
+  // Arms the timeout SQE for get_next_deadline(), unless one is armed for
+  // earlier already
+  void uring_arm_timer() noexcept;
+  // Sends pending output, or closes once it's all out and the connection
+  // isn't kept alive
+  void uring_flush(Connection& connection) noexcept;
+  void uring_close(Connection& connection) noexcept;
+#endif
+
+  ServerConfig m_config;
+  Handler m_handler{};
+  StreamHandler m_stream_handler{};
+  ServerStats m_stats{};
+  int m_listen_fd{-1};
+  int m_epoll_fd{-1};
+  int m_wake_fd{-1};
+  uint16_t m_port{0};
+  Backend m_backend{Backend::Epoll};
+  u32 m_next_generation{0};
+  std::atomic<bool> m_running{false};
+  std::shared_ptr<ServerMailbox> m_mailbox;
+  Connection* m_current{nullptr};  // the connection whose handler is running
+  std::vector<std::unique_ptr<Connection>> m_connections{};  // indexed by fd
+  std::vector<std::unique_ptr<Connection>> m_free_connections{};
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<>> m_timers{};
+  // Connection timeouts: far too many to keep in the heap, and nearly all
+  // are disarmed long before they expire
+  TimingWheel m_timeouts{};
+  u64 m_now_tick{0};
+  u64 m_now{0};  // nanoseconds, as of the last update_clock()
+  BufferPool m_buffers;
+  std::deque<PausedRead> m_paused_reads{};
+  AdmissionControl m_admission;
+  String m_rejection;  // the 503 refused requests get, rendered once
+  u64 m_in_flight{0};  // suspended responses
+#ifdef CELL_HAVE_IO_URING
+  std::unique_ptr<UringState, UringStateDeleter> m_uring{};
+#endif
+};
+
+}  // namespace cell::net
+
+#endif  // CELL_SERVER_HPP
@@ -0,0 +1,597 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+// io_uring backend of net::Server, only built with CELL_HAVE_IO_URING.
+//
+//   o Accept is a single multishot SQE on the listening socket.
+//   o Every connection has one multishot recv drawing from a provided buffer
+//     ring; data is copied into the connection's read buffer and the buffer
+//     goes straight back to the ring. Out of read buffer memory, the recv is
+//     cancelled until there's some again.
+//   o Output goes out with SENDMSG straight from the connection's buffer
+//     chain, sealed while the kernel reads it so handlers append behind.
+//     File segments go through a per-connection pipe with a SPLICE in
+//     linked to a SPLICE out, there's no sendfile opcode.
+//   o The last send of a connection that isn't kept alive is linked to a
+//     shutdown and a close, so hanging up costs no extra round trip.
+//   o Stream timers and connection timeouts share one absolute timeout SQE,
+//     armed for the earliest deadline; the loop runs whatever is due after
+//     every batch of completions.
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include "cell/core/assert.hpp"
+#include "cell/log/log.hpp"
+#include "server.hpp"
+#include "socket.hpp"
+#include "stream.hpp"
+#include "uring.hpp"
+
+namespace cell::net {
+
+namespace {
+
+constexpr u32 URING_ENTRIES = 1024;
+constexpr uint16_t URING_BUFFER_GROUP = 0;
+constexpr u32 URING_BUFFER_COUNT = 512;
+constexpr u32 URING_BUFFER_SIZE = 16 * 1024;
+constexpr u32 URING_GENERATION_MASK = 0xFFFFFF;
+
+enum class Op : u8 { Accept, Recv, Send, Shutdown, Close, Wake, Cancel, Timer, SpliceIn, SpliceOut };
+
+// op:8 | generation:24 | fd:32, stale completions of a recycled fd are told
+// apart by the generation
+constexpr u64 encode(Op op, u32 generation, int fd) noexcept {
+  return (static_cast<u64>(op) << 56) |
+         (static_cast<u64>(generation & URING_GENERATION_MASK) << 32) | static_cast<u32>(fd);
+}
+
+constexpr Op decode_op(u64 user_data) noexcept { return static_cast<Op>(user_data >> 56); }
+constexpr u32 decode_generation(u64 user_data) noexcept {
+  return static_cast<u32>(user_data >> 32) & URING_GENERATION_MASK;
+}
+constexpr int decode_fd(u64 user_data) noexcept { return static_cast<int>(user_data & 0xFFFFFFFF); }
+
+}  // namespace
+
+struct Server::UringState {
+  Uring ring{};
+  std::unique_ptr<u8[]> buffers{};
+  u64 wake_value{0};
+  u64 closes_in_flight{0};
+  // Read by the kernel when the timeout SQE is submitted
+  __kernel_timespec timer_deadline{};
+  std::chrono::steady_clock::time_point timer_armed_for{};
+  bool timer_armed{false};
+
+  // Submits first when fewer than `count` SQEs are left, links can't span a submit
+  void reserve(u32 count) noexcept {
+    if (ring.get_sq_space() < count) {
+      [[maybe_unused]] const bool submitted = ring.submit(0);
+    }
+  }
+};
+
+void Server::UringStateDeleter::operator()(UringState* state) const noexcept { delete state; }
+
+bool Server::listen_uring() noexcept {
+  std::unique_ptr<UringState, UringStateDeleter> state{new UringState{}};
+
+  if (!state->ring.init(URING_ENTRIES, IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN)) {
+    return false;
+  }
+
+  state->buffers = std::make_unique_for_overwrite<u8[]>(URING_BUFFER_COUNT * URING_BUFFER_SIZE);
+  if (!state->ring.register_buffer_ring(URING_BUFFER_GROUP, state->buffers.get(),
+                                        URING_BUFFER_COUNT, URING_BUFFER_SIZE)) {
+    return false;
+  }
+
+  m_uring = std::move(state);
+  return true;
+}
+
+void Server::run_uring() noexcept {
+  CELL_ASSERT(m_uring != nullptr);
+  Uring& ring = m_uring->ring;
+
+  uring_arm_accept();
+  uring_arm_wake();
+
+  while (m_running.load(std::memory_order_relaxed)) {
+    if (!ring.submit(1)) {
+      CELL_LOG_DEBUG("server: io_uring_enter failed (errno %d)", errno);
+      return;
+    }
+
+    update_clock();
+    ring.for_each_cqe([this](const io_uring_cqe& cqe) {
+      uring_on_completion(cqe.user_data, cqe.res, cqe.flags);
+    });
+
+    run_timers();
+    resume_reads();
+    if (m_running.load(std::memory_order_relaxed)) {
+      uring_arm_timer();
+    }
+  }
+
+  // A close refers to an fd number: one landing after the ring is gone would
+  // close whatever reuses the number. Cancel everything (a linked send may
+  // wait on the peer forever) and reap the closes before returning.
+  m_uring->reserve(1);
+  io_uring_sqe* sqe = ring.get_sqe();
+  CELL_ASSERT(sqe != nullptr);
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL | IORING_ASYNC_CANCEL_ANY;
+  sqe->user_data = encode(Op::Cancel, 0, 0);
+
+  while (m_uring->closes_in_flight != 0 && ring.submit(1)) {
+    ring.for_each_cqe([this](const io_uring_cqe& cqe) {
+      if (decode_op(cqe.user_data) == Op::Close) {
+        uring_on_completion(cqe.user_data, cqe.res, cqe.flags);
+      }
+    });
+  }
+}
+
+void Server::uring_on_completion(u64 user_data, int result, u32 flags) noexcept {
+  const Op op = decode_op(user_data);
+
+  if (op == Op::Accept) {
+    if (result >= 0) {
+      [[maybe_unused]] const bool nodelay = set_tcp_nodelay(result);
+      Connection* connection = acquire(result);
+      if (connection == nullptr) {
+        ::close(result);
+      } else {
+        uring_arm_recv(*connection);
+        if (m_stream_handler != nullptr) {
+          stream_open(*connection);
+        }
+      }
+    } else if (result != -ECONNABORTED && result != -EINTR) {
+      CELL_LOG_DEBUG("server: accept failed (errno %d)", -result);
+    }
+
+    if (!(flags & IORING_CQE_F_MORE) && m_running.load(std::memory_order_relaxed)) {
+      uring_arm_accept();
+    }
+    return;
+  }
+
+  if (op == Op::Timer) {
+    // -ETIME when it fired, the loop runs the timers and re-arms. One
+    // superseded by an earlier one only costs an extra wakeup.
+    m_uring->timer_armed = false;
+    return;
+  }
+
+  if (op == Op::Wake) {
+    drain_mailbox();
+    if (m_running.load(std::memory_order_relaxed)) {
+      uring_arm_wake();
+    }
+    return;
+  }
+
+  const int fd = decode_fd(user_data);
+  Connection* connection = static_cast<u64>(fd) < m_connections.size()
+                               ? m_connections[fd].get()
+                               : nullptr;
+  if (connection == nullptr ||
+      (connection->generation & URING_GENERATION_MASK) != decode_generation(user_data)) {
+    // Left over from a connection that is gone, only the buffer matters
+    if (flags & IORING_CQE_F_BUFFER) {
+      m_uring->ring.recycle_buffer(static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT));
+    }
+    return;
+  }
+
+  switch (op) {
+    case Op::Recv:
+      uring_on_recv(*connection, result, flags);
+      break;
+    case Op::Send:
+      uring_on_send(*connection, result);
+      break;
+    case Op::SpliceIn:
+      uring_on_splice_in(*connection, result);
+      break;
+    case Op::SpliceOut:
+      uring_on_splice_out(*connection, result);
+      break;
+    case Op::Close:
+      // The link was broken by a failed send or shutdown, close by hand
+      if (result == -ECANCELED) {
+        ::close(fd);
+      }
+      --m_uring->closes_in_flight;
+      release(*connection);
+      break;
+    default:
+      break;
+  }
+}
+
+void Server::uring_on_recv(Connection& connection, int result, u32 flags) noexcept {
+  if (flags & IORING_CQE_F_BUFFER) {
+    const auto id = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+
+    if (result > 0 && !connection.closing && !connection.close_after_write) {
+      String& in = connection.in;
+      const auto count = static_cast<u64>(result);
+      if (in.get_capacity() - in.get_length() <= count &&
+          !m_buffers.reserve(in, std::max(in.get_capacity() * 2, in.get_length() + count + 1))) {
+        // These bytes are in already and go over the limit, the next ones wait
+        [[maybe_unused]] const bool forced = m_buffers.reserve(in, in.get_length() + count + 1, true);
+        pause_reads(connection);
+      }
+      connection.received_at = m_now;
+      ::memcpy(in.get_buffer_ptr() + in.get_length(), m_uring->ring.get_buffer(id), count);
+      in.set_length(in.get_length() + count);
+    }
+
+    m_uring->ring.recycle_buffer(id);
+  }
+
+  const bool more = flags & IORING_CQE_F_MORE;
+  if (!more) {
+    connection.recv_armed = false;
+  }
+
+  if (connection.closing) {
+    return;
+  }
+
+  if (result == -ENOBUFS || result == -ECANCELED) {
+    // Every provided buffer is queued up, try again once some are back; or
+    // cancelled by pause_reads(), and resumed before it was through
+    if (!more && !connection.read_paused) {
+      uring_arm_recv(connection);
+    }
+    return;
+  }
+
+  if (m_stream_handler != nullptr) {
+    Stream& stream = *connection.stream;
+    if (result <= 0) {
+      stream.m_eof = true;
+    } else if (stream.m_wait != Stream::Wait::Read &&
+               connection.in.get_length() > m_config.max_request_size) {
+      // Same as behind a suspended response
+      uring_close(connection);
+      return;
+    } else if (!more && !connection.close_after_write && !connection.read_paused) {
+      uring_arm_recv(connection);
+    }
+
+    if (!connection.task.is_done()) {
+      stream_poll(connection);
+    }
+    return;
+  }
+
+  if (result <= 0) {
+    // Answer what the peer sent before it went away, then hang up
+    connection.close_after_write = true;
+    uring_flush(connection);
+    return;
+  }
+
+  // process() doesn't touch `in` once the connection is to be closed, and
+  // frame_request() refuses requests over max_request_size, so `in` stays
+  // bounded without pausing the recv. Except behind a suspended response,
+  // where a peer queueing that much gets hung up on.
+  if (connection.suspended && connection.in.get_length() > m_config.max_request_size) {
+    uring_close(connection);
+    return;
+  }
+
+  process(connection);
+  uring_flush(connection);
+  release_buffers(connection);
+  update_deadline(connection);
+
+  if (!more && !connection.close_after_write && !connection.read_paused) {
+    uring_arm_recv(connection);
+  }
+}
+
+void Server::uring_on_send(Connection& connection, int result) noexcept {
+  connection.send_in_flight = false;
+
+  // Sends linked to the close are done with, the close CQE follows
+  if (connection.closing) {
+    return;
+  }
+
+  if (result <= 0) {
+    uring_close(connection);
+    return;
+  }
+
+  connection.output.consume(static_cast<u64>(result));
+  connection.output.unseal();
+  uring_flush(connection);
+  release_buffers(connection);
+  update_deadline(connection);
+
+  if (m_stream_handler != nullptr && !connection.closing && !connection.task.is_done()) {
+    stream_poll(connection);
+  }
+}
+
+void Server::uring_on_splice_in(Connection& connection, int result) noexcept {
+  // The SPLICE out linked to it completes next and flushes on
+  if (connection.closing) {
+    return;
+  }
+
+  if (result <= 0) {
+    // Unreadable, or shrunk under us: the response can't be finished
+    uring_close(connection);
+    return;
+  }
+
+  connection.output.consume(static_cast<u64>(result));
+  connection.pipe_pending += static_cast<u64>(result);
+}
+
+void Server::uring_on_splice_out(Connection& connection, int result) noexcept {
+  connection.send_in_flight = false;
+
+  if (connection.closing) {
+    return;
+  }
+
+  // Cancelled when the SPLICE in came up short, whatever it did move is
+  // spliced out next
+  if (result != -ECANCELED) {
+    if (result <= 0) {
+      uring_close(connection);
+      return;
+    }
+    connection.pipe_pending -= static_cast<u64>(result);
+  }
+
+  uring_flush(connection);
+  release_buffers(connection);
+  update_deadline(connection);
+
+  if (m_stream_handler != nullptr && !connection.closing && !connection.task.is_done()) {
+    stream_poll(connection);
+  }
+}
+
+bool Server::uring_splice(Connection& connection) noexcept {
+  int file_fd = -1;
+  u64 file_offset = 0;
+  u64 file_length = 0;
+  if (connection.pipe_pending == 0 &&
+      !connection.output.get_front_file(file_fd, file_offset, file_length)) {
+    return false;
+  }
+
+  if (connection.pipe_read == -1) {
+    int fds[2];
+    if (::pipe2(fds, O_CLOEXEC) != 0) {
+      CELL_LOG_DEBUG("server: pipe2 failed (errno %d)", errno);
+      uring_close(connection);
+      return true;
+    }
+    connection.pipe_read = fds[0];
+    connection.pipe_write = fds[1];
+
+    // Larger than the default 64K when allowed, fewer round trips per file
+    const int capacity = ::fcntl(fds[1], F_SETPIPE_SZ, static_cast<int>(MAX_SENDFILE_SIZE));
+    connection.pipe_capacity = static_cast<u64>(capacity > 0 ? capacity
+                                                              : ::fcntl(fds[1], F_GETPIPE_SZ));
+  }
+
+  UringState& state = *m_uring;
+  state.reserve(2);
+  io_uring_sqe* sqe = nullptr;
+
+  u64 length = connection.pipe_pending;
+  if (length == 0) {
+    length = std::min(file_length, connection.pipe_capacity);
+
+    sqe = state.ring.get_sqe();
+    CELL_ASSERT(sqe != nullptr);
+    sqe->opcode = IORING_OP_SPLICE;
+    sqe->splice_fd_in = file_fd;
+    sqe->splice_off_in = file_offset;
+    sqe->fd = connection.pipe_write;
+    sqe->off = static_cast<u64>(-1);
+    sqe->len = static_cast<u32>(length);
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = encode(Op::SpliceIn, connection.generation, connection.fd);
+  }
+
+  sqe = state.ring.get_sqe();
+  CELL_ASSERT(sqe != nullptr);
+  sqe->opcode = IORING_OP_SPLICE;
+  sqe->splice_fd_in = connection.pipe_read;
+  sqe->splice_off_in = static_cast<u64>(-1);
+  sqe->fd = connection.fd;
+  sqe->off = static_cast<u64>(-1);
+  sqe->len = static_cast<u32>(length);
+  sqe->user_data = encode(Op::SpliceOut, connection.generation, connection.fd);
+  connection.send_in_flight = true;
+  return true;
+}
+
+void Server::uring_flush(Connection& connection) noexcept {
+  if (connection.send_in_flight || connection.closing) {
+    return;
+  }
+
+  BufferChain& output = connection.output;
+  const u64 length = output.get_length();
+  if (length == 0 && connection.pipe_pending == 0) {
+    if (connection.close_after_write && !connection.suspended) {
+      uring_close(connection);
+    }
+    return;
+  }
+
+  if (uring_splice(connection)) {
+    return;
+  }
+
+  const u32 count = output.fill_iovecs(connection.send_vectors.data(), BufferChain::MAX_IOVECS);
+  u64 sending = 0;
+  for (u32 i = 0; i < count; ++i) {
+    sending += connection.send_vectors[i].iov_len;
+  }
+  connection.send_message = {};
+  connection.send_message.msg_iov = connection.send_vectors.data();
+  connection.send_message.msg_iovlen = count;
+  output.seal();
+
+  UringState& state = *m_uring;
+  state.reserve(3);
+
+  io_uring_sqe* sqe = state.ring.get_sqe();
+  CELL_ASSERT(sqe != nullptr);
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = connection.fd;
+  sqe->addr = reinterpret_cast<u64>(&connection.send_message);
+  sqe->len = 1;
+  // With a file (or more iovecs) behind, let the head share a packet with it
+  sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL | (sending < length ? MSG_MORE : 0);
+  sqe->user_data = encode(Op::Send, connection.generation, connection.fd);
+  connection.send_in_flight = true;
+
+  if (connection.close_after_write && !connection.suspended && sending == length) {
+    sqe->flags |= IOSQE_IO_LINK;
+    uring_close(connection);
+  }
+}
+
+void Server::uring_close(Connection& connection) noexcept {
+  if (connection.closing) {
+    return;
+  }
+  connection.closing = true;
+  m_timeouts.disarm(connection.timeout);
+
+  UringState& state = *m_uring;
+  state.reserve(2);
+  ++state.closes_in_flight;
+
+  // The shutdown also ends the multishot recv, which would keep the socket
+  // alive past the close
+  io_uring_sqe* sqe = state.ring.get_sqe();
+  CELL_ASSERT(sqe != nullptr);
+  sqe->opcode = IORING_OP_SHUTDOWN;
+  sqe->fd = connection.fd;
+  sqe->len = SHUT_RDWR;
+  sqe->flags = IOSQE_IO_HARDLINK;
+  sqe->user_data = encode(Op::Shutdown, connection.generation, connection.fd);
+
+  sqe = state.ring.get_sqe();
+  CELL_ASSERT(sqe != nullptr);
+  sqe->opcode = IORING_OP_CLOSE;
+  sqe->fd = connection.fd;
+  sqe->user_data = encode(Op::Close, connection.generation, connection.fd);
+}
+
+void Server::uring_arm_accept() noexcept {
+  UringState& state = *m_uring;
+  state.reserve(1);
+
+  io_uring_sqe* sqe = state.ring.get_sqe();
+  CELL_ASSERT(sqe != nullptr);
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = m_listen_fd;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->accept_flags = SOCK_CLOEXEC;
+  sqe->user_data = encode(Op::Accept, 0, m_listen_fd);
+}
+
+void Server::uring_arm_wake() noexcept {
+  UringState& state = *m_uring;
+  state.reserve(1);
+
+  io_uring_sqe* sqe = state.ring.get_sqe();
+  CELL_ASSERT(sqe != nullptr);
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = m_wake_fd;
+  sqe->addr = reinterpret_cast<u64>(&state.wake_value);
+  sqe->len = sizeof(state.wake_value);
+  sqe->user_data = encode(Op::Wake, 0, m_wake_fd);
+}
+
+void Server::uring_arm_timer() noexcept {
+  UringState& state = *m_uring;
+  const auto next = get_next_deadline();
+  if (next == std::chrono::steady_clock::time_point::max() ||
+      (state.timer_armed && state.timer_armed_for <= next)) {
+    return;
+  }
+  state.reserve(1);
+
+  // steady_clock is CLOCK_MONOTONIC, what IORING_TIMEOUT_ABS counts in
+  const auto deadline = next.time_since_epoch();
+  const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(deadline);
+  state.timer_deadline.tv_sec = seconds.count();
+  state.timer_deadline.tv_nsec =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - seconds).count();
+  state.timer_armed = true;
+  state.timer_armed_for = next;
+
+  io_uring_sqe* sqe = state.ring.get_sqe();
+  CELL_ASSERT(sqe != nullptr);
+  sqe->opcode = IORING_OP_TIMEOUT;
+  sqe->fd = -1;
+  sqe->addr = reinterpret_cast<u64>(&state.timer_deadline);
+  sqe->len = 1;
+  sqe->timeout_flags = IORING_TIMEOUT_ABS;
+  sqe->user_data = encode(Op::Timer, 0, 0);
+}
+
+void Server::uring_arm_recv(Connection& connection) noexcept {
+  UringState& state = *m_uring;
+  state.reserve(1);
+
+  io_uring_sqe* sqe = state.ring.get_sqe();
+  CELL_ASSERT(sqe != nullptr);
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = connection.fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = URING_BUFFER_GROUP;
+  sqe->user_data = encode(Op::Recv, connection.generation, connection.fd);
+  connection.recv_armed = true;
+}
+
+void Server::uring_cancel_recv(Connection& connection) noexcept {
+  if (!connection.recv_armed || connection.closing) {
+    return;
+  }
+
+  UringState& state = *m_uring;
+  state.reserve(1);
+
+  // The recv completes with -ECANCELED, after whatever it still had
+  io_uring_sqe* sqe = state.ring.get_sqe();
+  CELL_ASSERT(sqe != nullptr);
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = encode(Op::Recv, connection.generation, connection.fd);
+  sqe->user_data = encode(Op::Cancel, 0, 0);
+}
+
+}  // namespace cell::net
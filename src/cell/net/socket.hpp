@@ -0,0 +1,28 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_SOCKET_HPP
+#define CELL_SOCKET_HPP
+
+#include <cstdint>
+
+#include "cell/core/types.hpp"
+
+namespace cell::net {
+
+// Non-blocking IPv4 TCP listening socket with SO_REUSEADDR set, and
+// SO_REUSEPORT when `reuse_port` is true so several sockets can share the
+// port with the kernel balancing connections between them. Returns the fd,
+// or -1 with errno set.
+[[nodiscard]] int create_listen_socket(const char* host, uint16_t port, int backlog,
+                                       bool reuse_port = false) noexcept;
+
+// Port a socket is bound to, useful after binding port 0
+[[nodiscard]] uint16_t get_local_port(int fd) noexcept;
+
+[[nodiscard]] bool set_nonblocking(int fd) noexcept;
+[[nodiscard]] bool set_tcp_nodelay(int fd) noexcept;
+
+}  // namespace cell::net
+
+#endif  // CELL_SOCKET_HPP
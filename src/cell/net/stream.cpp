@@ -0,0 +1,72 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stream.hpp"
+
+namespace cell::net {
+
+void Stream::reset() noexcept {
+  m_wait = Wait::None;
+  m_waiter = nullptr;
+  m_request = nullptr;
+  m_consumed = 0;
+  m_eof = false;
+  m_input_closed = false;
+  m_broken = false;
+}
+
+bool Stream::try_read_request() noexcept {
+  Server::Connection& connection = m_connection;
+
+  // The previous request is done with once the handler asks for the next one
+  if (m_consumed != 0) {
+    m_server.consume(connection, m_consumed);
+    m_consumed = 0;
+  }
+
+  m_request = nullptr;
+  while (!m_input_closed) {
+    u64 request_length = 0;
+    switch (m_server.next_request(connection, request_length)) {
+      case Server::NextRequest::Ready:
+        m_consumed = request_length;
+        m_request = &connection.request;
+        return true;
+      case Server::NextRequest::Rejected:
+        // Answered already, the handler never sees it
+        m_server.consume(connection, request_length);
+        m_server.stream_send(connection);
+        continue;
+      case Server::NextRequest::Error:
+        m_input_closed = true;
+        m_server.stream_send(connection);
+        return true;
+      case Server::NextRequest::Incomplete:
+        break;
+    }
+
+    if (m_eof) {
+      return true;
+    }
+
+    const u64 length = connection.in.get_length();
+    if (!m_server.stream_receive(connection)) {
+      m_eof = true;
+    } else if (connection.in.get_length() == length) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Stream::try_write(StringSlice data) noexcept {
+  if (m_broken) {
+    return true;
+  }
+
+  m_connection.output.append(data);
+  m_server.stream_send(m_connection);
+  return m_broken || m_server.get_pending_output(m_connection) <= WRITE_HIGH_WATERMARK;
+}
+
+}  // namespace cell::net
@@ -0,0 +1,133 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_STREAM_HPP
+#define CELL_STREAM_HPP
+
+#include <chrono>
+#include <coroutine>
+
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+#include "cell/http/request.hpp"
+#include "cell/net/server.hpp"
+
+namespace cell::net {
+
+// One connection as seen from a StreamHandler coroutine. Every operation is
+// an awaitable that completes on the server's reactor thread, so a handler
+// reads like blocking code without a thread of its own:
+//
+//   Task<void> serve(Stream& stream) {
+//     while (http::Request* request = co_await stream.read_request()) {
+//       co_await stream.write(head);
+//       co_await stream.sleep_for(std::chrono::milliseconds(10));
+//       co_await stream.write(tail);
+//     }
+//   }
+//
+// The connection is closed once the handler's task finishes and its output
+// is out. A connection dropped by the peer destroys the task wherever it is
+// suspended. Only one operation may be pending at a time.
+class Stream {
+ public:
+  // write() completes right away while less than this is waiting to go out,
+  // otherwise once the socket has taken enough of it
+  static constexpr u64 WRITE_HIGH_WATERMARK = 64 * 1024;
+
+  Stream(const Stream&) = delete;
+  Stream& operator=(const Stream&) = delete;
+
+  class ReadRequestAwaiter {
+   public:
+    bool await_ready() noexcept { return m_stream.try_read_request(); }
+    void await_suspend(std::coroutine_handle<> waiter) noexcept {
+      m_stream.wait(Wait::Read, waiter);
+    }
+    // The next request, or nullptr once the peer is done or sent garbage
+    // (which is answered with an error and ends the connection). Valid
+    // until the next read_request().
+    [[nodiscard]] http::Request* await_resume() const noexcept { return m_stream.m_request; }
+
+   private:
+    friend class Stream;
+    explicit ReadRequestAwaiter(Stream& stream) noexcept : m_stream(stream) {}
+    Stream& m_stream;
+  };
+
+  class WriteAwaiter {
+   public:
+    bool await_ready() noexcept { return m_stream.try_write(m_data); }
+    void await_suspend(std::coroutine_handle<> waiter) noexcept {
+      m_stream.wait(Wait::Write, waiter);
+    }
+    // false once the connection is broken, later writes are dropped
+    [[nodiscard]] bool await_resume() const noexcept { return !m_stream.m_broken; }
+
+   private:
+    friend class Stream;
+    WriteAwaiter(Stream& stream, StringSlice data) noexcept : m_stream(stream), m_data(data) {}
+    Stream& m_stream;
+    StringSlice m_data;
+  };
+
+  class SleepAwaiter {
+   public:
+    bool await_ready() const noexcept { return m_duration.count() <= 0; }
+    void await_suspend(std::coroutine_handle<> waiter) noexcept {
+      m_stream.wait(Wait::Sleep, waiter);
+      m_stream.m_server.add_timer(m_stream.m_connection,
+                                  std::chrono::steady_clock::now() + m_duration);
+    }
+    void await_resume() const noexcept {}
+
+   private:
+    friend class Stream;
+    SleepAwaiter(Stream& stream, std::chrono::milliseconds duration) noexcept
+        : m_stream(stream), m_duration(duration) {}
+    Stream& m_stream;
+    std::chrono::milliseconds m_duration;
+  };
+
+  [[nodiscard]] ReadRequestAwaiter read_request() noexcept { return ReadRequestAwaiter{*this}; }
+
+  // `data` is copied into the connection's write buffer before this returns
+  [[nodiscard]] WriteAwaiter write(StringSlice data) noexcept { return WriteAwaiter{*this, data}; }
+
+  [[nodiscard]] SleepAwaiter sleep_for(std::chrono::milliseconds duration) noexcept {
+    return SleepAwaiter{*this, duration};
+  }
+
+  [[nodiscard]] Server& get_server() const noexcept { return m_server; }
+
+ private:
+  friend class Server;
+
+  enum class Wait { None, Read, Write, Sleep };
+
+  Stream(Server& server, Server::Connection& connection) noexcept
+      : m_server(server), m_connection(connection) {}
+
+  void reset() noexcept;
+  [[nodiscard]] bool try_read_request() noexcept;
+  [[nodiscard]] bool try_write(StringSlice data) noexcept;
+  void wait(Wait what, std::coroutine_handle<> waiter) noexcept {
+    m_wait = what;
+    m_waiter = waiter;
+  }
+
+  Server& m_server;
+  Server::Connection& m_connection;
+
+  Wait m_wait{Wait::None};
+  std::coroutine_handle<> m_waiter{};
+  http::Request* m_request{nullptr};
+  u64 m_consumed{0};  // length of the request handed out last
+  bool m_eof{false};
+  bool m_input_closed{false};  // after a bad request
+  bool m_broken{false};
+};
+
+}  // namespace cell::net
+
+#endif  // CELL_STREAM_HPP
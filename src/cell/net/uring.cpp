@@ -0,0 +1,181 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include "uring.hpp"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "cell/core/assert.hpp"
+#include "cell/log/log.hpp"
+
+namespace cell::net {
+
+namespace {
+
+int io_uring_setup(u32 entries, io_uring_params* params) noexcept {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int fd, u32 to_submit, u32 min_complete, u32 flags) noexcept {
+  return static_cast<int>(
+      ::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int io_uring_register(int fd, u32 opcode, void* arg, u32 nr_args) noexcept {
+  return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+void* map_ring(int fd, u64 size, u64 offset) noexcept {
+  void* ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                     static_cast<off_t>(offset));
+  return ptr == MAP_FAILED ? nullptr : ptr;
+}
+
+}  // namespace
+
+Uring::~Uring() {
+  if (m_buffer_ring != nullptr) {
+    ::munmap(m_buffer_ring, m_buffer_ring_size);
+  }
+  if (m_sqes != nullptr) {
+    ::munmap(m_sqes, m_sqes_size);
+  }
+  if (m_cq_ring != nullptr && m_cq_ring != m_sq_ring) {
+    ::munmap(m_cq_ring, m_cq_ring_size);
+  }
+  if (m_sq_ring != nullptr) {
+    ::munmap(m_sq_ring, m_sq_ring_size);
+  }
+  if (m_fd >= 0) {
+    ::close(m_fd);
+  }
+}
+
+bool Uring::init(u32 entries, u32 flags) noexcept {
+  CELL_ASSERT(m_fd < 0);
+
+  io_uring_params params{};
+  params.flags = flags;
+  m_fd = io_uring_setup(entries, &params);
+  if (m_fd < 0 && errno == EINVAL && flags != 0) {
+    params = io_uring_params{};
+    m_fd = io_uring_setup(entries, &params);
+  }
+  if (m_fd < 0) {
+    CELL_LOG_DEBUG("uring: io_uring_setup failed (errno %d)", errno);
+    return false;
+  }
+
+  m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+  m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+  }
+
+  m_sq_ring = map_ring(m_fd, m_sq_ring_size, IORING_OFF_SQ_RING);
+  m_cq_ring = single_mmap ? m_sq_ring : map_ring(m_fd, m_cq_ring_size, IORING_OFF_CQ_RING);
+  m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  m_sqes = static_cast<io_uring_sqe*>(map_ring(m_fd, m_sqes_size, IORING_OFF_SQES));
+  if (m_sq_ring == nullptr || m_cq_ring == nullptr || m_sqes == nullptr) {
+    return false;
+  }
+
+  auto* sq = static_cast<u8*>(m_sq_ring);
+  m_sq_head = reinterpret_cast<u32*>(sq + params.sq_off.head);
+  m_sq_tail = reinterpret_cast<u32*>(sq + params.sq_off.tail);
+  m_sq_mask = *reinterpret_cast<u32*>(sq + params.sq_off.ring_mask);
+  m_sq_entries = *reinterpret_cast<u32*>(sq + params.sq_off.ring_entries);
+
+  // SQE i always sits in slot i, so the index array is filled once
+  auto* array = reinterpret_cast<u32*>(sq + params.sq_off.array);
+  for (u32 i = 0; i < m_sq_entries; ++i) {
+    array[i] = i;
+  }
+  m_sq_local_tail = m_sq_submitted = *m_sq_tail;
+
+  auto* cq = static_cast<u8*>(m_cq_ring);
+  m_cq_head = reinterpret_cast<u32*>(cq + params.cq_off.head);
+  m_cq_tail = reinterpret_cast<u32*>(cq + params.cq_off.tail);
+  m_cq_mask = *reinterpret_cast<u32*>(cq + params.cq_off.ring_mask);
+  m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  return true;
+}
+
+io_uring_sqe* Uring::get_sqe() noexcept {
+  const u32 head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+  if (m_sq_local_tail - head >= m_sq_entries) {
+    return nullptr;
+  }
+
+  io_uring_sqe* sqe = &m_sqes[m_sq_local_tail & m_sq_mask];
+  ++m_sq_local_tail;
+  ::memset(sqe, 0, sizeof(io_uring_sqe));
+  return sqe;
+}
+
+bool Uring::submit(u32 wait_for) noexcept {
+  __atomic_store_n(m_sq_tail, m_sq_local_tail, __ATOMIC_RELEASE);
+  const u32 to_submit = m_sq_local_tail - m_sq_submitted;
+
+  const u32 flags = wait_for != 0 ? IORING_ENTER_GETEVENTS : 0;
+  const int submitted = io_uring_enter(m_fd, to_submit, wait_for, flags);
+  if (submitted < 0) {
+    // EINTR and EBUSY (CQ overflow) clear up once completions are reaped
+    return errno == EINTR || errno == EBUSY;
+  }
+
+  m_sq_submitted += static_cast<u32>(submitted);
+  return true;
+}
+
+bool Uring::register_buffer_ring(uint16_t group, u8* memory, u32 count, u32 size) noexcept {
+  CELL_ASSERT(count != 0 && (count & (count - 1)) == 0 && count <= 32768);
+
+  m_buffer_ring_size = count * sizeof(io_uring_buf);
+  void* ring = ::mmap(nullptr, m_buffer_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+  if (ring == MAP_FAILED) {
+    return false;
+  }
+  m_buffer_ring = static_cast<io_uring_buf_ring*>(ring);
+
+  io_uring_buf_reg registration{};
+  registration.ring_addr = reinterpret_cast<u64>(m_buffer_ring);
+  registration.ring_entries = count;
+  registration.bgid = group;
+  if (io_uring_register(m_fd, IORING_REGISTER_PBUF_RING, &registration, 1) != 0) {
+    CELL_LOG_DEBUG("uring: can't register buffer ring (errno %d)", errno);
+    return false;
+  }
+
+  m_buffers = memory;
+  m_buffer_count = count;
+  m_buffer_size = size;
+  for (u32 i = 0; i < count; ++i) {
+    recycle_buffer(static_cast<uint16_t>(i));
+  }
+  return true;
+}
+
+void Uring::recycle_buffer(uint16_t id) noexcept {
+  // Not m_buffer_ring->bufs: older kernel headers declare the flexible array
+  // through an empty struct, which moves it off offset 0 in C++
+  auto* entries = reinterpret_cast<io_uring_buf*>(m_buffer_ring);
+  io_uring_buf& buffer = entries[m_buffer_ring_tail & (m_buffer_count - 1)];
+  buffer.addr = reinterpret_cast<u64>(get_buffer(id));
+  buffer.len = m_buffer_size;
+  buffer.bid = id;
+
+  ++m_buffer_ring_tail;
+  __atomic_store_n(&m_buffer_ring->tail, m_buffer_ring_tail, __ATOMIC_RELEASE);
+}
+
+}  // namespace cell::net
@@ -0,0 +1,99 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_URING_HPP
+#define CELL_URING_HPP
+
+// Only built when <linux/io_uring.h> is found, see CELL_HAVE_IO_URING
+
+#include <linux/io_uring.h>
+
+#include "cell/core/types.hpp"
+
+namespace cell::net {
+
+// Minimal io_uring ring over the raw syscalls: what the server backend
+// needs and nothing more, so there is no dependency on liburing.
+class Uring {
+ public:
+  explicit Uring() noexcept = default;
+  Uring(const Uring&) = delete;
+  Uring& operator=(const Uring&) = delete;
+  ~Uring();
+
+  // Tries `flags` first and retries without them on kernels that refuse them
+  [[nodiscard]] bool init(u32 entries, u32 flags) noexcept;
+  [[nodiscard]] bool is_ok() const noexcept { return m_fd >= 0; }
+
+  // A zeroed SQE, or nullptr when the SQ is full (call submit() first)
+  [[nodiscard]] io_uring_sqe* get_sqe() noexcept;
+
+  // Free SQ slots; linked SQEs must all fit before the next submit()
+  [[nodiscard]] u32 get_sq_space() const noexcept {
+    return m_sq_entries - (m_sq_local_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE));
+  }
+
+  // Submits pending SQEs and waits for at least `wait_for` completions.
+  // Returns false on errors other than EINTR / EBUSY.
+  [[nodiscard]] bool submit(u32 wait_for) noexcept;
+
+  // Calls `fn(const io_uring_cqe&)` for every available CQE, then marks
+  // them seen. Returns how many were handled.
+  template <typename Fn>
+  u32 for_each_cqe(Fn&& fn) noexcept {
+    u32 head = *m_cq_head;
+    const u32 tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+    const u32 count = tail - head;
+
+    for (; head != tail; ++head) {
+      fn(m_cqes[head & m_cq_mask]);
+    }
+
+    __atomic_store_n(m_cq_head, tail, __ATOMIC_RELEASE);
+    return count;
+  }
+
+  // Registers `count` (a power of two) buffers of `size` bytes carved from
+  // `memory` as provided buffer group `group`
+  [[nodiscard]] bool register_buffer_ring(uint16_t group, u8* memory, u32 count, u32 size) noexcept;
+
+  // Hands a consumed provided buffer back to the kernel
+  void recycle_buffer(uint16_t id) noexcept;
+
+  [[nodiscard]] u8* get_buffer(uint16_t id) const noexcept {
+    return m_buffers + static_cast<u64>(id) * m_buffer_size;
+  }
+
+ private:
+  int m_fd{-1};
+
+  void* m_sq_ring{nullptr};
+  u64 m_sq_ring_size{0};
+  void* m_cq_ring{nullptr};
+  u64 m_cq_ring_size{0};
+  io_uring_sqe* m_sqes{nullptr};
+  u64 m_sqes_size{0};
+
+  u32* m_sq_head{nullptr};
+  u32* m_sq_tail{nullptr};
+  u32 m_sq_mask{0};
+  u32 m_sq_entries{0};
+  u32 m_sq_local_tail{0};
+  u32 m_sq_submitted{0};
+
+  u32* m_cq_head{nullptr};
+  u32* m_cq_tail{nullptr};
+  u32 m_cq_mask{0};
+  io_uring_cqe* m_cqes{nullptr};
+
+  io_uring_buf_ring* m_buffer_ring{nullptr};
+  u64 m_buffer_ring_size{0};
+  u8* m_buffers{nullptr};
+  u32 m_buffer_count{0};
+  u32 m_buffer_size{0};
+  uint16_t m_buffer_ring_tail{0};
+};
+
+}  // namespace cell::net
+
+#endif  // CELL_URING_HPP
@@ -0,0 +1,162 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+// Offline companion of cell::encoding::ZstdDictionary:
+//
+//   cellzstd train <dictionary-out> <max-size-bytes> <sample>...
+//     Trains a dictionary from representative responses (one per file).
+//
+//   cellzstd bench <dictionary|-> <level> <file>...
+//     Compares gzip, zstd and zstd with the dictionary on every file.
+
+#include <zdict.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+#include "cell/encoding/gzip.hpp"
+#include "cell/encoding/zstd.hpp"
+
+using namespace cell;
+
+namespace {
+
+int usage() {
+  std::fprintf(stderr,
+               "usage: cellzstd train <dictionary-out> <max-size-bytes> <sample>...\n"
+               "       cellzstd bench <dictionary|-> <level> <file>...\n");
+  return 1;
+}
+
+bool write_file(const char* path, StringSlice contents) {
+  std::FILE* file = std::fopen(path, "wb");
+  if (file == nullptr) {
+    return false;
+  }
+
+  const bool ok =
+      std::fwrite(contents.get_u8_ptr(), 1, contents.get_length(), file) == contents.get_length();
+  return std::fclose(file) == 0 && ok;
+}
+
+int train(int argc, char* argv[]) {
+  if (argc < 5) {
+    return usage();
+  }
+
+  const u64 max_size = std::strtoull(argv[3], nullptr, 10);
+  if (max_size == 0) {
+    return usage();
+  }
+
+  // ZDICT wants every sample back to back plus their sizes
+  String samples(64 * 1024);
+  std::vector<size_t> sample_sizes;
+  for (int i = 4; i < argc; ++i) {
+    const u64 before = samples.get_length();
+    if (!samples.append_file_contents(argv[i])) {
+      std::fprintf(stderr, "cellzstd: can't read %s\n", argv[i]);
+      return 1;
+    }
+    sample_sizes.push_back(samples.get_length() - before);
+  }
+
+  String dictionary(max_size + 1);
+  const size_t dictionary_size =
+      ZDICT_trainFromBuffer(dictionary.get_buffer_ptr(), max_size, samples.get_buffer_ptr(),
+                            sample_sizes.data(), static_cast<unsigned>(sample_sizes.size()));
+  if (ZDICT_isError(dictionary_size)) {
+    std::fprintf(stderr, "cellzstd: training failed: %s\n", ZDICT_getErrorName(dictionary_size));
+    return 1;
+  }
+
+  dictionary.set_length(dictionary_size);
+  if (!write_file(argv[2], dictionary.slice())) {
+    std::fprintf(stderr, "cellzstd: can't write %s\n", argv[2]);
+    return 1;
+  }
+
+  std::printf("dictionary: %s, %zu bytes from %zu samples (%lu bytes), id %u\n", argv[2],
+              dictionary_size, sample_sizes.size(), samples.get_length(),
+              ZDICT_getDictID(dictionary.get_buffer_ptr(), dictionary_size));
+  return 0;
+}
+
+template <typename Encoder>
+void bench_one(const char* name, Encoder& encoder, StringSlice in) {
+  constexpr int ROUNDS = 20;
+  String out(in.get_length() + 64);
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < ROUNDS; ++i) {
+    out.set_length(0);
+    if (!encoder.compress_string(in, out)) {
+      std::printf("  %-10s failed\n", name);
+      return;
+    }
+  }
+  const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::printf("  %-10s %8lu bytes  %6.2f%%  %9.1f us\n", name, out.get_length(),
+              100.0 * static_cast<double>(out.get_length()) / static_cast<double>(in.get_length()),
+              elapsed.count() / ROUNDS);
+}
+
+int bench(int argc, char* argv[]) {
+  if (argc < 5) {
+    return usage();
+  }
+
+  const int level = std::atoi(argv[3]);
+  encoding::ZstdDictionary dictionary(level);
+  const bool with_dictionary = std::strcmp(argv[2], "-") != 0;
+  if (with_dictionary && !dictionary.load_from_file(argv[2])) {
+    std::fprintf(stderr, "cellzstd: can't load dictionary %s\n", argv[2]);
+    return 1;
+  }
+
+  encoding::Gzip gzip(encoding::Gzip::DEFAULT_COMPRESSION_LEVEL);
+  encoding::Zstd zstd(level);
+  encoding::Zstd zstd_dictionary(level, with_dictionary ? &dictionary : nullptr);
+
+  for (int i = 4; i < argc; ++i) {
+    String in(4096);
+    if (!in.append_file_contents(argv[i]) || in.get_length() == 0) {
+      std::fprintf(stderr, "cellzstd: can't read %s\n", argv[i]);
+      continue;
+    }
+
+    std::printf("%s (%lu bytes)\n", argv[i], in.get_length());
+    bench_one("gzip", gzip, in.slice());
+    bench_one("zstd", zstd, in.slice());
+    if (with_dictionary) {
+      bench_one("zstd+dict", zstd_dictionary, in.slice());
+    }
+  }
+
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    return usage();
+  }
+
+  if (std::strcmp(argv[1], "train") == 0) {
+    return train(argc, argv);
+  }
+
+  if (std::strcmp(argv[1], "bench") == 0) {
+    return bench(argc, argv);
+  }
+
+  return usage();
+}
@@ -5,6 +5,7 @@
 
 #include <cell/core/string.hpp>
 #include <cell/core/string_slice.hpp>
+#include <cell/encoding/gzip.hpp>
 #include <cell/http/request.hpp>
 
 using namespace cell;
@@ -106,3 +107,51 @@ TEST(HttpRequestTest, Post1) {
   ASSERT_EQ(request.get_can_upgrade_insecure_connections(), true);
   ASSERT_STREQ(request.get_body().get_const_char_ptr(), "Post Request Body");
 }
+
+namespace {
+
+cell::String make_gzip_request(StringSlice body) {
+  cell::String compressed(64);
+  cell::encoding::Gzip gzip;
+  EXPECT_TRUE(gzip.compress_string(body, compressed));
+
+  cell::String buf(StringSlice::from_cstr("POST /upload HTTP/1.1\r\n"
+                                          "Host: www.example.com\r\n"
+                                          "Content-Encoding: gzip\r\n"
+                                          "\r\n"));
+  buf.append_slice(compressed.slice());
+  return buf;
+}
+
+}  // namespace
+
+TEST(HttpRequestTest, PostGzipBody) {
+  const auto body = StringSlice::from_cstr("{\"name\": \"cell\", \"tags\": [\"http\", \"server\"]}");
+  cell::String buf = make_gzip_request(body);
+  Request request(&buf);
+
+  ASSERT_EQ(request.parse(), http::RequestParserResult::Ok);
+  ASSERT_EQ(request.get_content_encoding(), http::encoding::GZIP);
+  ASSERT_TRUE(request.get_body().compare(body));
+}
+
+TEST(HttpRequestTest, PostGzipBomb) {
+  cell::String body(1024 * 1024 + 1);
+  body.set_length(1024 * 1024);
+  cell::String buf = make_gzip_request(body.slice());
+  Request request(&buf);
+  request.set_body_limits({.max_output_size = 16 * 1024 * 1024, .max_ratio = 50,
+                           .ratio_grace_size = 64 * 1024});
+
+  ASSERT_EQ(request.parse(), http::RequestParserResult::ErrorBodyTooLarge);
+}
+
+TEST(HttpRequestTest, PostUnsupportedContentEncoding) {
+  cell::String buf(StringSlice::from_cstr("POST /upload HTTP/1.1\r\n"
+                                          "Content-Encoding: gzip, br\r\n"
+                                          "\r\n"
+                                          "xxxx"));
+  Request request(&buf);
+
+  ASSERT_EQ(request.parse(), http::RequestParserResult::ErrorContentEncodingUnsupported);
+}
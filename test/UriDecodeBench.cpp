@@ -0,0 +1,105 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+// Compares Uri::decode against the byte-at-a-time decoder it replaced, on
+// inputs shaped like the ones in UriDecodeTest. Not registered with ctest.
+
+#include <chrono>
+#include <cstdio>
+
+#include "cell/core/charset.hpp"
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/http/uri.hpp"
+
+using cell::String;
+using cell::StringSlice;
+using cell::http::Uri;
+
+namespace {
+
+constexpr int kIterations = 1'000'000;
+
+bool reference_decode(StringSlice slice, String& out) {
+  uint64_t cursor = 0;
+  bool fail_flag = false;
+
+  while (cursor < slice.get_length()) {
+    const uint8_t ch = slice.byte_at(cursor);
+
+    if (ch == '%') {
+      if (cursor + 2 >= slice.get_length()) {
+        return false;
+      }
+      const auto decoded_byte =
+          cell::hex_pair_to_byte(slice.byte_at(cursor + 1), slice.byte_at(cursor + 2), fail_flag);
+      if (fail_flag) {
+        return false;
+      }
+
+      out.append_byte(decoded_byte);
+      cursor += 2;
+    } else {
+      out.append_byte(ch);
+    }
+
+    ++cursor;
+  }
+
+  return true;
+}
+
+template <typename Fn>
+double time_ns_per_call(Fn&& fn) {
+  const auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) {
+    fn();
+  }
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - begin).count() / kIterations;
+}
+
+void run(const char* name, const char* input) {
+  const auto slice = StringSlice::from_cstr(input);
+  String out(1024);
+  String in_place(1024);
+
+  const double reference = time_ns_per_call([&] {
+    out.set_length(0);
+    (void)reference_decode(slice, out);
+  });
+
+  const double current = time_ns_per_call([&] {
+    out.set_length(0);
+    (void)Uri::decode(slice, out);
+  });
+
+  const double inplace = time_ns_per_call([&] {
+    in_place.set_length(0);
+    in_place.append_slice(slice);
+    (void)Uri::decode_in_place(in_place);
+  });
+
+  const double encode = time_ns_per_call([&] {
+    out.set_length(0);
+    Uri::encode(slice, out, true);
+  });
+
+  printf("%-16s len=%-4lu reference=%8.1fns decode=%8.1fns in_place=%8.1fns encode=%8.1fns\n",
+         name, slice.get_length(), reference, current, inplace, encode);
+}
+
+}  // namespace
+
+int main() {
+  run("ascii", "main/articles/view_page/article.php?article=32~");
+  run("one-escape", "main/articles/view_page/article.php?%25article=32~");
+  run("utf8", "/%D7%A9%D7%9C%D7%95%D7%9D");
+  run("long-path",
+      "/assets/javascripts/application-bundle/v2/vendor/node_modules/some-package/dist/"
+      "index.min.js");
+  run("long-mixed",
+      "/search/%D7%A9%D7%9C%D7%95%D7%9D/results/page/2/sort/relevance/filter/"
+      "type%3Darticle%26lang%3Dhe");
+  return 0;
+}
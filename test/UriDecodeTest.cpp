@@ -67,4 +67,51 @@ TEST(UriDecodeTest, SimpleUtf8) {
 
   ASSERT_TRUE(Uri::decode(encoded_uri, out));
   ASSERT_STREQ(out.get_c_str(), "/שלום");
-}
\ No newline at end of file
+}
+
+TEST(UriDecodeTest, LongInputCrossesChunks) {
+  String out(kOutDefaultCapacity);
+  const auto encoded_uri =
+      StringSlice::from_cstr("/assets/javascripts/application-bundle/v2/%E2%9C%93/main.min.js");
+
+  ASSERT_TRUE(Uri::decode(encoded_uri, out));
+  ASSERT_STREQ(out.get_c_str(), "/assets/javascripts/application-bundle/v2/\xE2\x9C\x93/main.min.js");
+}
+
+TEST(UriDecodeTest, PlusAsSpace) {
+  String out(kOutDefaultCapacity);
+  const auto encoded_uri = StringSlice::from_cstr("hello+big%20world");
+
+  ASSERT_TRUE(Uri::decode(encoded_uri, out, true));
+  ASSERT_STREQ(out.get_c_str(), "hello big world");
+
+  out.clear();
+  ASSERT_TRUE(Uri::decode(encoded_uri, out));
+  ASSERT_STREQ(out.get_c_str(), "hello+big world");
+}
+
+TEST(UriDecodeTest, InPlace) {
+  String buf(StringSlice::from_cstr("/%D7%A9%D7%9C%D7%95%D7%9D/some/longer/path/to/cross/a/chunk%2F"));
+
+  ASSERT_TRUE(Uri::decode_in_place(buf));
+  ASSERT_STREQ(buf.get_c_str(), "/שלום/some/longer/path/to/cross/a/chunk/");
+  ASSERT_EQ(buf.get_length(), 44);
+}
+
+TEST(UriDecodeTest, InPlaceShouldFailPercentAtTheEnd) {
+  String buf(StringSlice::from_cstr("/index.asp?%3"));
+
+  ASSERT_FALSE(Uri::decode_in_place(buf));
+}
+
+TEST(UriDecodeTest, EncodeRoundTrip) {
+  String encoded(kOutDefaultCapacity);
+  String decoded(kOutDefaultCapacity);
+  const auto original = StringSlice::from_cstr("/שלום/a b?c=d&e~f");
+
+  Uri::encode(original, encoded, true);
+  ASSERT_STREQ(encoded.get_c_str(), "/%D7%A9%D7%9C%D7%95%D7%9D/a%20b%3Fc%3Dd%26e~f");
+
+  ASSERT_TRUE(Uri::decode(encoded.slice(), decoded));
+  ASSERT_TRUE(decoded.compare(original));
+}
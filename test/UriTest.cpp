@@ -4,13 +4,80 @@
 #include <cell/core/string_slice.hpp>
 #include <cell/http/uri.hpp>
 
-using cell::String, cell::StringSlice, cell::http::Uri;
+using cell::String, cell::StringSlice, cell::http::Uri, cell::http::UriParserResult;
 
 TEST(UriParsingTests, SimpleUriToDecode) {
   Uri uri;
   uri.set_data_buffer(StringSlice::from_cstr("/index.php"));
 
+  ASSERT_EQ(uri.parse(), UriParserResult::Ok);
   ASSERT_TRUE(uri.get_path_decoded().compare(uri.get_path_raw()));
-  ASSERT_STREQ(uri.get_path_decoded().get_const_char_ptr(), "index.php");
-  ASSERT_TRUE(uri.get_queries().IsEmpty());
+  ASSERT_STREQ(uri.get_path_decoded().get_const_char_ptr(), "/index.php");
+  ASSERT_FALSE(uri.has_query());
+}
+
+TEST(UriParsingTests, PathWithoutEscapesIsNotCopied) {
+  Uri uri;
+  uri.set_data_buffer(StringSlice::from_cstr("/static/app.js?v=3"));
+
+  ASSERT_EQ(uri.parse(), UriParserResult::Ok);
+  ASSERT_EQ(uri.get_path_decoded().get_u8_ptr(), uri.get_data_buffer_as_slice().get_u8_ptr());
+  ASSERT_TRUE(uri.get_path_decoded().compare(StringSlice::from_cstr("/static/app.js")));
+  ASSERT_TRUE(uri.get_query_raw().compare(StringSlice::from_cstr("v=3")));
+}
+
+TEST(UriParsingTests, PathIsDecodedOnDemand) {
+  Uri uri;
+  uri.set_data_buffer(StringSlice::from_cstr("/a%20b/c?x=1"));
+
+  ASSERT_EQ(uri.parse(), UriParserResult::Ok);
+  ASSERT_TRUE(uri.get_path_raw().compare(StringSlice::from_cstr("/a%20b/c")));
+  ASSERT_TRUE(uri.get_path_decoded().compare(StringSlice::from_cstr("/a b/c")));
+}
+
+TEST(UriParsingTests, MalformedPathIsRejected) {
+  Uri uri;
+  uri.set_data_buffer(StringSlice::from_cstr("/a%2"));
+
+  ASSERT_EQ(uri.parse(), UriParserResult::DecodingPathFailed);
+}
+
+TEST(UriParsingTests, QueryValues) {
+  Uri uri;
+  uri.set_data_buffer(StringSlice::from_cstr("/search?q=hello+world&page=2&empty=&flag&bad=%G1"));
+  ASSERT_EQ(uri.parse(), UriParserResult::Ok);
+
+  StringSlice value{nullptr, 0};
+  ASSERT_TRUE(uri.get_query_value(StringSlice::from_cstr("page"), value));
+  ASSERT_TRUE(value.compare(StringSlice::from_cstr("2")));
+  ASSERT_TRUE(uri.get_query_value(StringSlice::from_cstr("q"), value));
+  ASSERT_TRUE(value.compare(StringSlice::from_cstr("hello world")));
+  ASSERT_TRUE(uri.get_query_value(StringSlice::from_cstr("empty"), value));
+  ASSERT_EQ(value.get_length(), 0);
+  ASSERT_TRUE(uri.get_query_value(StringSlice::from_cstr("flag"), value));
+  ASSERT_EQ(value.get_length(), 0);
+  ASSERT_FALSE(uri.get_query_value(StringSlice::from_cstr("bad"), value));
+  ASSERT_FALSE(uri.get_query_value(StringSlice::from_cstr("missing"), value));
+}
+
+TEST(UriParsingTests, NormalizedPath) {
+  const std::pair<const char*, const char*> cases[] = {
+      {"/", "/"},
+      {"/a/b/c", "/a/b/c"},
+      {"/a/./b/../c", "/a/c"},
+      {"/a/b/..", "/a/"},
+      {"/a/b/.", "/a/b/"},
+      {"/../../etc/passwd", "/etc/passwd"},
+      {"//a///b//", "/a/b/"},
+      {"/%7euser/%2fx%2F", "/~user/%2Fx%2F"},
+      {"/%2E%2E/secret", "/secret"},
+      {"/mid/content=5/../6", "/mid/6"},
+  };
+
+  for (const auto& [raw, expected] : cases) {
+    Uri uri;
+    uri.set_data_buffer(StringSlice::from_cstr(raw));
+    ASSERT_EQ(uri.parse(), UriParserResult::Ok) << raw;
+    ASSERT_STREQ(uri.get_path_normalized().get_const_char_ptr(), expected) << raw;
+  }
 }
@@ -0,0 +1,126 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_NET_TEST_UTIL_HPP
+#define CELL_NET_TEST_UTIL_HPP
+
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <string>
+#include <thread>
+
+#include "cell/net/server.hpp"
+
+// Loopback clients and a server on its own thread, for the net tests
+namespace cell::test {
+
+// Connected to 127.0.0.1:`port`, reads time out after 2s so a hung server
+// fails the test instead of the run
+inline int connect_to(uint16_t port) {
+  const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  EXPECT_EQ(::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+
+  timeval timeout{.tv_sec = 2, .tv_usec = 0};
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  return fd;
+}
+
+inline void send_all(int fd, const std::string& data) {
+  ASSERT_EQ(::send(fd, data.data(), data.size(), MSG_NOSIGNAL), static_cast<ssize_t>(data.size()));
+}
+
+// recv() that rides out EINTR: io_uring task work may interrupt this thread
+inline ssize_t receive_some(int fd, void* buffer, size_t size) {
+  ssize_t n;
+  do {
+    n = ::recv(fd, buffer, size, 0);
+  } while (n < 0 && errno == EINTR);
+  return n;
+}
+
+// Reads until `count` responses have arrived or the server hangs up
+inline std::string receive_responses(int fd, int count) {
+  std::string received;
+  char buffer[4096];
+  while (true) {
+    int complete = 0;
+    for (auto at = received.find("\r\n\r\n"); at != std::string::npos;
+         at = received.find("\r\n\r\n", at + 4)) {
+      ++complete;
+    }
+    if (complete >= count) {
+      return received;
+    }
+
+    const ssize_t n = receive_some(fd, buffer, sizeof(buffer));
+    if (n <= 0) {
+      return received;
+    }
+    received.append(buffer, static_cast<size_t>(n));
+  }
+}
+
+// Everything until the server hangs up
+inline std::string receive_all(int fd) {
+  std::string received;
+  char buffer[16 * 1024];
+  for (ssize_t n; (n = receive_some(fd, buffer, sizeof(buffer))) > 0;) {
+    received.append(buffer, static_cast<size_t>(n));
+  }
+  return received;
+}
+
+// A listening Server running on its own thread, stopped and joined on
+// destruction
+class ServerFixture {
+ public:
+  ServerFixture(net::Backend backend, net::Handler handler)
+      : ServerFixture(get_config(backend), std::move(handler)) {}
+  ServerFixture(net::Backend backend, net::StreamHandler handler)
+      : ServerFixture(get_config(backend), std::move(handler)) {}
+
+  ServerFixture(const net::ServerConfig& config, net::Handler handler)
+      : m_server(config, std::move(handler)) {
+    start();
+  }
+  ServerFixture(const net::ServerConfig& config, net::StreamHandler handler)
+      : m_server(config, std::move(handler)) {
+    start();
+  }
+
+  ServerFixture(const ServerFixture&) = delete;
+  ServerFixture& operator=(const ServerFixture&) = delete;
+
+  ~ServerFixture() {
+    m_server.stop();
+    m_thread.join();
+  }
+
+  [[nodiscard]] net::Server& get() { return m_server; }
+
+ private:
+  static net::ServerConfig get_config(net::Backend backend) {
+    return {.host = "127.0.0.1", .port = 0, .backend = backend};
+  }
+
+  void start() {
+    EXPECT_TRUE(m_server.listen());
+    m_thread = std::thread([this] { m_server.run(); });
+  }
+
+  net::Server m_server;
+  std::thread m_thread{};
+};
+
+}  // namespace cell::test
+
+#endif  // CELL_NET_TEST_UTIL_HPP
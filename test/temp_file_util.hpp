@@ -0,0 +1,85 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef CELL_TEMP_FILE_UTIL_HPP
+#define CELL_TEMP_FILE_UTIL_HPP
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "cell/core/file_handle.hpp"
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/core/types.hpp"
+
+// Files on disk for the tests of whatever opens, caches or sends them
+namespace cell::test {
+
+// An empty file under /tmp ending in `suffix`, removed on destruction
+class TempFile {
+ public:
+  explicit TempFile(const char* suffix = "") {
+    m_path.append_c_str("/tmp/cell_test_XXXXXX");
+    m_path.append_c_str(suffix);
+    const int fd = ::mkstemps(reinterpret_cast<char*>(m_path.get_buffer_ptr()),
+                              static_cast<int>(strlen(suffix)));
+    EXPECT_NE(fd, -1);
+    ::close(fd);
+  }
+  TempFile(const TempFile&) = delete;
+  TempFile& operator=(const TempFile&) = delete;
+  ~TempFile() { ::unlink(m_path.get_c_str()); }
+
+  // In place, the inode stays
+  void write(const std::string& content) {
+    const int fd = ::open(m_path.get_c_str(), O_WRONLY | O_TRUNC);
+    ASSERT_NE(fd, -1);
+    ASSERT_EQ(::write(fd, content.data(), content.size()), static_cast<ssize_t>(content.size()));
+    ::close(fd);
+  }
+
+  // A new inode renamed over the path, the way deploys replace files
+  void replace(const std::string& content) {
+    String staging{m_path.slice()};
+    staging.append_c_str(".new");
+    const int fd = ::open(staging.get_c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_NE(fd, -1);
+    ASSERT_EQ(::write(fd, content.data(), content.size()), static_cast<ssize_t>(content.size()));
+    ::close(fd);
+    ASSERT_EQ(::rename(staging.get_c_str(), m_path.get_c_str()), 0);
+  }
+
+  void set_mtime(i64 seconds) {
+    const timespec times[2] = {{seconds, 0}, {seconds, 0}};
+    ASSERT_EQ(::utimensat(AT_FDCWD, m_path.get_c_str(), times, 0), 0);
+  }
+
+  void remove() { ::unlink(m_path.get_c_str()); }
+
+  [[nodiscard]] StringSlice path() const { return m_path.slice(); }
+
+ private:
+  String m_path{64};
+};
+
+// A file holding `content` that's already unlinked, gone with its last handle
+inline std::shared_ptr<const FileHandle> make_unlinked_file(const std::string& content) {
+  char path[] = "/tmp/cell_test_XXXXXX";
+  const int fd = ::mkstemp(path);
+  EXPECT_NE(fd, -1);
+  ::unlink(path);
+  EXPECT_EQ(::write(fd, content.data(), content.size()), static_cast<ssize_t>(content.size()));
+  return std::make_shared<const FileHandle>(fd);
+}
+
+}  // namespace cell::test
+
+#endif  // CELL_TEMP_FILE_UTIL_HPP
@@ -0,0 +1,164 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+#include "cell/core/buffer_chain.hpp"
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+
+using namespace cell;
+
+namespace {
+
+std::string gather(const BufferChain& chain) {
+  iovec vectors[BufferChain::MAX_IOVECS];
+  const u32 count = chain.fill_iovecs(vectors, BufferChain::MAX_IOVECS);
+
+  std::string bytes;
+  for (u32 i = 0; i < count; ++i) {
+    bytes.append(static_cast<const char*>(vectors[i].iov_base), vectors[i].iov_len);
+  }
+  return bytes;
+}
+
+}  // namespace
+
+TEST(core_buffer_chain, copies_owns_and_borrows) {
+  BufferChain chain;
+  chain.append(StringSlice::from_cstr("head "));
+  chain.append(StringSlice::from_cstr("more "));
+
+  String body{StringSlice::from_cstr("owned body ")};
+  const u8* body_bytes = body.get_buffer_ptr();
+  chain.append_owned(body);
+  ASSERT_EQ(body.get_length(), 0);
+
+  chain.append_borrowed(StringSlice::from_cstr("borrowed"));
+  ASSERT_EQ(chain.get_length(), 29);
+
+  // Adjacent copies share a segment, the owned body wasn't copied
+  iovec vectors[BufferChain::MAX_IOVECS];
+  ASSERT_EQ(chain.fill_iovecs(vectors, BufferChain::MAX_IOVECS), 3);
+  ASSERT_EQ(vectors[1].iov_base, body_bytes);
+  ASSERT_EQ(gather(chain), "head more owned body borrowed");
+}
+
+TEST(core_buffer_chain, consumes_across_segments) {
+  BufferChain chain;
+  chain.append(StringSlice::from_cstr("abc"));
+  String body{StringSlice::from_cstr("defgh")};
+  chain.append_owned(body);
+  chain.append(StringSlice::from_cstr("ij"));
+
+  chain.consume(2);
+  ASSERT_EQ(gather(chain), "cdefghij");
+  chain.consume(4);
+  ASSERT_EQ(gather(chain), "ghij");
+  chain.consume(4);
+  ASSERT_TRUE(chain.is_empty());
+
+  // Slots are reused once drained
+  chain.append(StringSlice::from_cstr("again"));
+  ASSERT_EQ(gather(chain), "again");
+}
+
+TEST(core_buffer_chain, sealed_segments_are_not_appended_to) {
+  BufferChain chain;
+  chain.append(StringSlice::from_cstr("in flight"));
+  const u8* in_flight = chain.get_append_buffer().get_buffer_ptr();
+
+  chain.seal();
+  for (int i = 0; i < 100; ++i) {
+    chain.append(StringSlice::from_cstr("0123456789"));
+  }
+
+  iovec vectors[BufferChain::MAX_IOVECS];
+  ASSERT_EQ(chain.fill_iovecs(vectors, BufferChain::MAX_IOVECS), 2);
+  ASSERT_EQ(vectors[0].iov_base, in_flight);
+  ASSERT_EQ(vectors[0].iov_len, 9);
+
+  chain.consume(9);
+  chain.unseal();
+  chain.append(StringSlice::from_cstr("!"));
+  ASSERT_EQ(chain.get_length(), 1001);
+  ASSERT_EQ(chain.fill_iovecs(vectors, BufferChain::MAX_IOVECS), 1);
+}
+
+TEST(core_buffer_chain, fills_at_most_the_given_iovecs) {
+  BufferChain chain;
+  for (int i = 0; i < 40; ++i) {
+    chain.append_borrowed(StringSlice::from_cstr("x"));
+  }
+
+  iovec vectors[BufferChain::MAX_IOVECS];
+  ASSERT_EQ(chain.fill_iovecs(vectors, BufferChain::MAX_IOVECS), BufferChain::MAX_IOVECS);
+  chain.consume(BufferChain::MAX_IOVECS);
+  ASSERT_EQ(chain.get_length(), 40 - BufferChain::MAX_IOVECS);
+
+  chain.clear();
+  ASSERT_TRUE(chain.is_empty());
+}
+
+TEST(core_buffer_chain, file_segments_stop_the_iovecs) {
+  const auto file = std::make_shared<const FileHandle>(::open("/dev/null", O_RDONLY));
+  ASSERT_NE(file->get_fd(), -1);
+
+  BufferChain chain;
+  chain.append(StringSlice::from_cstr("head"));
+  chain.append_file({file, 100, 5000});
+  chain.append(StringSlice::from_cstr("tail"));
+  ASSERT_EQ(chain.get_length(), 5008);
+
+  int fd = -1;
+  u64 offset = 0;
+  u64 length = 0;
+  ASSERT_FALSE(chain.get_front_file(fd, offset, length));
+  ASSERT_EQ(gather(chain), "head");
+
+  chain.consume(4);
+  ASSERT_EQ(chain.fill_iovecs(nullptr, 0), 0);
+  ASSERT_TRUE(chain.get_front_file(fd, offset, length));
+  ASSERT_EQ(fd, file->get_fd());
+  ASSERT_EQ(offset, 100);
+  ASSERT_EQ(length, 5000);
+
+  chain.consume(1000);
+  ASSERT_TRUE(chain.get_front_file(fd, offset, length));
+  ASSERT_EQ(offset, 1100);
+  ASSERT_EQ(length, 4000);
+
+  // The chain holds a reference until the segment is consumed
+  ASSERT_EQ(file.use_count(), 2);
+  chain.consume(4000);
+  ASSERT_EQ(file.use_count(), 1);
+  ASSERT_EQ(gather(chain), "tail");
+}
+
+TEST(core_buffer_chain, shrink_drops_large_recycled_buffers) {
+  BufferChain chain;
+  String body{32 * 1024};
+  body.append_c_str("large body");
+  chain.append_owned(body);
+  chain.consume(chain.get_length());
+
+  // Taking a body over hands back what the slot kept: the large one, until shrunk
+  String next{StringSlice::from_cstr("next")};
+  chain.append_owned(next);
+  ASSERT_EQ(next.get_capacity(), 32 * 1024);
+  chain.consume(chain.get_length());
+
+  chain.shrink();
+  String last{StringSlice::from_cstr("last")};
+  chain.append_owned(last);
+  ASSERT_LT(last.get_capacity(), 4096);
+  ASSERT_EQ(gather(chain), "last");
+
+  // Live segments keep theirs
+  chain.shrink();
+  ASSERT_EQ(gather(chain), "last");
+}
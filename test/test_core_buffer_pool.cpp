@@ -0,0 +1,96 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include "cell/core/buffer_pool.hpp"
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+
+using namespace cell;
+
+TEST(core_buffer_pool, rounds_up_to_classes_and_reuses) {
+  BufferPool pool;
+  String buffer{};
+
+  ASSERT_TRUE(pool.reserve(buffer, 100));
+  ASSERT_EQ(buffer.get_capacity(), 4096);
+  ASSERT_EQ(pool.get_lent(), 4096);
+  const u8* first = buffer.get_buffer_ptr();
+
+  // A buffer large enough already stays
+  ASSERT_TRUE(pool.reserve(buffer, 4096));
+  ASSERT_EQ(buffer.get_buffer_ptr(), first);
+
+  pool.release(buffer);
+  ASSERT_EQ(buffer.get_length(), 0);
+  ASSERT_LT(buffer.get_capacity(), 4096);
+  ASSERT_EQ(pool.get_lent(), 0);
+  ASSERT_EQ(pool.get_reserved(), 4096);
+
+  // Given back, lent out again
+  String other{};
+  ASSERT_TRUE(pool.reserve(other, 4000));
+  ASSERT_EQ(other.get_buffer_ptr(), first);
+  ASSERT_EQ(pool.get_reserved(), 4096);
+
+  // Releasing what isn't lent does nothing
+  pool.release(buffer);
+  ASSERT_EQ(pool.get_lent(), 4096);
+}
+
+TEST(core_buffer_pool, grows_keeping_the_bytes) {
+  BufferPool pool;
+  String buffer{};
+  ASSERT_TRUE(pool.reserve(buffer, 10));
+  buffer.append_c_str("GET / HTTP/1.1\r\n");
+
+  ASSERT_TRUE(pool.reserve(buffer, 5000));
+  ASSERT_EQ(buffer.get_capacity(), 16 * 1024);
+  ASSERT_STREQ(buffer.get_c_str(), "GET / HTTP/1.1\r\n");
+  ASSERT_EQ(pool.get_lent(), 16 * 1024);
+  // The 4K one was given back on the way
+  ASSERT_EQ(pool.get_reserved(), 20 * 1024);
+
+  // Past the largest class, from the heap in multiples of it
+  ASSERT_TRUE(pool.reserve(buffer, 100 * 1024));
+  ASSERT_EQ(buffer.get_capacity(), 128 * 1024);
+  ASSERT_STREQ(buffer.get_c_str(), "GET / HTTP/1.1\r\n");
+
+  pool.release(buffer);
+  ASSERT_EQ(pool.get_lent(), 0);
+  ASSERT_EQ(pool.get_reserved(), 20 * 1024);
+}
+
+TEST(core_buffer_pool, limit_refuses_and_frees_kept_buffers) {
+  BufferPool pool{20 * 1024};
+  String a{};
+  String b{};
+  String c{};
+
+  ASSERT_TRUE(pool.reserve(a, 16 * 1024));
+  ASSERT_TRUE(pool.reserve(b, 4096));
+  ASSERT_FALSE(pool.has_room(4096));
+
+  // Refused, and left as it was
+  c.append_c_str("abc");
+  ASSERT_FALSE(pool.reserve(c, 4096));
+  ASSERT_STREQ(c.get_c_str(), "abc");
+  ASSERT_FALSE(pool.reserve(b, 16 * 1024));
+  ASSERT_EQ(b.get_capacity(), 4096);
+
+  // Bytes that already arrived are taken anyway
+  c.set_length(0);
+  ASSERT_TRUE(pool.reserve(c, 4096, true));
+  ASSERT_EQ(pool.get_lent(), 24 * 1024);
+
+  // Kept buffers make way for other classes
+  pool.release(a);
+  pool.release(c);
+  ASSERT_LE(pool.get_reserved(), 20 * 1024);
+  ASSERT_TRUE(pool.has_room(16 * 1024));
+  ASSERT_FALSE(pool.reserve(b, 64 * 1024 - 1));
+  ASSERT_TRUE(pool.reserve(a, 16 * 1024));
+  ASSERT_FALSE(pool.reserve(c, 4096));
+  ASSERT_LE(pool.get_reserved(), 20 * 1024);
+}
@@ -0,0 +1,26 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include "cell/core/hash.hpp"
+#include "cell/core/string_slice.hpp"
+
+using cell::hash_xxh64;
+using cell::StringSlice;
+
+TEST(core_hash, xxh64_reference_values) {
+  ASSERT_EQ(hash_xxh64(StringSlice::from_cstr("")), 0xef46db3751d8e999ULL);
+  ASSERT_EQ(hash_xxh64(StringSlice::from_cstr("a")), 0xd24ec4f1a98c6e5bULL);
+  ASSERT_EQ(hash_xxh64(StringSlice::from_cstr("abc")), 0x44bc2cf5ad770999ULL);
+  ASSERT_EQ(hash_xxh64(StringSlice::from_cstr("abc"), 7), 0x9e755206156676d7ULL);
+
+  // All four lanes, then the 8, 4 and 1 byte tails
+  ASSERT_EQ(hash_xxh64(StringSlice::from_cstr("Nobody inspects the spammish repetition")),
+            0xfbcea83c8a378bf1ULL);
+  u8 bytes[200];
+  for (u32 i = 0; i < sizeof(bytes); ++i) {
+    bytes[i] = static_cast<u8>(i);
+  }
+  ASSERT_EQ(hash_xxh64(bytes, sizeof(bytes)), 0x50dc1079b99e879cULL);
+}
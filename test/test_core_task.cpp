@@ -0,0 +1,136 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <coroutine>
+
+#include "cell/core/frame_pool.hpp"
+#include "cell/core/task.hpp"
+
+using namespace cell;
+
+namespace {
+
+// Suspends until resumed by hand through `waiter`
+struct Park {
+  std::coroutine_handle<>* waiter;
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> handle) noexcept { *waiter = handle; }
+  void await_resume() const noexcept {}
+};
+
+struct Counted {
+  int* destroyed;
+  ~Counted() { ++*destroyed; }
+};
+
+Task<int> add(int a, int b) { co_return a + b; }
+
+Task<int> sum_to(int n) {
+  int total = 0;
+  for (int i = 1; i <= n; ++i) {
+    total = co_await add(total, i);
+  }
+  co_return total;
+}
+
+Task<void> run_sum(int n, int* out) { *out = co_await sum_to(n); }
+
+Task<void> parked(std::coroutine_handle<>* waiter, int* destroyed, int* result) {
+  Counted counted{destroyed};
+  co_await Park{waiter};
+  *result = co_await add(20, 22);
+}
+
+Task<void> parked_deeper(std::coroutine_handle<>* waiter, int* destroyed) {
+  Counted counted{destroyed};
+  int result = 0;
+  co_await parked(waiter, destroyed, &result);
+}
+
+}  // namespace
+
+TEST(core_task, nested_tasks_return_values) {
+  int result = 0;
+  Task<void> task = run_sum(100, &result);
+  ASSERT_FALSE(task.is_done());  // lazy
+
+  task.get_handle().resume();
+  ASSERT_TRUE(task.is_done());
+  ASSERT_EQ(result, 5050);
+}
+
+TEST(core_task, resumes_where_it_parked) {
+  std::coroutine_handle<> waiter;
+  int destroyed = 0;
+  int result = 0;
+
+  Task<void> task = parked(&waiter, &destroyed, &result);
+  task.get_handle().resume();
+  ASSERT_FALSE(task.is_done());
+  ASSERT_TRUE(waiter);
+
+  waiter.resume();
+  ASSERT_TRUE(task.is_done());
+  ASSERT_EQ(result, 42);
+  ASSERT_EQ(destroyed, 1);
+}
+
+TEST(core_task, destroying_a_suspended_task_unwinds_the_chain) {
+  std::coroutine_handle<> waiter;
+  int destroyed = 0;
+
+  {
+    Task<void> task = parked_deeper(&waiter, &destroyed);
+    task.get_handle().resume();
+    ASSERT_FALSE(task.is_done());
+  }
+
+  // Locals of both frames are gone
+  ASSERT_EQ(destroyed, 2);
+}
+
+TEST(core_task, frames_come_from_the_current_pool) {
+  FramePool pool;
+  int result = 0;
+
+  {
+    FramePool::Scope scope{&pool};
+    Task<void> task = run_sum(10, &result);
+    task.get_handle().resume();
+  }
+  ASSERT_EQ(result, 55);
+  const u64 reserved = pool.get_reserved();
+  ASSERT_GT(reserved, 0);
+
+  // The same coroutines again reuse the freed frames
+  {
+    FramePool::Scope scope{&pool};
+    for (int i = 0; i < 100; ++i) {
+      Task<void> task = run_sum(10, &result);
+      task.get_handle().resume();
+    }
+  }
+  ASSERT_EQ(pool.get_reserved(), reserved);
+
+  // Outside a scope frames come from the heap
+  ASSERT_EQ(FramePool::get_current(), nullptr);
+}
+
+TEST(core_task, frame_pool_recycles_by_size_class) {
+  FramePool pool;
+
+  void* small = pool.allocate(40);
+  pool.deallocate(small, 40);
+  ASSERT_EQ(pool.allocate(64), small);  // same class
+
+  void* other = pool.allocate(65);
+  ASSERT_NE(other, small);
+  pool.deallocate(other, 65);
+
+  void* large = pool.allocate(FramePool::MAX_POOLED_SIZE + 1);
+  pool.deallocate(large, FramePool::MAX_POOLED_SIZE + 1);
+  ASSERT_EQ(pool.get_reserved(), FramePool::CHUNK_SIZE);
+}
@@ -0,0 +1,117 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "cell/core/task_pool.hpp"
+#include "cell/core/work_stealing_deque.hpp"
+
+using namespace cell;
+
+TEST(core_work_stealing_deque, owner_is_lifo_thieves_are_fifo) {
+  WorkStealingDeque<int> deque{2};
+  int items[5] = {0, 1, 2, 3, 4};
+
+  // Grows past the initial capacity
+  for (int& item : items) {
+    deque.push(&item);
+  }
+  ASSERT_EQ(deque.size(), 5);
+
+  ASSERT_EQ(deque.steal(), &items[0]);
+  ASSERT_EQ(deque.steal(), &items[1]);
+  ASSERT_EQ(deque.pop(), &items[4]);
+  ASSERT_EQ(deque.pop(), &items[3]);
+  ASSERT_EQ(deque.pop(), &items[2]);
+  ASSERT_EQ(deque.pop(), nullptr);
+  ASSERT_EQ(deque.steal(), nullptr);
+  ASSERT_EQ(deque.size(), 0);
+}
+
+TEST(core_work_stealing_deque, every_item_is_taken_once) {
+  constexpr int ITEMS = 200000;
+  constexpr int THIEVES = 3;
+
+  WorkStealingDeque<int> deque{};
+  std::vector<int> items(ITEMS);
+  std::vector<std::atomic<int>> taken(ITEMS);
+  std::atomic<bool> done{false};
+
+  auto take = [&](int* item) { taken[item - items.data()].fetch_add(1); };
+
+  std::vector<std::thread> thieves;
+  for (int i = 0; i < THIEVES; ++i) {
+    thieves.emplace_back([&] {
+      while (!done.load()) {
+        if (int* item = deque.steal(); item != nullptr) {
+          take(item);
+        }
+      }
+    });
+  }
+
+  for (int i = 0; i < ITEMS; ++i) {
+    deque.push(&items[i]);
+    if (i % 3 == 0) {
+      if (int* item = deque.pop(); item != nullptr) {
+        take(item);
+      }
+    }
+  }
+  while (int* item = deque.pop()) {
+    take(item);
+  }
+
+  done.store(true);
+  for (auto& thief : thieves) {
+    thief.join();
+  }
+
+  for (int i = 0; i < ITEMS; ++i) {
+    ASSERT_EQ(taken[i].load(), 1) << i;
+  }
+}
+
+TEST(core_task_pool, runs_every_task_including_nested_ones) {
+  constexpr int TASKS = 1000;
+  std::atomic<int> ran{0};
+
+  {
+    TaskPool pool({.worker_count = 4});
+    ASSERT_EQ(pool.get_worker_count(), 4);
+
+    for (int i = 0; i < TASKS; ++i) {
+      pool.submit([&pool, &ran] {
+        ++ran;
+        // Lands on the worker's own deque, for the others to steal
+        pool.submit([&ran] { ++ran; });
+      });
+    }
+  }
+
+  ASSERT_EQ(ran.load(), 2 * TASKS);
+}
+
+TEST(core_task_pool, stats) {
+  TaskPool pool({.worker_count = 2});
+  std::atomic<int> ran{0};
+
+  for (int i = 0; i < 100; ++i) {
+    pool.submit([&ran] { ++ran; });
+  }
+  while (ran.load() != 100) {
+    std::this_thread::yield();
+  }
+
+  // A worker bumps `executed` right after the task returns
+  while (pool.get_stats().executed != 100) {
+    std::this_thread::yield();
+  }
+  const TaskPoolStats stats = pool.get_stats();
+  ASSERT_EQ(stats.submitted, 100);
+  ASSERT_EQ(stats.queue_depth, 0);
+}
@@ -0,0 +1,159 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "cell/core/timing_wheel.hpp"
+
+using cell::TimerNode;
+using cell::TimingWheel;
+
+namespace {
+
+// Ticks of the timers `wheel` expires up to `now`, as (tick, data) pairs
+std::vector<std::pair<u64, u64>> advance(TimingWheel& wheel, u64 now, u64& tick) {
+  std::vector<std::pair<u64, u64>> expired;
+  for (; tick <= now; ++tick) {
+    wheel.advance(tick, [&](TimerNode& node) { expired.emplace_back(tick, node.data); });
+  }
+  return expired;
+}
+
+}  // namespace
+
+TEST(core_timing_wheel, arm_disarm_and_expire) {
+  TimingWheel wheel{1000};
+  TimerNode a;
+  TimerNode b;
+  TimerNode c;
+  a.data = 1;
+  b.data = 2;
+  c.data = 3;
+
+  ASSERT_EQ(wheel.get_next_expiry(), UINT64_MAX);
+  wheel.arm(a, 1005);
+  wheel.arm(b, 1005);
+  wheel.arm(c, 1003);
+  ASSERT_TRUE(a.is_armed());
+  ASSERT_EQ(wheel.get_count(), 3);
+  ASSERT_EQ(wheel.get_next_expiry(), 1003);
+
+  wheel.disarm(c);
+  ASSERT_FALSE(c.is_armed());
+  ASSERT_EQ(wheel.get_next_expiry(), 1005);
+
+  // Re-arming moves a timer, it isn't in twice
+  wheel.arm(b, 1010);
+  wheel.arm(b, 1007);
+  ASSERT_EQ(wheel.get_count(), 2);
+
+  u64 tick = 1000;
+  ASSERT_EQ(advance(wheel, 1004, tick).size(), 0);
+  ASSERT_EQ(advance(wheel, 1007, tick), (std::vector<std::pair<u64, u64>>{{1005, 1}, {1007, 2}}));
+  ASSERT_FALSE(a.is_armed());
+  ASSERT_EQ(wheel.get_count(), 0);
+
+  // Already due: the next advance
+  wheel.arm(c, 3);
+  ASSERT_EQ(advance(wheel, 1008, tick), (std::vector<std::pair<u64, u64>>{{1008, 3}}));
+}
+
+TEST(core_timing_wheel, cascades_down_the_levels) {
+  TimingWheel wheel{5};
+  std::vector<std::unique_ptr<TimerNode>> nodes;
+  // Each level, and each side of the boundaries between them
+  const u64 expiries[] = {69, 70, 4100, 4101, 262'149, 300'000, 5 + TimingWheel::MAX_SPAN};
+  for (const u64 expiry : expiries) {
+    nodes.push_back(std::make_unique<TimerNode>());
+    nodes.back()->data = expiry;
+    wheel.arm(*nodes.back(), expiry);
+  }
+
+  // One big step at a time, the wheel skips what's empty
+  std::vector<u64> expired;
+  for (u64 now = 5; wheel.get_count() != 0; now += 1000) {
+    wheel.advance(now, [&](TimerNode& node) {
+      ASSERT_LE(node.data, now);
+      ASSERT_GT(node.data + 1000, now);
+      expired.push_back(node.data);
+    });
+  }
+  ASSERT_EQ(expired, std::vector<u64>(std::begin(expiries), std::end(expiries)));
+}
+
+TEST(core_timing_wheel, callbacks_may_rearm) {
+  TimingWheel wheel{0};
+  TimerNode periodic;
+  TimerNode other;
+  wheel.arm(periodic, 10);
+  wheel.arm(other, 10);
+
+  u64 fired = 0;
+  for (u64 now = 0; now <= 100; ++now) {
+    wheel.advance(now, [&](TimerNode& node) {
+      if (&node == &periodic) {
+        ASSERT_EQ(now % 10, 0);
+        ++fired;
+        wheel.arm(periodic, now + 10);
+        // Disarming one that's due in the same tick is fine too
+        wheel.disarm(other);
+      }
+    });
+  }
+  ASSERT_EQ(fired, 10);
+  ASSERT_FALSE(other.is_armed());
+}
+
+TEST(core_timing_wheel, matches_a_sorted_map) {
+  std::mt19937_64 random{42};
+  TimingWheel wheel{777};
+  std::vector<std::unique_ptr<TimerNode>> nodes;
+  std::multimap<u64, u64> expected;  // expiry -> node
+  std::vector<u64> expiry_of(2000, 0);
+
+  u64 now = 777;
+  for (u64 round = 0; round < 200; ++round) {
+    // Arm, re-arm and disarm at random, near and far
+    for (int i = 0; i < 50; ++i) {
+      const u64 id = random() % expiry_of.size();
+      while (nodes.size() <= id) {
+        nodes.push_back(std::make_unique<TimerNode>());
+        nodes.back()->data = nodes.size() - 1;
+      }
+      TimerNode& node = *nodes[id];
+      if (node.is_armed()) {
+        expected.erase(std::find_if(expected.begin(), expected.end(),
+                                    [&](const auto& entry) { return entry.second == id; }));
+      }
+      if (random() % 4 == 0) {
+        wheel.disarm(node);
+        continue;
+      }
+      const u64 range = random() % 3 == 0 ? 300'000 : 200;
+      expiry_of[id] = now + 1 + random() % range;
+      wheel.arm(node, expiry_of[id]);
+      expected.emplace(expiry_of[id], id);
+    }
+    ASSERT_EQ(wheel.get_count(), expected.size());
+    if (!expected.empty()) {
+      ASSERT_LE(wheel.get_next_expiry(), expected.begin()->first);
+    }
+
+    now += random() % 5000;
+    std::multimap<u64, u64> due;
+    wheel.advance(now, [&](TimerNode& node) { due.emplace(expiry_of[node.data], node.data); });
+    while (!expected.empty() && expected.begin()->first <= now) {
+      const auto at = due.find(expected.begin()->first);
+      ASSERT_NE(at, due.end());
+      due.erase(at);
+      expected.erase(expected.begin());
+    }
+    ASSERT_TRUE(due.empty());
+  }
+}
@@ -0,0 +1,84 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include "cell/core/string_slice.hpp"
+#include "cell/encoding/compression_policy.hpp"
+#include "cell/http/mime_type.hpp"
+
+using cell::StringSlice;
+using cell::encoding::CompressionPolicy;
+using cell::encoding::CompressionPolicyConfig;
+using cell::encoding::CompressionSkipReason;
+namespace http_encoding = cell::http::encoding;
+
+namespace {
+
+CompressionPolicy make_policy() {
+  CompressionPolicyConfig config;
+  config.sample_interval_ns = 0;  // pressure set by hand
+  return CompressionPolicy(config);
+}
+
+}  // namespace
+
+TEST(encoding_compression_policy, mime_types) {
+  ASSERT_TRUE(cell::http::is_compressible_mime_type(StringSlice::from_cstr("text/html; charset=utf-8")));
+  ASSERT_TRUE(cell::http::is_compressible_mime_type(StringSlice::from_cstr("application/json")));
+  ASSERT_TRUE(cell::http::is_compressible_mime_type(StringSlice::from_cstr("image/svg+xml")));
+  ASSERT_FALSE(cell::http::is_compressible_mime_type(StringSlice::from_cstr("image/png")));
+  ASSERT_FALSE(cell::http::is_compressible_mime_type(StringSlice::from_cstr("application/zip")));
+  ASSERT_FALSE(cell::http::is_compressible_mime_type(StringSlice::from_cstr("")));
+}
+
+TEST(encoding_compression_policy, skips) {
+  auto policy = make_policy();
+  const auto json = StringSlice::from_cstr("application/json");
+
+  ASSERT_EQ(policy.decide(http_encoding::IDENTITY, 10000, json).skip_reason,
+            CompressionSkipReason::NotAccepted);
+  ASSERT_EQ(policy.decide(http_encoding::GZIP, 100, json).skip_reason,
+            CompressionSkipReason::BodyTooSmall);
+  ASSERT_EQ(policy.decide(http_encoding::GZIP, 10000, StringSlice::from_cstr("image/jpeg")).skip_reason,
+            CompressionSkipReason::NotCompressible);
+
+  policy.set_cpu_pressure(0.99);
+  ASSERT_EQ(policy.decide(http_encoding::GZIP, 10000, json).skip_reason,
+            CompressionSkipReason::Overloaded);
+
+  const auto& stats = policy.get_stats();
+  ASSERT_EQ(stats.skipped_not_accepted, 1);
+  ASSERT_EQ(stats.skipped_too_small, 1);
+  ASSERT_EQ(stats.skipped_not_compressible, 1);
+  ASSERT_EQ(stats.skipped_overloaded, 1);
+}
+
+TEST(encoding_compression_policy, level_follows_pressure_and_size) {
+  auto policy = make_policy();
+  const auto html = StringSlice::from_cstr("text/html");
+  const auto& config = policy.get_config();
+
+  auto decision = policy.decide(http_encoding::GZIP, 10000, html);
+  ASSERT_TRUE(decision.should_compress());
+  ASSERT_EQ(decision.coding, http_encoding::GZIP);
+  ASSERT_EQ(decision.level, config.level_idle);
+
+  ASSERT_EQ(policy.decide(http_encoding::GZIP, 100 * 1024 * 1024, html).level, config.level_busy);
+
+  policy.set_cpu_pressure(0.6);
+  ASSERT_EQ(policy.decide(http_encoding::GZIP, 10000, html).level, config.level_busy);
+
+  policy.set_cpu_pressure(0.85);
+  ASSERT_EQ(policy.decide(http_encoding::GZIP, 10000, html).level, config.level_saturated);
+}
+
+TEST(encoding_compression_policy, counters) {
+  auto policy = make_policy();
+  policy.record(10000, 2500, 40000);
+  policy.record(5000, 1000, 10000);
+
+  ASSERT_EQ(policy.get_stats().compressed, 2);
+  ASSERT_EQ(policy.get_stats().get_bytes_saved(), 11500);
+  ASSERT_EQ(policy.get_stats().cpu_ns, 50000);
+}
@@ -0,0 +1,80 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/encoding/compressor_pool.hpp"
+#include "cell/encoding/sink.hpp"
+
+using cell::String;
+using cell::StringSlice;
+using cell::encoding::CompressorPool;
+using cell::encoding::StringSink;
+namespace http_encoding = cell::http::encoding;
+
+TEST(encoding_compressor_pool, reuses_released_contexts) {
+  CompressorPool pool;
+  String out(64);
+  StringSink sink(&out);
+
+  {
+    auto lease = pool.acquire(http_encoding::GZIP, 6, &sink);
+    ASSERT_TRUE(lease.is_valid());
+    ASSERT_TRUE(lease->write(StringSlice::from_cstr("hello hello hello")));
+    ASSERT_TRUE(lease->finish());
+    ASSERT_EQ(pool.get_stats().leased_contexts, 1);
+    ASSERT_GT(pool.get_stats().leased_bytes, 0);
+  }
+
+  ASSERT_EQ(pool.get_stats().misses, 1);
+  ASSERT_EQ(pool.get_stats().idle_contexts, 1);
+  ASSERT_EQ(pool.get_stats().leased_bytes, 0);
+
+  const auto first_length = out.get_length();
+  {
+    auto lease = pool.acquire(http_encoding::GZIP, 6, &sink);
+    ASSERT_TRUE(lease->write(StringSlice::from_cstr("hello hello hello")));
+    ASSERT_TRUE(lease->finish());
+  }
+
+  // a reset context produces the exact same member again
+  ASSERT_EQ(out.get_length(), first_length * 2);
+  ASSERT_TRUE(out.slice(0, first_length).compare(out.slice(first_length, first_length)));
+  ASSERT_EQ(pool.get_stats().hits, 1);
+}
+
+TEST(encoding_compressor_pool, keyed_by_level_and_bounded) {
+  CompressorPool pool(1);
+
+  {
+    auto a = pool.acquire(http_encoding::GZIP, 1, nullptr);
+    auto b = pool.acquire(http_encoding::GZIP, 1, nullptr);
+    auto c = pool.acquire(http_encoding::GZIP, 9, nullptr);
+    ASSERT_EQ(pool.get_stats().misses, 3);
+  }
+
+  ASSERT_EQ(pool.get_stats().idle_contexts, 2);
+  ASSERT_EQ(pool.get_stats().discarded, 1);
+
+  pool.trim();
+  ASSERT_EQ(pool.get_stats().idle_contexts, 0);
+  ASSERT_EQ(pool.get_stats().idle_bytes, 0);
+}
+
+TEST(encoding_compressor_pool, unsupported_coding) {
+  CompressorPool pool;
+  auto lease = pool.acquire(http_encoding::BROTLI, 5, nullptr);
+  ASSERT_FALSE(lease.is_valid());
+}
+
+TEST(encoding_compressor_pool, prewarm_and_thread_local) {
+  auto& pool = CompressorPool::get_thread_local();
+  pool.prewarm(http_encoding::GZIP, 4, 2);
+  ASSERT_EQ(pool.get_stats().idle_contexts, 2);
+
+  auto lease = pool.acquire(http_encoding::GZIP, 4, nullptr);
+  ASSERT_EQ(pool.get_stats().hits, 1);
+  ASSERT_EQ(&pool, &CompressorPool::get_thread_local());
+}
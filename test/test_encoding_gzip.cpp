@@ -2,17 +2,108 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include <gtest/gtest.h>
+#include <zlib.h>
+
 #include "cell/core/string.hpp"
 #include "cell/core/string_slice.hpp"
 #include "cell/encoding/gzip.hpp"
+#include "cell/encoding/sink.hpp"
 
 using cell::String;
 using cell::StringSlice;
 
+namespace {
+
+// Reference gunzip through plain zlib, so the tests don't trust our own code
+String gunzip(StringSlice compressed) {
+  z_stream stream{};
+  EXPECT_EQ(inflateInit2(&stream, 15 + 16), Z_OK);
+
+  String out(compressed.get_length() * 4 + 64);
+  stream.next_in = const_cast<Bytef*>(compressed.get_u8_ptr());
+  stream.avail_in = static_cast<uInt>(compressed.get_length());
+
+  int status;
+  do {
+    if (out.get_capacity() - out.get_length() < 1024) {
+      out.expand(out.get_capacity() * 2);
+    }
+    stream.next_out = out.get_buffer_ptr() + out.get_length();
+    stream.avail_out = static_cast<uInt>(out.get_capacity() - out.get_length() - 1);
+    const auto before = stream.avail_out;
+    status = inflate(&stream, Z_NO_FLUSH);
+    out.set_length(out.get_length() + (before - stream.avail_out));
+  } while (status == Z_OK);
+
+  EXPECT_EQ(status, Z_STREAM_END);
+  inflateEnd(&stream);
+  return out;
+}
+
+String make_input(int repeat) {
+  String input(64);
+  for (int i = 0; i < repeat; ++i) {
+    input.append_sprintf<64>("line %d: the quick brown fox jumps over the lazy dog\n", i);
+  }
+  return input;
+}
+
+}  // namespace
+
 TEST(encoding_gzip, simple) {
   String src(StringSlice::from_cstr("HTTP/1.1 200 OK"));
   String dest(16);
 
   cell::encoding::Gzip gzip;
   ASSERT_TRUE(gzip.is_ok());
-}
\ No newline at end of file
+}
+
+TEST(encoding_gzip, compress_string_grows_output_and_is_reusable) {
+  const String input = make_input(2000);
+  cell::encoding::Gzip gzip;
+
+  for (int round = 0; round < 2; ++round) {
+    String out(16);
+    ASSERT_TRUE(gzip.compress_string(input.slice(), out));
+    ASSERT_GT(out.get_length(), 512);
+    ASSERT_TRUE(gunzip(out.slice()).compare(input.slice()));
+  }
+}
+
+TEST(encoding_gzip, stream_in_pieces_into_string) {
+  const String input = make_input(5000);
+  String out(16);
+  cell::encoding::StringSink sink(&out);
+  cell::encoding::GzipStream stream(&sink, 6, 1024);
+  ASSERT_TRUE(stream.is_ok());
+
+  constexpr uint64_t piece = 777;
+  for (uint64_t offset = 0; offset < input.get_length(); offset += piece) {
+    const auto n = std::min(piece, input.get_length() - offset);
+    ASSERT_TRUE(stream.write(input.slice(offset, n)));
+  }
+  ASSERT_TRUE(stream.flush());
+  ASSERT_TRUE(stream.finish());
+
+  ASSERT_TRUE(gunzip(out.slice()).compare(input.slice()));
+}
+
+TEST(encoding_gzip, stream_chunks_are_bounded_and_stream_is_reusable) {
+  const String input = make_input(3000);
+  cell::encoding::ChainSink chain;
+  cell::encoding::GzipStream stream(&chain, 1, 512);
+
+  for (int round = 0; round < 2; ++round) {
+    chain.clear();
+    ASSERT_TRUE(stream.write(input.slice()));
+    ASSERT_TRUE(stream.finish());
+
+    String joined(chain.get_total_length() + 1);
+    for (const auto& chunk : chain.get_chain()) {
+      ASSERT_LE(chunk.get_length(), 512);
+      joined.append_string(chunk);
+    }
+    ASSERT_GT(chain.get_chain().size(), 1);
+    ASSERT_TRUE(gunzip(joined.slice()).compare(input.slice()));
+  }
+}
@@ -0,0 +1,169 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/encoding/gzip.hpp"
+#include "cell/encoding/inflate.hpp"
+#include "cell/encoding/sink.hpp"
+
+using cell::String;
+using cell::StringSlice;
+using cell::encoding::InflateLimits;
+using cell::encoding::InflateResult;
+using cell::encoding::InflateStream;
+
+namespace http_encoding = cell::http::encoding;
+
+namespace {
+
+String make_input(int repeat) {
+  String input(64);
+  for (int i = 0; i < repeat; ++i) {
+    input.append_sprintf<64>("{\"line\": %d, \"text\": \"the quick brown fox\"}\n", i);
+  }
+  return input;
+}
+
+String gzip(StringSlice in) {
+  String out(64);
+  cell::encoding::Gzip encoder;
+  EXPECT_TRUE(encoder.compress_string(in, out));
+  return out;
+}
+
+// zlib-wrapped (window_bits 15) or raw (-15) deflate
+String deflate(StringSlice in, int window_bits) {
+  z_stream stream{};
+  EXPECT_EQ(deflateInit2(&stream, 6, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY), Z_OK);
+
+  const auto bound = deflateBound(&stream, static_cast<uLong>(in.get_length()));
+  String out(bound + 1);
+  stream.next_in = const_cast<Bytef*>(in.get_u8_ptr());
+  stream.avail_in = static_cast<uInt>(in.get_length());
+  stream.next_out = out.get_buffer_ptr();
+  stream.avail_out = static_cast<uInt>(bound);
+  EXPECT_EQ(::deflate(&stream, Z_FINISH), Z_STREAM_END);
+  out.set_length(stream.total_out);
+  deflateEnd(&stream);
+  return out;
+}
+
+}  // namespace
+
+TEST(encoding_inflate, gzip_in_small_buffers) {
+  const String input = make_input(1000);
+  const String compressed = gzip(input.slice());
+
+  InflateStream stream;
+  ASSERT_TRUE(stream.is_ok());
+  ASSERT_TRUE(stream.begin(http_encoding::GZIP));
+
+  // Feed 100 bytes at a time into a 256 byte buffer
+  String out(input.get_length() + 1);
+  u8 buffer[256];
+  InflateResult result = InflateResult::NeedInput;
+  for (u64 offset = 0; offset < compressed.get_length(); offset += 100) {
+    StringSlice piece = compressed.slice(offset, std::min<u64>(100, compressed.get_length() - offset));
+    do {
+      u64 length = 0;
+      result = stream.inflate(piece, buffer, sizeof(buffer), length);
+      out.append_slice(StringSlice{buffer, length});
+    } while (result == InflateResult::OutputFull);
+
+    ASSERT_TRUE(result == InflateResult::NeedInput || result == InflateResult::Done);
+    ASSERT_EQ(piece.get_length(), 0);
+  }
+
+  ASSERT_EQ(result, InflateResult::Done);
+  ASSERT_TRUE(out.compare(input.slice()));
+  ASSERT_EQ(stream.get_total_in(), compressed.get_length());
+  ASSERT_EQ(stream.get_total_out(), input.get_length());
+}
+
+TEST(encoding_inflate, deflate_zlib_and_raw) {
+  const String input = make_input(200);
+
+  for (const int window_bits : {15, -15}) {
+    const String compressed = deflate(input.slice(), window_bits);
+    String out(8);
+    cell::encoding::StringSink sink(&out);
+
+    InflateStream stream;
+    ASSERT_TRUE(stream.begin(http_encoding::DEFLATE));
+    ASSERT_EQ(stream.inflate_to_sink(compressed.slice(), &sink, 512), InflateResult::Done);
+    ASSERT_TRUE(out.compare(input.slice()));
+  }
+}
+
+TEST(encoding_inflate, concatenated_gzip_members) {
+  const String first = make_input(10);
+  const String second = make_input(20);
+  String compressed = gzip(first.slice());
+  compressed.append_slice(gzip(second.slice()).slice());
+
+  String expected(first.slice());
+  expected.append_slice(second.slice());
+
+  String out(8);
+  cell::encoding::StringSink sink(&out);
+  InflateStream stream;
+  ASSERT_TRUE(stream.begin(http_encoding::GZIP));
+  ASSERT_EQ(stream.inflate_to_sink(compressed.slice(), &sink), InflateResult::Done);
+  ASSERT_TRUE(out.compare(expected.slice()));
+}
+
+TEST(encoding_inflate, corrupt_and_truncated) {
+  const String input = make_input(100);
+  const String compressed = gzip(input.slice());
+
+  String out(8);
+  cell::encoding::StringSink sink(&out);
+  InflateStream stream;
+
+  ASSERT_TRUE(stream.begin(http_encoding::GZIP));
+  ASSERT_EQ(stream.inflate_to_sink(compressed.slice(0, compressed.get_length() / 2), &sink),
+            InflateResult::ErrorCorrupt);
+
+  ASSERT_TRUE(stream.begin(http_encoding::GZIP));
+  ASSERT_EQ(stream.inflate_to_sink(StringSlice::from_cstr("definitely not gzip"), &sink),
+            InflateResult::ErrorCorrupt);
+
+  ASSERT_FALSE(stream.begin(http_encoding::BROTLI));
+}
+
+TEST(encoding_inflate, bombs_are_refused_early) {
+  // 8 MiB of zeros compress to about 8 KiB
+  String zeros(8 * 1024 * 1024 + 1);
+  zeros.set_length(8 * 1024 * 1024);
+  const String compressed = gzip(zeros.slice());
+
+  InflateStream ratio_limited({.max_output_size = 64 * 1024 * 1024, .max_ratio = 100,
+                               .ratio_grace_size = 64 * 1024});
+  ASSERT_TRUE(ratio_limited.begin(http_encoding::GZIP));
+
+  StringSlice in = compressed.slice();
+  u8 buffer[16 * 1024];
+  InflateResult result;
+  u64 produced = 0;
+  do {
+    u64 length = 0;
+    result = ratio_limited.inflate(in, buffer, sizeof(buffer), length);
+    produced += length;
+  } while (result == InflateResult::OutputFull);
+
+  ASSERT_EQ(result, InflateResult::ErrorRatioExceeded);
+  // Refused within a buffer of crossing the limit, not after expanding it all
+  ASSERT_LE(produced, 100 * compressed.get_length() + sizeof(buffer));
+
+  String out(8);
+  cell::encoding::StringSink sink(&out);
+  InflateStream size_limited({.max_output_size = 1024 * 1024, .max_ratio = 10'000,
+                              .ratio_grace_size = 64 * 1024});
+  ASSERT_TRUE(size_limited.begin(http_encoding::GZIP));
+  ASSERT_EQ(size_limited.inflate_to_sink(compressed.slice(), &sink), InflateResult::ErrorTooLarge);
+  ASSERT_LE(out.get_length(), 1024 * 1024 + 1);
+}
@@ -0,0 +1,123 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <atomic>
+
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/core/task_pool.hpp"
+#include "cell/encoding/gzip.hpp"
+#include "cell/encoding/parallel_gzip.hpp"
+
+using cell::String;
+using cell::StringSlice;
+using cell::encoding::ParallelGzip;
+
+namespace {
+
+// Reference gunzip through plain zlib, which also checks CRC32 and ISIZE
+String gunzip(StringSlice compressed) {
+  z_stream stream{};
+  EXPECT_EQ(inflateInit2(&stream, 15 + 16), Z_OK);
+
+  String out(compressed.get_length() * 4 + 64);
+  stream.next_in = const_cast<Bytef*>(compressed.get_u8_ptr());
+  stream.avail_in = static_cast<uInt>(compressed.get_length());
+
+  int status;
+  do {
+    if (out.get_capacity() - out.get_length() < 1024) {
+      out.expand(out.get_capacity() * 2);
+    }
+    stream.next_out = out.get_buffer_ptr() + out.get_length();
+    stream.avail_out = static_cast<uInt>(out.get_capacity() - out.get_length() - 1);
+    const auto before = stream.avail_out;
+    status = inflate(&stream, Z_NO_FLUSH);
+    out.set_length(out.get_length() + (before - stream.avail_out));
+  } while (status == Z_OK);
+
+  EXPECT_EQ(status, Z_STREAM_END);
+  EXPECT_EQ(stream.avail_in, 0);
+  inflateEnd(&stream);
+  return out;
+}
+
+String make_input(int repeat) {
+  String input(64);
+  for (int i = 0; i < repeat; ++i) {
+    input.append_sprintf<96>("%d,export-row,%d,the quick brown fox jumps over the lazy dog\n", i,
+                             i * 7919 % 1000);
+  }
+  return input;
+}
+
+}  // namespace
+
+TEST(encoding_parallel_gzip, many_blocks_one_member) {
+  const String input = make_input(20000);  // ~1.3 MiB, ~40 blocks
+  cell::TaskPool pool({.worker_count = 4});
+  ParallelGzip gzip({.level = 6, .block_size = 32 * 1024, .pool = &pool});
+  ASSERT_EQ(gzip.get_pool(), &pool);
+
+  String out(8);
+  ASSERT_TRUE(gzip.compress_string(input.slice(), out));
+  ASSERT_TRUE(gunzip(out.slice()).compare(input.slice()));
+
+  // Priming each block with its predecessor keeps the ratio close to zlib's
+  String reference(8);
+  cell::encoding::Gzip single(6);
+  ASSERT_TRUE(single.compress_string(input.slice(), reference));
+  ASSERT_LT(out.get_length(), reference.get_length() + reference.get_length() / 20);
+
+  // One job per block but the caller's
+  const u64 blocks = (input.get_length() + 32 * 1024 - 1) / (32 * 1024);
+  ASSERT_EQ(pool.get_stats().submitted, blocks - 1);
+}
+
+TEST(encoding_parallel_gzip, appends_and_uneven_tail) {
+  const String input = make_input(3001);
+  cell::TaskPool pool({.worker_count = 3});
+  ParallelGzip gzip({.level = 1, .block_size = 64 * 1024, .pool = &pool});
+
+  String out(StringSlice::from_cstr("prefix"));
+  ASSERT_TRUE(gzip.compress_string(input.slice(), out));
+  ASSERT_TRUE(out.slice(0, 6).compare(StringSlice::from_cstr("prefix")));
+  ASSERT_TRUE(gunzip(out.slice(6)).compare(input.slice()));
+}
+
+TEST(encoding_parallel_gzip, small_and_empty_inputs) {
+  ParallelGzip gzip;
+  ASSERT_EQ(gzip.get_pool(), nullptr);
+
+  String out(8);
+  ASSERT_TRUE(gzip.compress_string(StringSlice::from_cstr("hello"), out));
+  ASSERT_TRUE(gunzip(out.slice()).compare(StringSlice::from_cstr("hello")));
+
+  String empty_out(8);
+  ASSERT_TRUE(gzip.compress_string(StringSlice{nullptr, 0}, empty_out));
+  ASSERT_EQ(gunzip(empty_out.slice()).get_length(), 0);
+}
+
+TEST(encoding_parallel_gzip, from_a_task_on_a_single_worker) {
+  // The only worker is the caller: its blocks' jobs queue up behind it,
+  // and it compresses them itself
+  const String input = make_input(5000);
+  cell::TaskPool pool({.worker_count = 1});
+  ParallelGzip gzip({.level = 1, .block_size = 32 * 1024, .pool = &pool});
+
+  String out(8);
+  std::atomic<bool> ok{false};
+  std::atomic<bool> finished{false};
+  pool.submit([&] {
+    ok = gzip.compress_string(input.slice(), out);
+    finished = true;
+    finished.notify_all();
+  });
+  finished.wait(false);
+
+  ASSERT_TRUE(ok);
+  ASSERT_TRUE(gunzip(out.slice()).compare(input.slice()));
+}
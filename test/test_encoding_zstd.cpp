@@ -0,0 +1,151 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+#include <zstd.h>
+
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/encoding/compressor_pool.hpp"
+#include "cell/encoding/sink.hpp"
+#include "cell/encoding/zstd.hpp"
+
+using cell::String;
+using cell::StringSlice;
+using cell::encoding::Zstd;
+using cell::encoding::ZstdDictionary;
+using cell::encoding::ZstdStream;
+
+namespace {
+
+// Reference decompression through plain libzstd, handles concatenated frames
+String unzstd(StringSlice compressed, StringSlice dictionary = StringSlice{nullptr, 0}) {
+  ZSTD_DCtx* dctx = ZSTD_createDCtx();
+  if (dictionary.get_length() != 0) {
+    EXPECT_FALSE(ZSTD_isError(
+        ZSTD_DCtx_loadDictionary(dctx, dictionary.get_u8_ptr(), dictionary.get_length())));
+  }
+
+  String out(compressed.get_length() * 8 + 64);
+  ZSTD_inBuffer input{compressed.get_u8_ptr(), compressed.get_length(), 0};
+  while (input.pos < input.size) {
+    if (out.get_capacity() - out.get_length() < 1024) {
+      out.expand(out.get_capacity() * 2);
+    }
+    ZSTD_outBuffer output{out.get_buffer_ptr() + out.get_length(),
+                          out.get_capacity() - out.get_length() - 1, 0};
+    const size_t status = ZSTD_decompressStream(dctx, &output, &input);
+    EXPECT_FALSE(ZSTD_isError(status));
+    if (ZSTD_isError(status)) {
+      break;
+    }
+    out.set_length(out.get_length() + output.pos);
+  }
+
+  ZSTD_freeDCtx(dctx);
+  return out;
+}
+
+String make_input(int repeat) {
+  String input(64);
+  for (int i = 0; i < repeat; ++i) {
+    input.append_sprintf<64>("{\"id\": %d, \"status\": \"active\", \"tags\": []}\n", i);
+  }
+  return input;
+}
+
+}  // namespace
+
+TEST(encoding_zstd, compress_string_round_trip_and_is_reusable) {
+  Zstd zstd(3);
+  ASSERT_TRUE(zstd.is_ok());
+
+  const String input = make_input(500);
+  String out(8);
+  ASSERT_TRUE(zstd.compress_string(input.slice(), out));
+  ASSERT_LT(out.get_length(), input.get_length());
+  ASSERT_TRUE(unzstd(out.slice()).compare(input.slice()));
+
+  // Appends a second, independent frame
+  const u64 first_length = out.get_length();
+  ASSERT_TRUE(zstd.compress_string(input.slice(), out));
+  ASSERT_EQ(out.get_length(), first_length * 2);
+}
+
+TEST(encoding_zstd, dictionary_helps_small_payloads) {
+  // A raw-content dictionary: what the offline trainer would give us for
+  // payloads shaped like this one
+  const String samples = make_input(64);
+  ZstdDictionary dictionary(3);
+  ASSERT_FALSE(dictionary.is_loaded());
+  ASSERT_FALSE(dictionary.load_from_memory(StringSlice{nullptr, 0}));
+  ASSERT_TRUE(dictionary.load_from_memory(samples.slice()));
+  ASSERT_TRUE(dictionary.is_loaded());
+
+  const auto input = StringSlice::from_cstr("{\"id\": 7, \"status\": \"active\", \"tags\": []}\n");
+
+  Zstd plain(3);
+  Zstd with_dictionary(3, &dictionary);
+  String plain_out(8);
+  String dictionary_out(8);
+  ASSERT_TRUE(plain.compress_string(input, plain_out));
+  ASSERT_TRUE(with_dictionary.compress_string(input, dictionary_out));
+
+  ASSERT_LT(dictionary_out.get_length(), plain_out.get_length());
+  ASSERT_TRUE(unzstd(dictionary_out.slice(), samples.slice()).compare(input));
+}
+
+TEST(encoding_zstd, stream_in_pieces_and_reuse) {
+  const String input = make_input(2000);
+  String compressed(8);
+  cell::encoding::StringSink sink(&compressed);
+
+  ZstdStream stream(&sink, 3, nullptr, 512);
+  ASSERT_TRUE(stream.is_ok());
+  ASSERT_GT(stream.get_memory_footprint(), 0);
+
+  for (u64 offset = 0; offset < input.get_length(); offset += 1000) {
+    const u64 n = std::min<u64>(1000, input.get_length() - offset);
+    ASSERT_TRUE(stream.write(input.slice(offset, n)));
+  }
+  ASSERT_TRUE(stream.flush());
+  ASSERT_TRUE(stream.finish());
+  ASSERT_TRUE(unzstd(compressed.slice()).compare(input.slice()));
+
+  // finish() resets the session, the next frame starts clean
+  String second(8);
+  cell::encoding::StringSink second_sink(&second);
+  stream.set_sink(&second_sink);
+  ASSERT_TRUE(stream.write(input.slice()));
+  ASSERT_TRUE(stream.finish());
+  ASSERT_TRUE(unzstd(second.slice()).compare(input.slice()));
+}
+
+TEST(encoding_zstd, pooled) {
+  namespace http_encoding = cell::http::encoding;
+
+  cell::encoding::CompressorPool pool;
+  String compressed(8);
+  cell::encoding::StringSink sink(&compressed);
+
+  const String input = make_input(100);
+  u64 leased_bytes = 0;
+  {
+    auto lease = pool.acquire(http_encoding::ZSTD, 3, &sink);
+    ASSERT_TRUE(lease.is_valid());
+    leased_bytes = pool.get_stats().leased_bytes;
+    ASSERT_NE(leased_bytes, 0);
+    ASSERT_TRUE(lease->write(input.slice()));
+    ASSERT_TRUE(lease->finish());
+  }
+  ASSERT_TRUE(unzstd(compressed.slice()).compare(input.slice()));
+
+  // Compressing grew the context, the accounting is the same both ways
+  ASSERT_EQ(pool.get_stats().leased_bytes, 0);
+  ASSERT_EQ(pool.get_stats().idle_bytes, leased_bytes);
+
+  auto again = pool.acquire(http_encoding::ZSTD, 3, nullptr);
+  ASSERT_EQ(pool.get_stats().hits, 1);
+  ASSERT_EQ(pool.get_stats().idle_bytes, 0);
+  ASSERT_EQ(pool.get_stats().leased_bytes, leased_bytes);
+}
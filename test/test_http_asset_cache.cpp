@@ -0,0 +1,166 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/http/asset_cache.hpp"
+#include "cell/http/encoding.hpp"
+#include "temp_file_util.hpp"
+
+using cell::String;
+using cell::StringSlice;
+using cell::http::Asset;
+using cell::http::AssetCache;
+using cell::http::AssetCacheConfig;
+using cell::http::AssetCacheResult;
+using cell::test::TempFile;
+namespace http_encoding = cell::http::encoding;
+
+namespace {
+
+// `repeat` copies of `line` as a new inode, the way the old content is
+// replaced, with the given mtime
+void write_lines(TempFile& file, int repeat, const char* line, long mtime_sec) {
+  std::string content;
+  for (int i = 0; i < repeat; ++i) {
+    content += line;
+  }
+  file.replace(content);
+  file.set_mtime(mtime_sec);
+}
+
+std::string to_string(StringSlice slice) {
+  return {reinterpret_cast<const char*>(slice.get_u8_ptr()), slice.get_length()};
+}
+
+}  // namespace
+
+TEST(http_asset_cache, serves_best_variant) {
+  TempFile file(".html");
+  write_lines(file, 200, "<p>hello asset cache</p>\n", 1000);
+
+  AssetCache cache;
+  Asset asset;
+
+  const auto gzip_ok = http_encoding::parse_accept_encoding(StringSlice::from_cstr("gzip, br"));
+  ASSERT_EQ(cache.get(file.path(), gzip_ok, asset), AssetCacheResult::Ok);
+  ASSERT_EQ(asset.coding, http_encoding::GZIP);
+  ASSERT_LT(asset.body.get_length(), asset.identity_length);
+  ASSERT_TRUE(asset.content_type.compare(StringSlice::from_cstr("text/html; charset=utf-8")));
+
+  const http_encoding::AcceptEncoding none;
+  ASSERT_EQ(cache.get(file.path(), none, asset), AssetCacheResult::Ok);
+  ASSERT_EQ(asset.coding, http_encoding::IDENTITY);
+  ASSERT_EQ(asset.body.get_length(), 200 * strlen("<p>hello asset cache</p>\n"));
+
+  ASSERT_EQ(cache.get_stats().misses, 1);
+  ASSERT_EQ(cache.get_stats().hits, 1);
+}
+
+TEST(http_asset_cache, incompressible_types_have_identity_only) {
+  TempFile file(".png");
+  write_lines(file, 100, "not really a png but who's checking\n", 1000);
+
+  AssetCache cache;
+  Asset asset;
+  const auto gzip_ok = http_encoding::parse_accept_encoding(StringSlice::from_cstr("gzip"));
+  ASSERT_EQ(cache.get(file.path(), gzip_ok, asset), AssetCacheResult::Ok);
+  ASSERT_EQ(asset.coding, http_encoding::IDENTITY);
+}
+
+TEST(http_asset_cache, reloads_on_mtime_change) {
+  TempFile file(".txt");
+  write_lines(file, 10, "version one\n", 1000);
+
+  AssetCacheConfig config;
+  config.revalidate_interval_ns = 0;
+  AssetCache cache(config);
+  Asset asset;
+  const http_encoding::AcceptEncoding none;
+
+  ASSERT_EQ(cache.get(file.path(), none, asset), AssetCacheResult::Ok);
+  ASSERT_EQ(asset.mtime_ns, 1000LL * 1'000'000'000);
+
+  write_lines(file, 10, "version two!\n", 2000);
+  ASSERT_EQ(cache.get(file.path(), none, asset), AssetCacheResult::Ok);
+  ASSERT_EQ(cache.get_stats().reloads, 1);
+  ASSERT_TRUE(StringSlice(asset.body.get_u8_ptr(), 13).compare(StringSlice::from_cstr("version two!\n")));
+}
+
+TEST(http_asset_cache, strong_etag_per_variant_and_version) {
+  TempFile file(".html");
+  write_lines(file, 200, "<p>etag</p>\n", 1000);
+
+  AssetCacheConfig config;
+  config.revalidate_interval_ns = 0;
+  AssetCache cache(config);
+  Asset identity;
+  Asset gzip;
+  const http_encoding::AcceptEncoding none;
+  const auto gzip_ok = http_encoding::parse_accept_encoding(StringSlice::from_cstr("gzip"));
+
+  ASSERT_EQ(cache.get(file.path(), none, identity), AssetCacheResult::Ok);
+  const std::string identity_etag = to_string(identity.etag);
+  ASSERT_EQ(identity_etag.size(), 18);
+  ASSERT_EQ(identity_etag.front(), '"');
+  ASSERT_EQ(to_string(identity.etag_header), "ETag: " + identity_etag + "\r\n");
+
+  ASSERT_EQ(cache.get(file.path(), gzip_ok, gzip), AssetCacheResult::Ok);
+  ASSERT_EQ(to_string(gzip.etag), identity_etag.substr(0, 17) + "-gzip\"");
+
+  // Touched, same bytes: reloaded, same tags
+  write_lines(file, 200, "<p>etag</p>\n", 2000);
+  ASSERT_EQ(cache.get(file.path(), gzip_ok, gzip), AssetCacheResult::Ok);
+  ASSERT_EQ(cache.get_stats().reloads, 1);
+  ASSERT_EQ(to_string(gzip.etag), identity_etag.substr(0, 17) + "-gzip\"");
+
+  write_lines(file, 200, "<p>ETAG</p>\n", 3000);
+  ASSERT_EQ(cache.get(file.path(), none, identity), AssetCacheResult::Ok);
+  ASSERT_NE(to_string(identity.etag), identity_etag);
+}
+
+TEST(http_asset_cache, lru_eviction_within_budget) {
+  TempFile a(".bin");
+  TempFile b(".bin");
+  TempFile c(".bin");
+  write_lines(a, 100, "0123456789", 1000);
+  write_lines(b, 100, "0123456789", 1000);
+  write_lines(c, 100, "0123456789", 1000);
+
+  AssetCacheConfig config;
+  config.byte_budget = 2500;
+  AssetCache cache(config);
+
+  ASSERT_EQ(cache.warmup({a.path(), b.path()}), 2);
+  Asset asset;
+  const http_encoding::AcceptEncoding none;
+  ASSERT_EQ(cache.get(a.path(), none, asset), AssetCacheResult::Ok);  // a is now most recent
+  ASSERT_EQ(cache.get(c.path(), none, asset), AssetCacheResult::Ok);  // evicts b
+
+  ASSERT_EQ(cache.get_stats().evictions, 1);
+  ASSERT_EQ(cache.get_stats().entries, 2);
+  ASSERT_LE(cache.get_stats().bytes_used, 2500);
+
+  const auto misses = cache.get_stats().misses;
+  ASSERT_EQ(cache.get(a.path(), none, asset), AssetCacheResult::Ok);
+  ASSERT_EQ(cache.get_stats().misses, misses);
+}
+
+TEST(http_asset_cache, missing_and_too_large) {
+  AssetCacheConfig config;
+  config.max_asset_size = 10;
+  AssetCache cache(config);
+  Asset asset;
+  const http_encoding::AcceptEncoding none;
+
+  ASSERT_EQ(cache.get(StringSlice::from_cstr("/nonexistent/file"), none, asset),
+            AssetCacheResult::NotFound);
+
+  TempFile file(".txt");
+  write_lines(file, 10, "too long for the cache\n", 1000);
+  ASSERT_EQ(cache.get(file.path(), none, asset), AssetCacheResult::TooLarge);
+}
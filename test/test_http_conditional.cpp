@@ -0,0 +1,93 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/http/conditional.hpp"
+#include "cell/http/entity_tag.hpp"
+
+using cell::String;
+using cell::StringSlice;
+using namespace cell::http;
+
+namespace {
+
+// 1994-11-06 08:49:37
+constexpr i64 LAST_MODIFIED = 784111777;
+
+std::string to_string(StringSlice slice) {
+  return {reinterpret_cast<const char*>(slice.get_u8_ptr()), slice.get_length()};
+}
+
+bool matches(const char* list, const char* etag) {
+  return if_none_match_matches(StringSlice::from_cstr(list), StringSlice::from_cstr(etag));
+}
+
+// is_not_modified() for a request with the given method and header lines
+bool not_modified(const char* method, const char* headers, const char* etag) {
+  String buf(StringSlice::from_cstr(method));
+  buf.append_c_str(" / HTTP/1.1\r\n");
+  buf.append_c_str(headers);
+  buf.append_c_str("\r\n");
+  Request request(&buf);
+  EXPECT_EQ(request.parse(), RequestParserResult::Ok);
+  return is_not_modified(request, StringSlice::from_cstr(etag), LAST_MODIFIED);
+}
+
+}  // namespace
+
+TEST(http_conditional, renders_entity_tags) {
+  const EntityTag etag{0x0123456789abcdefULL};
+  ASSERT_TRUE(etag.is_set());
+  ASSERT_EQ(to_string(etag.get_value()), "\"0123456789abcdef\"");
+  ASSERT_EQ(to_string(etag.get_header_line()), "ETag: \"0123456789abcdef\"\r\n");
+
+  const EntityTag gzip{0xfULL, StringSlice::from_cstr("-gzip")};
+  ASSERT_EQ(to_string(gzip.get_value()), "\"000000000000000f-gzip\"");
+
+  ASSERT_FALSE(EntityTag{}.is_set());
+  ASSERT_EQ(EntityTag{}.get_header_line().get_length(), 0);
+  ASSERT_EQ(EntityTag{}.get_value().get_length(), 0);
+}
+
+TEST(http_conditional, if_none_match_is_a_weak_comparison) {
+  ASSERT_TRUE(matches("\"a\"", "\"a\""));
+  ASSERT_TRUE(matches("W/\"a\"", "\"a\""));
+  ASSERT_TRUE(matches("\"x\", W/\"y\" ,\"a\"", "\"a\""));
+  ASSERT_TRUE(matches("\"a,b\"", "\"a,b\""));
+  ASSERT_TRUE(matches("*", "\"a\""));
+
+  ASSERT_FALSE(matches("\"ab\"", "\"a\""));
+  ASSERT_FALSE(matches("\"x\", \"y\"", "\"a\""));
+  ASSERT_FALSE(matches("a", "\"a\""));
+  ASSERT_FALSE(matches("\"a", "\"a\""));
+  ASSERT_FALSE(matches("*", ""));
+  ASSERT_FALSE(matches("\"a\"", ""));
+
+  ASSERT_TRUE(etag_matches_strongly(StringSlice::from_cstr("\"a\""), StringSlice::from_cstr("\"a\"")));
+  ASSERT_FALSE(
+      etag_matches_strongly(StringSlice::from_cstr("W/\"a\""), StringSlice::from_cstr("\"a\"")));
+  ASSERT_FALSE(
+      etag_matches_strongly(StringSlice::from_cstr("\"a\", \"b\""), StringSlice::from_cstr("\"a\"")));
+}
+
+TEST(http_conditional, not_modified) {
+  ASSERT_FALSE(not_modified("GET", "", "\"a\""));
+  ASSERT_TRUE(not_modified("GET", "If-None-Match: \"a\"\r\n", "\"a\""));
+  ASSERT_TRUE(not_modified("HEAD", "If-None-Match: \"a\"\r\n", "\"a\""));
+  ASSERT_FALSE(not_modified("POST", "If-None-Match: \"a\"\r\n", "\"a\""));
+
+  ASSERT_TRUE(not_modified("GET", "If-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n", ""));
+  ASSERT_TRUE(not_modified("GET", "If-Modified-Since: Mon, 07 Nov 1994 00:00:00 GMT\r\n", ""));
+  ASSERT_FALSE(not_modified("GET", "If-Modified-Since: Sun, 06 Nov 1994 08:49:36 GMT\r\n", ""));
+  ASSERT_FALSE(not_modified("GET", "If-Modified-Since: yesterday\r\n", ""));
+
+  // If-None-Match wins, even when it fails and the date would pass
+  ASSERT_FALSE(not_modified(
+      "GET", "If-None-Match: \"b\"\r\nIf-Modified-Since: Mon, 07 Nov 1994 00:00:00 GMT\r\n",
+      "\"a\""));
+}
@@ -0,0 +1,80 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <ctime>
+#include <string>
+
+#include "cell/http/date.hpp"
+#include "cell/http/status.hpp"
+
+using namespace cell;
+using namespace cell::http;
+
+namespace {
+
+std::string imf_fixdate(i64 seconds) {
+  char out[IMF_FIXDATE_LENGTH];
+  format_imf_fixdate(seconds, out);
+  return std::string(out, IMF_FIXDATE_LENGTH);
+}
+
+}  // namespace
+
+TEST(http_date, formats_imf_fixdate) {
+  ASSERT_EQ(imf_fixdate(0), "Thu, 01 Jan 1970 00:00:00 GMT");
+  ASSERT_EQ(imf_fixdate(784111777), "Sun, 06 Nov 1994 08:49:37 GMT");  // RFC 9110's example
+  ASSERT_EQ(imf_fixdate(951782400), "Tue, 29 Feb 2000 00:00:00 GMT");
+  ASSERT_EQ(imf_fixdate(4102444799), "Thu, 31 Dec 2099 23:59:59 GMT");
+  ASSERT_EQ(imf_fixdate(-1), "Wed, 31 Dec 1969 23:59:59 GMT");
+}
+
+TEST(http_date, matches_strftime) {
+  for (i64 seconds = 0; seconds < 4102444800; seconds += 7777777) {
+    const time_t t = static_cast<time_t>(seconds);
+    tm parts{};
+    ::gmtime_r(&t, &parts);
+    char expected[64];
+    ::strftime(expected, sizeof(expected), "%a, %d %b %Y %H:%M:%S GMT", &parts);
+    ASSERT_EQ(imf_fixdate(seconds), expected);
+  }
+}
+
+TEST(http_date, parses_imf_fixdate) {
+  for (const i64 expected : {0LL, 784111777LL, 951782400LL, 4102444799LL, 1700000000LL}) {
+    const std::string text = imf_fixdate(expected);
+    i64 seconds = -1;
+    ASSERT_TRUE(parse_imf_fixdate(StringSlice::from_cstr(text.c_str()), seconds)) << text;
+    ASSERT_EQ(seconds, expected);
+  }
+
+  i64 seconds = 0;
+  for (const char* text : {"Sun, 06 Nov 1994 08:49:37 UTC", "Sun, 06 Nov 1994 08:49:37",
+                           "Sun, 06 Xyz 1994 08:49:37 GMT", "Sun, 06 Nov 1994 25:49:37 GMT",
+                           "Sunday, 06-Nov-94 08:49:37 GMT", "Sun Nov  6 08:49:37 1994", ""}) {
+    ASSERT_FALSE(parse_imf_fixdate(StringSlice::from_cstr(text), seconds)) << text;
+  }
+}
+
+TEST(http_date, date_line_is_cached_per_second) {
+  const StringSlice line = get_date_line();
+  const std::string text(line.get_const_char_ptr(), line.get_length());
+  ASSERT_EQ(text.size(), 6 + IMF_FIXDATE_LENGTH + 2);
+  ASSERT_TRUE(text.starts_with("Date: "));
+  ASSERT_TRUE(text.ends_with(" GMT\r\n"));
+
+  // Same storage every call
+  ASSERT_EQ(get_date_line().get_u8_ptr(), line.get_u8_ptr());
+}
+
+TEST(http_status, status_lines) {
+  ASSERT_TRUE(status_line(Status::NotFound, Version::Http1).compare(
+      StringSlice::from_cstr("HTTP/1.0 404 Not Found\r\n")));
+  ASSERT_TRUE(status_line(Status::Ok, Version::Http1_1).compare(
+      StringSlice::from_cstr("HTTP/1.1 200 OK\r\n")));
+  ASSERT_TRUE(status_line(Status::ServiceUnavailable, Version::Http2).compare(
+      StringSlice::from_cstr("HTTP/1.1 503 Service Unavailable\r\n")));
+  ASSERT_TRUE(status_to_string(Status::PayloadTooLarge).compare(
+      StringSlice::from_cstr("Content Too Large")));
+}
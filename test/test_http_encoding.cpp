@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include "cell/core/string_slice.hpp"
+#include "cell/http/encoding.hpp"
+
+using cell::StringSlice;
+using namespace cell::http::encoding;
+
+TEST(http_encoding, common_browser_header) {
+  const auto accepted = parse_accept_encoding(StringSlice::from_cstr("gzip, deflate, br, zstd"));
+
+  ASSERT_EQ(accepted.get_acceptable(), GZIP | DEFLATE | BROTLI | ZSTD | IDENTITY);
+  ASSERT_EQ(accepted.negotiate(GZIP | DEFLATE), GZIP);
+  ASSERT_EQ(accepted.negotiate(GZIP | ZSTD), ZSTD);
+  ASSERT_EQ(accepted.negotiate(kNone), kNone);
+}
+
+TEST(http_encoding, case_insensitive_and_unknown_codings) {
+  ASSERT_EQ(parse_from_request_header(StringSlice::from_cstr("Gzip, x-compress, DEFLATE")),
+            GZIP | DEFLATE);
+  ASSERT_EQ(parse_from_request_header(StringSlice::from_cstr("")), kNone);
+}
+
+TEST(http_encoding, q_values) {
+  const auto accepted =
+      parse_accept_encoding(StringSlice::from_cstr("deflate;q=0.9, gzip ; q=0.5, br;q=0"));
+
+  ASSERT_EQ(accepted.get_listed_q(DEFLATE), 900);
+  ASSERT_EQ(accepted.get_listed_q(GZIP), 500);
+  ASSERT_EQ(accepted.get_listed_q(BROTLI), 0);
+  ASSERT_EQ(accepted.get_listed_q(ZSTD), Q_UNSET);
+  ASSERT_EQ(accepted.negotiate(GZIP | DEFLATE | BROTLI), DEFLATE);
+  ASSERT_EQ(accepted.negotiate(BROTLI), kNone);
+  ASSERT_EQ(accepted.negotiate(BROTLI | IDENTITY), IDENTITY);
+}
+
+TEST(http_encoding, malformed_q_skips_element_only) {
+  const auto accepted =
+      parse_accept_encoding(StringSlice::from_cstr("gzip;q=2, br;q=abc, deflate;q=1.000"));
+
+  ASSERT_EQ(accepted.get_listed_q(GZIP), Q_UNSET);
+  ASSERT_EQ(accepted.get_listed_q(BROTLI), Q_UNSET);
+  ASSERT_EQ(accepted.get_listed_q(DEFLATE), Q_MAX);
+}
+
+TEST(http_encoding, wildcard_and_identity) {
+  const auto any = parse_accept_encoding(StringSlice::from_cstr("*;q=0.3, gzip;q=0.1"));
+  ASSERT_EQ(any.negotiate(GZIP | ZSTD), ZSTD);
+
+  const auto no_identity = parse_accept_encoding(StringSlice::from_cstr("gzip, identity;q=0"));
+  ASSERT_EQ(no_identity.negotiate(IDENTITY), kNone);
+
+  const auto nothing = parse_accept_encoding(StringSlice::from_cstr("*;q=0"));
+  ASSERT_EQ(nothing.negotiate(GZIP | IDENTITY), kNone);
+
+  const AcceptEncoding absent;
+  ASSERT_EQ(absent.negotiate(GZIP | IDENTITY), IDENTITY);
+}
+
+TEST(http_encoding, content_encoding) {
+  ASSERT_EQ(parse_content_encoding(StringSlice::from_cstr("gzip")), GZIP);
+  ASSERT_EQ(parse_content_encoding(StringSlice::from_cstr(" Deflate ")), DEFLATE);
+  ASSERT_EQ(parse_content_encoding(StringSlice::from_cstr("identity, gzip")), GZIP);
+  ASSERT_EQ(parse_content_encoding(StringSlice::from_cstr("")), IDENTITY);
+  ASSERT_EQ(parse_content_encoding(StringSlice::from_cstr("gzip, br")), ERROR_PARSING);
+  ASSERT_EQ(parse_content_encoding(StringSlice::from_cstr("compress")), ERROR_PARSING);
+}
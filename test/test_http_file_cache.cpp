@@ -0,0 +1,127 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/http/file_cache.hpp"
+#include "temp_file_util.hpp"
+
+using cell::String;
+using cell::StringSlice;
+using cell::http::FileCache;
+using cell::http::FileCacheConfig;
+using cell::http::FileCacheResult;
+using cell::http::OpenFile;
+using cell::test::TempFile;
+
+namespace {
+
+// Revalidation by stat() out of the way, only inotify notices changes
+constexpr FileCacheConfig NOTIFY_ONLY{.revalidate_interval_ns = UINT64_MAX,
+                                      .notify_interval_ns = 0};
+
+std::string read_all(const OpenFile& file) {
+  std::string content(file.size, '\0');
+  EXPECT_EQ(::pread(file.handle->get_fd(), content.data(), content.size(), 0),
+            static_cast<ssize_t>(content.size()));
+  return content;
+}
+
+}  // namespace
+
+TEST(http_file_cache, keeps_files_open) {
+  TempFile file(".mp4");
+  file.write("movie");
+
+  FileCache cache{NOTIFY_ONLY};
+  OpenFile first;
+  ASSERT_EQ(cache.get(file.path(), first), FileCacheResult::Ok);
+  ASSERT_EQ(first.size, 5);
+  ASSERT_TRUE(first.content_type.compare(StringSlice::from_cstr("video/mp4")));
+  ASSERT_EQ(read_all(first), "movie");
+
+  OpenFile second;
+  ASSERT_EQ(cache.get(file.path(), second), FileCacheResult::Ok);
+  ASSERT_EQ(second.handle, first.handle);
+
+  ASSERT_EQ(cache.get(StringSlice::from_cstr("/tmp/cell_file_missing"), second),
+            FileCacheResult::NotFound);
+  ASSERT_EQ(cache.get_stats().hits, 1);
+  ASSERT_EQ(cache.get_stats().misses, 2);
+  ASSERT_EQ(cache.get_stats().open_files, 1);
+}
+
+TEST(http_file_cache, inotify_drops_changed_files) {
+  TempFile file(".bin");
+  file.write("version one");
+
+  FileCache cache{NOTIFY_ONLY};
+  OpenFile before;
+  ASSERT_EQ(cache.get(file.path(), before), FileCacheResult::Ok);
+
+  file.write("version two!");
+  OpenFile after;
+  ASSERT_EQ(cache.get(file.path(), after), FileCacheResult::Ok);
+  ASSERT_EQ(after.size, 12);
+  ASSERT_EQ(read_all(after), "version two!");
+  ASSERT_GE(cache.get_stats().notifications, 1);
+
+  // Renamed over: the old inode is still open for whoever holds it
+  file.replace("version three");
+  OpenFile replaced;
+  ASSERT_EQ(cache.get(file.path(), replaced), FileCacheResult::Ok);
+  ASSERT_NE(replaced.handle, after.handle);
+  ASSERT_EQ(read_all(replaced), "version three");
+  ASSERT_EQ(read_all(after), "version two!");
+
+  // Deleted
+  file.remove();
+  ASSERT_EQ(cache.get(file.path(), replaced), FileCacheResult::NotFound);
+  ASSERT_EQ(cache.get_stats().open_files, 0);
+}
+
+TEST(http_file_cache, stat_revalidation_catches_changes) {
+  TempFile file(".bin");
+  file.write("short");
+
+  FileCache cache{{.revalidate_interval_ns = 0, .notify_interval_ns = UINT64_MAX}};
+  OpenFile open_file;
+  ASSERT_EQ(cache.get(file.path(), open_file), FileCacheResult::Ok);
+
+  file.replace("much longer");
+  ASSERT_EQ(cache.get(file.path(), open_file), FileCacheResult::Ok);
+  ASSERT_EQ(read_all(open_file), "much longer");
+  ASSERT_EQ(cache.get_stats().reloads, 1);
+  ASSERT_EQ(cache.get_stats().notifications, 0);
+}
+
+TEST(http_file_cache, bounded_by_open_files) {
+  TempFile a(".a");
+  TempFile b(".b");
+  TempFile c(".c");
+  a.write("a");
+  b.write("b");
+  c.write("c");
+
+  FileCache cache{{.max_open_files = 2}};
+  OpenFile held;
+  ASSERT_EQ(cache.get(a.path(), held), FileCacheResult::Ok);
+
+  OpenFile open_file;
+  ASSERT_EQ(cache.get(b.path(), open_file), FileCacheResult::Ok);
+  ASSERT_EQ(cache.get(c.path(), open_file), FileCacheResult::Ok);
+  ASSERT_EQ(cache.get_stats().open_files, 2);
+  ASSERT_EQ(cache.get_stats().evictions, 1);
+
+  // Evicted, but open until the last holder lets go
+  ASSERT_EQ(held.handle.use_count(), 1);
+  ASSERT_EQ(read_all(held), "a");
+
+  cache.clear();
+  ASSERT_EQ(cache.get_stats().open_files, 0);
+}
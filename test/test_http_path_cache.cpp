@@ -0,0 +1,43 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include "cell/core/string_slice.hpp"
+#include "cell/http/path_cache.hpp"
+
+using cell::StringSlice;
+using cell::http::PathCache;
+
+TEST(http_path_cache, hit_after_miss) {
+  PathCache cache(16);
+  StringSlice canonical{nullptr, 0};
+
+  ASSERT_TRUE(cache.canonicalize(StringSlice::from_cstr("/a//b/../c"), canonical));
+  ASSERT_TRUE(canonical.compare(StringSlice::from_cstr("/a/c")));
+  ASSERT_EQ(cache.get_misses(), 1);
+
+  ASSERT_TRUE(cache.canonicalize(StringSlice::from_cstr("/a//b/../c"), canonical));
+  ASSERT_TRUE(canonical.compare(StringSlice::from_cstr("/a/c")));
+  ASSERT_EQ(cache.get_hits(), 1);
+}
+
+TEST(http_path_cache, eviction_keeps_results_correct) {
+  PathCache cache(1);
+  StringSlice canonical{nullptr, 0};
+
+  ASSERT_TRUE(cache.canonicalize(StringSlice::from_cstr("/x/./y"), canonical));
+  ASSERT_TRUE(cache.canonicalize(StringSlice::from_cstr("/p/q/.."), canonical));
+  ASSERT_TRUE(canonical.compare(StringSlice::from_cstr("/p/")));
+  ASSERT_TRUE(cache.canonicalize(StringSlice::from_cstr("/x/./y"), canonical));
+  ASSERT_TRUE(canonical.compare(StringSlice::from_cstr("/x/y")));
+  ASSERT_EQ(cache.get_hits(), 0);
+}
+
+TEST(http_path_cache, malformed) {
+  PathCache cache;
+  StringSlice canonical{nullptr, 0};
+
+  ASSERT_FALSE(cache.canonicalize(StringSlice::from_cstr("/a%zz"), canonical));
+  ASSERT_FALSE(cache.canonicalize(StringSlice::from_cstr("relative"), canonical));
+}
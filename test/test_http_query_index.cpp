@@ -0,0 +1,95 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/http/query_index.hpp"
+#include "cell/http/uri.hpp"
+
+using cell::String;
+using cell::StringSlice;
+using cell::http::QueryIndex;
+
+TEST(http_query_index, repeated_keys_keep_every_value) {
+  QueryIndex index;
+  index.build(StringSlice::from_cstr("id=1&name=x&id=2&id=3"));
+
+  ASSERT_EQ(index.get_size(), 4);
+  ASSERT_EQ(index.count(StringSlice::from_cstr("id")), 3);
+
+  const char* expected[] = {"1", "2", "3"};
+  int n = 0;
+  for (auto i = index.find_first(StringSlice::from_cstr("id")); i != QueryIndex::NOT_FOUND;
+       i = index.find_next(i)) {
+    ASSERT_TRUE(index.get_raw_value_at(i).compare(StringSlice::from_cstr(expected[n++])));
+  }
+  ASSERT_EQ(n, 3);
+
+  ASSERT_TRUE(index.get_key_at(1).compare(StringSlice::from_cstr("name")));
+}
+
+TEST(http_query_index, typed_accessors) {
+  QueryIndex index;
+  index.build(
+      StringSlice::from_cstr("page=42&offset=-7&big=99999999999999999999&debug&cache=off&x=%31%32"));
+
+  i64 i = 0;
+  u64 u = 0;
+  bool b = false;
+
+  ASSERT_TRUE(index.get_u64(StringSlice::from_cstr("page"), u));
+  ASSERT_EQ(u, 42);
+  ASSERT_TRUE(index.get_i64(StringSlice::from_cstr("offset"), i));
+  ASSERT_EQ(i, -7);
+  ASSERT_FALSE(index.get_u64(StringSlice::from_cstr("offset"), u));
+  ASSERT_FALSE(index.get_u64(StringSlice::from_cstr("big"), u));
+  ASSERT_TRUE(index.get_i64(StringSlice::from_cstr("x"), i));
+  ASSERT_EQ(i, 12);
+  ASSERT_TRUE(index.get_bool(StringSlice::from_cstr("debug"), b));
+  ASSERT_TRUE(b);
+  ASSERT_TRUE(index.get_bool(StringSlice::from_cstr("cache"), b));
+  ASSERT_FALSE(b);
+  ASSERT_FALSE(index.get_bool(StringSlice::from_cstr("missing"), b));
+}
+
+TEST(http_query_index, encoded_keys_and_values) {
+  QueryIndex index;
+  index.build(StringSlice::from_cstr("first%20name=Ada+Lovelace&&=&q=a%26b"));
+
+  String out(16);
+  ASSERT_TRUE(index.get_decoded(StringSlice::from_cstr("first name"), out));
+  ASSERT_STREQ(out.get_c_str(), "Ada Lovelace");
+
+  out.clear();
+  ASSERT_TRUE(index.get_decoded(StringSlice::from_cstr("q"), out));
+  ASSERT_STREQ(out.get_c_str(), "a&b");
+}
+
+TEST(http_query_index, many_parameters) {
+  String query(1024);
+  for (int i = 0; i < 64; ++i) {
+    query.append_sprintf<32>("k%d=%d&", i, i * 10);
+  }
+
+  QueryIndex index;
+  index.build(query.slice());
+  ASSERT_EQ(index.get_size(), 64);
+
+  for (int i = 0; i < 64; ++i) {
+    String key(8);
+    key.append_sprintf<16>("k%d", i);
+    i64 value = 0;
+    ASSERT_TRUE(index.get_i64(key.slice(), value));
+    ASSERT_EQ(value, i * 10);
+  }
+}
+
+TEST(http_query_index, lazily_built_by_uri) {
+  cell::http::Uri uri;
+  uri.set_data_buffer(StringSlice::from_cstr("/search?tag=a&tag=b"));
+  ASSERT_EQ(uri.parse(), cell::http::UriParserResult::Ok);
+
+  ASSERT_EQ(uri.get_query_index().count(StringSlice::from_cstr("tag")), 2);
+}
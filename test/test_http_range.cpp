@@ -0,0 +1,189 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/http/date.hpp"
+#include "cell/http/file_response.hpp"
+#include "cell/http/range.hpp"
+#include "temp_file_util.hpp"
+
+using cell::String;
+using cell::StringSlice;
+using namespace cell::http;
+
+namespace {
+
+// 1994-11-06 08:49:37, the RFC's own example date
+constexpr i64 MTIME = 784111777;
+
+std::string resolve(const char* value, u64 length) {
+  ByteRange ranges[ByteRanges::MAX_RANGES];
+  const u32 count = parse_range(StringSlice::from_cstr(value)).resolve(length, ranges);
+
+  std::string out;
+  for (u32 i = 0; i < count; ++i) {
+    out += (i == 0 ? "" : ",") + std::to_string(ranges[i].first) + "-" +
+           std::to_string(ranges[i].last);
+  }
+  return out;
+}
+
+// An unlinked file of `content` as the cache would hand it out
+OpenFile make_file(const std::string& content) {
+  OpenFile file;
+  file.handle = cell::test::make_unlinked_file(content);
+  file.size = content.size();
+  file.mtime_ns = MTIME * 1'000'000'000;
+  file.content_type = StringSlice::from_cstr("text/plain");
+  file.etag = EntityTag{0xe7a9};
+  return file;
+}
+
+// respond_with_file() for a request with the given header lines
+std::string respond(const OpenFile& file, const char* headers, Response& response) {
+  String buf(StringSlice::from_cstr("GET /f HTTP/1.1\r\n"));
+  buf.append_c_str(headers);
+  buf.append_c_str("\r\n");
+  Request request(&buf);
+  EXPECT_EQ(request.parse(), RequestParserResult::Ok);
+
+  respond_with_file(request, file, response);
+  String out(8);
+  response.serialize(out, Version::Http1_1, true, true);
+  const std::string text = out.get_std_string();
+  return text.substr(text.find("\r\n\r\n") + 4);
+}
+
+std::string get_headers(const Response& response) {
+  const StringSlice headers = response.get_headers();
+  return {reinterpret_cast<const char*>(headers.get_u8_ptr()), headers.get_length()};
+}
+
+bool has_header(const Response& response, const char* line) {
+  return get_headers(response).find(line) != std::string::npos;
+}
+
+}  // namespace
+
+TEST(http_range, parses_range_sets) {
+  const ByteRanges ranges = parse_range(StringSlice::from_cstr("BYTES=0-99, 500-,,-20 ,"));
+  ASSERT_TRUE(ranges.is_present());
+  ASSERT_EQ(ranges.get_count(), 3);
+
+  ASSERT_EQ(resolve("bytes=0-0", 10), "0-0");
+  ASSERT_EQ(resolve("bytes=5-", 10), "5-9");
+  ASSERT_EQ(resolve("bytes=-3", 10), "7-9");
+  ASSERT_EQ(resolve("bytes=-30", 10), "0-9");
+  ASSERT_EQ(resolve("bytes=2-99999999999999999999999", 10), "2-9");
+
+  // Each of these is ignored and the whole representation is sent
+  for (const char* value : {"bytes=", "bytes=-", "bytes=5-2", "bytes=1-2x", "bytes=a-b",
+                            "items=0-1", "bytes 0-1", "bytes=1-2;3-4", ""}) {
+    ASSERT_FALSE(parse_range(StringSlice::from_cstr(value)).is_present()) << value;
+  }
+
+  std::string many = "bytes=0-0";
+  for (u32 i = 1; i <= ByteRanges::MAX_RANGES; ++i) {
+    many += "," + std::to_string(i * 2) + "-" + std::to_string(i * 2);
+  }
+  ASSERT_FALSE(parse_range(StringSlice::from_cstr(many.c_str())).is_present());
+}
+
+TEST(http_range, resolves_against_the_length) {
+  // Sorted, overlapping and adjacent ranges merged
+  ASSERT_EQ(resolve("bytes=50-59,0-9,5-14,15-19", 100), "0-19,50-59");
+  ASSERT_EQ(resolve("bytes=-10,0-", 100), "0-99");
+
+  // Unsatisfiable ranges are dropped, 416 once none is left
+  ASSERT_EQ(resolve("bytes=100-,0-1", 100), "0-1");
+  ASSERT_EQ(resolve("bytes=100-200", 100), "");
+  ASSERT_EQ(resolve("bytes=-0", 100), "");
+  ASSERT_EQ(resolve("bytes=-5", 0), "");
+}
+
+TEST(http_range, responds_with_windows_of_a_file) {
+  const OpenFile file = make_file("0123456789abcdefghij");
+
+  Response whole;
+  ASSERT_EQ(respond(file, "", whole), "0123456789abcdefghij");
+  ASSERT_EQ(whole.get_status(), Status::Ok);
+  ASSERT_TRUE(has_header(whole, "Accept-Ranges: bytes\r\n"));
+  ASSERT_TRUE(has_header(whole, "Last-Modified: Sun, 06 Nov 1994 08:49:37 GMT\r\n"));
+
+  Response single;
+  ASSERT_EQ(respond(file, "Range: bytes=-5\r\n", single), "fghij");
+  ASSERT_EQ(single.get_status(), Status::PartialContent);
+  ASSERT_TRUE(has_header(single, "Content-Range: bytes 15-19/20\r\n"));
+
+  Response unsatisfiable;
+  ASSERT_EQ(respond(file, "Range: bytes=20-\r\n", unsatisfiable), "");
+  ASSERT_EQ(unsatisfiable.get_status(), Status::RangeNotSatisfiable);
+  ASSERT_TRUE(has_header(unsatisfiable, "Content-Range: bytes */20\r\n"));
+}
+
+TEST(http_range, multipart_byteranges) {
+  const OpenFile file = make_file("0123456789abcdefghij");
+
+  Response response;
+  const std::string body = respond(file, "Range: bytes=0-1,10-12\r\n", response);
+  ASSERT_EQ(response.get_status(), Status::PartialContent);
+
+  const std::string headers = get_headers(response);
+  const auto at = headers.find("boundary=");
+  ASSERT_NE(at, std::string::npos);
+  const std::string boundary = headers.substr(at + 9, headers.find("\r\n", at) - at - 9);
+  ASSERT_EQ(boundary.size(), 21);
+
+  ASSERT_EQ(body, "--" + boundary +
+                      "\r\nContent-Type: text/plain\r\nContent-Range: bytes 0-1/20\r\n\r\n01"
+                      "\r\n--" +
+                      boundary +
+                      "\r\nContent-Type: text/plain\r\nContent-Range: bytes 10-12/20\r\n\r\nabc"
+                      "\r\n--" +
+                      boundary + "--\r\n");
+}
+
+TEST(http_range, if_range) {
+  const OpenFile file = make_file("0123456789");
+
+  // Still the same version: the range applies
+  Response same;
+  ASSERT_EQ(respond(file,
+                    "Range: bytes=0-1\r\nIf-Range: Sun, 06 Nov 1994 08:49:37 GMT\r\n", same),
+            "01");
+
+  // Changed since, or an entity tag: the whole file
+  Response changed;
+  ASSERT_EQ(respond(file,
+                    "Range: bytes=0-1\r\nIf-Range: Sun, 06 Nov 1994 08:49:38 GMT\r\n", changed),
+            "0123456789");
+  ASSERT_EQ(changed.get_status(), Status::Ok);
+
+  // By strong ETag too, never by a weak one
+  ASSERT_TRUE(if_range_matches(file.etag.get_value(), file));
+  String weak(StringSlice::from_cstr("W/"));
+  weak.append_slice(file.etag.get_value());
+  ASSERT_FALSE(if_range_matches(weak.slice(), file));
+  ASSERT_FALSE(if_range_matches(StringSlice::from_cstr("\"abc\""), file));
+  ASSERT_FALSE(if_range_matches(StringSlice::from_cstr("yesterday"), file));
+  ASSERT_TRUE(if_range_matches(StringSlice::from_cstr(""), file));
+}
+
+TEST(http_range, not_modified_before_ranges) {
+  const OpenFile file = make_file("0123456789");
+
+  String headers(StringSlice::from_cstr("Range: bytes=0-1\r\nIf-None-Match: "));
+  headers.append_slice(file.etag.get_value());
+  headers.append_c_str("\r\n");
+
+  Response response;
+  ASSERT_EQ(respond(file, headers.get_c_str(), response), "");
+  ASSERT_EQ(response.get_status(), Status::NotModified);
+  ASSERT_TRUE(has_header(response, "ETag: \"000000000000e7a9\"\r\n"));
+  ASSERT_FALSE(has_header(response, "Accept-Ranges"));
+}
@@ -0,0 +1,230 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "cell/core/buffer_chain.hpp"
+#include "cell/core/string.hpp"
+#include "cell/core/string_slice.hpp"
+#include "cell/http/date.hpp"
+#include "cell/http/request.hpp"
+#include "cell/http/response.hpp"
+#include "temp_file_util.hpp"
+
+using cell::BufferChain;
+using cell::String;
+using cell::StringSlice;
+using namespace cell::http;
+
+namespace {
+
+// The serialized response with its Date line, checked for shape, taken out
+std::string without_date(const std::string& response) {
+  const auto at = response.find("\r\nDate: ");
+  EXPECT_NE(at, std::string::npos);
+  EXPECT_EQ(response.substr(at + 2 + 6 + IMF_FIXDATE_LENGTH - 4, 6), " GMT\r\n");
+  return response.substr(0, at + 2) + response.substr(at + 2 + 6 + IMF_FIXDATE_LENGTH + 2);
+}
+
+}  // namespace
+
+TEST(http_response, serialize) {
+  Response response;
+  response.set_content_type(StringSlice::from_cstr("text/plain"));
+  response.set_body(StringSlice::from_cstr("hi"));
+
+  String out(8);
+  response.serialize(out, Version::Http1_1, true, true);
+  ASSERT_EQ(without_date(out.get_std_string()),
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Length: 2\r\n"
+            "Connection: keep-alive\r\n"
+            "\r\n"
+            "hi");
+}
+
+TEST(http_response, head_and_no_content) {
+  Response response;
+  response.set_status(Status::NotFound);
+  response.set_body(StringSlice::from_cstr("missing"));
+
+  String out(8);
+  response.serialize(out, Version::Http1, false, false);
+  ASSERT_EQ(without_date(out.get_std_string()),
+            "HTTP/1.0 404 Not Found\r\n"
+            "Content-Length: 7\r\n"
+            "Connection: close\r\n"
+            "\r\n");
+
+  response.reset();
+  response.set_status(Status::NoContent);
+  out.set_length(0);
+  response.serialize(out, Version::Http1_1, true, true);
+  ASSERT_EQ(without_date(out.get_std_string()),
+            "HTTP/1.1 204 No Content\r\nConnection: keep-alive\r\n\r\n");
+}
+
+TEST(http_response, serialize_into_a_buffer_chain) {
+  Response response;
+  String body{StringSlice::from_cstr(std::string(4096, 'b').c_str())};
+  const u8* body_bytes = body.get_buffer_ptr();
+  response.set_body(std::move(body));
+
+  BufferChain out;
+  response.serialize(out, Version::Http1_1, true, true);
+
+  // Head copied, the large body moved in
+  iovec vectors[BufferChain::MAX_IOVECS];
+  ASSERT_EQ(out.fill_iovecs(vectors, BufferChain::MAX_IOVECS), 2);
+  ASSERT_EQ(without_date(std::string(static_cast<const char*>(vectors[0].iov_base),
+                                     vectors[0].iov_len)),
+            "HTTP/1.1 200 OK\r\nContent-Length: 4096\r\nConnection: keep-alive\r\n\r\n");
+  ASSERT_EQ(vectors[1].iov_base, body_bytes);
+  ASSERT_EQ(vectors[1].iov_len, 4096);
+
+  // Small bodies are copied behind the head, views are sent in place
+  response.reset();
+  response.set_body(StringSlice::from_cstr("small"));
+  response.serialize(out, Version::Http1_1, false, true);
+  ASSERT_EQ(out.fill_iovecs(vectors, BufferChain::MAX_IOVECS), 3);
+
+  static const std::string view(2048, 'v');
+  response.reset();
+  response.set_body_view(StringSlice{reinterpret_cast<const u8*>(view.data()), view.size()});
+  response.serialize(out, Version::Http1_1, true, false);  // HEAD
+  response.serialize(out, Version::Http1_1, true, true);
+  ASSERT_EQ(out.fill_iovecs(vectors, BufferChain::MAX_IOVECS), 4);
+  ASSERT_EQ(vectors[3].iov_base, view.data());
+}
+
+TEST(http_response, file_bodies) {
+  const auto file = cell::test::make_unlinked_file("0123456789");
+
+  Response response;
+  response.set_body_file({file, 2, 5});
+  ASSERT_TRUE(response.has_body_file());
+  ASSERT_EQ(response.get_body_length(), 5);
+
+  // The copying path reads the span in
+  String out(8);
+  response.serialize(out, Version::Http1_1, true, true);
+  ASSERT_EQ(without_date(out.get_std_string()),
+            "HTTP/1.1 200 OK\r\nContent-Length: 5\r\nConnection: keep-alive\r\n\r\n23456");
+
+  // The chain gets the span itself, for sendfile()
+  BufferChain chain;
+  response.serialize(chain, Version::Http1_1, true, true);
+  ASSERT_FALSE(response.has_body_file());
+  iovec vectors[BufferChain::MAX_IOVECS];
+  ASSERT_EQ(chain.fill_iovecs(vectors, BufferChain::MAX_IOVECS), 1);
+  chain.consume(vectors[0].iov_len);
+
+  int file_fd = -1;
+  u64 offset = 0;
+  u64 length = 0;
+  ASSERT_TRUE(chain.get_front_file(file_fd, offset, length));
+  ASSERT_EQ(file_fd, file->get_fd());
+  ASSERT_EQ(offset, 2);
+  ASSERT_EQ(length, 5);
+
+  // Any other body drops the file
+  response.set_body_file({file, 0, 10});
+  response.set_body(StringSlice::from_cstr("text"));
+  ASSERT_FALSE(response.has_body_file());
+  ASSERT_EQ(response.get_body_length(), 4);
+}
+
+TEST(http_response, bytes_between_file_spans) {
+  const auto file = cell::test::make_unlinked_file("0123456789");
+
+  Response response;
+  response.set_body(StringSlice::from_cstr("["));
+  response.append_body_file({file, 0, 2});
+  response.append_body(StringSlice::from_cstr("|"));
+  response.append_body_file({file, 8, 2});
+  response.append_body_file({file, 4, 1});
+  response.append_body(StringSlice::from_cstr("]"));
+  ASSERT_EQ(response.get_body_length(), 8);
+
+  String out(8);
+  response.serialize(out, Version::Http1_1, true, true);
+  const std::string text = out.get_std_string();
+  ASSERT_EQ(text.substr(text.size() - 8), "[01|894]");
+
+  // In the chain, the bytes are copied in and each span stays a span
+  BufferChain chain;
+  response.serialize(chain, Version::Http1_1, true, true);
+  std::string sent;
+  iovec vectors[BufferChain::MAX_IOVECS];
+  while (!chain.is_empty()) {
+    int file_fd = -1;
+    u64 offset = 0;
+    u64 length = 0;
+    if (chain.get_front_file(file_fd, offset, length)) {
+      std::string part(length, '\0');
+      ASSERT_EQ(::pread(file_fd, part.data(), length, static_cast<off_t>(offset)),
+                static_cast<ssize_t>(length));
+      sent += part;
+      chain.consume(length);
+      continue;
+    }
+    const u32 count = chain.fill_iovecs(vectors, BufferChain::MAX_IOVECS);
+    ASSERT_GT(count, 0);
+    u64 total = 0;
+    for (u32 i = 0; i < count; ++i) {
+      sent.append(static_cast<const char*>(vectors[i].iov_base), vectors[i].iov_len);
+      total += vectors[i].iov_len;
+    }
+    chain.consume(total);
+  }
+  ASSERT_EQ(without_date(sent), without_date(text));
+}
+
+TEST(http_response, frame_request) {
+  u64 length = 0;
+  const auto pipelined = StringSlice::from_cstr(
+      "POST /a HTTP/1.1\r\ncontent-LENGTH: 3\r\n\r\nabcGET /b HTTP/1.1\r\n\r\n");
+  ASSERT_EQ(frame_request(pipelined, 1024, length), RequestFramingResult::Complete);
+  ASSERT_EQ(length, 42);
+  const StringSlice second{pipelined.get_u8_ptr() + 42, pipelined.get_length() - 42};
+  ASSERT_EQ(frame_request(second, 1024, length), RequestFramingResult::Complete);
+  ASSERT_EQ(length, 19);
+
+  ASSERT_EQ(frame_request(StringSlice::from_cstr("GET / HTTP/1.1\r\nHost: x\r\n"), 1024, length),
+            RequestFramingResult::Incomplete);
+  ASSERT_EQ(frame_request(StringSlice::from_cstr("POST / HTTP/1.1\r\nContent-Length: 10\r\n\r\nab"),
+                          1024, length),
+            RequestFramingResult::Incomplete);
+  ASSERT_EQ(frame_request(StringSlice::from_cstr("POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n"),
+                          1024, length),
+            RequestFramingResult::ErrorInvalidContentLength);
+  ASSERT_EQ(frame_request(StringSlice::from_cstr("POST / HTTP/1.1\r\nContent-Length: 5000\r\n\r\n"),
+                          1024, length),
+            RequestFramingResult::ErrorBodyTooLarge);
+  ASSERT_EQ(frame_request(StringSlice::from_cstr("GET / HTTP/1.1\r\nX: yyyyyyyyyyyyyyyy"), 16, length),
+            RequestFramingResult::ErrorHeadersTooLarge);
+  ASSERT_EQ(frame_request(
+                StringSlice::from_cstr("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"), 1024,
+                length),
+            RequestFramingResult::ErrorChunkedUnsupported);
+}
+
+TEST(http_response, request_reuse_and_keep_alive_default) {
+  String buf(StringSlice::from_cstr("GET /one HTTP/1.1\r\nHost: a\r\n\r\n"));
+  Request request(&buf);
+  ASSERT_EQ(request.parse(), RequestParserResult::Ok);
+  ASSERT_EQ(request.get_connection_type(), Connection::KeepAlive);
+
+  buf.set_length(0);
+  buf.append_slice(StringSlice::from_cstr("GET /two HTTP/1.0\r\n\r\nleftover"));
+  request.reset();
+  ASSERT_EQ(request.parse(buf.get_length() - 8), RequestParserResult::Ok);
+  ASSERT_TRUE(request.get_uri().get_path_raw().compare(StringSlice::from_cstr("/two")));
+  ASSERT_EQ(request.get_connection_type(), Connection::Close);
+  ASSERT_EQ(request.get_body().get_length(), 0);
+  ASSERT_EQ(request.get_host().get_length(), 0);
+}
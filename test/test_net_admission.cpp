@@ -0,0 +1,77 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "cell/net/admission.hpp"
+
+using namespace cell;
+using net::Admission;
+using net::AdmissionControl;
+
+namespace {
+
+constexpr u64 MS = 1'000'000;
+
+}  // namespace
+
+TEST(net_admission, everything_off_admits_everything) {
+  AdmissionControl admission{{}};
+  ASSERT_FALSE(admission.is_enabled());
+  ASSERT_EQ(admission.admit(10'000 * MS, 0, 1'000), Admission::Admitted);
+}
+
+TEST(net_admission, in_flight_and_queue_time_limits) {
+  AdmissionControl admission{{.max_in_flight = 2, .max_queue_time_ms = 50}};
+  ASSERT_TRUE(admission.is_enabled());
+  ASSERT_TRUE(admission.needs_clock());
+
+  ASSERT_EQ(admission.admit(100 * MS, 100 * MS, 1), Admission::Admitted);
+  ASSERT_EQ(admission.admit(100 * MS, 100 * MS, 2), Admission::InFlightLimit);
+  ASSERT_EQ(admission.admit(150 * MS, 100 * MS, 0), Admission::Admitted);
+  ASSERT_EQ(admission.admit(151 * MS, 100 * MS, 0), Admission::QueueTimeout);
+
+  // Only the in-flight limit: no clock needed
+  AdmissionControl in_flight{{.max_in_flight = 1}};
+  ASSERT_FALSE(in_flight.needs_clock());
+}
+
+TEST(net_admission, codel_lets_bursts_through) {
+  AdmissionControl admission{{.codel_target_ms = 5, .codel_interval_ms = 100}};
+
+  // Over target, but the queue drains within the interval
+  for (u64 now = 1'000 * MS; now < 1'090 * MS; now += MS) {
+    ASSERT_EQ(admission.admit(now, now - 20 * MS, 0), Admission::Admitted);
+  }
+  ASSERT_EQ(admission.admit(1'090 * MS, 1'090 * MS, 0), Admission::Admitted);
+  ASSERT_EQ(admission.admit(1'150 * MS, 1'140 * MS, 0), Admission::Admitted);
+  ASSERT_FALSE(admission.is_dropping());
+}
+
+TEST(net_admission, codel_sheds_a_standing_queue_faster_and_faster) {
+  AdmissionControl admission{{.codel_target_ms = 5, .codel_interval_ms = 100}};
+
+  // A request every millisecond, each queued for 20
+  std::vector<u64> shed;
+  for (u64 now = 1'000 * MS; now < 1'600 * MS; now += MS) {
+    if (admission.admit(now, now - 20 * MS, 0) == Admission::CoDel) {
+      shed.push_back(now);
+    }
+  }
+
+  // Nothing for the first interval, then at interval / sqrt(count)
+  ASSERT_GE(shed.size(), 5);
+  ASSERT_GE(shed[0], 1'100 * MS);
+  ASSERT_LE(shed[0], 1'101 * MS);
+  for (u64 i = 2; i < shed.size(); ++i) {
+    ASSERT_LE(shed[i] - shed[i - 1], shed[i - 1] - shed[i - 2] + MS);
+  }
+  ASSERT_TRUE(admission.is_dropping());
+
+  // Once the queue is gone, so is the shedding
+  ASSERT_EQ(admission.admit(1'600 * MS, 1'599 * MS, 0), Admission::Admitted);
+  ASSERT_FALSE(admission.is_dropping());
+  ASSERT_EQ(admission.admit(1'601 * MS, 1'581 * MS, 0), Admission::Admitted);
+}
@@ -0,0 +1,75 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "cell/core/string_slice.hpp"
+#include "cell/net/reactor_group.hpp"
+#include "net_test_util.hpp"
+
+using namespace cell;
+using namespace cell::test;
+
+namespace {
+
+std::string get(uint16_t port, const std::string& path) {
+  const int fd = connect_to(port);
+  send_all(fd, "GET " + path + " HTTP/1.1\r\nConnection: close\r\n\r\n");
+  std::string received = receive_all(fd);
+  ::close(fd);
+  return received;
+}
+
+}  // namespace
+
+TEST(net_reactor_group, every_reactor_serves_the_same_port) {
+  std::atomic<u32> factory_calls{0};
+  std::atomic<bool> factory_on_caller_thread{false};
+  const auto caller = std::this_thread::get_id();
+
+  net::ReactorGroup group({.server = {.host = "127.0.0.1", .port = 0}, .reactor_count = 3},
+                          [&](u32 reactor) -> net::Handler {
+                            ++factory_calls;
+                            if (std::this_thread::get_id() == caller) {
+                              factory_on_caller_thread = true;
+                            }
+                            return [reactor](http::Request&, http::Response& response) {
+                              response.set_body(StringSlice::from_cstr("reactor "));
+                              response.get_body().append_u64(reactor);
+                            };
+                          });
+
+  ASSERT_TRUE(group.start());
+  ASSERT_EQ(group.get_reactor_count(), 3);
+  ASSERT_NE(group.get_port(), 0);
+  ASSERT_EQ(factory_calls.load(), 3);
+  ASSERT_FALSE(factory_on_caller_thread.load());
+
+  constexpr int REQUESTS = 24;
+  for (int i = 0; i < REQUESTS; ++i) {
+    const std::string response = get(group.get_port(), "/");
+    ASSERT_TRUE(response.starts_with("HTTP/1.1 200 OK\r\n")) << response;
+    ASSERT_NE(response.find("\r\n\r\nreactor "), std::string::npos);
+  }
+
+  group.stop();
+  group.wait();
+  ASSERT_EQ(group.get_stats().accepted, REQUESTS);
+  ASSERT_EQ(group.get_stats().requests, REQUESTS);
+}
+
+TEST(net_reactor_group, start_fails_when_the_port_is_taken) {
+  // Without SO_REUSEPORT on the first listener nobody else can join the port
+  net::Server taken({.host = "127.0.0.1", .port = 0}, [](http::Request&, http::Response&) {});
+  ASSERT_TRUE(taken.listen());
+
+  net::ReactorGroup group({.server = {.host = "127.0.0.1", .port = taken.get_port()},
+                           .reactor_count = 2},
+                          [](u32) -> net::Handler { return [](http::Request&, http::Response&) {}; });
+  ASSERT_FALSE(group.start());
+}
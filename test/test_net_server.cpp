@@ -0,0 +1,367 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cell/core/string_slice.hpp"
+#include "cell/core/task_pool.hpp"
+#include "cell/net/server.hpp"
+#include "net_test_util.hpp"
+#include "temp_file_util.hpp"
+
+using cell::StringSlice;
+using namespace cell;
+using namespace cell::test;
+
+namespace {
+
+void echo_path_and_body(http::Request& request, http::Response& response) {
+  response.set_content_type(StringSlice::from_cstr("text/plain"));
+  response.set_body(request.get_uri().get_path_raw());
+  response.get_body().append_slice(request.get_body());
+}
+
+}  // namespace
+
+// Every case runs against both backends, io_uring falls back to epoll where
+// it isn't available
+class net_server : public ::testing::TestWithParam<net::Backend> {};
+
+INSTANTIATE_TEST_SUITE_P(backends, net_server,
+                         ::testing::Values(net::Backend::Epoll, net::Backend::IoUring));
+
+TEST_P(net_server, keep_alive_and_pipelining) {
+  ServerFixture server{GetParam(), echo_path_and_body};
+  const int fd = connect_to(server.get().get_port());
+
+  send_all(fd, "GET /first HTTP/1.1\r\nHost: x\r\n\r\n");
+  const std::string first = receive_responses(fd, 1);
+  ASSERT_NE(first.find("HTTP/1.1 200 OK\r\n"), std::string::npos);
+  ASSERT_NE(first.find("Connection: keep-alive\r\n"), std::string::npos);
+  ASSERT_TRUE(first.ends_with("\r\n\r\n/first"));
+
+  // Two requests in one segment, the second with a body, answered in order
+  send_all(fd,
+           "GET /second HTTP/1.1\r\n\r\n"
+           "POST /third HTTP/1.1\r\nContent-Length: 4\r\nConnection: close\r\n\r\nbody");
+  const std::string rest = receive_responses(fd, 2);
+  const auto second_at = rest.find("/second");
+  const auto third_at = rest.find("/thirdbody");
+  ASSERT_NE(second_at, std::string::npos);
+  ASSERT_NE(third_at, std::string::npos);
+  ASSERT_LT(second_at, third_at);
+  ASSERT_NE(rest.find("Connection: close\r\n"), std::string::npos);
+
+  // The server hangs up after Connection: close
+  char byte;
+  ASSERT_EQ(receive_some(fd, &byte, 1), 0);
+  ::close(fd);
+}
+
+TEST_P(net_server, request_split_across_writes) {
+  ServerFixture server{GetParam(), echo_path_and_body};
+  const int fd = connect_to(server.get().get_port());
+
+  send_all(fd, "POST /split HTTP/1.1\r\nContent-Le");
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  send_all(fd, "ngth: 6\r\n\r\nabc");
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  send_all(fd, "def");
+
+  ASSERT_TRUE(receive_responses(fd, 1).ends_with("/splitabcdef"));
+  ::close(fd);
+}
+
+TEST_P(net_server, errors_close_the_connection) {
+  ServerFixture server{GetParam(), echo_path_and_body};
+
+  const int chunked = connect_to(server.get().get_port());
+  send_all(chunked, "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n");
+  const std::string response = receive_responses(chunked, 1);
+  ASSERT_TRUE(response.starts_with("HTTP/1.1 501 Not Implemented\r\n"));
+  ASSERT_NE(response.find("Connection: close\r\n"), std::string::npos);
+  ::close(chunked);
+
+  const int invalid = connect_to(server.get().get_port());
+  send_all(invalid, "GET / SPDY/9\r\n\r\n");
+  ASSERT_TRUE(receive_responses(invalid, 1).starts_with("HTTP/1.1 400 Bad Request\r\n"));
+  ::close(invalid);
+
+  ASSERT_GE(server.get().get_stats().accepted, 2);
+}
+
+TEST_P(net_server, large_body_round_trip) {
+  ServerFixture server{GetParam(), echo_path_and_body};
+  const int fd = connect_to(server.get().get_port());
+
+  // Larger than every read, write and provided buffer
+  const std::string body(256 * 1024, 'x');
+  send_all(fd, "POST /large HTTP/1.1\r\nContent-Length: " + std::to_string(body.size()) +
+                   "\r\nConnection: close\r\n\r\n" + body);
+
+  std::string received;
+  char buffer[4096];
+  for (ssize_t n; (n = receive_some(fd, buffer, sizeof(buffer))) > 0;) {
+    received.append(buffer, static_cast<size_t>(n));
+  }
+  ASSERT_TRUE(received.starts_with("HTTP/1.1 200 OK\r\n"));
+  ASSERT_TRUE(received.ends_with("\r\n\r\n/large" + body));
+  ::close(fd);
+}
+
+TEST_P(net_server, file_bodies_go_out_from_the_page_cache) {
+  // Several sendfile()/splice() rounds' worth, no two bytes alike nearby
+  std::string content(3 * 1024 * 1024 + 123, '\0');
+  for (size_t i = 0; i < content.size(); ++i) {
+    content[i] = static_cast<char>('a' + (i * 7 + i / 4096) % 26);
+  }
+
+  const auto file = make_unlinked_file(content);
+
+  ServerFixture server{GetParam(), [&](http::Request& request, http::Response& response) {
+                         if (request.get_uri().get_path_raw().compare(StringSlice::from_cstr("/part"))) {
+                           response.set_body_file({file, 1000, 10});
+                         } else {
+                           response.set_body_file({file, 0, content.size()});
+                         }
+                       }};
+  const int client = connect_to(server.get().get_port());
+
+  // Pipelined behind a whole file, and a HEAD that sends none of it
+  send_all(client,
+           "GET /all HTTP/1.1\r\n\r\n"
+           "HEAD /all HTTP/1.1\r\n\r\n"
+           "GET /part HTTP/1.1\r\nConnection: close\r\n\r\n");
+
+  std::string received;
+  char buffer[64 * 1024];
+  for (ssize_t n; (n = receive_some(client, buffer, sizeof(buffer))) > 0;) {
+    received.append(buffer, static_cast<size_t>(n));
+  }
+  ::close(client);
+
+  const std::string length_line = "Content-Length: " + std::to_string(content.size()) + "\r\n";
+  const auto first_body = received.find("\r\n\r\n") + 4;
+  ASSERT_NE(received.find(length_line), std::string::npos);
+  ASSERT_EQ(received.compare(first_body, content.size(), content), 0);
+
+  const std::string rest = received.substr(first_body + content.size());
+  ASSERT_TRUE(rest.starts_with("HTTP/1.1 200 OK\r\n"));
+  ASSERT_NE(rest.find(length_line), std::string::npos);
+  ASSERT_TRUE(rest.ends_with("\r\n\r\n" + content.substr(1000, 10)));
+}
+
+TEST_P(net_server, suspended_responses_keep_pipelined_order) {
+  TaskPool pool({.worker_count = 2});
+
+  ServerFixture server{GetParam(), [&pool](http::Request& request, http::Response& response) {
+                         if (!request.get_uri().get_path_raw().compare(StringSlice::from_cstr("/slow"))) {
+                           response.set_body(StringSlice::from_cstr("fast"));
+                           return;
+                         }
+
+                         ASSERT_NE(net::Server::get_current(), nullptr);
+                         net::DeferredResponse deferred = net::Server::get_current()->suspend();
+                         pool.submit([deferred]() mutable {
+                           std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                           deferred.resume([](http::Response& response) {
+                             response.set_body(StringSlice::from_cstr("slow"));
+                           });
+                         });
+                       }};
+  const int fd = connect_to(server.get().get_port());
+
+  send_all(fd,
+           "GET /slow HTTP/1.1\r\n\r\n"
+           "GET /fast HTTP/1.1\r\n\r\n"
+           "GET /slow HTTP/1.1\r\nConnection: close\r\n\r\n");
+  const std::string received = receive_responses(fd, 3);
+  const auto first = received.find("\r\n\r\nslow");
+  const auto second = received.find("\r\n\r\nfast");
+  const auto third = received.find("\r\n\r\nslow", first + 1);
+  ASSERT_NE(first, std::string::npos);
+  ASSERT_NE(second, std::string::npos);
+  ASSERT_NE(third, std::string::npos);
+  ASSERT_LT(first, second);
+  ASSERT_LT(second, third);
+
+  char byte;
+  ASSERT_EQ(receive_some(fd, &byte, 1), 0);
+  ::close(fd);
+
+  // A peer that leaves while suspended: the late resume is dropped
+  const int gone = connect_to(server.get().get_port());
+  send_all(gone, "GET /slow HTTP/1.1\r\n\r\n");
+  ::close(gone);
+
+  const int next = connect_to(server.get().get_port());
+  send_all(next, "GET /fast HTTP/1.1\r\nConnection: close\r\n\r\n");
+  ASSERT_TRUE(receive_responses(next, 1).ends_with("\r\n\r\nfast"));
+  ::close(next);
+}
+
+TEST_P(net_server, timeouts_close_slow_and_idle_connections) {
+  using std::chrono::milliseconds;
+  using std::chrono::steady_clock;
+  ServerFixture server{{.host = "127.0.0.1",
+                        .port = 0,
+                        .backend = GetParam(),
+                        .idle_timeout_ms = 150,
+                        .header_timeout_ms = 150,
+                        .body_timeout_ms = 150},
+                       [](http::Request&, http::Response& response) {
+                         response.set_body(StringSlice::from_cstr("ok"));
+                       }};
+  const auto port = server.get().get_port();
+  char byte;
+
+  // Connected, nothing sent; then headers trickled in faster than the
+  // timeout but never finished; then a body that stops short
+  const int silent = connect_to(port);
+  const int slowloris = connect_to(port);
+  const int slow_body = connect_to(port);
+  const auto start = steady_clock::now();
+  send_all(slow_body, "POST / HTTP/1.1\r\nContent-Length: 10\r\n\r\nab");
+  for (const char* part : {"GET / HTTP/1.1\r\n", "Host: x\r\n", "X-A: 1\r\n", "X-B: 2\r\n"}) {
+    send_all(slowloris, part);
+    std::this_thread::sleep_for(milliseconds(60));
+  }
+
+  for (const int fd : {silent, slowloris, slow_body}) {
+    ASSERT_EQ(receive_some(fd, &byte, 1), 0);
+    ::close(fd);
+  }
+  ASSERT_GE(steady_clock::now() - start, milliseconds(150));
+  ASSERT_LT(steady_clock::now() - start, milliseconds(1500));
+
+  // Requests closer together than the idle timeout keep a connection open,
+  // it's closed once they stop
+  const int active = connect_to(port);
+  for (int i = 0; i < 4; ++i) {
+    send_all(active, "GET / HTTP/1.1\r\n\r\n");
+    ASSERT_TRUE(receive_responses(active, 1).ends_with("\r\n\r\nok"));
+    std::this_thread::sleep_for(milliseconds(100));
+  }
+  ASSERT_EQ(receive_some(active, &byte, 1), 0);
+  ::close(active);
+}
+
+TEST_P(net_server, reads_pause_at_the_buffer_memory_limit) {
+  // Room for two of the smallest read buffers
+  ServerFixture server{{.host = "127.0.0.1",
+                        .port = 0,
+                        .backend = GetParam(),
+                        .buffer_memory_limit = 8 * 1024},
+                       [](http::Request&, http::Response& response) {
+                         response.set_body(StringSlice::from_cstr("ok"));
+                       }};
+  const auto port = server.get().get_port();
+
+  // Half a request each holds a buffer
+  const int first = connect_to(port);
+  const int second = connect_to(port);
+  send_all(first, "GET / HTTP/1.1\r\n");
+  send_all(second, "GET / HTTP/1.1\r\n");
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  const int third = connect_to(port);
+  send_all(third, "GET / HTTP/1.1\r\n\r\n");
+  if (server.get().get_backend() == net::Backend::Epoll) {
+    // Not read at all. io_uring has the bytes in by then and takes them
+    // anyway, only reading on is held off.
+    pollfd waiting{.fd = third, .events = POLLIN, .revents = 0};
+    ASSERT_EQ(::poll(&waiting, 1, 200), 0);
+  }
+
+  // Idle connections give their buffers back, the paused one goes on
+  send_all(first, "\r\n");
+  ASSERT_TRUE(receive_responses(first, 1).ends_with("\r\n\r\nok"));
+  ASSERT_TRUE(receive_responses(third, 1).ends_with("\r\n\r\nok"));
+  send_all(second, "\r\n");
+  ASSERT_TRUE(receive_responses(second, 1).ends_with("\r\n\r\nok"));
+
+  for (const int fd : {first, second, third}) {
+    send_all(fd, "GET / HTTP/1.1\r\n\r\n");
+    ASSERT_TRUE(receive_responses(fd, 1).ends_with("\r\n\r\nok"));
+    ::close(fd);
+  }
+}
+
+TEST_P(net_server, admission_control_refuses_unparsed_with_503) {
+  std::mutex mutex;
+  std::vector<net::DeferredResponse> held;
+  ServerFixture server{
+      {.host = "127.0.0.1",
+       .port = 0,
+       .backend = GetParam(),
+       .admission = {.max_in_flight = 1, .max_queue_time_ms = 50, .retry_after_s = 2}},
+      [&](http::Request& request, http::Response& response) {
+        const StringSlice path = request.get_uri().get_path_raw();
+        if (path.compare(StringSlice::from_cstr("/hold"))) {
+          std::lock_guard lock(mutex);
+          held.push_back(net::Server::get_current()->suspend());
+          return;
+        }
+        if (path.compare(StringSlice::from_cstr("/busy"))) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        response.set_body(StringSlice::from_cstr("ok"));
+      }};
+  const auto port = server.get().get_port();
+
+  const int holding = connect_to(port);
+  send_all(holding, "GET /hold HTTP/1.1\r\n\r\n");
+  while (true) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    std::lock_guard lock(mutex);
+    if (!held.empty()) {
+      break;
+    }
+  }
+
+  // Over the in-flight limit: refused before parsing, a method that would
+  // get 501 included, and the connection stays open
+  const int fd = connect_to(port);
+  send_all(fd, "GET / HTTP/1.1\r\n\r\nBREW / HTTP/1.1\r\n\r\n");
+  const std::string refused = receive_responses(fd, 2);
+  ASSERT_TRUE(refused.starts_with("HTTP/1.1 503 Service Unavailable\r\nRetry-After: 2\r\n"));
+  ASSERT_NE(refused.find("503", 20), std::string::npos);
+  ASSERT_EQ(refused.find("501"), std::string::npos);
+
+  {
+    std::lock_guard lock(mutex);
+    held[0].resume([](http::Response& response) {
+      response.set_body(StringSlice::from_cstr("held"));
+    });
+  }
+  ASSERT_TRUE(receive_responses(holding, 1).ends_with("\r\n\r\nheld"));
+  ::close(holding);
+
+  // Queued behind a slow handler for longer than max_queue_time
+  send_all(fd, "GET /busy HTTP/1.1\r\n\r\nGET / HTTP/1.1\r\n\r\n");
+  const std::string queued = receive_responses(fd, 2);
+  ASSERT_TRUE(queued.starts_with("HTTP/1.1 200 OK\r\n"));
+  ASSERT_TRUE(queued.ends_with("HTTP/1.1 503 Service Unavailable\r\nRetry-After: 2\r\n"
+                               "Content-Length: 0\r\n\r\n"));
+
+  send_all(fd, "GET / HTTP/1.1\r\n\r\n");
+  ASSERT_TRUE(receive_responses(fd, 1).ends_with("\r\n\r\nok"));
+  ::close(fd);
+}
+
+TEST(net_server_backend, epoll_is_used_when_asked_for) {
+  net::Server server({.host = "127.0.0.1", .port = 0},
+                     [](http::Request&, http::Response&) {});
+  ASSERT_TRUE(server.listen());
+  ASSERT_EQ(server.get_backend(), net::Backend::Epoll);
+}
@@ -0,0 +1,158 @@
+// SPDX-FileCopyrightText: (c) 2023 Ron Shabi <ron@ronsh.net>
+// SPDX-License-Identifier: Apache-2.0
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "cell/core/string_slice.hpp"
+#include "cell/core/task.hpp"
+#include "cell/net/stream.hpp"
+#include "net_test_util.hpp"
+
+using namespace cell;
+using namespace cell::test;
+using namespace std::chrono_literals;
+
+namespace {
+
+Task<bool> write_line(net::Stream& stream, StringSlice text) {
+  const bool written = co_await stream.write(text);
+  co_return written && co_await stream.write(StringSlice::from_cstr("\n"));
+}
+
+// Echoes every request's path twice, a little apart, then says bye
+Task<void> echo_paths(net::Stream& stream) {
+  while (http::Request* request = co_await stream.read_request()) {
+    const String path{request->get_uri().get_path_raw()};
+    co_await write_line(stream, path.slice());
+    co_await stream.sleep_for(5ms);
+    co_await write_line(stream, path.slice());
+  }
+  co_await stream.write(StringSlice::from_cstr("bye"));
+}
+
+}  // namespace
+
+class net_stream : public ::testing::TestWithParam<net::Backend> {};
+
+INSTANTIATE_TEST_SUITE_P(backends, net_stream,
+                         ::testing::Values(net::Backend::Epoll, net::Backend::IoUring));
+
+TEST_P(net_stream, handler_reads_writes_and_sleeps_in_order) {
+  ServerFixture server{GetParam(), echo_paths};
+  const int fd = connect_to(server.get().get_port());
+
+  send_all(fd, "GET /a HTTP/1.1\r\n\r\nGET /b HTTP/1.1\r\n\r\n");
+  std::this_thread::sleep_for(20ms);
+  send_all(fd, "GET /c HTTP/1.1\r\n\r\n");
+  ::shutdown(fd, SHUT_WR);
+
+  ASSERT_EQ(receive_all(fd), "/a\n/a\n/b\n/b\n/c\n/c\nbye");
+  ASSERT_EQ(server.get().get_stats().requests, 3);
+  ::close(fd);
+}
+
+TEST_P(net_stream, large_writes_wait_for_the_socket) {
+  const std::string chunk(256 * 1024, 'x');
+
+  ServerFixture server{GetParam(), [&chunk](net::Stream& stream) -> Task<void> {
+                        if (co_await stream.read_request() == nullptr) {
+                          co_return;
+                        }
+                        for (int i = 0; i < 16; ++i) {
+                          co_await stream.write(
+                              StringSlice{reinterpret_cast<const u8*>(chunk.data()), chunk.size()});
+                        }
+                      }};
+  const int fd = connect_to(server.get().get_port());
+  send_all(fd, "GET / HTTP/1.1\r\n\r\n");
+
+  // Let the server fill the socket and wait on it
+  std::this_thread::sleep_for(50ms);
+  ASSERT_EQ(receive_all(fd).size(), 16 * chunk.size());
+  ::close(fd);
+}
+
+TEST_P(net_stream, bad_requests_end_the_stream) {
+  std::atomic<int> ended{0};
+
+  ServerFixture server{GetParam(), [&ended](net::Stream& stream) -> Task<void> {
+                        while (co_await stream.read_request() != nullptr) {
+                        }
+                        ++ended;
+                      }};
+  const int fd = connect_to(server.get().get_port());
+  send_all(fd, "GET / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n");
+
+  ASSERT_TRUE(receive_all(fd).starts_with("HTTP/1.1 501 "));
+  ASSERT_EQ(ended.load(), 1);
+  ::close(fd);
+}
+
+TEST_P(net_stream, writes_fail_once_the_peer_is_gone) {
+  struct Counted {
+    std::atomic<int>* destroyed;
+    ~Counted() { ++*destroyed; }
+  };
+  std::atomic<int> destroyed{0};
+
+  ServerFixture server{GetParam(), [&](net::Stream& stream) -> Task<void> {
+                        Counted counted{&destroyed};
+                        if (co_await stream.read_request() == nullptr) {
+                          co_return;
+                        }
+                        co_await stream.write(StringSlice::from_cstr("sleeping"));
+                        co_await stream.sleep_for(50ms);
+                        // The peer is gone by now
+                        while (co_await stream.write(StringSlice::from_cstr("zzz"))) {
+                          co_await stream.sleep_for(1ms);
+                        }
+                      }};
+  const int fd = connect_to(server.get().get_port());
+  send_all(fd, "GET / HTTP/1.1\r\n\r\n");
+
+  char buffer[8];
+  ASSERT_EQ(::recv(fd, buffer, sizeof(buffer), MSG_WAITALL), 8);
+  ::close(fd);
+
+  for (int i = 0; i < 200 && destroyed.load() == 0; ++i) {
+    std::this_thread::sleep_for(5ms);
+  }
+  ASSERT_EQ(destroyed.load(), 1);
+  ASSERT_EQ(server.get().get_stats().active_connections, 0);
+}
+
+TEST_P(net_stream, rejected_requests_are_answered_and_skipped) {
+  // Each request holds the next one up for longer than it may queue
+  ServerFixture server{{.host = "127.0.0.1",
+                       .port = 0,
+                       .backend = GetParam(),
+                       .admission = {.max_queue_time_ms = 20}},
+                      [](net::Stream& stream) -> Task<void> {
+                        while (http::Request* request = co_await stream.read_request()) {
+                          const String path{request->get_uri().get_path_raw()};
+                          co_await write_line(stream, path.slice());
+                          co_await stream.sleep_for(50ms);
+                        }
+                        co_await stream.write(StringSlice::from_cstr("bye"));
+                      }};
+  const int fd = connect_to(server.get().get_port());
+
+  send_all(fd, "GET /a HTTP/1.1\r\n\r\nGET /b HTTP/1.1\r\n\r\n");
+  std::this_thread::sleep_for(100ms);
+  send_all(fd, "GET /c HTTP/1.1\r\n\r\n");
+  std::this_thread::sleep_for(100ms);
+  ::shutdown(fd, SHUT_WR);
+
+  ASSERT_EQ(receive_all(fd),
+            "/a\nHTTP/1.1 503 Service Unavailable\r\nRetry-After: 1\r\n"
+            "Content-Length: 0\r\n\r\n/c\nbye");
+  ASSERT_EQ(server.get().get_stats().rejected_queue_time, 1);
+  ::close(fd);
+}